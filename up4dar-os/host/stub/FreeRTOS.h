@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * FreeRTOS.h (host)
+ *
+ * Types and macros of FreeRTOS for the host builds of the firmware
+ * modules. There is only one thread, critical sections are empty.
+ * Semaphores, mutexes and queues are in host_rtos.c, a test can
+ * override them because they are weak.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+// from the ASF compiler.h, included by the AVR32 port
+typedef uint8_t U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef int8_t S8;
+typedef int16_t S16;
+typedef int32_t S32;
+
+typedef long portBASE_TYPE;
+typedef unsigned long portTickType;
+typedef unsigned long portSTACK_TYPE;
+
+typedef void (*pdTASK_CODE)(void *);
+typedef void * xTaskHandle;
+typedef struct host_queue * xQueueHandle;
+typedef struct host_queue * xSemaphoreHandle;
+
+#define pdFALSE		0
+#define pdTRUE		1
+#define pdPASS		1
+#define pdFAIL		0
+
+#define portMAX_DELAY		((portTickType) -1)
+#define portTICK_RATE_MS	1
+#define configTICK_RATE_HZ	1000
+#define configCPU_CLOCK_HZ	65536000
+#define configPBA_CLOCK_HZ	16384000
+#define configMINIMAL_STACK_SIZE	256
+
+#define portTASK_FUNCTION(f, p)		void f (void * p)
+#define portTASK_FUNCTION_PROTO(f, p)	void f (void * p)
+
+extern int host_critical_nesting;
+
+#define portENTER_CRITICAL()	(host_critical_nesting ++)
+#define portEXIT_CRITICAL()		(host_critical_nesting --)
+#define taskENTER_CRITICAL()	portENTER_CRITICAL()
+#define taskEXIT_CRITICAL()		portEXIT_CRITICAL()
+#define portENTER_SWITCHING_ISR()
+#define portEXIT_SWITCHING_ISR()
+#define portYIELD()
+
+void * pvPortMalloc (size_t size);
+void vPortFree (void * p);
+
+#endif
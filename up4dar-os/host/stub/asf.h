@@ -0,0 +1,40 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * asf.h (host)
+ *
+ * The cycle counter of the ASF: host_sys_count() in host_rtos.c counts
+ * configCPU_CLOCK_HZ cycles per second of host_ticks, a simulation can
+ * replace it. The registers are in avr32/io.h.
+ */
+
+#ifndef HOST_ASF_H_
+#define HOST_ASF_H_
+
+#include <stdint.h>
+
+#include <avr32/io.h>
+
+uint32_t host_sys_count (void);
+
+#define Get_sys_count()		host_sys_count()
+
+#endif
@@ -0,0 +1,193 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * avr32/io.h (host)
+ *
+ * Registers of the AVR32 peripherals used by the host builds, as plain
+ * memory. The tests model the hardware: they look at the registers
+ * after a firmware call and update the status registers.
+ */
+
+#ifndef HOST_AVR32_IO_H_
+#define HOST_AVR32_IO_H_
+
+#include <stdint.h>
+
+
+#define AVR32_INTC_INT0		0
+#define AVR32_INTC_INT1		1
+#define AVR32_INTC_INT2		2
+#define AVR32_INTC_INT3		3
+
+
+// PDCA
+
+typedef struct avr32_pdca_channel_t
+{
+	unsigned long mar;
+	unsigned long psr;
+	unsigned long tcr;
+	unsigned long marr;
+	unsigned long tcrr;
+	unsigned long cr;
+	unsigned long mr;
+	unsigned long sr;
+	unsigned long ier;
+	unsigned long idr;
+	unsigned long imr;
+	unsigned long isr;
+	unsigned long pad[4];
+} avr32_pdca_channel_t;
+
+typedef struct avr32_pdca_t
+{
+	avr32_pdca_channel_t channel[15];
+} avr32_pdca_t;
+
+extern volatile avr32_pdca_t AVR32_PDCA;
+
+#define AVR32_PDCA_CR_TEN_MASK		0x00000001
+#define AVR32_PDCA_CR_TDIS_MASK		0x00000002
+#define AVR32_PDCA_CR_ECLR_MASK		0x00000100
+#define AVR32_PDCA_ISR_RCZ_MASK		0x00000001
+#define AVR32_PDCA_ISR_TRC_MASK		0x00000002
+#define AVR32_PDCA_ISR_TERR_MASK	0x00000004
+#define AVR32_PDCA_IER_RCZ_MASK		0x00000001
+#define AVR32_PDCA_IER_TRC_MASK		0x00000002
+#define AVR32_PDCA_IDR_RCZ_MASK		0x00000001
+#define AVR32_PDCA_IDR_TRC_MASK		0x00000002
+#define AVR32_PDCA_TRANSFER_SIZE_BYTE		0
+#define AVR32_PDCA_TRANSFER_SIZE_HALF_WORD	1
+#define AVR32_PDCA_TRANSFER_SIZE_WORD		2
+
+#define AVR32_PDCA_IRQ_0	96
+
+
+// MACB, the bit fields in the order of a little endian host
+
+typedef struct avr32_macb_ncr_t
+{
+	unsigned int lb			: 1;
+	unsigned int llb		: 1;
+	unsigned int re			: 1;
+	unsigned int te			: 1;
+	unsigned int mpe		: 1;
+	unsigned int clrstat	: 1;
+	unsigned int incstat	: 1;
+	unsigned int westat		: 1;
+	unsigned int bp			: 1;
+	unsigned int tstart		: 1;
+	unsigned int thalt		: 1;
+	unsigned int			: 21;
+} avr32_macb_ncr_t;
+
+typedef struct avr32_macb_ncfgr_t
+{
+	unsigned int spd		: 1;
+	unsigned int fd			: 1;
+	unsigned int			: 1;
+	unsigned int jframe		: 1;
+	unsigned int caf		: 1;
+	unsigned int nbc		: 1;
+	unsigned int mti		: 1;
+	unsigned int uni		: 1;
+	unsigned int big		: 1;
+	unsigned int			: 1;
+	unsigned int clk		: 2;
+	unsigned int rty		: 1;
+	unsigned int pae		: 1;
+	unsigned int rbof		: 2;
+	unsigned int rlce		: 1;
+	unsigned int drfcs		: 1;
+	unsigned int efrhd		: 1;
+	unsigned int irxfcs		: 1;
+	unsigned int			: 12;
+} avr32_macb_ncfgr_t;
+
+typedef struct avr32_macb_rsr_t
+{
+	unsigned int bna		: 1;
+	unsigned int rec		: 1;
+	unsigned int ovr		: 1;
+	unsigned int			: 29;
+} avr32_macb_rsr_t;
+
+typedef struct avr32_macb_man_t
+{
+	unsigned int data		: 16;
+	unsigned int code		: 2;
+	unsigned int rega		: 5;
+	unsigned int phya		: 5;
+	unsigned int rw			: 2;
+	unsigned int sof		: 2;
+} avr32_macb_man_t;
+
+typedef struct avr32_macb_usrio_t
+{
+	unsigned int rmii		: 1;
+	unsigned int eam		: 1;
+	unsigned int			: 30;
+} avr32_macb_usrio_t;
+
+typedef struct avr32_macb_t
+{
+	union { unsigned long ncr; avr32_macb_ncr_t NCR; };
+	union { unsigned long ncfgr; avr32_macb_ncfgr_t NCFGR; };
+	unsigned long nsr;
+	unsigned long tsr;
+	unsigned long rbqp;
+	unsigned long tbqp;
+	union { unsigned long rsr; avr32_macb_rsr_t RSR; };
+	unsigned long isr;
+	unsigned long ier;
+	unsigned long idr;
+	unsigned long imr;
+	union { unsigned long man; avr32_macb_man_t MAN; };
+	unsigned long sa1b;
+	unsigned long sa1t;
+	union { unsigned long usrio; avr32_macb_usrio_t USRIO; };
+} avr32_macb_t;
+
+extern volatile avr32_macb_t AVR32_MACB;
+
+#define AVR32_MACB_TSR_UBR_MASK		0x00000001
+#define AVR32_MACB_TSR_COL_MASK		0x00000002
+#define AVR32_MACB_TSR_RLE_MASK		0x00000004
+#define AVR32_MACB_TSR_TGO_MASK		0x00000008
+#define AVR32_MACB_TSR_BEX_MASK		0x00000010
+#define AVR32_MACB_TSR_COMP_MASK	0x00000020
+#define AVR32_MACB_TSR_UND_MASK		0x00000040
+#define AVR32_MACB_RSR_BNA_MASK		0x00000001
+#define AVR32_MACB_RSR_REC_MASK		0x00000002
+#define AVR32_MACB_RSR_OVR_MASK		0x00000004
+#define AVR32_MACB_IER_RCOMP_MASK	0x00000002
+#define AVR32_MACB_IER_RXUBR_MASK	0x00000004
+#define AVR32_MACB_IER_TXUBR_MASK	0x00000008
+#define AVR32_MACB_IER_TUND_MASK	0x00000010
+#define AVR32_MACB_IER_RLE_MASK		0x00000020
+#define AVR32_MACB_IER_TXERR_MASK	0x00000040
+#define AVR32_MACB_IER_TCOMP_MASK	0x00000080
+#define AVR32_MACB_IER_ROVR_MASK	0x00000400
+
+#define AVR32_MACB_IRQ		832
+
+
+#endif
@@ -0,0 +1,130 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dstar_env.c
+ *
+ * The modules around the D-STAR receive path of dstar.c for the host:
+ * display, PHY, recorder, last heard list, slow data and the AMBE task
+ * do nothing. rtclock ticks are host_ticks. All functions are weak, a
+ * test or tool replaces the ones it looks at (e.g. ambe_input_data,
+ * the sink of rx_q_process).
+ */
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+#include "up_dstar/dstar.h"
+#include "up_dstar/vdisp.h"
+#include "up_dstar/rtclock.h"
+#include "up_dstar/phycomm.h"
+#include "up_dstar/r2cs.h"
+#include "up_dstar/ambe.h"
+#include "up_dstar/recorder.h"
+#include "up_dstar/lastheard.h"
+#include "up_dstar/slowdata.h"
+#include "up_dstar/settings.h"
+#include "up_app/a_lib_internal.h"
+
+#define WEAK	__attribute__((weak))
+
+settings_t settings;
+
+char dcs_mode;
+char hotspot_mode;
+char repeater_mode;
+
+struct vdisp_font vdisp_fonts[4];
+
+WEAK void vdisp_prints_xy (int x, int y, struct vdisp_font * font, int disp_inverse, const char * s) { }
+WEAK void vdisp_clear_rect (int x, int y, int width, int height) { }
+WEAK void vdisp_set_pixel (int x, int y, int disp_inverse, unsigned char data, int numbits) { }
+WEAK void vd_set_pixel (int layer, int x, int y, int disp_inverse, unsigned char data, int numbits) { }
+WEAK void vd_prints_xy (int layer, int x, int y, struct vdisp_font * font, int disp_inverse, const char * s) { }
+WEAK void vd_copy_screen (int dst, int src, int y_from, int y_to) { }
+
+WEAK void vdisp_i2s (char * buf, int size, int base, int leading_zero, unsigned int n)
+{
+	int i;
+
+	for (i=size - 1; i >= 0; i--)
+	{
+		buf[i] = ((n == 0) && (i < (size - 1)) && !leading_zero) ? ' ' : "0123456789ABCDEF"[n % base];
+		n /= base;
+	}
+
+	buf[size] = 0;
+}
+
+WEAK unsigned long volatile the_clock = 1000;
+
+WEAK unsigned long rtclock_get_ticks (void)
+{
+	return host_ticks;
+}
+
+static unsigned long rx_ticks;
+
+WEAK long rtclock_get_rx_ticks (void)
+{
+	return host_ticks - rx_ticks;
+}
+
+WEAK void rtclock_reset_rx_ticks (void)
+{
+	rx_ticks = host_ticks;
+}
+
+WEAK void rtclock_disp_xy (int x, int y, int dots, int display_seconds) { }
+
+WEAK void phyCommSend (const char * buf, int len) { }
+WEAK void phyCommSendCmd (const char * cmd, int len) { }
+
+WEAK void r2cs_append (const char urcall[8]) { }
+
+WEAK int ambe_input_data (const uint8_t * d, const struct latency_tag * tag)
+{
+	return 0;
+}
+
+WEAK void ambe_set_header_exp_timer (int enable) { }
+WEAK void ambe_ref_timer_break (int enable) { }
+
+WEAK void recorder_start (uint8_t dir_source, const uint8_t * header) { }
+WEAK void recorder_put_frame (const uint8_t * ambe_data) { }
+WEAK void recorder_stop (uint8_t dir_source) { }
+
+WEAK void lastheard_header (uint8_t source, const uint8_t * header) { }
+WEAK void lastheard_end (uint8_t source, uint32_t frames, uint16_t ber) { }
+
+WEAK void slowdata_register (uint8_t type, slowdata_handler_t func) { }
+WEAK void slowdata_rx_reset (void) { }
+WEAK void slowdata_rx_frame (uint8_t pos, const uint8_t * data, uint8_t source) { }
+WEAK void slowdata_data_input (const unsigned char * data, unsigned char len) { }
+
+// defaults of settings.c for the receive path
+
+void host_dstar_settings (void)
+{
+	SETTING_CHAR(C_RX_JB_MIN_DEPTH) = 2;
+	SETTING_CHAR(C_RX_JB_MAX_DEPTH) = 42;
+	SETTING_CHAR(C_RX_ARBITRATION) = 0;
+}
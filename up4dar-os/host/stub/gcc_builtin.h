@@ -0,0 +1,34 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * gcc_builtin.h (host)
+ *
+ * The firmware declares the C library functions itself, the host
+ * uses the C library headers.
+ */
+
+#ifndef GCC_BUILTIN_H_
+#define GCC_BUILTIN_H_
+
+#include <string.h>
+#include <stdlib.h>
+
+#endif
@@ -0,0 +1,202 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * host_rtos.c
+ *
+ * FreeRTOS functions for the host builds: queues with copied items,
+ * semaphores are queues of one item. There are no other tasks, nothing
+ * blocks. All functions are weak, a test can replace them.
+ */
+
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+#include <asf.h>
+
+#include <avr32/io.h>
+#include "intc.h"
+
+#include "up_net/snmp_data.h"
+
+#define WEAK	__attribute__((weak))
+
+struct host_queue
+{
+	unsigned long length;
+	unsigned long item_size;
+	unsigned long count;
+	unsigned long in;
+	uint8_t * buf;
+};
+
+int host_critical_nesting;
+portTickType host_ticks;
+
+WEAK void * pvPortMalloc (size_t size)
+{
+	return malloc(size);
+}
+
+WEAK void vPortFree (void * p)
+{
+	free(p);
+}
+
+WEAK xQueueHandle xQueueCreate (unsigned long length, unsigned long item_size)
+{
+	xQueueHandle q = calloc(1, sizeof (struct host_queue));
+
+	q->length = length;
+	q->item_size = item_size;
+	q->buf = calloc(length, (item_size > 0) ? item_size : 1);
+
+	return q;
+}
+
+WEAK portBASE_TYPE xQueueSend (xQueueHandle q, const void * item, portTickType wait)
+{
+	if (q->count >= q->length)
+		return pdFALSE;
+
+	memcpy(q->buf + ((q->in + q->count) % q->length) * q->item_size, item, q->item_size);
+	q->count ++;
+
+	return pdTRUE;
+}
+
+WEAK portBASE_TYPE xQueueSendFromISR (xQueueHandle q, const void * item, portBASE_TYPE * woken)
+{
+	if (woken != NULL)
+	{
+		*woken = pdFALSE;
+	}
+
+	return xQueueSend(q, item, 0);
+}
+
+WEAK portBASE_TYPE xQueueReceive (xQueueHandle q, void * item, portTickType wait)
+{
+	if (q->count == 0)
+		return pdFALSE;
+
+	memcpy(item, q->buf + q->in * q->item_size, q->item_size);
+	q->in = (q->in + 1) % q->length;
+	q->count --;
+
+	return pdTRUE;
+}
+
+WEAK unsigned long uxQueueMessagesWaiting (xQueueHandle q)
+{
+	return q->count;
+}
+
+WEAK xSemaphoreHandle xSemaphoreCreateMutex (void)
+{
+	xSemaphoreHandle s = xQueueCreate(1, 0);
+
+	s->count = 1;
+
+	return s;
+}
+
+WEAK portBASE_TYPE xSemaphoreTake (xSemaphoreHandle s, portTickType wait)
+{
+	if (s->count == 0)
+		return pdFALSE;
+
+	s->count = 0;
+
+	return pdTRUE;
+}
+
+WEAK portBASE_TYPE xSemaphoreGive (xSemaphoreHandle s)
+{
+	s->count = 1;
+
+	return pdTRUE;
+}
+
+WEAK portBASE_TYPE xSemaphoreGiveFromISR (xSemaphoreHandle s, portBASE_TYPE * woken)
+{
+	if (woken != NULL)
+	{
+		*woken = pdTRUE;
+	}
+
+	return xSemaphoreGive(s);
+}
+
+WEAK portBASE_TYPE xTaskCreate (pdTASK_CODE code, const signed char * name, unsigned short stack,
+	void * param, unsigned long prio, xTaskHandle * handle)
+{
+	return pdPASS;  // the test calls the task functions itself
+}
+
+WEAK portTickType xTaskGetTickCount (void)
+{
+	return host_ticks;
+}
+
+WEAK void vTaskDelay (portTickType ticks)
+{
+	host_ticks += ticks;
+}
+
+WEAK uint32_t host_sys_count (void)
+{
+	return host_ticks * (configCPU_CLOCK_HZ / configTICK_RATE_HZ);
+}
+
+
+// peripherals and interrupt controller
+
+volatile avr32_pdca_t AVR32_PDCA;
+volatile avr32_macb_t AVR32_MACB;
+
+__int_handler host_int_handler[HOST_NUM_IRQ];
+
+WEAK void INTC_register_interrupt (__int_handler handler, unsigned int irq, unsigned int int_level)
+{
+	host_int_handler[irq] = handler;
+}
+
+
+// SNMP: the last value is kept for the tests
+
+int32_t host_snmp_value;
+
+WEAK int snmp_encode_int (int32_t value, uint8_t * res, int * res_len, int maxlen)
+{
+	host_snmp_value = value;
+
+	res[0] = value >> 24;
+	res[1] = value >> 16;
+	res[2] = value >> 8;
+	res[3] = value;
+	*res_len = 4;
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * host_time.h
+ *
+ * Time measurement for the benchmarks of the host builds
+ *
+ */
+
+
+#ifndef HOST_TIME_H_
+#define HOST_TIME_H_
+
+#include <stdint.h>
+#include <time.h>
+
+
+static inline uint64_t host_nsec (void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return ((uint64_t) t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+// CPU cycles (time stamp counter) on x86, nanoseconds elsewhere
+
+static inline uint64_t host_cycles (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return host_nsec();
+#endif
+}
+
+// keeps the compiler from removing a benchmarked calculation
+
+static volatile uint32_t host_sink;
+
+#endif /* HOST_TIME_H_ */
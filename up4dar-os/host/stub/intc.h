@@ -0,0 +1,42 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * intc.h (host)
+ *
+ * Interrupt handlers are registered in a table, a test calls them
+ * like the interrupt controller would. They are plain functions on
+ * the host, so the naked attribute of the AVR32 handlers is removed.
+ */
+
+#ifndef HOST_INTC_H_
+#define HOST_INTC_H_
+
+#define __naked__
+
+#define HOST_NUM_IRQ	1024
+
+typedef void (* __int_handler) (void);
+
+extern __int_handler host_int_handler[HOST_NUM_IRQ];
+
+void INTC_register_interrupt (__int_handler handler, unsigned int irq, unsigned int int_level);
+
+#endif
@@ -0,0 +1,382 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * macb_model.c (host)
+ *
+ * MACB, see macb_model.h. Registers of the host are plain memory: the
+ * model keeps the real RSR, TSR and IMR and looks at the registers after
+ * the firmware calls. The firmware functions are weak references, a
+ * test links only the driver it uses (eth.c, eth_txmem.c).
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#include "FreeRTOS.h"
+
+#include <avr32/io.h>
+#include "intc.h"
+
+#include "macb_model.h"
+
+
+#define RX_OWN		0x01
+#define RX_WRAP		0x02
+#define RX_SOF		0x4000
+#define RX_EOF		0x8000
+
+#define RX_BUF_SIZE	128
+
+#define TX_USED		0x80000000
+#define TX_WRAP		0x40000000
+#define TX_LAST		0x00008000
+#define TX_LEN		0x000007FF
+
+// 100 MBit/s, preamble, FCS and inter frame gap are 24 bytes
+#define TX_CYCLES(len)	((((len) + 24) * 8 * (uint64_t) configCPU_CLOCK_HZ) / 100000000)
+
+#define TX_ERRORS	(AVR32_MACB_TSR_RLE_MASK | AVR32_MACB_TSR_BEX_MASK | AVR32_MACB_TSR_UND_MASK)
+
+// CPU id in the user page of the flash
+#define CPU_ID_PAGE		0x80800000UL
+
+#define WEAK_REF	__attribute__((weak))
+
+void eth_init (void) WEAK_REF;
+int eth_rx (int budget) WEAK_REF;
+void eth_txmem_flush_q (void) WEAK_REF;
+
+int macb_rx_pos;
+
+static unsigned long rsr;			// RSR of the MACB
+static unsigned long rsr_during;	// bits set while the firmware runs
+static unsigned long imr;
+
+static unsigned long tsr;
+static unsigned long * tx_base;		// descriptor list, TBQP
+static int tx_pos;					// first descriptor of the frame being sent
+static int tx_running;
+static uint32_t tx_end;				// the frame is sent at this time
+
+static uint8_t tx_frame[2048];
+static int tx_len;
+
+void (* macb_tx_sent) (const uint8_t * frame, int len);
+long macb_tx_frames;
+long macb_tx_starts;
+
+
+static void update_imr (void)
+{
+	imr = (imr & ~AVR32_MACB.idr) | AVR32_MACB.ier;
+
+	AVR32_MACB.idr = 0;
+	AVR32_MACB.ier = 0;
+	AVR32_MACB.imr = imr;
+}
+
+void macb_eth_init (void)
+{
+	void * p = mmap((void *) CPU_ID_PAGE, 4096, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	assert(p == (void *) CPU_ID_PAGE);
+
+	memset(p + 0x204, 0x42, 3);
+
+	eth_init();
+	macb_poll(0);
+
+	assert(AVR32_MACB.NCR.re && (imr != 0));
+
+	macb_rx_pos = 0;
+	rsr = 0;
+}
+
+
+static unsigned long * descriptor (int n)
+{
+	return (unsigned long *) AVR32_MACB.rbqp + (n << 1);
+}
+
+// number of descriptors, the last one has the wrap bit
+
+static int ring_len (void)
+{
+	int n = 1;
+
+	while ((descriptor(n - 1)[0] & RX_WRAP) == 0)
+	{
+		n ++;
+	}
+
+	return n;
+}
+
+static void set_rsr (unsigned long bits)
+{
+	rsr |= bits;
+	rsr_during |= bits;
+}
+
+
+void macb_interrupt (unsigned long bits)
+{
+	AVR32_MACB.isr |= bits;
+
+	if ((imr & bits) != 0)
+	{
+		host_int_handler[AVR32_MACB_IRQ]();
+		AVR32_MACB.isr = 0;  // clear on read
+	}
+}
+
+
+int macb_rx_frame (const uint8_t * frame, int len)
+{
+	int count = ring_len();
+	int n = (len + RX_BUF_SIZE - 1) / RX_BUF_SIZE;
+	int i;
+
+	for (i=0; i < n; i++)
+	{
+		if ((descriptor((macb_rx_pos + i) % count)[0] & RX_OWN) != 0)
+		{
+			set_rsr(AVR32_MACB_RSR_BNA_MASK);
+			macb_interrupt(AVR32_MACB_IER_RXUBR_MASK);
+			return 1;
+		}
+	}
+
+	for (i=0; i < n; i++)
+	{
+		unsigned long * d = descriptor(macb_rx_pos);
+		int c = len - (i * RX_BUF_SIZE);
+
+		if (c > RX_BUF_SIZE)
+		{
+			c = RX_BUF_SIZE;
+		}
+
+		memcpy((uint8_t *) (d[0] & ~3UL), frame + i * RX_BUF_SIZE, c);
+
+		d[1] = ((i == 0) ? RX_SOF : 0) | ((i == (n - 1)) ? (RX_EOF | len) : 0);
+		d[0] |= RX_OWN;
+
+		macb_rx_pos = (macb_rx_pos + 1) % count;
+	}
+
+	set_rsr(AVR32_MACB_RSR_REC_MASK);
+	macb_interrupt(AVR32_MACB_IER_RCOMP_MASK);
+
+	return 0;
+}
+
+
+void macb_rx_skip (int n)
+{
+	macb_rx_pos = (macb_rx_pos + n) % ring_len();
+}
+
+void macb_rx_overrun (void)
+{
+	set_rsr(AVR32_MACB_RSR_OVR_MASK);
+	macb_interrupt(AVR32_MACB_IER_ROVR_MASK);
+}
+
+
+// eth_rx() writes back the bits it has read, bits set by frames that
+// arrive during the call stay set
+
+int macb_eth_rx (int budget)
+{
+	int more;
+
+	AVR32_MACB.rsr = rsr;
+	rsr_during = 0;
+
+	more = eth_rx(budget);
+
+	rsr = (rsr & ~AVR32_MACB.rsr) | rsr_during;
+	AVR32_MACB.rsr = rsr;
+
+	return more;
+}
+
+
+// transmitter
+
+static unsigned long * tx_descriptor (int n)
+{
+	return tx_base + (n << 1);
+}
+
+static int tx_next (int n)
+{
+	return ((tx_descriptor(n)[1] & TX_WRAP) != 0) ? 0 : (n + 1);
+}
+
+static void tx_stop (void)
+{
+	tx_running = 0;
+	tsr &= ~AVR32_MACB_TSR_TGO_MASK;
+	AVR32_MACB.tsr = tsr;
+}
+
+// the frame at tx_pos is read from memory, a used descriptor after the
+// first one is an error (buffers exhausted mid frame)
+
+static void tx_start (uint32_t now)
+{
+	int n = tx_pos;
+
+	if ((tx_descriptor(n)[0] == 0) || ((tx_descriptor(n)[1] & TX_USED) != 0))
+	{
+		tsr |= AVR32_MACB_TSR_UBR_MASK;
+		tx_stop();
+		macb_interrupt(AVR32_MACB_IER_TXUBR_MASK);
+		return;
+	}
+
+	tx_len = 0;
+
+	while (1)
+	{
+		unsigned long * d = tx_descriptor(n);
+		int len = d[1] & TX_LEN;
+
+		if ((n != tx_pos) && ((d[1] & TX_USED) != 0))
+		{
+			tsr |= AVR32_MACB_TSR_BEX_MASK;
+			tx_pos = 0;
+			tx_stop();
+			macb_interrupt(AVR32_MACB_IER_TXERR_MASK);
+			return;
+		}
+
+		assert((tx_len + len) <= sizeof tx_frame);
+		memcpy(tx_frame + tx_len, (const uint8_t *) d[0], len);
+		tx_len += len;
+
+		if ((d[1] & TX_LAST) != 0)
+			break;
+
+		n = tx_next(n);
+	}
+
+	tx_running = 1;
+	tx_end = now + TX_CYCLES(tx_len);
+
+	tsr |= AVR32_MACB_TSR_TGO_MASK;
+	AVR32_MACB.tsr = tsr;
+}
+
+// the frame has been sent: used bit in its first descriptor, on to the
+// next frame
+
+static void tx_complete (void)
+{
+	int n = tx_pos;
+
+	tx_descriptor(n)[1] |= TX_USED;
+
+	while ((tx_descriptor(n)[1] & TX_LAST) == 0)
+	{
+		n = tx_next(n);
+	}
+
+	tx_pos = tx_next(n);
+	macb_tx_frames ++;
+
+	if (macb_tx_sent != NULL)
+	{
+		macb_tx_sent(tx_frame, tx_len);
+	}
+
+	tsr |= AVR32_MACB_TSR_COMP_MASK;
+	macb_interrupt(AVR32_MACB_IER_TCOMP_MASK);
+}
+
+
+void macb_poll (uint32_t now)
+{
+	update_imr();
+
+	if (AVR32_MACB.tbqp != 0)  // TBQP written: back to the first descriptor
+	{
+		tx_base = (unsigned long *) AVR32_MACB.tbqp;
+		tx_pos = 0;
+		AVR32_MACB.tbqp = 0;
+	}
+
+	if (AVR32_MACB.NCR.tstart)  // no effect if the transmitter is running
+	{
+		AVR32_MACB.NCR.tstart = 0;
+
+		if (!tx_running && (tx_base != NULL))
+		{
+			macb_tx_starts ++;
+			tx_start(now);
+		}
+	}
+}
+
+int macb_tx_run (uint32_t now)
+{
+	long frames = macb_tx_frames;
+
+	while (tx_running && ((int32_t) (now - tx_end) >= 0))
+	{
+		tx_complete();
+		tx_start(tx_end);
+	}
+
+	return macb_tx_frames - frames;
+}
+
+void macb_tx_error (unsigned long tsr_bits)
+{
+	tsr |= tsr_bits;
+	tx_pos = 0;
+	tx_stop();
+	macb_interrupt(AVR32_MACB_IER_TXERR_MASK);
+}
+
+
+// A write of TSR is not seen in plain memory. eth_txmem_flush_q() writes
+// back the error bits it has read and resets the ring (TBQP) in the
+// same call, the error bits are cleared if TBQP was written.
+
+void macb_eth_txmem_flush_q (uint32_t now)
+{
+	AVR32_MACB.tsr = tsr;
+
+	eth_txmem_flush_q();
+
+	if (((tsr & TX_ERRORS) != 0) && (AVR32_MACB.tbqp != 0))
+	{
+		tsr &= ~TX_ERRORS;
+	}
+
+	AVR32_MACB.tsr = tsr;
+	macb_poll(now);
+}
@@ -0,0 +1,78 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * macb_model.h (host)
+ *
+ * Model of the MACB on the registers of avr32/io.h and the descriptor
+ * rings of eth.c and eth_txmem.c: frames are written to the receive
+ * buffers and read from the transmit buffers the way the MACB does it,
+ * RSR and TSR are write-1-to-clear, ISR is clear-on-read and the
+ * interrupt is raised if it is enabled in IMR.
+ */
+
+#ifndef MACB_MODEL_H_
+#define MACB_MODEL_H_
+
+#include <stdint.h>
+
+// maps the CPU id (read by eth_init) and calls eth_init
+void macb_eth_init (void);
+
+// a frame from the wire, returns 1 if it was dropped (no free buffer)
+int macb_rx_frame (const uint8_t * frame, int len);
+
+// the MACB goes on n buffers further on (frames lost in an overrun)
+void macb_rx_skip (int n);
+
+// RSR.OVR: a frame was lost, the receiver was too slow
+void macb_rx_overrun (void);
+
+// descriptor of the next frame
+extern int macb_rx_pos;
+
+// eth_rx() with write-1-to-clear of RSR
+int macb_eth_rx (int budget);
+
+// sets ISR bits, calls the interrupt handler if one of them is enabled
+void macb_interrupt (unsigned long bits);
+
+// after a call of the firmware: IER, IDR, TBQP and TSTART
+void macb_poll (uint32_t now);
+
+
+// the transmitter sends at 100 MBit/s in simulated time (cycles)
+
+// sends the frames up to the time now, returns the number of frames
+int macb_tx_run (uint32_t now);
+
+// called for every frame sent
+extern void (* macb_tx_sent) (const uint8_t * frame, int len);
+
+extern long macb_tx_frames;
+extern long macb_tx_starts;		// TSTART while the transmitter was stopped
+
+// TX error (TSR bits): the MACB stops and goes back to the first descriptor
+void macb_tx_error (unsigned long tsr_bits);
+
+// eth_txmem_flush_q() with write-1-to-clear of TSR, then macb_poll()
+void macb_eth_txmem_flush_q (uint32_t now);
+
+#endif
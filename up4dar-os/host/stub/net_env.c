@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * net_env.c
+ *
+ * The modules around ipv4.c for the host: every neighbor is known with
+ * the same MAC addr and a packet to a neighbor is freed, DHCP is not
+ * ready, SNMP has no answer, ARP does nothing and random numbers come
+ * from rand(). All functions are weak, a test replaces the ones it
+ * looks at (e.g. ipneigh_send_packet, the sink of the TX path).
+ */
+
+#include "FreeRTOS.h"
+
+#include "up_io/eth_txmem.h"
+#include "up_net/ipneigh.h"
+#include "up_net/arp.h"
+#include "up_net/snmp.h"
+#include "up_net/dhcp.h"
+#include "up_crypto/up_crypto.h"
+
+#define WEAK	__attribute__((weak))
+
+WEAK void ipneigh_init (void) { }
+WEAK void ipneigh_rx (const ip_addr_t * a, const mac_addr_t * m, int solicited) { }
+WEAK void ipneigh_changed (void) { }
+
+WEAK uint32_t ipneigh_generation (void)
+{
+	return 1;
+}
+
+WEAK int ipneigh_get_mac (const ip_addr_t * a, mac_addr_t * m)
+{
+	static const uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+	memcpy(m->addr, mac, sizeof mac);
+	return 1;
+}
+
+WEAK void ipneigh_send_packet (const ip_addr_t * a, eth_txmem_t * packet)
+{
+	eth_txmem_free(packet);
+}
+
+WEAK void arp_process_packet (uint8_t * raw_packet) { }
+
+WEAK int dhcp_is_ready (void)
+{
+	return 0;
+}
+
+WEAK eth_txmem_t * snmp_process_request (const uint8_t * req, int req_len, int * data_len)
+{
+	return NULL;
+}
+
+WEAK int crypto_get_random_15bit (void)
+{
+	return rand() & 0x7FFF;
+}
+
+WEAK int crypto_get_random_16bit (void)
+{
+	return rand() & 0xFFFF;
+}
@@ -0,0 +1,38 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * queue.h (host)
+ */
+
+#ifndef HOST_QUEUE_H_
+#define HOST_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+xQueueHandle xQueueCreate (unsigned long length, unsigned long item_size);
+portBASE_TYPE xQueueSend (xQueueHandle q, const void * item, portTickType wait);
+portBASE_TYPE xQueueReceive (xQueueHandle q, void * item, portTickType wait);
+portBASE_TYPE xQueueSendFromISR (xQueueHandle q, const void * item, portBASE_TYPE * woken);
+unsigned long uxQueueMessagesWaiting (xQueueHandle q);
+
+#define xQueueSendToBack	xQueueSend
+
+#endif
@@ -0,0 +1,526 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * sd_card_emu.c
+ *
+ * sd_spi.c for the host: every byte sent by the SD card driver clocks
+ * a state machine of an SD card (SPI mode). Commands, R1/R3/R7
+ * responses, CSD, single and multiple block reads and writes with data
+ * tokens, stop token, CMD12 and the busy signal after writes. The card
+ * needs time for the access of a read, for each block written and for
+ * the stop; the SPI clock (set by sdcard.c) gives the time of each byte.
+ *
+ * The time is counted in CPU cycles (sd_emu_now). The SD card task
+ * started by sdcard_init() runs as a coroutine: it runs in sd_emu_run()
+ * until it sleeps (vTaskDelay), waits on a semaphore or for a DMA
+ * transfer longer than SD_SPI_POLL_LEN. The test runs in between.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ucontext.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <asf.h>
+
+#include "sd_spi.h"
+#include "sd_card_emu.h"
+
+
+uint64_t sd_emu_now;
+struct sd_card_emu sd_card;
+
+static uint32_t spi_hz;
+static int chip_select;
+
+
+// the SD card task as coroutine
+
+static ucontext_t main_ctx, task_ctx;
+static char task_stack[1 << 20];
+static pdTASK_CODE task_code;
+static int in_task;
+
+static void task_yield (void)
+{
+	if (in_task)
+	{
+		in_task = 0;
+		swapcontext(&task_ctx, &main_ctx);
+	}
+}
+
+void sd_emu_run (void)
+{
+	in_task = 1;
+	swapcontext(&main_ctx, &task_ctx);
+}
+
+void sd_emu_run_ms (int ms)
+{
+	uint64_t end = sd_emu_now + SD_EMU_MS(ms);
+
+	while (sd_emu_now < end)
+	{
+		sd_emu_run();
+	}
+}
+
+static void task_start (void)
+{
+	task_code(NULL);
+}
+
+portBASE_TYPE xTaskCreate (pdTASK_CODE code, const signed char * name, unsigned short stack,
+	void * param, unsigned long prio, xTaskHandle * handle)
+{
+	assert(task_code == NULL);  // only the SD card task
+
+	task_code = code;
+
+	getcontext(&task_ctx);
+	task_ctx.uc_stack.ss_sp = task_stack;
+	task_ctx.uc_stack.ss_size = sizeof task_stack;
+	task_ctx.uc_link = NULL;
+	makecontext(&task_ctx, task_start, 0);
+
+	return pdPASS;
+}
+
+portTickType xTaskGetTickCount (void)
+{
+	return sd_emu_now / SD_EMU_MS(1);
+}
+
+void vTaskDelay (portTickType ticks)
+{
+	sd_emu_now += SD_EMU_MS(ticks);
+	task_yield();
+}
+
+uint32_t host_sys_count (void)
+{
+	return (uint32_t) sd_emu_now;
+}
+
+// the test runs while the task waits, it may give the semaphore
+
+portBASE_TYPE xSemaphoreTake (xSemaphoreHandle s, portTickType wait)
+{
+	uint8_t dummy;
+
+	if (xQueueReceive(s, &dummy, 0) == pdTRUE)
+	{
+		task_yield();
+		return pdTRUE;
+	}
+
+	task_yield();
+
+	if (xQueueReceive(s, &dummy, 0) == pdTRUE)
+		return pdTRUE;
+
+	sd_emu_now += SD_EMU_MS(wait);
+	return pdFALSE;
+}
+
+
+// card
+
+enum { MODE_CMD, MODE_READ, MODE_WRITE_TOKEN, MODE_WRITE_DATA };
+
+static uint64_t usec (uint32_t n)
+{
+	return (uint64_t) n * (configCPU_CLOCK_HZ / 1000000);
+}
+
+static uint64_t byte_time (void)
+{
+	return 8ULL * configCPU_CLOCK_HZ / spi_hz;
+}
+
+static void out_put (uint8_t b)
+{
+	sd_card.outq[sd_card.out_tail++ & (sizeof sd_card.outq - 1)] = b;
+}
+
+static void out_clear (void)
+{
+	sd_card.out_head = sd_card.out_tail;
+}
+
+static void r1 (uint8_t r)
+{
+	out_put(0xFF);  // one byte NCR
+	out_put(r);
+}
+
+static void data_block (const uint8_t * d, int len)
+{
+	int i;
+
+	out_put(0xFE);
+
+	for (i=0; i < len; i++)
+	{
+		out_put(d[i]);
+	}
+
+	out_put(0x12);  // CRC is not checked by the driver
+	out_put(0x34);
+}
+
+static void command (void)
+{
+	int cmd = sd_card.cmd[0] & 0x3F;
+	uint32_t arg = ((uint32_t) sd_card.cmd[1] << 24) | (sd_card.cmd[2] << 16) |
+		(sd_card.cmd[3] << 8) | sd_card.cmd[4];
+	uint32_t blk = sd_card.sdhc ? arg : (arg >> 9);
+	uint8_t idle = sd_card.ready ? 0x00 : 0x01;
+	int app = sd_card.app_cmd;
+
+	sd_card.app_cmd = 0;
+	sd_card.cmds[cmd] ++;
+
+	if ((sd_card.mode == MODE_READ) && (cmd != 12))  // ignored while sending data
+		return;
+
+	switch (cmd)
+	{
+		case 0:  // GO_IDLE_STATE
+			sd_card.ready = 0;
+			sd_card.acmd41 = 0;
+			sd_card.mode = MODE_CMD;
+			r1(0x01);
+			break;
+
+		case 8:  // SEND_IF_COND
+			r1(idle);
+			out_put(0);
+			out_put(0);
+			out_put(0x01);
+			out_put(arg & 0xFF);
+			break;
+
+		case 55:  // APP_CMD
+			sd_card.app_cmd = 1;
+			r1(idle);
+			break;
+
+		case 41:  // SD_SEND_OP_COND, ready after the third
+			if (!app)
+			{
+				r1(idle | 0x04);
+				break;
+			}
+
+			if (++ sd_card.acmd41 >= 3)
+			{
+				sd_card.ready = 1;
+			}
+
+			r1(sd_card.ready ? 0x00 : 0x01);
+			break;
+
+		case 58:  // READ_OCR
+			r1(idle);
+			out_put(sd_card.sdhc ? 0xC0 : 0x80);
+			out_put(0xFF);
+			out_put(0x80);
+			out_put(0);
+			break;
+
+		case 16:  // SET_BLOCKLEN
+			r1(idle);
+			break;
+
+		case 9:  // SEND_CSD, version 2
+		{
+			uint8_t csd[16];
+			uint32_t c_size = sd_card.num_blocks / 1024 - 1;
+
+			memset(csd, 0, sizeof csd);
+			csd[0] = 0x40;
+			csd[7] = (c_size >> 16) & 0x3F;
+			csd[8] = c_size >> 8;
+			csd[9] = c_size;
+
+			r1(0);
+			out_put(0xFF);
+			data_block(csd, sizeof csd);
+			break;
+		}
+
+		case 17:  // READ_SINGLE_BLOCK
+		case 18:  // READ_MULTIPLE_BLOCK
+			if (!sd_card.ready)
+			{
+				r1(0x04);
+			}
+			else if (blk >= sd_card.num_blocks)
+			{
+				r1(0x40);  // address error
+			}
+			else
+			{
+				r1(0);
+				sd_card.cur = blk;
+				sd_card.multi = (cmd == 18);
+				sd_card.mode = MODE_READ;
+				sd_card.ready_at = sd_emu_now + usec(sd_card.read_access_us);
+			}
+			break;
+
+		case 24:  // WRITE_BLOCK
+		case 25:  // WRITE_MULTIPLE_BLOCK
+			if (!sd_card.ready)
+			{
+				r1(0x04);
+			}
+			else if (blk >= sd_card.num_blocks)
+			{
+				r1(0x40);
+			}
+			else
+			{
+				r1(0);
+				sd_card.cur = blk;
+				sd_card.multi = (cmd == 25);
+				sd_card.mode = MODE_WRITE_TOKEN;
+			}
+			break;
+
+		case 12:  // STOP_TRANSMISSION
+			out_clear();
+			sd_card.mode = MODE_CMD;
+			out_put(0xFF);  // stuff byte
+			out_put(0x00);
+			sd_card.busy_until = sd_emu_now + usec(20);
+			break;
+
+		default:
+			r1(idle | 0x04);  // illegal command
+			break;
+	}
+}
+
+// one byte on the bus: MOSI in, MISO out
+
+static uint8_t card_clock (uint8_t mosi)
+{
+	uint8_t miso = 0xFF;
+
+	if (!chip_select || sd_card.removed)
+		return 0xFF;
+
+	if ((sd_card.mode == MODE_READ) && (sd_card.out_head == sd_card.out_tail)
+		&& (sd_emu_now >= sd_card.ready_at))
+	{
+		if (sd_card.cur >= sd_card.num_blocks)
+		{
+			sd_card.mode = MODE_CMD;
+		}
+		else
+		{
+			data_block(sd_card.img + (size_t) sd_card.cur * 512, 512);
+			sd_card.cur ++;
+			sd_card.blocks_read ++;
+
+			if (sd_card.multi)
+			{
+				sd_card.ready_at = sd_emu_now + usec(sd_card.read_next_us) + 515 * byte_time();
+			}
+			else
+			{
+				sd_card.mode = MODE_CMD;
+			}
+		}
+	}
+
+	if (sd_card.out_head != sd_card.out_tail)
+	{
+		miso = sd_card.outq[sd_card.out_head++ & (sizeof sd_card.outq - 1)];
+	}
+	else if (sd_emu_now < sd_card.busy_until)
+	{
+		miso = 0x00;  // busy
+	}
+
+	switch (sd_card.mode)
+	{
+		case MODE_CMD:
+		case MODE_READ:
+			if (sd_card.cmd_len == 0)
+			{
+				if ((mosi & 0xC0) == 0x40)  // start and transmission bit
+				{
+					sd_card.cmd[sd_card.cmd_len++] = mosi;
+				}
+			}
+			else
+			{
+				sd_card.cmd[sd_card.cmd_len++] = mosi;
+
+				if (sd_card.cmd_len == 6)
+				{
+					sd_card.cmd_len = 0;
+					command();
+				}
+			}
+			break;
+
+		case MODE_WRITE_TOKEN:
+			if (sd_emu_now < sd_card.busy_until)
+				break;
+
+			if (((mosi == 0xFE) && !sd_card.multi) || ((mosi == 0xFC) && sd_card.multi))
+			{
+				sd_card.mode = MODE_WRITE_DATA;
+				sd_card.wlen = 0;
+			}
+			else if ((mosi == 0xFD) && sd_card.multi)  // stop token
+			{
+				sd_card.mode = MODE_CMD;
+				sd_card.busy_until = sd_emu_now + usec(sd_card.stop_busy_us);
+			}
+			break;
+
+		case MODE_WRITE_DATA:
+			sd_card.wbuf[sd_card.wlen++] = mosi;
+
+			if (sd_card.wlen < sizeof sd_card.wbuf)  // data and CRC
+				break;
+
+			if (sd_card.cur >= sd_card.num_blocks)
+			{
+				out_put(0xED);  // write error
+				sd_card.mode = MODE_CMD;
+				break;
+			}
+
+			memcpy(sd_card.img + (size_t) sd_card.cur * 512, sd_card.wbuf, 512);
+			sd_card.cur ++;
+			sd_card.blocks_written ++;
+
+			out_put(0xE5);  // data accepted
+			sd_card.busy_until = sd_emu_now + byte_time() +
+				usec(sd_card.multi ? sd_card.write_busy_us : sd_card.single_busy_us);
+			sd_card.mode = sd_card.multi ? MODE_WRITE_TOKEN : MODE_CMD;
+			break;
+	}
+
+	return miso;
+}
+
+void sd_emu_insert (void)
+{
+	sd_card.removed = 0;
+	sd_card.ready = 0;
+	sd_card.mode = MODE_CMD;
+	sd_card.cmd_len = 0;
+	sd_card.busy_until = 0;
+	out_clear();
+}
+
+uint32_t sd_emu_spi_hz (void)
+{
+	return spi_hz;
+}
+
+
+// sd_spi.c
+
+#define DMA_START_CYCLES	200
+
+void sd_spi_init (void)
+{
+	spi_hz = SD_SPI_INIT_CLOCK;
+}
+
+uint32_t sd_spi_set_clock (uint32_t hz)
+{
+	uint32_t cd = (configPBA_CLOCK_HZ + hz - 1) / hz;
+
+	if (cd < 4)
+	{
+		cd = 4;
+	}
+	else if (cd > 0xFFFF)
+	{
+		cd = 0xFFFF;
+	}
+
+	spi_hz = configPBA_CLOCK_HZ / cd;
+
+	return spi_hz;
+}
+
+void sd_spi_select (int on)
+{
+	chip_select = on;
+}
+
+static void xfer (const uint8_t * tx, uint8_t * rx, int len)
+{
+	int i;
+
+	for (i=0; i < len; i++)
+	{
+		sd_emu_now += byte_time();
+		rx[i] = card_clock(tx[i]);
+	}
+}
+
+void sd_spi_xfer (const uint8_t * tx, uint8_t * rx, int len)
+{
+	sd_emu_now += DMA_START_CYCLES;
+	xfer(tx, rx, len);
+	sd_card.xfers ++;
+
+	if (len > SD_SPI_POLL_LEN)  // the task waits for the interrupt
+	{
+		task_yield();
+	}
+}
+
+void sd_spi_xfer2 (const uint8_t * tx1, uint8_t * rx1, int len1,
+		const uint8_t * tx2, uint8_t * rx2, int len2)
+{
+	sd_emu_now += DMA_START_CYCLES + 50;  // reload registers
+	xfer(tx1, rx1, len1);
+	xfer(tx2, rx2, len2);
+	sd_card.xfers ++;
+
+	task_yield();
+}
+
+uint8_t sd_spi_byte (uint8_t d)
+{
+	uint8_t r;
+
+	sd_spi_xfer(&d, &r, 1);
+
+	return r;
+}
@@ -0,0 +1,82 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * sd_card_emu.h (host)
+ *
+ * SPI level SD card emulator in place of sd_spi.c, the SD card task
+ * runs as a coroutine on the emulated time.
+ */
+
+#ifndef SD_CARD_EMU_H_
+#define SD_CARD_EMU_H_
+
+#include <stdint.h>
+
+struct sd_card_emu
+{
+	uint8_t * img;			// card contents, num_blocks * 512 bytes
+	uint32_t num_blocks;
+	int sdhc;				// block addressing, byte addressing if 0
+	int removed;
+
+	// timing (microseconds)
+	uint32_t read_access_us;	// command to first data block
+	uint32_t read_next_us;		// further blocks of CMD18
+	uint32_t write_busy_us;		// per block of CMD25
+	uint32_t single_busy_us;	// CMD24
+	uint32_t stop_busy_us;		// stop token of CMD25
+
+	// statistics
+	long cmds[64];
+	long blocks_read;
+	long blocks_written;
+	long xfers;
+
+	// state of the card
+	int ready, acmd41, app_cmd, mode, multi;
+	uint8_t cmd[6];
+	int cmd_len;
+	uint8_t outq[4096];
+	unsigned out_head, out_tail;
+	uint64_t busy_until, ready_at;
+	uint32_t cur;
+	uint8_t wbuf[514];
+	int wlen;
+};
+
+extern struct sd_card_emu sd_card;
+
+extern uint64_t sd_emu_now;		// CPU cycles
+
+#define SD_EMU_MS(n)	((uint64_t) (n) * (configCPU_CLOCK_HZ / 1000))
+
+// runs the SD card task until it sleeps or waits
+void sd_emu_run (void);
+
+// runs the SD card task for ms milliseconds of emulated time
+void sd_emu_run_ms (int ms);
+
+// card removed and inserted again: back to the idle state
+void sd_emu_insert (void);
+
+uint32_t sd_emu_spi_hz (void);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * semphr.h (host)
+ *
+ * Binary semaphores and mutexes are queues of one item, a take never
+ * blocks: it fails at once if the semaphore is not available.
+ */
+
+#ifndef HOST_SEMPHR_H_
+#define HOST_SEMPHR_H_
+
+#include "queue.h"
+
+xSemaphoreHandle xSemaphoreCreateMutex (void);
+portBASE_TYPE xSemaphoreTake (xSemaphoreHandle s, portTickType wait);
+portBASE_TYPE xSemaphoreGive (xSemaphoreHandle s);
+portBASE_TYPE xSemaphoreGiveFromISR (xSemaphoreHandle s, portBASE_TYPE * woken);
+
+#define vSemaphoreCreateBinary(s)	((s) = xSemaphoreCreateMutex())
+#define xSemaphoreCreateCounting(max, init)	xSemaphoreCreateMutex()
+
+#endif
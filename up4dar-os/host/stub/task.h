@@ -0,0 +1,41 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * task.h (host)
+ *
+ * The tick count is host_ticks (1 ms), a test moves it forward.
+ */
+
+#ifndef HOST_TASK_H_
+#define HOST_TASK_H_
+
+#include "FreeRTOS.h"
+
+#define tskIDLE_PRIORITY	0
+
+extern portTickType host_ticks;
+
+portBASE_TYPE xTaskCreate (pdTASK_CODE code, const signed char * name, unsigned short stack,
+	void * param, unsigned long prio, xTaskHandle * handle);
+portTickType xTaskGetTickCount (void);
+void vTaskDelay (portTickType ticks);
+
+#endif
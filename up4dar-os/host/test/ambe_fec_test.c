@@ -0,0 +1,165 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_fec_test.c
+ *
+ * Golay decoder of ambe_fec.c: same results as the old first block
+ * decoder (ambe_fec_ref.c) for random frames, exact error counts for
+ * up to three bit errors per block in both blocks, and the time per
+ * frame of the old and the new decoder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "host_time.h"
+
+#include "ambe_fec_ref.c"
+
+
+// AMBE silence frame, no bit errors
+
+static const uint8_t silence[9] = { 0x9e, 0x8d, 0x32, 0x88, 0x26, 0x1a, 0x3f, 0x61, 0xe8 };
+
+static int flip_errors (const int * bit, int n, uint32_t * blocks)
+{
+	uint8_t d[9];
+	int i;
+
+	memcpy(d, silence, 9);
+
+	for (i=0; i < n; i++)
+	{
+		d[bit[i] >> 3] ^= 0x80 >> (bit[i] & 7);
+	}
+
+	return ambe_fec_decode(d, blocks);
+}
+
+#define FRAMES	1000
+#define ROUNDS	2000
+
+int main (void)
+{
+	static uint8_t buf[FRAMES][9];
+	uint32_t b0[3], b[3], x, y, u, v;
+	int checked[72];
+	int num_checked = 0;
+	int i, j, k, n;
+
+	// 1. random frames: first block data, unprotected bits and error count as before
+
+	srand(1);
+
+	for (n=0; n < 2000000; n++)
+	{
+		uint8_t d[9];
+
+		for (i=0; i < 9; i++)
+		{
+			d[i] = rand();
+		}
+
+		assert(ref_fec_decode_first_block(d, &x, &y) == ambe_fec_decode_first_block(d, &u, &v));
+		assert((x == u) && (y == v));
+	}
+
+	printf("2000000 random frames: first block equal to the old decoder\n");
+
+	// 2. single bit errors: every checked bit is counted, the data is corrected
+
+	assert(ambe_fec_decode(silence, b0) == 0);
+
+	for (i=0; i < 72; i++)
+	{
+		int e = flip_errors(&i, 1, b);
+
+		assert((e == 0) || (e == 1));
+
+		if (e == 1)
+		{
+			assert((b[0] == b0[0]) && (b[1] == b0[1]));
+			checked[num_checked++] = i;
+		}
+	}
+
+	assert(num_checked == AMBE_FEC_CHECKED_BITS);
+
+	// 3. two and three bit errors in the checked bits: all corrected and counted
+	//    (each block gets at most three of them)
+
+	for (i=0; i < num_checked; i++)
+	{
+		for (j=i+1; j < num_checked; j++)
+		{
+			int e[2] = { checked[i], checked[j] };
+
+			assert(flip_errors(e, 2, b) == 2);
+			assert((b[0] == b0[0]) && (b[1] == b0[1]));
+
+			for (k=j+1; k < num_checked; k += 5)
+			{
+				int e3[3] = { checked[i], checked[j], checked[k] };
+
+				assert(flip_errors(e3, 3, b) == 3);
+				assert((b[0] == b0[0]) && (b[1] == b0[1]));
+			}
+		}
+	}
+
+	printf("%d checked bits, one to three bit errors corrected and counted\n", num_checked);
+
+	// 4. benchmark
+
+	for (n=0; n < FRAMES; n++)
+	{
+		for (i=0; i < 9; i++)
+		{
+			buf[n][i] = rand();
+		}
+	}
+
+	uint64_t t = host_nsec();
+	for (k=0; k < ROUNDS; k++)
+		for (n=0; n < FRAMES; n++)
+			host_sink += ref_fec_decode_first_block(buf[n], &x, &y) + x;
+	double t_old = (double) (host_nsec() - t) / (ROUNDS * FRAMES);
+
+	t = host_nsec();
+	for (k=0; k < ROUNDS; k++)
+		for (n=0; n < FRAMES; n++)
+			host_sink += ambe_fec_decode_first_block(buf[n], &x, &y) + x;
+	double t_new = (double) (host_nsec() - t) / (ROUNDS * FRAMES);
+
+	t = host_nsec();
+	for (k=0; k < ROUNDS; k++)
+		for (n=0; n < FRAMES; n++)
+			host_sink += ambe_fec_decode(buf[n], b) + b[1];
+	double t_both = (double) (host_nsec() - t) / (ROUNDS * FRAMES);
+
+	printf("first block: old %.1f ns/frame, new %.1f ns/frame; both blocks %.1f ns/frame\n",
+		t_old, t_new, t_both);
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_plc_test.c
+ *
+ * Loss patterns through ambe_q and ambe_plc the way ambe.c uses them:
+ * a lost frame is the LFI indicator in the queue, every 20ms one frame
+ * goes to the AMBE chip and the audio of the frame before the previous
+ * one comes back. Checks the frame sequence sent to the chip and the
+ * gain of the audio blocks, then random burst loss at 3% and 5%.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "ambe_q.h"
+#include "ambe_plc.h"
+
+#define BLOCK_LEN	160		// samples per frame
+#define AUDIO_LEVEL	1000
+
+static ambe_q_t q;
+
+static int fade[AMBE_PLC_REPEAT_FRAMES] = { 230, 181, 128, 90, 64 };
+
+static void make_frame (uint8_t * d, int id)
+{
+	int i;
+
+	for (i=0; i < AMBE_Q_DATASIZE; i++)
+	{
+		d[i] = (uint8_t) (id * 7 + i * 31 + 1);
+	}
+
+	d[0] = id >> 8;  // keeps the frames apart from the LFI and silence data
+	d[1] = id;
+}
+
+static int frame_id (const uint8_t * d)  // -1: silence, -2: unknown
+{
+	uint8_t e[AMBE_Q_DATASIZE];
+	int id = (d[0] << 8) | d[1];
+
+	if (memcmp(d, ambe_silence_data, AMBE_Q_DATASIZE) == 0)
+		return -1;
+
+	make_frame(e, id);
+
+	return (memcmp(d, e, AMBE_Q_DATASIZE) == 0) ? id : -2;
+}
+
+// one 20ms cycle of the AMBE task, returns the frame for the chip and
+// the gain of the audio block that comes back (last sample)
+
+static int cycle (int * gain)
+{
+	uint8_t d[AMBE_Q_DATASIZE];
+	int16_t audio[BLOCK_LEN];
+	int state = AMBE_PLC_FRAME_IDLE;
+	int i;
+
+	ambe_plc_next_frame();
+
+	if (ambe_q_get(&q, d) == 0)
+	{
+		state = (memcmp(d, ambe_lfi_indicator, AMBE_Q_DATASIZE) == 0) ? AMBE_PLC_FRAME_LOST : AMBE_PLC_FRAME_OK;
+	}
+	else
+	{
+		memcpy(d, ambe_silence_data, AMBE_Q_DATASIZE);
+	}
+
+	ambe_plc_process(d, state);
+
+	for (i=0; i < BLOCK_LEN; i++)
+	{
+		audio[i] = AUDIO_LEVEL;
+	}
+
+	ambe_plc_apply_gain(audio, BLOCK_LEN);
+	*gain = (audio[BLOCK_LEN - 1] * 256 + AUDIO_LEVEL / 2) / AUDIO_LEVEL;
+
+	return frame_id(d);
+}
+
+// pattern: '.' = frame received, 'x' = lost; checks every output frame
+// and the gain two cycles later
+
+static void run_pattern (const char * pattern)
+{
+	int n = strlen(pattern);
+	int expect_frame[200], expect_gain[200];
+	int last_good = -1, burst = 0;
+	int i, gain;
+	uint8_t d[AMBE_Q_DATASIZE];
+
+	ambe_plc_reset();
+
+	for (i=0; i < n; i++)
+	{
+		if (pattern[i] == '.')
+		{
+			make_frame(d, 100 + i);
+			last_good = 100 + i;
+			burst = 0;
+			expect_frame[i] = 100 + i;
+			expect_gain[i] = AMBE_PLC_GAIN_UNITY;
+		}
+		else
+		{
+			memcpy(d, ambe_lfi_indicator, AMBE_Q_DATASIZE);
+			burst ++;
+
+			if ((last_good >= 0) && (burst <= AMBE_PLC_REPEAT_FRAMES))
+			{
+				expect_frame[i] = last_good;
+				expect_gain[i] = fade[burst - 1];
+			}
+			else
+			{
+				expect_frame[i] = -1;
+				expect_gain[i] = 0;
+			}
+		}
+
+		assert(ambe_q_put(&q, d) == 0);
+	}
+
+	for (i=0; i < n + 2; i++)
+	{
+		int f = cycle(&gain);
+
+		if (i < n)
+		{
+			assert(f == expect_frame[i]);
+		}
+
+		// the gain is applied to the audio of the frame two cycles before,
+		// the ramp (8 per sample) reaches it within the block
+		if (i >= 2)
+		{
+			assert(gain == expect_gain[i - 2]);
+		}
+	}
+}
+
+// Gilbert-Elliott channel: losses come in bursts of mean_burst frames
+
+static void random_loss (double loss, double mean_burst, int frames)
+{
+	double p_end = 1.0 / mean_burst;
+	double p_start = loss * p_end / (1.0 - loss);
+	int bad = 0, lost = 0, i, k, gain;
+	long gain_sum = 0;
+	uint8_t d[AMBE_Q_DATASIZE];
+
+	ambe_plc_reset();
+	srand(1);
+
+	for (i=0; i < frames; i += 40)
+	{
+		for (k=0; k < 40; k++)
+		{
+			double r = rand() / (RAND_MAX + 1.0);
+
+			bad = bad ? (r >= p_end) : (r < p_start);
+
+			if (bad)
+			{
+				memcpy(d, ambe_lfi_indicator, AMBE_Q_DATASIZE);
+				lost ++;
+			}
+			else
+			{
+				make_frame(d, i + k);
+			}
+
+			assert(ambe_q_put(&q, d) == 0);
+		}
+
+		for (k=0; k < 40; k++)
+		{
+			assert(cycle(&gain) != -2);
+			gain_sum += gain;
+		}
+	}
+
+	printf("loss %.0f%%, mean burst %.1f: %u of %u frames lost, %u repeated, %u muted,"
+		" %u bursts (longest %u), mean gain %.3f\n",
+		loss * 100, mean_burst, ambe_plc_stats.lost, ambe_plc_stats.frames,
+		ambe_plc_stats.repeated, ambe_plc_stats.muted, ambe_plc_stats.bursts,
+		ambe_plc_stats.max_burst, (double) gain_sum / frames / AMBE_PLC_GAIN_UNITY);
+
+	assert((int) ambe_plc_stats.lost == lost);
+	assert(ambe_plc_stats.repeated + ambe_plc_stats.muted == ambe_plc_stats.lost);
+}
+
+int main (void)
+{
+	int gain;
+
+	ambe_q_initialize(&q);
+
+	run_pattern("..........");
+	run_pattern("....x....x.x...");
+	run_pattern("...xx..xxx..xxxx..xxxxx...");
+	run_pattern("..xxxxxx....xxxxxxxxxxxx....");
+	run_pattern("xxx....x..");  // no good frame yet: silence
+	printf("loss patterns: frame sequence and gain ok\n");
+
+	// reset from another task: taken with the next frame
+	run_pattern("....");
+	ambe_plc_reset();
+	assert(ambe_plc_stats.frames == 4);  // not yet
+	ambe_q_flush(&q, 1);  // one frame is sent at once
+	assert(ambe_q_put(&q, ambe_lfi_indicator) == 0);
+	assert(cycle(&gain) == -1);  // last good frame is gone
+	assert((ambe_plc_stats.frames == 1) && (ambe_plc_stats.muted == 1));
+	printf("reset: ok\n");
+
+	random_loss(0.03, 2.0, 200000);
+	random_loss(0.05, 2.0, 200000);
+	random_loss(0.05, 4.0, 200000);
+
+	printf("all ok\n");
+	return 0;
+}
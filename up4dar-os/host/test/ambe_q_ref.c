@@ -0,0 +1,137 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_q_ref.c
+ *
+ * Reference for ambe_q_test.c: ambe_q.c and the jitter queue slot
+ * before the packed frames, the queues hold the 36 byte SD format
+ */
+
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+#define REF_Q_BUFLEN  (AMBE_Q_DATASIZE_SD * 50)
+
+struct ref_q {
+	uint8_t buf[REF_Q_BUFLEN];
+	short in_ptr;
+	short out_ptr;
+	short count;
+	short state;
+	xSemaphoreHandle mutex;
+};
+
+struct ref_jitter_q_slot {
+	int32_t seq;
+	uint8_t source;
+	uint8_t data[3];
+	uint8_t voice[AMBE_Q_DATASIZE_SD];
+};
+
+
+static void ref_q_initialize (struct ref_q * a)
+{
+	a->mutex = xSemaphoreCreateMutex();
+	a->count = 0;
+	a->in_ptr = 0;
+	a->out_ptr = 0;
+	a->state = 0;
+}
+
+static int ref_q_put_sd (struct ref_q * a,  const uint8_t * data)
+{
+	int ret = 0;
+	
+	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		if ((REF_Q_BUFLEN - a->count) >= AMBE_Q_DATASIZE_SD) // there is space in the buffer
+		{
+			memcpy (a->buf + a->in_ptr, data, AMBE_Q_DATASIZE_SD);
+			
+			a->in_ptr += AMBE_Q_DATASIZE_SD;
+			
+			if (a->in_ptr >= REF_Q_BUFLEN)
+			{
+				a->in_ptr = 0;
+			}
+			
+			a->count += AMBE_Q_DATASIZE_SD;
+			
+			if (a->count >= (AMBE_Q_DATASIZE_SD * 3)) // if 3 ambe records are in memory...
+			{
+				a->state = 1;  // ... start delivering via get method
+			}
+		}
+		else
+		{
+			ret = 1; // buffer is full
+		}
+		xSemaphoreGive( a->mutex );
+	}
+	else
+	{
+		ret = 1;
+	}
+	
+	return ret;
+}
+
+static int ref_q_get_sd (struct ref_q * a,  uint8_t * data )
+{
+	int ret = 0;
+	
+	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		if ((a->count > 0) && (a->state == 1)) // there is data in the buffer
+		{
+			memcpy (data, a->buf + a->out_ptr, AMBE_Q_DATASIZE_SD);
+			
+			a->out_ptr += AMBE_Q_DATASIZE_SD;
+			
+			if (a->out_ptr >= REF_Q_BUFLEN)
+			{
+				a->out_ptr = 0;
+			}
+			
+			a->count -= AMBE_Q_DATASIZE_SD;
+			
+			if (a->count <= 0)
+			{
+				a->state = 0;
+			}
+		}
+		else
+		{
+			ambe_expand_to_sd_data( data, ambe_silence_data );
+			ret = 1;
+		}
+		xSemaphoreGive( a->mutex );
+	}
+	else
+	{
+		ambe_expand_to_sd_data( data, ambe_silence_data );
+		ret = 1;
+	}
+	
+	return ret;
+}
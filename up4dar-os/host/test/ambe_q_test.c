@@ -0,0 +1,288 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_q_test.c
+ *
+ * The soft decision values of PHY frames next to the packed queues
+ * (ambe_sd_hold_put/get): values come back for the frames in order,
+ * changed and dropped frames and frames of a full hold get hard bits.
+ * Then the voice data of one frame from the input to the SPI buffer
+ * of the AMBE chip, before (36 byte SD format in the jitter queue and
+ * ambe_q, ambe_q_ref.c) and now (packed frames): RAM of the queues
+ * and time per frame. The jitter queue bookkeeping is the same in both,
+ * only the copies into and out of its slots are measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "up_dstar/ambe_q.h"
+#include "up_dstar/jitter_q.h"
+
+#include "host_time.h"
+
+#include "ambe_q_ref.c"
+
+
+#define NUM_FRAMES	64
+
+static uint8_t frame[NUM_FRAMES][AMBE_Q_DATASIZE];
+static uint8_t sd[NUM_FRAMES][AMBE_Q_DATASIZE_SD];
+
+static void make_frames (void)
+{
+	int i, k;
+
+	srand(1);
+
+	for (i=0; i < NUM_FRAMES; i++)
+	{
+		for (k=0; k < AMBE_Q_DATASIZE_SD; k++)
+		{
+			sd[i][k] = rand();  // the chip looks at the MSB of each nibble
+		}
+
+		ambe_reduce_sd_data(frame[i], sd[i]);
+	}
+}
+
+static int get_check (int i, const uint8_t * data)  // 0: the SD values of frame i
+{
+	uint8_t out[AMBE_Q_DATASIZE_SD], e[AMBE_Q_DATASIZE_SD];
+	int ret = ambe_sd_hold_get(out, data);
+
+	if (ret == 0)
+	{
+		assert(memcmp(out, sd[i], AMBE_Q_DATASIZE_SD) == 0);
+	}
+	else
+	{
+		ambe_expand_to_sd_data(e, data);
+		assert(memcmp(out, e, AMBE_Q_DATASIZE_SD) == 0);
+	}
+
+	return ret;
+}
+
+
+static void hold (void)
+{
+	uint8_t changed[AMBE_Q_DATASIZE];
+	int i;
+
+	// in order, each value once
+	for (i=0; i < 4; i++)
+	{
+		ambe_sd_hold_put(sd[i], frame[i]);
+	}
+
+	for (i=0; i < 4; i++)
+	{
+		assert(get_check(i, frame[i]) == 0);
+	}
+
+	assert(get_check(0, frame[0]) == 1);
+
+	// a bit changed on the way (FEC, concealment): hard bits, the next frame
+	// still has its values
+	ambe_sd_hold_put(sd[4], frame[4]);
+	ambe_sd_hold_put(sd[5], frame[5]);
+	memcpy(changed, frame[4], AMBE_Q_DATASIZE);
+	changed[2] ^= 0x10;
+	assert(get_check(4, changed) == 1);
+	assert(get_check(5, frame[5]) == 0);
+
+	// frames 6 and 7 dropped by the jitter queue, their values are discarded
+	for (i=6; i < 10; i++)
+	{
+		ambe_sd_hold_put(sd[i], frame[i]);
+	}
+
+	assert(get_check(8, frame[8]) == 0);
+	assert(get_check(6, frame[6]) == 1);
+	assert(get_check(9, frame[9]) == 0);
+
+	// the same packed frame twice with different values (e.g. silence)
+	ambe_sd_hold_put(sd[10], frame[10]);
+	ambe_sd_hold_put(sd[11], frame[10]);
+	assert(get_check(10, frame[10]) == 0);
+	assert(get_check(11, frame[10]) == 0);
+
+	// more frames than the hold keeps: the oldest ones get hard bits
+	for (i=12; i < (12 + AMBE_SD_HOLD + 4); i++)
+	{
+		ambe_sd_hold_put(sd[i], frame[i]);
+	}
+
+	for (i=12; i < (12 + AMBE_SD_HOLD + 4); i++)
+	{
+		assert(get_check(i, frame[i]) == ((i < 16) ? 1 : 0));
+	}
+
+	printf("SD hold: values in order, changed, dropped and overwritten frames with hard bits\n");
+}
+
+
+// one frame from the input to the SPI buffer of the chip: the frame into
+// a jitter queue slot and out of the slot two frames later, into ambe_q
+// (ambe_input_data), the voice for the caller of rx_q_process and the SD
+// format from ambe_q (3 frames in the queue)
+
+#define ROUNDS	200000
+
+static struct ref_jitter_q_slot ref_slot[JITTER_Q_SLOTS];
+static struct jitter_q_slot slot[JITTER_Q_SLOTS];
+static struct ref_q ref_q;
+static ambe_q_t q;
+
+static uint8_t chip[AMBE_Q_DATASIZE_SD];
+static uint8_t voice[AMBE_Q_DATASIZE];
+
+static void old_path (int i, int phy)
+{
+	uint8_t buf[AMBE_Q_DATASIZE_SD];
+	struct ref_jitter_q_slot * s = ref_slot + (i & (JITTER_Q_SLOTS - 1));
+
+	if (phy)
+	{
+		memcpy (s->voice, sd[i & (NUM_FRAMES - 1)], AMBE_Q_DATASIZE_SD);
+	}
+	else
+	{
+		ambe_expand_to_sd_data(buf, frame[i & (NUM_FRAMES - 1)]);
+		memcpy (s->voice, buf, AMBE_Q_DATASIZE_SD);
+	}
+
+	s = ref_slot + ((i - 2) & (JITTER_Q_SLOTS - 1));
+	memcpy (buf, s->voice, AMBE_Q_DATASIZE_SD);
+
+	ref_q_put_sd(&ref_q, buf);
+	ambe_reduce_sd_data(voice, buf);
+	ref_q_get_sd(&ref_q, chip);
+}
+
+static void new_path (int i, int phy)
+{
+	uint8_t buf[AMBE_Q_DATASIZE];
+	struct latency_tag tag;
+	struct jitter_q_slot * s = slot + (i & (JITTER_Q_SLOTS - 1));
+
+	if (phy)
+	{
+		ambe_reduce_sd_data(buf, sd[i & (NUM_FRAMES - 1)]);
+		ambe_sd_hold_put(sd[i & (NUM_FRAMES - 1)], buf);
+		memcpy (s->voice, buf, AMBE_Q_DATASIZE);
+	}
+	else
+	{
+		memcpy (s->voice, frame[i & (NUM_FRAMES - 1)], AMBE_Q_DATASIZE);
+	}
+
+	s = slot + ((i - 2) & (JITTER_Q_SLOTS - 1));
+	memcpy (buf, s->voice, AMBE_Q_DATASIZE);
+
+	ambe_q_put_tag(&q, buf, NULL);
+	memcpy (voice, buf, AMBE_Q_DATASIZE);
+	ambe_q_get_tag(&q, buf, &tag);
+	ambe_sd_hold_get(chip, buf);
+}
+
+static double bench (void (* path) (int i, int phy), int phy)
+{
+	int i;
+
+	for (i=0; i < 5; i++)  // two frames in the jitter queue, three in ambe_q
+	{
+		path(i, phy);
+	}
+
+	uint64_t c0 = host_cycles();
+
+	for (i=5; i < ROUNDS; i++)
+	{
+		path(i, phy);
+	}
+
+	return (double) (host_cycles() - c0) / (ROUNDS - 5);
+}
+
+static void empty_queues (void)
+{
+	ref_q.count = ref_q.in_ptr = ref_q.out_ptr = ref_q.state = 0;
+	ambe_q_flush(&q, 0);
+}
+
+static void per_frame (void)
+{
+	uint8_t old_chip[AMBE_Q_DATASIZE_SD], old_voice[AMBE_Q_DATASIZE];
+	int phy, i;
+
+	ref_q_initialize(&ref_q);
+	ambe_q_initialize(&q);
+
+	for (phy=0; phy < 2; phy++)
+	{
+		// the chip and the caller of rx_q_process get the same data
+		empty_queues();
+
+		for (i=0; i < 1000; i++)
+		{
+			old_path(i, phy);
+			memcpy(old_chip, chip, AMBE_Q_DATASIZE_SD);
+			memcpy(old_voice, voice, AMBE_Q_DATASIZE);
+			new_path(i, phy);
+
+			assert(memcmp(chip, old_chip, AMBE_Q_DATASIZE_SD) == 0);
+			assert(memcmp(voice, old_voice, AMBE_Q_DATASIZE) == 0);
+		}
+
+		empty_queues();
+		double c_old = bench(old_path, phy);
+		double c_new = bench(new_path, phy);
+
+		printf("%-8s frame: SD queues %5.1f cycles, packed queues %5.1f cycles\n",
+			phy ? "PHY" : "network", c_old, c_new);
+	}
+
+	// RAM: the decoder and microphone ambe_q, two jitter queues
+	int ram_old = 2 * sizeof ref_q.buf + 2 * sizeof ref_slot;
+	int ram_new = 2 * sizeof q.buf + 2 * sizeof slot + AMBE_SD_HOLD * (AMBE_Q_DATASIZE + AMBE_Q_DATASIZE_SD + 1);
+
+	printf("RAM of the voice data: SD queues %d bytes, packed queues and SD hold %d bytes\n",
+		ram_old, ram_new);
+
+	assert(ram_new < ram_old);
+}
+
+
+int main (void)
+{
+	make_frames();
+	hold();
+	per_frame();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,323 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * audio_meter_test.c
+ *
+ * Test and benchmark of the block meter in audio_meter.c: RMS equal to
+ * the per sample square sum of the old ambeTask code, levels of known
+ * signals, clip counting, peak decay, history order and the SNMP
+ * access.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "host_time.h"
+
+#include "up_dstar/audio_meter.h"
+#include "up_dstar/fixpoint_math.h"
+
+#include "up_net/snmp_data.h"
+
+
+#define BLOCK	32		// samples per audio_q buffer
+#define ROUNDS	2000000
+
+
+// the per sample meter of ambeTask before audio_meter.c, without display
+
+struct old_meter
+{
+	int square_sum;
+	int sample_counter;
+	int clip;
+	int level;
+};
+
+static void old_meter_block (struct old_meter * o, const int16_t * samples)
+{
+	int i;
+
+	for (i=0; i < BLOCK; i++)
+	{
+		short sample = samples[i];
+
+		o->square_sum += (sample*sample) >> 7;
+
+		o->sample_counter++;
+
+		if (o->sample_counter >= AUDIO_METER_PERIOD)
+		{
+			o->sample_counter = 0;
+			o->level = fixpoint_milliBel(o->square_sum);
+			o->square_sum = 0;
+		}
+
+		if (sample > 8191)
+		{
+			o->clip = 1;
+		}
+		else if (sample < -8191)
+		{
+			o->clip = 1;
+		}
+	}
+}
+
+static int16_t sine_sample (double amplitude, int n)
+{
+	return (int16_t) lrint(32767.0 * amplitude * sin(2 * M_PI * 1000.0 * n / 8000.0));
+}
+
+static void run_periods (audio_meter_t * m, int periods, int16_t (*sample)(int n), int * n)
+{
+	int16_t b[BLOCK];
+	int k, i;
+
+	for (k=0; k < (periods * AUDIO_METER_PERIOD / BLOCK); k++)
+	{
+		for (i=0; i < BLOCK; i++)
+		{
+			b[i] = sample((*n)++);
+		}
+
+		assert(audio_meter_block(m, b, BLOCK) == (((k + 1) % (AUDIO_METER_PERIOD / BLOCK)) == 0));
+	}
+}
+
+static int16_t sine_10dB (int n)
+{
+	return sine_sample(0.316, n);
+}
+
+static int16_t square_full (int n)
+{
+	return (n & 1) ? 32767 : -32767;
+}
+
+static int16_t silence (int n)
+{
+	return 0;
+}
+
+
+static void compare_old (void)
+{
+	audio_meter_t m;
+	struct old_meter o;
+	int16_t b[BLOCK];
+	int k, i;
+
+	memset(&o, 0, sizeof o);
+	audio_meter_init(&m, 8192);
+	srand(13);
+
+	for (k=0; k < 100000; k++)
+	{
+		int amplitude = 1 << (rand() % 16);  // all levels
+
+		for (i=0; i < BLOCK; i++)
+		{
+			b[i] = (rand() % (2 * amplitude)) - amplitude;
+		}
+
+		old_meter_block(&o, b);
+
+		if (audio_meter_block(&m, b, BLOCK))
+		{
+			assert(m.rms == o.level);
+			assert(o.sample_counter == 0);
+		}
+
+		assert(m.clipped == o.clip);
+	}
+
+	printf("100000 random blocks: RMS equal to the per sample meter\n");
+}
+
+
+static void levels (void)
+{
+	audio_meter_t m;
+	int n = 0;
+	int i;
+
+	audio_meter_init(&m, 32767);  // as the speaker meter
+
+	assert(m.rms == fixpoint_milliBel(0));
+
+	run_periods(&m, 5, sine_10dB, &n);
+
+	double exact = 1000.0 * log10(0.316 * 0.316 / 2);
+
+	printf("sine -10 dBFS: RMS %d mB (exact %.0f), peak %d mB (exact -1000)\n",
+		m.rms, exact, m.peak);
+	assert(fabs(m.rms - exact) <= 10);
+	assert(abs(m.peak + 1000) <= 10);
+	assert(m.clip_count == 0);
+	assert(m.clipped == 0);
+
+	run_periods(&m, 1, square_full, &n);
+
+	printf("square full scale: RMS %d mB, peak %d mB, %u clipped\n", m.rms, m.peak, m.clip_count);
+	assert(abs(m.rms) <= 10);
+	assert(abs(m.peak) <= 10);
+	assert(m.clip_count == AUDIO_METER_PERIOD);
+	assert(m.clipped == 1);
+
+	// the peak decays by AUDIO_METER_DECAY per measurement
+
+	int peak = m.peak;
+
+	for (i=0; i < 10; i++)
+	{
+		run_periods(&m, 1, silence, &n);
+		assert(m.rms == fixpoint_milliBel(0));
+		assert(m.peak == (peak - (i + 1) * AUDIO_METER_DECAY));
+	}
+
+	printf("silence: RMS %d mB, peak %d mB after 10 measurements\n", m.rms, m.peak);
+
+	// a louder signal replaces the decaying peak at once
+
+	run_periods(&m, 1, square_full, &n);
+	assert(m.peak == peak);
+}
+
+
+static void history (void)
+{
+	uint8_t res[AUDIO_METER_HISTORY * 4];
+	int res_len, n = 0;
+	int i;
+
+	audio_meter_init(&audio_meter[AUDIO_METER_SPKR], 32767);
+	audio_meter_init(&audio_meter[AUDIO_METER_MIC], 8192);
+
+	// oldest first: 3 x sine, then 1 x full scale, the older entries are silence
+
+	run_periods(&audio_meter[AUDIO_METER_SPKR], 3, sine_10dB, &n);
+	run_periods(&audio_meter[AUDIO_METER_SPKR], 1, square_full, &n);
+
+	snmp_get_audio_meter_history(AUDIO_METER_SPKR, res, &res_len, sizeof res);
+	assert(res_len == sizeof res);
+
+	for (i=0; i < AUDIO_METER_HISTORY; i++)
+	{
+		int16_t rms = (res[i*4] << 8) | res[i*4 + 1];
+		int16_t peak = (res[i*4 + 2] << 8) | res[i*4 + 3];
+
+		if (i < (AUDIO_METER_HISTORY - 4))
+		{
+			assert(rms == fixpoint_milliBel(0));
+		}
+		else if (i < (AUDIO_METER_HISTORY - 1))
+		{
+			assert(abs(rms + 1302) <= 10);
+			assert(abs(peak + 1000) <= 10);
+		}
+		else
+		{
+			assert(abs(rms) <= 10);
+			assert(abs(peak) <= 10);
+		}
+	}
+
+	// short buffer: only complete entries
+
+	snmp_get_audio_meter_history(AUDIO_METER_SPKR, res, &res_len, 10);
+	assert(res_len == 8);
+
+	// the SNMP argument selects meter (upper nibble) and value
+
+	uint8_t v[4];
+	int v_len;
+
+	snmp_get_audio_meter((AUDIO_METER_SPKR << 4) | 3, v, &v_len, sizeof v);
+	assert((v_len == 4) && (v[3] == AUDIO_METER_PERIOD));
+	snmp_get_audio_meter((AUDIO_METER_MIC << 4) | 3, v, &v_len, sizeof v);
+	assert((v_len == 4) && (v[3] == 0));
+
+	printf("history oldest first, SNMP access of both meters\n");
+}
+
+
+static void benchmark (void)
+{
+	static int16_t b[BLOCK];
+	audio_meter_t m;
+	struct old_meter o;
+	long k;
+	int i;
+
+	for (i=0; i < BLOCK; i++)
+	{
+		b[i] = sine_10dB(i);
+	}
+
+	memset(&o, 0, sizeof o);
+	audio_meter_init(&m, 8192);
+
+	uint64_t t = host_nsec();
+
+	for (k=0; k < ROUNDS; k++)
+	{
+		b[k & (BLOCK - 1)] ^= 1;
+		old_meter_block(&o, b);
+		host_sink += o.level;
+	}
+
+	double t_old = (double) (host_nsec() - t) / ROUNDS;
+
+	t = host_nsec();
+
+	for (k=0; k < ROUNDS; k++)
+	{
+		b[k & (BLOCK - 1)] ^= 1;
+
+		if (audio_meter_block(&m, b, BLOCK))
+		{
+			host_sink += m.rms;
+		}
+	}
+
+	double t_new = (double) (host_nsec() - t) / ROUNDS;
+
+	printf("%d samples: per sample meter %.1f ns/block, block meter %.1f ns/block (with peak and clip count)\n",
+		BLOCK, t_old, t_new);
+}
+
+
+int main (void)
+{
+	compare_old();
+	levels();
+	history();
+	benchmark();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * audio_q_drift_test.c
+ *
+ * Simulation of the clock drift between the producer (AMBE decoder)
+ * and the consumer (codec) of audio_q. Both sides are served from a
+ * 1ms task tick, the producer clock is off by the given ppm. A 440 Hz
+ * sine goes through the queue, steps in the second difference of the
+ * output count as discontinuities. Reports the fill level (latency)
+ * before every get, its standard deviation and the discontinuities,
+ * for audio_q.c and for the old queue (audio_q_ref.c).
+ *
+ *   audio_q_drift_test            the ppm values below, with checks
+ *   audio_q_drift_test ppm ...    only these values
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "up_dstar/audio_q.h"
+
+#include "audio_q_ref.c"
+
+
+#define SIM_SECONDS		120
+#define SETTLE_SECONDS	20
+
+struct result
+{
+	double mean, sd;
+	int min, max;
+	long discontinuities;
+	double drift_ppm;
+	int underruns, overruns;
+};
+
+static void simulate (double ppm, int new_q, struct result * res)
+{
+	static audio_q_t nq;
+	static struct ref_q oq;
+	double tp_period = 4000.0 / (1 + ppm * 1e-6);	// usec per block of 32 samples
+	double tc_period = 4000.0;
+	double tp = tp_period * 0.37, tc = 0;
+	double phase = 0, w = 2 * M_PI * 440 / 8000;
+	double prev1 = 0, prev2 = 0, sum = 0, sum2 = 0, dsum = 0;
+	short in[AUDIO_Q_TRANSFERLEN], out[AUDIO_Q_TRANSFERLEN];
+	long n = 0, ns = 0;
+	long tick;
+	int i, k;
+
+	audio_q_initialize(&nq);
+	ref_q_initialize(&oq);
+
+	memset(res, 0, sizeof (struct result));
+	res->min = 9999;
+	res->max = -1;
+
+	srand(5);
+
+	for (tick=1; tick <= (SIM_SECONDS * 1000); tick++)
+	{
+		double t = tick * 1000.0;
+		int order = rand() & 1;  // producer or consumer first in this tick
+
+		for (k=0; k < 2; k++)
+		{
+			if ((k == 0) == (order == 0))
+			{
+				while (tp <= t)
+				{
+					for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+					{
+						in[i] = (short) (10000 * sin(phase));
+						phase += w;
+					}
+
+					if (new_q)
+						audio_q_put(&nq, in);
+					else
+						ref_q_put(&oq, in);
+
+					tp += tp_period;
+				}
+			}
+			else
+			{
+				while (tc <= t)
+				{
+					int c = new_q ? nq.count : oq.count;
+
+					tc += tc_period;
+
+					if (new_q)
+						audio_q_get(&nq, out);
+					else
+						ref_q_get(&oq, out);
+
+					if (t > (SETTLE_SECONDS * 1e6))
+					{
+						sum += c;
+						sum2 += (double) c * c;
+						ns ++;
+						res->min = (c < res->min) ? c : res->min;
+						res->max = (c > res->max) ? c : res->max;
+
+						if (new_q)
+						{
+							dsum += audio_q_drift_ppm(&nq);
+						}
+					}
+
+					for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+					{
+						double y = out[i];
+
+						if ((n >= 2) && (t > 2e6) && (fabs(y - 2 * prev1 + prev2) > 2000))
+						{
+							res->discontinuities ++;
+						}
+
+						prev2 = prev1;
+						prev1 = y;
+						n ++;
+					}
+				}
+			}
+		}
+	}
+
+	res->mean = sum / ns;
+	res->sd = sqrt(sum2 / ns - res->mean * res->mean);
+	res->drift_ppm = dsum / ns;
+	res->underruns = nq.underruns;
+	res->overruns = nq.overruns;
+}
+
+static void run (double ppm, int check)
+{
+	struct result o, r;
+
+	simulate(ppm, 0, &o);
+	simulate(ppm, 1, &r);
+
+	printf("%+6.0f ppm  old: latency %5.1f sd %4.1f (%d..%d) disc. %3ld"
+		"   new: latency %5.1f sd %4.1f (%d..%d) disc. %ld, drift %+.0f ppm\n",
+		ppm, o.mean, o.sd, o.min, o.max, o.discontinuities,
+		r.mean, r.sd, r.min, r.max, r.discontinuities, r.drift_ppm);
+
+	if (check)
+	{
+		// level before get: target + one block
+		assert(fabs(r.mean - (AUDIO_Q_TARGET + AUDIO_Q_TRANSFERLEN)) < 2);
+		assert(r.sd < 11);
+		assert(r.discontinuities == 0);
+		assert(fabs(r.drift_ppm - ppm) < (10 + fabs(ppm) * 0.05));
+	}
+}
+
+int main (int argc, char ** argv)
+{
+	// the controller is made for up to +-1000 ppm
+	static const double ppm[] = { 0, 100, -300, 500, -1000 };
+	int i;
+
+	if (argc > 1)
+	{
+		for (i=1; i < argc; i++)
+		{
+			run(atof(argv[i]), 0);
+		}
+
+		return 0;
+	}
+
+	for (i=0; i < (sizeof ppm / sizeof ppm[0]); i++)
+	{
+		run(ppm[i], 1);
+	}
+
+	printf("outside of the range:\n");
+	run(2000, 0);
+
+	printf("all ok\n");
+	return 0;
+}
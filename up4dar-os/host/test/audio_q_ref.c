@@ -0,0 +1,106 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * audio_q_ref.c
+ *
+ * Reference for audio_q_drift_test.c: audio_q.c before the resampler,
+ * drift is compensated by adding or deleting one sample per block
+ */
+
+
+struct ref_q {
+	short buf[AUDIO_Q_BUFLEN];
+	short in_ptr;
+	short out_ptr;
+	short count;
+};
+
+static void ref_q_initialize (struct ref_q * a)
+{
+	a->count = 0;
+	a->in_ptr = 0;
+	a->out_ptr = 0;
+}
+
+static void ref_q_put (struct ref_q * a,  const short * samples)
+{
+	int i;
+
+	if ((AUDIO_Q_BUFLEN - a->count) >= AUDIO_Q_TRANSFERLEN) // there is space in the buffer
+	{
+		for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+		{
+			a->buf[a->in_ptr] = samples[i];
+			a->in_ptr ++;
+			if (a->in_ptr >= AUDIO_Q_BUFLEN)
+			{
+				a->in_ptr = 0;
+			}
+		}
+		a->count += AUDIO_Q_TRANSFERLEN;
+
+		if (a->count < ((AUDIO_Q_TRANSFERLEN*2) -2) )  // add one sample
+		{
+			a->buf[a->in_ptr] = samples[AUDIO_Q_TRANSFERLEN -1];
+			a->in_ptr ++;
+			if (a->in_ptr >= AUDIO_Q_BUFLEN)
+			{
+				a->in_ptr = 0;
+			}
+			a->count ++;
+		}
+		else if (a->count > (AUDIO_Q_BUFLEN - AUDIO_Q_TRANSFERLEN + 2)) // delete last sample
+		{
+			a->in_ptr --;
+			if (a->in_ptr < 0)
+			{
+				a->in_ptr = AUDIO_Q_BUFLEN -1;
+			}
+			a->count --;
+		}
+	}
+}
+
+static void ref_q_get (struct ref_q * a,  short * samples)
+{
+	int i;
+
+	if (a->count >= AUDIO_Q_TRANSFERLEN) // there is data in the buffer
+	{
+		for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+		{
+			samples[i] = a->buf[a->out_ptr];
+			a->out_ptr ++;
+			if (a->out_ptr >= AUDIO_Q_BUFLEN)
+			{
+				a->out_ptr = 0;
+			}
+		}
+		a->count -= AUDIO_Q_TRANSFERLEN;
+	}
+	else
+	{
+		for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+		{
+			samples[i] = 0;
+		}
+	}
+}
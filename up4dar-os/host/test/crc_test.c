@@ -0,0 +1,155 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * crc_test.c
+ *
+ * Equivalence test and benchmark of the table driven CRC-CCITT in
+ * rx_dstar_crc_header.c against the bit serial code it replaced.
+ * crc_nibble_test.c runs the same with the 16 entry table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "host_time.h"
+
+#include "up_dstar/rx_dstar_crc_header.h"
+
+
+// the bit serial implementation before the table
+
+static unsigned short old_crc_data(const unsigned char* data, int num){
+  register const unsigned short genpoly = 0x8408;
+  register unsigned short crc = 0xffff;
+
+  for (int i=0; i<num; ++i){
+    crc ^= *data++;
+    for (char j=0; j<8; ++j){
+      if ( crc & 0x1 ) {
+        crc >>= 1;
+        crc ^= genpoly;
+      } else {
+        crc >>= 1;
+      }
+    }
+  }
+
+  return (crc ^ 0xffff);
+}
+
+static unsigned short old_update_byte (unsigned short crc, unsigned char d)
+{
+	int j;
+
+	crc ^= d;
+
+	for (j=0; j < 8; j++)
+	{
+		crc = (crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1);
+	}
+
+	return crc;
+}
+
+static double bench (unsigned short (* f)(const unsigned char *, int), const unsigned char * b, int len, int rounds)
+{
+	uint64_t t = host_nsec();
+	int i;
+
+	for (i=0; i < rounds; i++)
+	{
+		host_sink += f(b, len);
+	}
+
+	return (double) (host_nsec() - t) / rounds / len;
+}
+
+int main (void)
+{
+	unsigned char b[600];
+	unsigned int crc;
+	int d, i, t;
+
+	printf("%s table\n", RX_DSTAR_CRC_BYTE_TABLE ? "256 entry" : "16 entry");
+
+	// every CRC state with every input byte
+
+	for (crc=0; crc < 0x10000; crc++)
+	{
+		for (d=0; d < 256; d++)
+		{
+			assert(rx_dstar_crc_update_byte(crc, d) == old_update_byte(crc, d));
+		}
+	}
+
+	printf("update_byte: all 65536 states x 256 bytes equal\n");
+
+	// random buffers, whole and split into incremental updates
+
+	srand(1);
+
+	for (t=0; t < 20000; t++)
+	{
+		int n = rand() % 600;
+		int split = n ? (rand() % n) : 0;
+
+		for (i=0; i < n; i++)
+		{
+			b[i] = rand();
+		}
+
+		unsigned short c = rx_dstar_crc_update(RX_DSTAR_CRC_INIT, b, split);
+		c = rx_dstar_crc_update(c, b + split, n - split);
+
+		assert(rx_dstar_crc_data(b, n) == old_crc_data(b, n));
+		assert(rx_dstar_crc_final(c) == old_crc_data(b, n));
+
+		if (n >= 39)
+		{
+			assert(rx_dstar_crc_header(b) == old_crc_data(b, 39));
+		}
+	}
+
+	printf("20000 random buffers (whole and split): equal\n");
+
+	// a header followed by its CRC (low byte first) leaves the residue
+
+	memcpy(b, "\0\0\0DIRECT  DIRECT  CQCQCQ  DL1BFF  UP4D", 39);
+	unsigned short h = rx_dstar_crc_header(b);
+	b[39] = h & 0xff;
+	b[40] = h >> 8;
+	assert(rx_dstar_crc_final(rx_dstar_crc_update(RX_DSTAR_CRC_INIT, b, 41)) == 0x0f47);
+
+	// benchmark: radio header and settings page
+
+	double o39 = bench(old_crc_data, b, 39, 200000);
+	double n39 = bench(rx_dstar_crc_data, b, 39, 200000);
+	double o504 = bench(old_crc_data, b, 504, 20000);
+	double n504 = bench(rx_dstar_crc_data, b, 504, 20000);
+
+	printf("39 bytes:  bit serial %.2f ns/byte, table %.2f ns/byte\n", o39, n39);
+	printf("504 bytes: bit serial %.2f ns/byte, table %.2f ns/byte\n", o504, n504);
+
+	printf("all ok\n");
+	return 0;
+}
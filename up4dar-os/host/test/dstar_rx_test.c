@@ -0,0 +1,395 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dstar_rx_test.c
+ *
+ * Two synthetic streams interleaved through the receive path of
+ * dstar.c: a network stream (DCS packets) and a PHY stream (packets of
+ * the PHY serial protocol). Every 20ms rx_q_process() is called. The
+ * test checks which frames it returns and which frames the secondary
+ * consumer gets, for both arbitration settings. The frames played go
+ * through ambe_q to a model of ambeTask: PHY frames reach the AMBE chip
+ * with the soft decision values the PHY delivered.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "up_dstar/dstar.c"
+
+void host_dstar_settings (void);
+
+#define MAX_FRAMES	2000
+
+struct stream
+{
+	uint8_t source;
+	uint16_t session;
+	uint8_t tag;
+	unsigned long start;
+	int frames;			// voice frames of the transmission
+	int sent;
+	int primary[MAX_FRAMES];	// how often the frame came out of rx_q_process
+	int secondary[MAX_FRAMES];	// ... or to the secondary consumer
+	int sec_start, sec_end;
+};
+
+static struct stream net, phy;
+
+static void make_voice (uint8_t * v, const struct stream * s, int n)
+{
+	int i;
+
+	for (i=0; i < AMBE_Q_DATASIZE; i++)
+	{
+		v[i] = (uint8_t) (i * 29 + 3);
+	}
+
+	v[0] = s->tag;
+	v[1] = n >> 8;
+	v[2] = n;
+}
+
+// soft decision values of PHY frame n: the bits of v, with varying
+// confidence in the lower 3 bits of each nibble
+
+static void make_sd (uint8_t * sd, const uint8_t * v, int n)
+{
+	int i;
+
+	ambe_expand_to_sd_data(sd, v);
+
+	for (i=0; i < AMBE_Q_DATASIZE_SD; i++)
+	{
+		sd[i] = (sd[i] & 0x88) | (((i * 5 + n) & 7) << 4) | ((i * 3 + n * 7) & 7);
+	}
+}
+
+static int voice_frame (const uint8_t * v, struct stream ** s)  // -1: no frame of a stream
+{
+	uint8_t e[AMBE_Q_DATASIZE];
+	int n = (v[1] << 8) | v[2];
+
+	*s = (v[0] == net.tag) ? &net : (v[0] == phy.tag) ? &phy : NULL;
+
+	if ((*s == NULL) || (n >= MAX_FRAMES))
+		return -1;
+
+	make_voice(e, *s, n);
+
+	return (memcmp(v, e, AMBE_Q_DATASIZE) == 0) ? n : -1;
+}
+
+static void send_dcs (struct stream * s)
+{
+	uint8_t d[100];
+
+	memset(d, 0, sizeof d);
+	memset(d + 4, 'N', 39);  // header
+	d[43] = s->session;
+	d[44] = s->session >> 8;
+	d[45] = (s->sent < s->frames) ? (s->sent % NUM_PACKETS_IN_FRAME) : (0x40 | (s->sent % NUM_PACKETS_IN_FRAME));
+	make_voice(d + 46, s, s->sent);
+	d[58] = s->sent;
+	d[59] = s->sent >> 8;
+
+	dstarProcessDCSPacket(d);
+}
+
+static void send_phy (struct stream * s)
+{
+	if (s->sent == 0)
+	{
+		dp.cmdByte = 0x30;  // header, CRC ok
+		dp.dataLen = 40;
+		dp.data[0] = 0;
+		memset(dp.data + 1, 'P', 39);
+		processPacket();
+	}
+
+	if (s->sent >= s->frames)
+	{
+		dp.cmdByte = 0x34;  // end
+		dp.dataLen = 0;
+		processPacket();
+		return;
+	}
+
+	if ((s->sent % NUM_PACKETS_IN_FRAME) == 0)
+	{
+		dp.cmdByte = 0x32;  // sync
+		dp.dataLen = 0;
+		processPacket();
+	}
+
+	uint8_t v[AMBE_Q_DATASIZE];
+
+	make_voice(v, s, s->sent);
+	dp.cmdByte = 0x31;
+	dp.dataLen = 37;
+	dp.data[0] = 0x20;
+	make_sd(dp.data + 1, v, s->sent);
+	processPacket();
+}
+
+static void secondary (uint8_t source, int event, uint8_t pos, const uint8_t * data, const uint8_t * voice)
+{
+	struct stream * s = (source == SOURCE_NET) ? &net : &phy;
+	struct stream * f;
+	int n;
+
+	switch (event)
+	{
+		case RX_Q_SECONDARY_START:
+			s->sec_start ++;
+			break;
+
+		case RX_Q_SECONDARY_END:
+			s->sec_end ++;
+			break;
+
+		case RX_Q_SECONDARY_FRAME:
+			n = voice_frame(voice, &f);
+			if (n >= 0)
+			{
+				assert(f == s);
+				assert(pos == (n % NUM_PACKETS_IN_FRAME));
+				s->secondary[n] ++;
+			}
+			else
+			{
+				assert(memcmp(voice, ambe_lfi_indicator, AMBE_Q_DATASIZE) == 0);
+			}
+			break;
+	}
+}
+
+static void stream_init (struct stream * s, uint8_t source, uint16_t session, uint8_t tag, unsigned long start, int frames)
+{
+	memset(s, 0, sizeof (struct stream));
+	s->source = source;
+	s->session = session;
+	s->tag = tag;
+	s->start = start;
+	s->frames = frames;
+}
+
+// ambeTask: a frame from ambe_q every 20ms, in the SD format for the chip
+
+static ambe_q_t decoder_q;
+static int sd_held, sd_expanded;
+
+int ambe_input_data (const uint8_t * d, const struct latency_tag * tag)
+{
+	return ambe_q_put_tag(&decoder_q, d, tag);
+}
+
+static void decode (void)
+{
+	uint8_t frame[AMBE_Q_DATASIZE], sd[AMBE_Q_DATASIZE_SD], e[AMBE_Q_DATASIZE_SD];
+	struct stream * f;
+
+	if (ambe_q_get(&decoder_q, frame) != 0)
+		return;
+
+	int held = (ambe_sd_hold_get(sd, frame) == 0);
+	int n = voice_frame(frame, &f);
+
+	if ((n >= 0) && (f == &phy))
+	{
+		make_sd(e, frame, n);
+		assert(held && (memcmp(sd, e, AMBE_Q_DATASIZE_SD) == 0));
+		sd_held ++;
+	}
+	else
+	{
+		ambe_expand_to_sd_data(e, frame);
+		assert(!held && (memcmp(sd, e, AMBE_Q_DATASIZE_SD) == 0));
+		sd_expanded ++;
+	}
+}
+
+// runs both streams until they have ended, every 20ms one call of rx_q_process
+
+static void run (void)
+{
+	int idle = 0;
+
+	while (idle < 100)
+	{
+		struct stream * s[2] = { &net, &phy };
+		int i;
+
+		host_ticks += 20;
+
+		for (i=0; i < 2; i++)
+		{
+			if ((host_ticks >= s[i]->start) && (s[i]->sent <= s[i]->frames))
+			{
+				if (s[i]->source == SOURCE_NET)
+				{
+					send_dcs(s[i]);
+				}
+				else
+				{
+					send_phy(s[i]);
+				}
+
+				s[i]->sent ++;
+			}
+		}
+
+		uint8_t pos, data[3], voice[AMBE_Q_DATASIZE];
+		struct stream * f;
+		int res = rx_q_process(&pos, data, voice);
+
+		decode();
+
+		if (res != 0)
+		{
+			int n = voice_frame(voice, &f);
+
+			if (n >= 0)
+			{
+				assert(res == f->source);
+				assert(pos == (n % NUM_PACKETS_IN_FRAME));
+				f->primary[n] ++;
+			}
+			else
+			{
+				assert(memcmp(voice, ambe_lfi_indicator, AMBE_Q_DATASIZE) == 0);
+			}
+		}
+
+		idle = ((net.sent > net.frames) && (phy.sent > phy.frames) && (current_source == 0)) ? idle + 1 : 0;
+	}
+}
+
+// frames [from, to) of s went to the primary (1) or the secondary (0) output, exactly once
+
+static void check (const struct stream * s, int from, int to, int primary)
+{
+	int i;
+
+	for (i=from; i < to; i++)
+	{
+		if ((s->primary[i] != primary) || (s->secondary[i] != !primary))
+		{
+			printf("stream %c frame %d: primary %d secondary %d\n", s->tag, i, s->primary[i], s->secondary[i]);
+			assert(0);
+		}
+	}
+}
+
+static int first_primary (const struct stream * s)
+{
+	int i;
+
+	for (i=0; i < s->frames; i++)
+	{
+		if (s->primary[i] != 0)
+			return i;
+	}
+
+	return -1;
+}
+
+int main (void)
+{
+	host_dstar_settings();
+	dstarInit(NULL);
+	ambe_q_initialize(&decoder_q);
+	rx_q_set_secondary(secondary);
+
+	// 1. first come: network first, the PHY stream is forwarded only
+	stream_init(&net, SOURCE_NET, 0x1234, 'N', 1000, 500);
+	stream_init(&phy, SOURCE_PHY, 0, 'P', 3000, 300);
+	run();
+	check(&net, 0, 500, 1);
+	check(&phy, 0, 300, 0);
+	assert((phy.sec_start == 1) && (phy.sec_end == 1) && (net.sec_start == 0));
+	printf("first come, net then PHY: net 500 frames played, PHY 300 frames to the secondary consumer\n");
+
+	// 2. first come: PHY first
+	stream_init(&net, SOURCE_NET, 0x2345, 'N', host_ticks + 2000, 400);
+	stream_init(&phy, SOURCE_PHY, 0, 'P', host_ticks + 1000, 300);
+	run();
+	check(&phy, 0, 300, 1);
+	check(&net, 0, 400, 0);
+	printf("first come, PHY then net: PHY 300 frames played, net 400 frames to the secondary consumer\n");
+	assert(sd_held == 300);
+
+	// 3. local RF first: PHY preempts the network stream
+	SETTING_CHAR(C_RX_ARBITRATION) = 1;
+	stream_init(&net, SOURCE_NET, 0x3456, 'N', host_ticks + 1000, 600);
+	stream_init(&phy, SOURCE_PHY, 0, 'P', host_ticks + 4000, 200);
+	uint32_t preempted = rx_arb_stats.preempted;
+	run();
+	int k = first_primary(&phy);
+	assert(k >= 0 && k < 5);  // PHY is played after its pre-buffering
+	check(&phy, k, 200, 1);
+	assert(rx_arb_stats.preempted == preempted + 1);
+	int i, net_primary = 0, net_secondary = 0;
+	for (i=0; i < 600; i++)
+	{
+		assert(net.primary[i] + net.secondary[i] <= 1);
+		net_primary += net.primary[i];
+		net_secondary += net.secondary[i];
+	}
+	assert(net.sec_start == 1);
+	printf("RF first: PHY preempts net, PHY frames %d..199 played; net %d frames played, %d to the secondary consumer\n",
+		k, net_primary, net_secondary);
+	assert(sd_held == 300 + 200 - k);
+
+	// 4. a second session on a busy source is dropped and counted
+	SETTING_CHAR(C_RX_ARBITRATION) = 0;
+	stream_init(&net, SOURCE_NET, 0x4567, 'N', host_ticks + 1000, 300);
+	stream_init(&phy, SOURCE_PHY, 0, 'P', host_ticks + 100000, 0);
+	phy.sent = 1;  // no PHY stream
+	uint32_t drops = rx_arb_stats.session_drop;
+	host_ticks += 20;
+	run();
+	check(&net, 0, 300, 1);
+	host_ticks += 1000;
+	stream_init(&net, SOURCE_NET, 0x5678, 'N', host_ticks, 100);
+	net.sent = 0;
+	{
+		struct stream other = net;
+		other.session = 0x6789;
+		int j;
+		for (j=0; j < 50; j++)
+		{
+			host_ticks += 20;
+			send_dcs(&net); net.sent ++;
+			other.sent = j;
+			send_dcs(&other);
+			rx_q_process(NULL, NULL, NULL);
+		}
+	}
+	assert(rx_arb_stats.session_drop - drops == 50);
+	printf("second session on the network stream: 50 frames dropped and counted\n");
+
+	printf("AMBE chip: %d PHY frames with their soft decision values, %d frames with hard bits\n",
+		sd_held, sd_expanded);
+
+	printf("all ok\n");
+	return 0;
+}
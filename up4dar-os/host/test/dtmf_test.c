@@ -0,0 +1,267 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dtmf_test.c
+ *
+ * DTMF detector (dtmf.c) driven by AMBE frame sequences: detected
+ * digit strings and the frame numbers of the digit events, for
+ * different on/off counts and digit gaps. Also compares the detector
+ * with the one it replaced (histogram rebuilt every frame in txtask.c).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "up_dstar/ambe_fec.h"
+#include "up_dstar/dtmf.h"
+
+
+static const char dtmfchar[] = " 123A456B789C*0#D";
+
+// one AMBE frame for every DTMF code (0 = voice), found by trying frames
+
+static uint8_t frames[DTMF_NUM_CODES][9];
+
+static void find_frames (void)
+{
+	int have[DTMF_NUM_CODES] = { 0 };
+	int found = 0;
+	uint32_t x = 1;
+
+	while (found < DTMF_NUM_CODES)
+	{
+		uint8_t d[9];
+		int i, c;
+
+		for (i=0; i < 9; i++)
+		{
+			x = x * 1103515245 + 12345;
+			d[i] = x >> 16;
+		}
+
+		c = ambe_get_dtmf_code(d);
+
+		if (have[c] == 0)
+		{
+			have[c] = 1;
+			memcpy(frames[c], d, 9);
+			found ++;
+		}
+	}
+}
+
+// seq: one character per frame, '.' = voice, otherwise the digit
+
+static void run (const char * name, const char * seq, int on, int off, int gap,
+	const char * digits, const char * event_frames)
+{
+	char out[40] = "", tim[200] = "";
+	struct dtmf_event ev;
+	const char * p;
+	int n = 0;
+
+	dtmf_detect_init(on, off, gap);
+
+	for (p=seq; *p; p++)
+	{
+		int code = (*p == '.') ? 0 : (strchr(dtmfchar, *p) - dtmfchar);
+		int digit;
+
+		assert(dtmf_detect(frames[code], &digit) == (((p - seq) < DTMF_DETECT_TIME) ? code : 0));
+	}
+
+	while (dtmf_get_event(&ev))
+	{
+		out[n++] = ev.digit;
+		sprintf(tim + strlen(tim), "%s%d", (n > 1) ? " " : "", ev.frame);
+	}
+
+	out[n] = 0;
+
+	printf("%-12s %-34.34s -> \"%s\" at frames %s\n", name, seq, out, tim);
+
+	assert(strcmp(out, digits) == 0);
+	assert(strcmp(tim, event_frames) == 0);
+}
+
+// the detector before dtmf.c, on DTMF codes
+
+static uint8_t old_history[5];
+static uint8_t old_tone_detected;
+static int old_counter;
+
+static void old_init (void)
+{
+	memset(old_history, 0, sizeof old_history);
+	old_tone_detected = 0;
+	old_counter = 0;
+}
+
+static int old_detect (int code)
+{
+	uint8_t histogram[17];
+	int i;
+
+	old_counter ++;
+	old_history[old_counter % 5] = code;
+
+	memset(histogram, 0, sizeof histogram);
+
+	for (i=0; i < 5; i++)
+	{
+		histogram[old_history[i]] ++;
+	}
+
+	for (i=0; i < 17; i++)
+	{
+		if (histogram[i] >= 3)
+		{
+			if (i != old_tone_detected)
+			{
+				old_tone_detected = i;
+
+				if (i > 0)
+					return dtmfchar[i];
+			}
+
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// random sequences of frames with the given codes, compared with the old detector
+
+static int compare_old (const int * codes, int num_codes, int runs)
+{
+	int differences = 0;
+	int r, i;
+
+	for (r=0; r < runs; r++)
+	{
+		int seq[60];
+		int same = 1;
+
+		for (i=0; i < 60; i++)
+		{
+			seq[i] = codes[rand() % num_codes];
+		}
+
+		old_init();
+		dtmf_detect_init(DTMF_DEFAULT_ON_COUNT, DTMF_DEFAULT_OFF_COUNT, 0);
+
+		for (i=0; i < 60; i++)
+		{
+			if (old_detect(seq[i]) != dtmf_detect_code(seq[i]))
+			{
+				same = 0;
+			}
+		}
+
+		differences += !same;
+	}
+
+	return differences;
+}
+
+int main (void)
+{
+	find_frames();
+
+	// defaults: 3 of 5 frames on, 2 of 5 off, no gap
+
+	run("digits", "1111.....2222.....3333....", 3, 2, 0, "123", "2 11 20");
+	run("repeat", "1111...1111...", 3, 2, 0, "11", "2 9");
+	run("dropouts", "11.11.11....", 3, 2, 0, "1", "3");
+	run("too short", "11...11...", 3, 2, 0, "", "");
+	run("no pause", "111222333.....", 3, 2, 0, "123", "2 5 8");
+	run("all codes", "DDDD....****....####....AAAA....0000....", 3, 2, 0, "D*#A0", "2 10 18 26 34");
+	run("uninit", "DDDD....1111....2222....3333....", 0, 0, 0, "D123", "2 10 18 26");
+
+	// minimum gap between the end of a digit and the next digit
+
+	run("gap 3", "111222333.....", 3, 2, 3, "13", "2 8");
+	run("gap 3 ok", "111...222...", 3, 2, 3, "12", "2 8");
+
+	// hysteresis: with off count 1 a digit needs 4 frames without it to end
+
+	run("off 1", "1111..1111....", 3, 1, 0, "1", "2");
+	run("off 1 ends", "1111....1111....", 3, 1, 0, "11", "2 10");
+	run("on 5", "1111.11111....", 5, 4, 0, "1", "9");
+
+	// detection only in the first DTMF_DETECT_TIME frames
+	{
+		char seq[DTMF_DETECT_TIME + 10];
+
+		memset(seq, '.', DTMF_DETECT_TIME - 2);
+		strcpy(seq + DTMF_DETECT_TIME - 2, "5555....");
+		run("late", seq, 3, 2, 0, "", "");
+		strcpy(seq + DTMF_DETECT_TIME - 4, "5555....");
+		run("just in time", seq, 3, 2, 0, "5", "248");
+	}
+
+	// compared with the old detector:
+	// - windows with voice frames and one DTMF code give the same digits
+	// - with two DTMF codes in the window the old detector kept a digit
+	//   until another code (voice too) had 3 frames, the new one ends it
+	//   when it has 2 frames or less. The same digit after a short
+	//   mix of voice and another code is therefore reported again.
+
+	srand(1);
+
+	int voice_and_one[] = { 0, 1 };
+	int voice_and_two[] = { 0, 1, 2 };
+
+	assert(compare_old(voice_and_one, 2, 100000) == 0);
+	printf("voice and one DTMF code: 100000 random sequences, same digits as the old detector\n");
+
+	int d = compare_old(voice_and_two, 3, 100000);
+	assert(d > 0);
+	printf("voice and two DTMF codes: %d of 100000 random sequences differ from the old detector\n", d);
+
+	{
+		const char * seq = "111.2.111....";
+		const char * p;
+		char old_out[10] = "";
+		int n = 0;
+
+		old_init();
+
+		for (p=seq; *p; p++)
+		{
+			int c = old_detect((*p == '.') ? 0 : (*p - '0'));
+
+			if (c != 0)
+				old_out[n++] = c;
+		}
+
+		assert(strcmp(old_out, "1") == 0);
+		run("mixed", seq, 3, 2, 0, "11", "2 8");
+	}
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,338 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * eth_rx_test.c
+ *
+ * eth.c (included, the test looks at the ring and the statistics) on
+ * the MACB model with simulated time: the Ethernet task sleeps in
+ * eth_wait() until the RX interrupt and works through the ring with
+ * eth_rx(ETH_RX_BUDGET). Traffic: idle, D-STAR voice with some
+ * background, a busy network and a broadcast storm. Reported are the
+ * wakes per second, dropped frames and the time from the arrival of a
+ * frame to its processing. Then the resync of the ring after an overrun.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "up_io/eth.c"
+
+#include "macb_model.h"
+
+
+#define CYC_PER_MS		(configCPU_CLOCK_HZ / 1000)
+#define PROC_CYCLES		1300	// about 20us to process a frame (IPv4, UDP, DCS)
+#define YIELD_CYCLES	6554	// tasks of the same priority run for 100us
+
+
+static uint32_t sim_now;  // cycle counter
+static int sem;
+
+uint32_t host_sys_count (void)
+{
+	return sim_now;
+}
+
+
+// frames on the wire
+
+struct arrival
+{
+	uint32_t t;
+	int len;
+	int voice;
+};
+
+static struct arrival * arr;
+static int num_arr, next_arr;
+
+static int received, dropped, bad, order_errors, last_seq;
+static double lat_sum, voice_lat_sum;
+static uint32_t lat_max, voice_lat_max, longest_run;
+static int voice_count, wakes;
+
+static void frame_data (uint8_t * fr, int seq, int len)
+{
+	int k;
+
+	for (k=0; k < len; k++)
+	{
+		fr[k] = (uint8_t) (seq * 7 + k);
+	}
+
+	fr[12] = 0x00;  // eth.c compares the type as a 16 bit word
+	fr[13] = 0x08;
+	memcpy(fr + 14, &seq, sizeof seq);
+}
+
+static void deliver (int seq)
+{
+	uint8_t fr[1600];
+
+	frame_data(fr, seq, arr[seq].len);
+	arr[seq].t = sim_now;
+
+	dropped += macb_rx_frame(fr, arr[seq].len);
+}
+
+static void advance_to (uint32_t t)
+{
+	while ((next_arr < num_arr) && ((int32_t) (arr[next_arr].t - t) <= 0))
+	{
+		sim_now = arr[next_arr].t;
+		deliver(next_arr++);
+	}
+
+	if ((int32_t) (t - sim_now) > 0)
+	{
+		sim_now = t;
+	}
+}
+
+
+void ipv4_input (eth_rx_frame_t * f)
+{
+	uint8_t lin[1600], e[1600];
+	int seq;
+
+	memcpy(lin, f->data, f->len1);
+
+	if (f->len1 < f->len)
+	{
+		memcpy(lin + f->len1, f->data2, f->len - f->len1);
+	}
+
+	memcpy(&seq, lin + 14, sizeof seq);
+	assert((seq >= 0) && (seq < num_arr));
+
+	frame_data(e, seq, arr[seq].len);
+
+	if ((f->len != arr[seq].len) || (memcmp(lin, e, f->len) != 0))
+	{
+		bad ++;
+	}
+
+	if (seq <= last_seq)
+	{
+		order_errors ++;
+	}
+
+	last_seq = seq;
+	received ++;
+
+	uint32_t lat = sim_now - arr[seq].t;
+
+	lat_sum += lat;
+
+	if (lat > lat_max)
+	{
+		lat_max = lat;
+	}
+
+	if (arr[seq].voice)
+	{
+		voice_lat_sum += lat;
+		voice_count ++;
+
+		if (lat > voice_lat_max)
+		{
+			voice_lat_max = lat;
+		}
+	}
+
+	advance_to(sim_now + PROC_CYCLES);
+}
+
+void arp_process_packet (uint8_t * raw_packet)
+{
+}
+
+
+// the Ethernet task sleeps until the interrupt gives the semaphore
+
+portBASE_TYPE xSemaphoreGive (xSemaphoreHandle s)
+{
+	sem = 1;
+	return pdTRUE;
+}
+
+portBASE_TYPE xSemaphoreTake (xSemaphoreHandle s, portTickType timeout)
+{
+	uint32_t deadline = sim_now + timeout * CYC_PER_MS;
+
+	while (1)
+	{
+		if (sem)
+		{
+			sem = 0;
+			return pdTRUE;
+		}
+
+		if ((next_arr < num_arr) && ((int32_t) (arr[next_arr].t - deadline) <= 0))
+		{
+			advance_to(arr[next_arr].t);
+		}
+		else
+		{
+			advance_to(deadline);
+			return pdFALSE;
+		}
+	}
+}
+
+
+static void run (uint32_t end)
+{
+	int more = 0;
+
+	while (((int32_t) (sim_now - end) < 0) || more)
+	{
+		uint32_t t0 = sim_now;
+
+		wakes ++;
+		more = macb_eth_rx(ETH_RX_BUDGET);
+
+		if ((sim_now - t0) > longest_run)
+		{
+			longest_run = sim_now - t0;
+		}
+
+		if (more)
+		{
+			advance_to(sim_now + YIELD_CYCLES);
+		}
+		else
+		{
+			eth_wait(ETH_IDLE_TIMEOUT);
+		}
+	}
+}
+
+static int cmp_arrival (const void * a, const void * b)
+{
+	const struct arrival * x = a;
+	const struct arrival * y = b;
+
+	return (x->t > y->t) - (x->t < y->t);
+}
+
+#define US(c)	((c) / (CYC_PER_MS / 1000.0))
+
+static void scenario (const char * name, int secs, int voice_fps, int bg_fps,
+	int minlen, int maxlen, int max_voice_lat_us)
+{
+	uint32_t base = sim_now + 1000;
+	uint32_t wrapped = eth_rx_stats.wrapped;
+	int i, n = 0;
+
+	arr = calloc(secs * (voice_fps + bg_fps) + 1, sizeof *arr);
+
+	for (i=0; i < (secs * voice_fps); i++)
+	{
+		arr[n].t = base + (uint32_t) ((uint64_t) i * configCPU_CLOCK_HZ / voice_fps) + rand() % 3000;
+		arr[n].len = 142;
+		arr[n++].voice = 1;
+	}
+
+	for (i=0; i < (secs * bg_fps); i++)
+	{
+		arr[n].t = base + (uint32_t) ((uint64_t) rand() * secs * configCPU_CLOCK_HZ / RAND_MAX);
+		arr[n].len = minlen + rand() % (maxlen - minlen + 1);
+		arr[n++].voice = 0;
+	}
+
+	qsort(arr, n, sizeof *arr, cmp_arrival);
+
+	num_arr = n;
+	next_arr = 0;
+	received = dropped = bad = order_errors = voice_count = wakes = 0;
+	last_seq = -1;
+	lat_sum = voice_lat_sum = 0;
+	lat_max = voice_lat_max = longest_run = 0;
+
+	run(sim_now + (uint32_t) secs * configCPU_CLOCK_HZ);
+	run(sim_now + 200 * CYC_PER_MS);  // the frames of the last 200ms
+
+	printf("%-6s %6d wakes/s, %6d frames (%5u wrapped), %5d dropped, latency mean %5.1f max %6.1f us,"
+		" voice mean %5.1f max %6.1f us, longest run %6.1f us\n",
+		name, wakes / secs, n, eth_rx_stats.wrapped - wrapped, dropped,
+		received ? US(lat_sum / received) : 0, US(lat_max),
+		voice_count ? US(voice_lat_sum / voice_count) : 0, US(voice_lat_max), US(longest_run));
+
+	assert((bad == 0) && (order_errors == 0));
+	assert((received + dropped) == n);
+	assert(longest_run <= (ETH_RX_BUDGET * PROC_CYCLES + CYC_PER_MS / 10));
+	assert(US(voice_lat_max) <= max_voice_lat_us);
+
+	free(arr);
+}
+
+
+// the MACB skipped buffers in an overrun, the ring is searched once
+
+static void overrun_resync (void)
+{
+	static struct arrival a[3] = { { 0, 200, 0 }, { 0, 60, 0 }, { 0, 1514, 0 } };
+	uint32_t resyncs = eth_rx_stats.resyncs;
+
+	arr = a;
+	num_arr = next_arr = 3;
+	received = 0;
+	last_seq = -1;
+
+	macb_rx_skip(5);
+	deliver(0);
+	assert((macb_eth_rx(ETH_RX_BUDGET) == 0) && (received == 0));  // not seen without the overrun
+
+	macb_rx_overrun();
+	deliver(1);
+	deliver(2);
+	assert((macb_eth_rx(ETH_RX_BUDGET) == 0) && (received == 3));
+	assert(eth_rx_stats.resyncs == (resyncs + 1));
+	assert(eth_rx_stats.overruns == 1);
+
+	// the bits were cleared
+	assert(macb_eth_rx(ETH_RX_BUDGET) == 0);
+	assert(eth_rx_stats.overruns == 1);
+
+	printf("overrun: ring searched once, 3 frames received\n");
+}
+
+
+int main (void)
+{
+	macb_eth_init();
+
+	srand(1);
+
+	scenario("idle", 10, 0, 0, 60, 60, 0);
+	assert(wakes <= ((10 * 1000 + 200) / ETH_IDLE_TIMEOUT));  // only the timeouts
+	scenario("voice", 10, 50, 20, 60, 1514, 100);
+	scenario("busy", 10, 50, 2000, 60, 1514, 1000);
+	scenario("storm", 2, 50, 20000, 60, 64, 1000);
+	assert(eth_rx_stats.lat_count > 0);  // the task was woken by the interrupt
+
+	overrun_resync();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,429 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * eth_sg_test.c
+ *
+ * Frames from a buffer and payload segments (eth_txmem_add_seg()) on the
+ * MACB model, through ipv4.c: the frame on the wire is the same as the
+ * frame built in one buffer, the UDP checksum is right for segments at
+ * odd and even offsets, shared segments are freed after the last frame
+ * was sent. Then the DCS send path with and without segments: bytes
+ * written to the TX buffers, buffer sizes and time per frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include <asf.h>
+
+#include "up_io/eth_txmem.h"
+#include "up_net/ipneigh.h"
+#include "up_net/ipv4.h"
+#include "up_net/inet_csum.h"
+
+#include "macb_model.h"
+#include "host_time.h"
+
+
+static uint32_t sim_now;
+
+uint32_t host_sys_count (void)
+{
+	return sim_now;
+}
+
+
+// frames on the wire
+
+#define MAX_WIRE	32
+
+static uint8_t wire[MAX_WIRE][1600];
+static int wire_len[MAX_WIRE], num_wire;
+
+static void sent (const uint8_t * frame, int len)
+{
+	if (num_wire < MAX_WIRE)
+	{
+		memcpy(wire[num_wire], frame, len);
+		wire_len[num_wire] = len;
+	}
+
+	num_wire ++;
+}
+
+// the MACB sends everything in the ring, the buffers are reclaimed
+
+static void run (void)
+{
+	macb_poll(sim_now);
+	sim_now += configCPU_CLOCK_HZ / 100;
+	macb_tx_run(sim_now);
+	macb_eth_txmem_flush_q(sim_now);
+}
+
+// the neighbor cache of net_env.c knows every neighbor
+
+void ipneigh_send_packet (const ip_addr_t * a, eth_txmem_t * packet)
+{
+	ipneigh_get_mac(a, (mac_addr_t *) packet->data);
+	eth_txmem_send(packet);
+}
+
+
+// UDP checksum of the frame on the wire, summed in the byte order of the
+// CPU like ipv4.c does it
+
+static int wire_checksum_ok (const uint8_t * f, int len)
+{
+	int udp_length = ((const uint16_t *) (f + 14)) [12];
+
+	assert(udp_length == (len - 34));
+
+	uint32_t sum = inet_csum_add(0, f + 26, 8) + 17 + udp_length;
+
+	sum = inet_csum_add(sum, f + 34, 6);
+	sum = inet_csum_add(sum, f + 42, len - 42);
+	sum = INET_CSUM_FINISH(sum);
+
+	if (sum == 0)
+	{
+		sum = 0xFFFF;
+	}
+
+	return sum == ((const uint16_t *) (f + 14)) [13];
+}
+
+// frames a and b are equal but for the IP ID and the IP header checksum
+
+static int same_datagram (int a, int b)
+{
+	return (wire_len[a] == wire_len[b]) &&
+		(memcmp(wire[a], wire[b], 18) == 0) &&
+		(memcmp(wire[a] + 20, wire[b] + 20, 4) == 0) &&
+		(memcmp(wire[a] + 26, wire[b] + 26, wire_len[a] - 26) == 0);
+}
+
+
+// buffers in the free lists (10 * 200 and 3 * 1540 bytes)
+
+#define ALL_FREE	13
+
+static int free_buffers (void)
+{
+	eth_txmem_t * b[20];
+	int n = 0;
+
+	while ((n < 20) && ((b[n] = eth_txmem_get_raw(60)) != NULL))
+	{
+		n ++;
+	}
+
+	int count = n;
+
+	while (n > 0)
+	{
+		eth_txmem_free(b[--n]);
+	}
+
+	return count;
+}
+
+
+static const uint8_t dest[4] = { 169, 254, 1, 2 };
+
+#define INFO_SIZE	500
+
+static uint8_t info_mem[INFO_SIZE];
+static eth_txmem_t info_seg;
+
+
+// DCS connect request: 19 bytes and the HTML info
+
+static eth_txmem_t * connect_one_buffer (udp4_flow_t * flow)
+{
+	eth_txmem_t * p = udp4_flow_get_packet_mem(flow, 19 + INFO_SIZE);
+
+	memcpy(p->data + 42, "DL1BFF  B C", 11);
+	memcpy(p->data + 42 + 19, info_mem, INFO_SIZE);  // infocpy() for every request
+
+	return p;
+}
+
+static eth_txmem_t * connect_seg (udp4_flow_t * flow)
+{
+	eth_txmem_t * p = udp4_flow_get_packet_mem_seg(flow, 19, &info_seg);
+
+	memcpy(p->data + 42, "DL1BFF  B C", 11);
+
+	return p;
+}
+
+
+static void same_frames (void)
+{
+	udp4_flow_t flow;
+
+	udp4_flow_connect(&flow, dest, 30051, 30051);
+
+	num_wire = 0;
+	udp4_flow_send(&flow, connect_one_buffer(&flow));
+	udp4_flow_send(&flow, connect_seg(&flow));
+	run();
+
+	eth_txmem_t * p = udp4_get_packet_mem(19 + INFO_SIZE, 30051, 30051, dest);
+	memcpy(p->data + 42, "DL1BFF  B C", 11);
+	memcpy(p->data + 42 + 19, info_mem, INFO_SIZE);
+	udp4_calc_chksum_and_send(p, dest);
+
+	p = udp4_get_packet_mem_seg(19, &info_seg, 30051, 30051, dest);
+	memcpy(p->data + 42, "DL1BFF  B C", 11);
+	udp4_calc_chksum_and_send(p, dest);
+	run();
+
+	assert((num_wire == 4) && (wire_len[0] == 561));
+	assert(same_datagram(0, 1) && same_datagram(2, 3) && same_datagram(0, 2));
+	assert(wire_checksum_ok(wire[1], wire_len[1]) && wire_checksum_ok(wire[3], wire_len[3]));
+	assert((free_buffers() == ALL_FREE) && (info_seg.refs == 1));
+
+	printf("connect request with the info segment: same frame as from one buffer\n");
+}
+
+
+// random frames: no segment, a shared segment from the pool, the static
+// segment or both, with 0 to 59 bytes in the buffer (odd and even offsets)
+
+static void random_frames (void)
+{
+	static uint8_t expect[8][1600];
+	int expect_len[8];
+	long frames = 0, seg_frames = 0;
+	udp4_flow_t flow;
+	int i, j, k;
+
+	srand(3);
+	udp4_flow_connect(&flow, dest, 1000, 2000);
+
+	for (i=0; i < 20000; i++)
+	{
+		eth_txmem_t * shared = NULL;
+		int n = 0;
+
+		if (rand() & 1)
+		{
+			int len = 1 + rand() % 150;
+
+			shared = eth_txmem_get_raw(len);
+
+			for (k=0; k < len; k++)
+			{
+				shared->data[k] = rand();
+			}
+		}
+
+		num_wire = 0;
+
+		for (j = 1 + rand() % 6; j > 0; j--)
+		{
+			int h = rand() % 60;
+			int kind = rand() % 3;
+			int use_flow = rand() & 1;
+			eth_txmem_t * s = ((kind == 1) && (shared != NULL)) ? shared : ((kind == 2) ? &info_seg : NULL);
+			eth_txmem_t * p;
+
+			if (use_flow)
+			{
+				p = (s != NULL) ? udp4_flow_get_packet_mem_seg(&flow, h, s) : udp4_flow_get_packet_mem(&flow, h);
+			}
+			else
+			{
+				p = (s != NULL) ? udp4_get_packet_mem_seg(h, s, 1000, 2000, dest) : udp4_get_packet_mem(h, 1000, 2000, dest);
+			}
+
+			if (p == NULL)
+				continue;
+
+			for (k=0; k < h; k++)
+			{
+				p->data[42 + k] = rand();
+			}
+
+			if ((s == shared) && (s != NULL) && ((rand() % 5) == 0))
+			{
+				assert(eth_txmem_add_seg(p, &info_seg) == 0);
+
+				if (!use_flow)
+				{
+					ipv4_udp_prepare_packet(p, dest, eth_txmem_frame_len(p) - 42, 1000, 2000);
+				}
+			}
+
+			// the buffer and the segments one after the other
+			int off = p->tx_size;
+
+			memcpy(expect[n], p->data, off);
+
+			for (k=0; k < p->num_seg; k++)
+			{
+				memcpy(expect[n] + off, p->seg[k]->data, p->seg[k]->tx_size);
+				off += p->seg[k]->tx_size;
+			}
+
+			expect_len[n++] = off;
+			seg_frames += (p->num_seg != 0);
+
+			if (use_flow)
+			{
+				udp4_flow_send(&flow, p);
+			}
+			else
+			{
+				udp4_calc_chksum_and_send(p, dest);
+			}
+		}
+
+		if (shared != NULL)
+		{
+			eth_txmem_free(shared);  // the frames hold their own references
+		}
+
+		run();
+
+		assert(num_wire == n);
+
+		for (j=0; j < n; j++)
+		{
+			assert(wire_len[j] == expect_len[j]);
+			assert(memcmp(wire[j] + 42, expect[j] + 42, expect_len[j] - 42) == 0);
+			assert(wire_checksum_ok(wire[j], wire_len[j]));
+		}
+
+		frames += n;
+	}
+
+	assert((free_buffers() == ALL_FREE) && (info_seg.refs == 1));
+
+	printf("%ld random frames, %ld with segments: contents and checksums ok, all buffers freed\n",
+		frames, seg_frames);
+}
+
+
+// DCS send path: bytes the CPU writes to TX buffers, the buffer size and
+// the time from eth_txmem_get() to eth_txmem_send() for 3 frames at a
+// time (3 buffers of 1540 bytes), the MACB model is not measured
+
+#define ROUNDS	20000
+
+static int bench (const char * name, eth_txmem_t * (* get) (udp4_flow_t * flow), udp4_flow_t * flow)
+{
+	eth_txmem_t * p = get(flow);
+	int written = p->tx_size;
+
+	udp4_flow_send(flow, p);
+	run();
+
+	uint64_t t = 0;
+	int i, k;
+
+	for (i=0; i < ROUNDS; i++)
+	{
+		uint64_t t0 = host_nsec();
+
+		for (k=0; k < 3; k++)
+		{
+			udp4_flow_send(flow, get(flow));
+		}
+
+		t += host_nsec() - t0;
+		run();
+	}
+
+	printf("%-36s %4d bytes written, buffer of %4d bytes, %4.0f ns per frame\n",
+		name, written, (written <= 200) ? 200 : 1540, (double) t / (3 * ROUNDS));
+
+	return written;
+}
+
+
+static eth_txmem_t * voice_shared;
+
+static eth_txmem_t * voice_copy (udp4_flow_t * flow)
+{
+	eth_txmem_t * p = udp4_flow_get_packet_mem(flow, 100);
+
+	memcpy(p->data + 42, voice_shared->data, 100);
+	return p;
+}
+
+static eth_txmem_t * voice_seg (udp4_flow_t * flow)
+{
+	return udp4_flow_get_packet_mem_seg(flow, 0, voice_shared);
+}
+
+static void dcs_send_path (void)
+{
+	udp4_flow_t flow;
+
+	udp4_flow_connect(&flow, dest, 30051, 30051);
+
+	assert(bench("connect request, one buffer:", connect_one_buffer, &flow) == (42 + 19 + INFO_SIZE));
+	assert(bench("connect request, info segment:", connect_seg, &flow) == (42 + 19));
+
+	// a voice frame to three destinations: three copies or three headers
+	// with the frame as a shared segment
+
+	voice_shared = eth_txmem_get_raw(100);
+	memset(voice_shared->data, 0x55, 100);
+
+	assert(bench("voice frame copied per destination:", voice_copy, &flow) == 142);
+	assert(bench("voice frame as shared segment:", voice_seg, &flow) == 42);
+
+	eth_txmem_free(voice_shared);
+	run();
+
+	assert(free_buffers() == ALL_FREE);
+}
+
+
+int main (void)
+{
+	int i;
+
+	assert(eth_txmem_init() == 0);
+	ipv4_init();
+	macb_tx_sent = sent;
+
+	for (i=0; i < INFO_SIZE; i++)
+	{
+		info_mem[i] = 'a' + (i % 26);
+	}
+
+	eth_txmem_static_init(&info_seg, info_mem, INFO_SIZE);
+
+	same_frames();
+	random_frames();
+	dcs_send_path();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,336 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * eth_tx_test.c
+ *
+ * eth_txmem.c on the MACB model with simulated time: D-STAR voice frames
+ * every 20ms and bursts of other frames (SNMP, DNS, APRS) are appended
+ * to the TX ring while the MACB is sending. The Ethernet task reclaims
+ * the buffers when the TCOMP interrupt wakes it and higher priority
+ * tasks leave it the CPU. Every frame on the wire is compared with the
+ * frame that was sent, reported is the time from eth_txmem_send() to
+ * the end of the frame on the wire. Then a TX error, a lost TSTART and
+ * the buffer pools after all frames were sent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include <asf.h>
+#include "intc.h"
+
+#include "up_io/eth_txmem.h"
+#include "up_net/snmp_data.h"
+
+#include "macb_model.h"
+
+
+#define US(us)		((uint32_t) ((us) * (configCPU_CLOCK_HZ / 1000000.0)))
+
+extern int32_t host_snmp_value;
+
+static uint32_t sim_now;  // cycle counter
+static int eth_sem;
+
+uint32_t host_sys_count (void)
+{
+	return sim_now;
+}
+
+// the interrupt handler of eth.c wakes the Ethernet task
+static void eth_int (void)
+{
+	eth_sem = 1;
+}
+
+
+// frames: sequence number and kind in the first bytes, then a pattern
+
+#define MAX_SEQ		100000
+
+static uint32_t t_send[MAX_SEQ];
+static uint8_t voice_of[MAX_SEQ];
+static int len_of[MAX_SEQ];
+static int next_seq, last_seq_on_wire = -1, lost, bad;
+
+static double lat_sum[2], lat_max[2];
+static long lat_count[2], dropped[2], no_mem[2];
+
+static void sent (const uint8_t * frame, int len)
+{
+	int seq, k;
+
+	memcpy(&seq, frame, sizeof seq);
+	assert((seq > last_seq_on_wire) && (seq < next_seq));
+
+	lost += seq - last_seq_on_wire - 1;
+	last_seq_on_wire = seq;
+
+	if (len != len_of[seq])
+	{
+		bad ++;
+	}
+
+	for (k=sizeof seq; k < len; k++)
+	{
+		if (frame[k] != (uint8_t) (seq + k))
+		{
+			bad ++;
+			break;
+		}
+	}
+
+	int v = voice_of[seq];
+	double lat = (sim_now - t_send[seq]) / (configCPU_CLOCK_HZ / 1000000.0);
+
+	lat_sum[v] += lat;
+	lat_count[v] ++;
+
+	if (lat > lat_max[v])
+	{
+		lat_max[v] = lat;
+	}
+}
+
+// returns 0 if the frame went to the TX ring
+
+static int send (int len, int voice)
+{
+	eth_txmem_t * b = eth_txmem_get_raw(len);
+	int seq = next_seq;
+	int k;
+
+	if (b == NULL)
+	{
+		no_mem[voice] ++;
+		return -1;
+	}
+
+	assert(seq < MAX_SEQ);
+
+	memcpy(b->data, &seq, sizeof seq);
+
+	for (k=sizeof seq; k < len; k++)
+	{
+		b->data[k] = (uint8_t) (seq + k);
+	}
+
+	t_send[seq] = sim_now;
+	voice_of[seq] = voice;
+	len_of[seq] = len;
+	next_seq ++;
+
+	int r = eth_txmem_send(b);
+
+	macb_poll(sim_now);
+
+	if (r != 0)
+	{
+		dropped[voice] ++;
+		lost --;  // not sent, counted by sent() as lost
+	}
+
+	return r;
+}
+
+
+static int snmp_value (int arg)
+{
+	uint8_t res[8];
+	int res_len;
+
+	snmp_get_eth_tx(arg, res, &res_len, sizeof res);
+	return host_snmp_value;
+}
+
+// buffers in the free lists: all * 100 + large (10 * 200 and 3 * 1540 bytes)
+
+#define ALL_FREE	1303
+
+static int count_free (int size)
+{
+	eth_txmem_t * b[20];
+	int n = 0;
+
+	while ((n < 20) && ((b[n] = eth_txmem_get_raw(size)) != NULL))
+	{
+		n ++;
+	}
+
+	int count = n;
+
+	while (n > 0)
+	{
+		eth_txmem_free(b[--n]);
+	}
+
+	return count;
+}
+
+static int free_buffers (void)
+{
+	return count_free(60) * 100 + count_free(1500);
+}
+
+
+static void traffic (int secs)
+{
+	uint32_t end = sim_now + secs * configCPU_CLOCK_HZ;
+	uint32_t next_voice = sim_now;
+	uint32_t next_burst = sim_now + US(3000);
+	uint32_t busy_until = 0;
+	long runs = 0, frames = macb_tx_frames, starts = macb_tx_starts;
+
+	for ( ; (int32_t) (sim_now - end) < 0; sim_now += US(1))
+	{
+		macb_tx_run(sim_now);
+
+		if ((int32_t) (sim_now - next_voice) >= 0)
+		{
+			// AMBE and audio tasks keep the CPU for up to 3ms every 20ms
+			next_voice += US(20000);
+			busy_until = sim_now + US(300 + rand() % 3000);
+			send(100, 1);  // DCS voice frame
+		}
+
+		if ((int32_t) (sim_now - next_burst) >= 0)
+		{
+			// SNMP walk replies, DNS, APRS: 1 to 12 frames
+			int n = 1 + rand() % 12;
+			int i;
+
+			for (i=0; i < n; i++)
+			{
+				send((rand() & 3) ? (100 + rand() % 100) : (1000 + rand() % 500), 0);
+			}
+
+			next_burst = sim_now + US(1000 + rand() % 15000);
+		}
+
+		if (eth_sem && ((int32_t) (sim_now - busy_until) >= 0))
+		{
+			eth_sem = 0;
+			macb_eth_txmem_flush_q(sim_now);
+			runs ++;
+		}
+	}
+
+	frames = macb_tx_frames - frames;
+	starts = macb_tx_starts - starts;
+
+	printf("%d s: %ld frames on the wire, %ld TSTART that started the MACB, %ld Ethernet task runs\n",
+		secs, frames, starts, runs);
+	printf("voice: mean %5.0f us, max %5.0f us, %ld dropped, %ld no buffer\n",
+		lat_sum[1] / lat_count[1], lat_max[1], dropped[1], no_mem[1]);
+	printf("other: mean %5.0f us, max %5.0f us, %ld dropped, %ld no buffer\n",
+		lat_sum[0] / lat_count[0], lat_max[0], dropped[0], no_mem[0]);
+	printf("eth_txmem: queue latency mean %d us max %d us, max %d descriptors in use\n",
+		snmp_value(4), snmp_value(5), snmp_value(6));
+
+	assert(bad == 0);
+	assert(starts < frames);  // frames are appended while the MACB is sending
+	assert((dropped[1] == 0) && (no_mem[1] == 0));
+	assert(lat_max[1] < 1000);
+}
+
+
+static void drain (void)
+{
+	int i;
+
+	for (i=0; i < 100; i++)
+	{
+		sim_now += US(100);
+		macb_tx_run(sim_now);
+		macb_eth_txmem_flush_q(sim_now);
+	}
+}
+
+
+int main (void)
+{
+	assert(eth_txmem_init() == 0);
+
+	INTC_register_interrupt(eth_int, AVR32_MACB_IRQ, AVR32_INTC_INT1);
+	AVR32_MACB.ier = AVR32_MACB_IER_TCOMP_MASK | AVR32_MACB_IER_TXUBR_MASK;
+	macb_poll(sim_now);
+
+	macb_tx_sent = sent;
+	srand(7);
+
+	traffic(20);
+	drain();
+
+	assert(last_seq_on_wire == (next_seq - 1));
+	assert(lost == 0);
+	assert(free_buffers() == ALL_FREE);
+	assert(snmp_value(1) == (next_seq - dropped[0]));
+
+	// TX error: the frames in the ring are lost, the ring starts again
+
+	int i;
+
+	for (i=0; i < 6; i++)
+	{
+		assert(send((i < 3) ? 1000 : 150, 0) == 0);
+	}
+
+	sim_now += US(100);
+	macb_tx_run(sim_now);
+	macb_tx_error(AVR32_MACB_TSR_UND_MASK);
+
+	drain();
+	assert(snmp_value(7) == 1);
+	assert(free_buffers() == ALL_FREE);
+
+	assert(send(100, 1) == 0);
+	drain();
+	assert(last_seq_on_wire == (next_seq - 1));
+	assert(lost >= 3);
+	printf("TX error: %d frames lost, ring restarted\n", lost);
+
+	// a TSTART that was lost: the Ethernet task starts the MACB
+
+	eth_txmem_t * b = eth_txmem_get(100);
+	int seq = next_seq++;
+
+	memcpy(b->data, &seq, sizeof seq);
+	len_of[seq] = 100;
+
+	for (i=sizeof seq; i < 100; i++)
+	{
+		b->data[i] = (uint8_t) (seq + i);
+	}
+
+	assert(eth_txmem_send(b) == 0);
+	AVR32_MACB.NCR.tstart = 0;
+
+	drain();
+	assert(last_seq_on_wire == seq);
+	assert(free_buffers() == ALL_FREE);
+	printf("lost TSTART: frame sent after the next run of the Ethernet task\n");
+
+	printf("all ok\n");
+	return 0;
+}
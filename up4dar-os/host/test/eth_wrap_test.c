@@ -0,0 +1,351 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * eth_wrap_test.c
+ *
+ * Frames that start at every buffer of the receive ring of eth.c
+ * (included) with every length, through ipv4.c and the UDP sockets:
+ * sockets that read only the first bytes (DCS, CCS) get the datagram
+ * in place, the others get it in one piece, copied if the frame wraps
+ * at the end of the ring. ICMP echo requests are answered with the
+ * same data. A broken byte in the second piece of a frame is found by
+ * the UDP checksum. The copy does not need a free TX buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "up_io/eth.c"
+
+#include "up_net/inet_csum.h"
+#include "up_net/udp_socket.h"
+#include "up_dstar/dcs.h"
+#include "up_dstar/ccs.h"
+
+#include "macb_model.h"
+
+
+static uint8_t fr[1600];  // the frame on the wire
+static int fr_len;
+
+static int calls, bad, echo_replies;
+
+
+static void fill (int from, int len, uint32_t seed)
+{
+	int k;
+
+	for (k=from; k < len; k++)
+	{
+		seed = seed * 1103515245 + 12345;
+		fr[k] = seed >> 16;
+	}
+}
+
+
+static void check (const uint8_t * data, int data_len, int read_len)
+{
+	calls ++;
+
+	if (data_len != (fr_len - 42))
+	{
+		bad ++;
+		return;
+	}
+
+	if ((read_len == 0) || (read_len > data_len))
+	{
+		read_len = data_len;
+	}
+
+	if (memcmp(data, fr + 42, read_len) != 0)
+	{
+		bad ++;
+	}
+}
+
+static void sock_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	check(data, data_len, s->read_len);
+	assert((ipv4_src_addr[3] == 2) && (src_port == 12345));
+}
+
+eth_txmem_t * snmp_process_request (const uint8_t * req, int req_len, int * data_len)
+{
+	check(req, req_len, 0);
+	return NULL;
+}
+
+void ipneigh_send_packet (const ip_addr_t * a, eth_txmem_t * packet)
+{
+	// echo reply: the data after type, code and checksum is the request's
+	if (memcmp(packet->data + 38, fr + 38, fr_len - 38) == 0)
+	{
+		echo_replies ++;
+	}
+	else
+	{
+		bad ++;
+	}
+
+	eth_txmem_free(packet);
+}
+
+
+static void ip_header (int proto)
+{
+	uint8_t * ip = fr + 14;
+	int total = fr_len - 14;
+
+	memset(fr, 0, 34);
+	fr[12] = 0x00;  // eth.c compares the type as a 16 bit word
+	fr[13] = 0x08;
+
+	ip[0] = 0x45;
+	ip[2] = total >> 8;
+	ip[3] = total;
+	ip[6] = 0x40;
+	ip[8] = 64;
+	ip[9] = proto;
+	ip[12] = 169; ip[13] = 254; ip[14] = 1; ip[15] = 2;
+	memcpy(ip + 16, ipv4_addr, 4);
+
+	((uint16_t *) ip)[5] = INET_CSUM_FINISH(inet_csum_add(0, ip, 20));
+}
+
+static void make_udp (int port, int len, uint32_t seed)
+{
+	uint8_t * u = fr + 34;
+	int ulen = len - 34;
+
+	fr_len = len;
+	fill(42, len, seed);
+
+	ip_header(17);
+
+	u[0] = 12345 >> 8; u[1] = 12345 & 0xFF;
+	u[2] = port >> 8; u[3] = port;
+	u[4] = ulen >> 8; u[5] = ulen;
+	u[6] = u[7] = 0;
+
+	uint32_t sum = inet_csum_add(0, fr + 26, 8) + 17 + ulen;
+	int cs = INET_CSUM_FINISH(inet_csum_add(sum, u, ulen));
+
+	if (cs == 0)
+	{
+		cs = 0xFFFF;
+	}
+
+	u[6] = cs >> 8;  // udp_input() reads the field as a number
+	u[7] = cs;
+}
+
+static void make_icmp (int len, uint32_t seed)
+{
+	uint8_t * p = fr + 34;
+
+	fr_len = len;
+	fill(34, len, seed);
+
+	ip_header(1);
+
+	p[0] = 8;  // echo request
+	p[1] = 0;
+	p[2] = p[3] = 0;
+	((uint16_t *) p)[1] = INET_CSUM_FINISH(inet_csum_add(0, p, len - 34));
+}
+
+
+// the MACB writes the next frame at buffer s, frames of up to 11 buffers
+// of another protocol fill the ring up to s
+
+static void move_to (int s)
+{
+	while (macb_rx_pos != s)
+	{
+		int n = (s - macb_rx_pos + RECV_BUF_COUNT) % RECV_BUF_COUNT;
+
+		if (n > 11)
+		{
+			n = 11;
+		}
+
+		fr_len = (n == 1) ? 60 : (n * RECV_BUF_SIZE);
+		ip_header(99);
+		assert(macb_rx_frame(fr, fr_len) == 0);
+		assert(macb_eth_rx(ETH_RX_BUDGET) == 0);
+	}
+}
+
+
+static udp_socket_t dcs_sock, ccs_sock, ntp_sock, dns_sock;
+static udp_socket_queue_t dns_q;
+static uint8_t dns_q_mem[UDP_SOCKET_QUEUE_MEM(2, 1500)];
+
+#define NUM_KINDS	6
+
+static const struct
+{
+	const char * name;
+	int port;  // 0: ICMP
+	int in_place;
+}
+kinds[NUM_KINDS] =
+{
+	{ "dcs", 30051, 1 },
+	{ "ccs", 30062, 1 },
+	{ "ntp", 123, 0 },
+	{ "dns", 40000, 0 },
+	{ "snmp", 161, 0 },
+	{ "icmp", 0, 0 }
+};
+
+
+int main (void)
+{
+	int k, s, len;
+
+	macb_eth_init();
+	eth_txmem_init();
+	ipv4_init();
+
+	udp_socket_init(&dcs_sock, sock_input, 0, DCS_INPUT_READ_LEN);
+	udp_socket_init(&ccs_sock, sock_input, 0, CCS_INPUT_READ_LEN);
+	udp_socket_init(&ntp_sock, sock_input, 0, 0);
+	udp_socket_init(&dns_sock, sock_input, 0, 0);
+	udp_socket_queue_init(&dns_q, dns_q_mem, 2, 1500);
+	udp_socket_set_queue(&dns_sock, &dns_q);
+
+	assert(udp_socket_bind(&dcs_sock, 30051) == 0);
+	assert(udp_socket_bind(&ccs_sock, 30062) == 0);
+	assert(udp_socket_bind(&ntp_sock, 123) == 0);
+	assert(udp_socket_bind(&dns_sock, 40000) == 0);
+
+	for (k=0; k < NUM_KINDS; k++)
+	{
+		uint32_t copied = eth_rx_stats.copied;
+		uint32_t wrapped = 0;
+		int calls0 = calls, echo0 = echo_replies;
+		int frames = 0, broken = 0;
+
+		for (s=0; s < RECV_BUF_COUNT; s++)
+		{
+			for (len=60; len <= 1514; len++)
+			{
+				int wraps = (s + (len + RECV_BUF_SIZE - 1) / RECV_BUF_SIZE) > RECV_BUF_COUNT;
+
+				move_to(s);
+
+				if (kinds[k].port != 0)
+				{
+					make_udp(kinds[k].port, len, len * 77 + s);
+				}
+				else
+				{
+					make_icmp(len, len * 77 + s);
+				}
+
+				uint32_t w = eth_rx_stats.wrapped;
+
+				assert(macb_rx_frame(fr, fr_len) == 0);
+				assert(macb_eth_rx(ETH_RX_BUDGET) == 0);
+				udp_socket_queue_service(&dns_q);
+
+				wrapped += eth_rx_stats.wrapped - w;
+				assert(eth_ptr == macb_rx_pos);
+				frames ++;
+
+				// a broken byte in the second piece
+				if ((kinds[k].port != 0) && wraps && ((len & 7) == 0))
+				{
+					int before = calls;
+
+					move_to(s);
+					make_udp(kinds[k].port, len, len * 77 + s);
+					fr[len - 1] ^= 0x10;
+
+					assert(macb_rx_frame(fr, fr_len) == 0);
+					assert(macb_eth_rx(ETH_RX_BUDGET) == 0);
+					udp_socket_queue_service(&dns_q);
+
+					assert(calls == before);
+					broken ++;
+				}
+			}
+		}
+
+		int got = (kinds[k].port != 0) ? (calls - calls0) : (echo_replies - echo0);
+
+		printf("%-5s %5d frames, %4u wrapped, %4u copied, %d delivered, %d broken frames dropped\n",
+			kinds[k].name, frames, wrapped, eth_rx_stats.copied - copied,
+			got, broken);
+
+		assert(bad == 0);
+		assert(got == frames);
+		assert(wrapped > 0);
+
+		if (kinds[k].in_place)
+		{
+			assert(eth_rx_stats.copied == copied);
+		}
+		else
+		{
+			assert(eth_rx_stats.copied > copied);
+		}
+	}
+
+	assert((dcs_sock.drop_count == 0) && (dns_sock.drop_count == 0));
+	assert(eth_rx_stats.no_buffer == 0);
+
+	// all TX buffers of 1540 bytes in use: a wrapped NTP frame is delivered
+	{
+		eth_txmem_t * tx[3];
+		int before = calls;
+		uint32_t copied = eth_rx_stats.copied;
+
+		for (k=0; k < 3; k++)
+		{
+			assert((tx[k] = eth_txmem_get_raw(1540)) != NULL);
+		}
+
+		assert(eth_txmem_get_raw(1540) == NULL);
+
+		move_to(RECV_BUF_COUNT - 2);
+		make_udp(123, 1000, 99);
+		assert(macb_rx_frame(fr, fr_len) == 0);
+		assert(macb_eth_rx(ETH_RX_BUDGET) == 0);
+
+		assert((calls == (before + 1)) && (bad == 0));
+		assert((eth_rx_stats.copied == (copied + 1)) && (eth_rx_stats.no_buffer == 0));
+
+		for (k=0; k < 3; k++)
+		{
+			eth_txmem_free(tx[k]);
+		}
+
+		printf("no free TX buffer: wrapped frame copied and delivered\n");
+	}
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * inet_csum_ref.c
+ *
+ * Reference for inet_csum_test.c: the checksums of ipv4.c before
+ * inet_csum.c (one 16 bit word per step, the checksum field skipped
+ * by its index, fold in a loop)
+ */
+
+
+#include "FreeRTOS.h"
+
+
+static int ref_ipv4_header_checksum( const uint8_t * p, int header_len )
+{
+	int sum = 0;
+	int i;
+	
+	for (i=0; i < (header_len >> 1); i++)
+	{
+		if (i != 5)  // skip checksum field
+		{
+			sum += ((unsigned short *) p) [i];
+		}
+	}
+	
+	while ((sum >> 16) != 0)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	
+	return ( ~sum ) & 0xFFFF;
+}
+
+
+static int ref_icmpv4_checksum( const uint8_t * p, int len )
+{
+	int sum = 0;
+	int i;
+	
+	for (i=0; i < (len >> 1); i++)
+	{
+		if (i != 1)  // das checksum-feld weglassen
+		{
+			sum += ((unsigned short *) p) [i];
+		}
+	}
+	
+	if ((len & 0x01) != 0)  // ungerade Anzahl bytes
+	{
+		sum += p[len -1] << 8;  // letztes byte mit 0 als padding
+	}
+	
+	while ((sum >> 16) != 0)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	
+	return ( ~sum ) & 0xFFFF;
+}
+
+
+// p is the IPv4 header, the first len1 bytes of the UDP datagram follow
+// the header, the rest is at p2 (datagram that wraps at the end of the
+// receive ring). len1 is even.
+
+static int ref_udp4_header_checksum( const uint8_t * p, int len1, const uint8_t * p2 )
+{
+	int sum = 0;
+	int i;
+
+	for (i=6; i < 10; i++) // dest+src IP addr
+	{
+		sum += ((unsigned short *) (p)) [i];
+	}
+
+	sum += 17;
+
+	int udp_length = (p[24] << 8) | p[25];
+	sum += udp_length;
+
+	if (len1 > udp_length)
+	{
+		len1 = udp_length;
+	}
+
+	for (i=0; i < (len1 >> 1); i++)
+	{
+		if (i != 3) // skip checksum field
+		{
+			sum += ((unsigned short *) (p + 20))[i];
+		}
+	}
+	
+	const uint8_t * last = p + 20;
+
+	if (len1 < udp_length)
+	{
+		last = p2 - len1;  // same index as in the first piece
+
+		for (; i < (udp_length >> 1); i++)
+		{
+			sum += ((unsigned short *) last)[i];
+		}
+	}
+
+	if ((udp_length & 1) == 1) // odd number of bytes
+	{
+		sum += last[udp_length-1] << 8;
+	}
+
+	while ((sum >> 16) != 0)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+
+	sum = ( ~sum ) & 0xFFFF;
+
+	if (sum == 0)
+	{
+		sum = 0xFFFF;
+	}
+	
+	return sum;
+}
@@ -0,0 +1,379 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * inet_csum_test.c
+ *
+ * inet_csum.c with the byte order of the firmware (the first byte of
+ * a word is the high byte): the IP header, ICMP and UDP checksums of
+ * ipv4.c are equal to the old word by word code (inet_csum_ref.c) for
+ * random datagrams, also for UDP datagrams in two pieces. Benchmark of
+ * the IP header (inet_csum_ip_header()), the sum and copy and sum
+ * against the old code.
+ *
+ * inet_csum_native_test builds the same file with the byte order of
+ * the host: sums at any address and length against RFC 1071, pieces
+ * added with inet_csum_swap(), inet_csum_copy() at any alignment and
+ * the incremental update against recomputation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "host_time.h"
+
+#include "inet_csum.h"
+
+#include "inet_csum_ref.c"
+
+
+static uint8_t buf[4096] __attribute__((aligned(8)));
+static uint8_t buf2[4096] __attribute__((aligned(8)));
+
+
+static void fill (uint8_t * d, int len)
+{
+	uint32_t seed = rand();
+	int i;
+
+	for (i=0; i < len; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		d[i] = seed >> 16;
+	}
+}
+
+
+#ifndef INET_CSUM_BYTE0
+
+// the checksums as ipv4.c calculates them
+
+static int ipv4_header_checksum( const uint8_t * p, int header_len )
+{
+	if (header_len == 20)  // no options
+	{
+		return inet_csum_ip_header(p);
+	}
+	
+	uint32_t sum = inet_csum_add(0, p, 10);
+	
+	sum = inet_csum_add(sum, p + 12, header_len - 12); // skip checksum field
+	
+	return INET_CSUM_FINISH(sum);
+}
+
+static int icmpv4_checksum( const uint8_t * p, int len )
+{
+	uint32_t sum = inet_csum_add(0, p, 2);
+	
+	sum = inet_csum_add(sum, p + 4, len - 4);  // das checksum-feld weglassen
+	
+	return INET_CSUM_FINISH(sum);
+}
+
+static int udp4_header_checksum( const uint8_t * p, int len1, const uint8_t * p2 )
+{
+	uint32_t sum = inet_csum_add(0, p + 12, 8); // dest+src IP addr
+
+	sum += 17;
+
+	int udp_length = (p[24] << 8) | p[25];
+	sum += udp_length;
+
+	if (len1 > udp_length)
+	{
+		len1 = udp_length;
+	}
+
+	sum = inet_csum_add(sum, p + 20, 6); // UDP header without checksum field
+	sum = inet_csum_add(sum, p + 28, len1 - 8);
+
+	if (len1 < udp_length)
+	{
+		sum = inet_csum_add(sum, p2, udp_length - len1);
+	}
+
+	sum = INET_CSUM_FINISH(sum);
+
+	if (sum == 0)
+	{
+		sum = 0xFFFF;
+	}
+
+	return sum;
+}
+
+
+static void old_equals_new (void)
+{
+	int n;
+
+	srand(1);
+
+	for (n=0; n < 100000; n++)
+	{
+		uint8_t * p = buf + 2 * (rand() & 1);  // the call sites have even addresses
+		int len = 28 + rand() % 1500;
+		int header_len = (rand() & 1) ? 20 : (20 + 4 * (rand() % 11));
+
+		fill(p, len);
+
+		assert(ref_ipv4_header_checksum(p, header_len) == ipv4_header_checksum(p, header_len));
+		assert(ref_icmpv4_checksum(p + 20, len - 20) == icmpv4_checksum(p + 20, len - 20));
+
+		// UDP datagram, in two pieces if it wraps at the end of the receive ring
+
+		int udp_length = len - 20;
+		int len1 = udp_length;
+
+		p[24] = udp_length >> 8;
+		p[25] = udp_length;
+
+		if (rand() & 1)
+		{
+			len1 = 8 + 2 * (rand() % ((udp_length - 8) / 2 + 1));
+			memcpy(buf2, p + 20 + len1, udp_length - len1);
+		}
+
+		assert(ref_udp4_header_checksum(p, len1, buf2) == udp4_header_checksum(p, len1, buf2));
+	}
+
+	printf("old == new: %d random IP headers, ICMP messages and UDP datagrams (1 or 2 pieces)\n", n);
+}
+
+
+static void benchmark (void)
+{
+	static const int sizes[] = { 20, 64, 142, 561, 1514 };
+	int i, k;
+
+	// IP header of 20 bytes behind the Ethernet header and word aligned
+
+	for (i=2; i >= 0; i -= 2)
+	{
+		uint8_t * p = buf + i;
+		int rounds = 20000000;
+
+		fill(p, 20);
+
+		uint64_t t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			host_sink += ref_ipv4_header_checksum(p, 20);
+			p[3] = k;
+		}
+		double t_old = (double) (host_nsec() - t) / rounds;
+
+		t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			uint32_t sum = inet_csum_add(0, p, 10);
+			host_sink += INET_CSUM_FINISH(inet_csum_add(sum, p + 12, 8));
+			p[3] = k;
+		}
+		double t_add = (double) (host_nsec() - t) / rounds;
+
+		t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			host_sink += inet_csum_ip_header(p);
+			p[3] = k;
+		}
+		double t_fast = (double) (host_nsec() - t) / rounds;
+
+		printf("IP header at address %% 4 = %d: old %5.1f ns, inet_csum_add() %5.1f ns, inet_csum_ip_header() %5.1f ns\n",
+			i, t_old, t_add, t_fast);
+	}
+
+	for (i=0; i < (sizeof sizes / sizeof sizes[0]); i++)
+	{
+		int len = sizes[i];
+		int rounds = 20000000 / len;
+		uint8_t * p = buf + 2;  // IP header behind the Ethernet header
+		uint8_t * d = buf2 + 2;
+
+		fill(p, len);
+
+		uint64_t t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			host_sink += ref_icmpv4_checksum(p, len);
+			p[3] = k;
+		}
+		double t_old = (double) (host_nsec() - t) / rounds;
+
+		t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			host_sink += icmpv4_checksum(p, len);
+			p[3] = k;
+		}
+		double t_new = (double) (host_nsec() - t) / rounds;
+
+		t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			memcpy(d, p, len);
+			host_sink += ref_icmpv4_checksum(d, len);
+			p[3] = k;
+		}
+		double t_copy_old = (double) (host_nsec() - t) / rounds;
+
+		t = host_nsec();
+		for (k=0; k < rounds; k++)
+		{
+			host_sink += INET_CSUM_FINISH(inet_csum_copy(0, d, p, len));
+			p[3] = k;
+		}
+		double t_copy_new = (double) (host_nsec() - t) / rounds;
+
+		printf("%4d bytes: sum old %6.1f ns, new %6.1f ns; copy and sum old %6.1f ns, new %6.1f ns\n",
+			len, t_old, t_new, t_copy_old, t_copy_new);
+	}
+}
+
+#else
+
+// RFC 1071 in the byte order of the host, d[0] is at an even offset
+
+static uint16_t reference (const uint8_t * d, int len)
+{
+	uint16_t one = 1;
+	int little_endian = *(uint8_t *) &one;
+	uint32_t sum = 0;
+	int i;
+
+	for (i=0; i < len; i++)
+	{
+		int high = ((i & 1) == 0) ^ little_endian;
+
+		sum += high ? (d[i] << 8) : d[i];
+	}
+
+	while ((sum >> 16) != 0)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+
+	return sum;
+}
+
+// 0x0000 and 0xFFFF are both zero in ones' complement
+
+static int same_sum (uint32_t a, uint32_t b)
+{
+	return (a % 0xFFFF) == (b % 0xFFFF);
+}
+
+
+static void native (void)
+{
+	int n;
+
+	srand(1);
+
+	for (n=0; n < 100000; n++)
+	{
+		int off = rand() % 8;
+		int len = rand() % 1600;
+		uint8_t * p = buf + off;
+
+		fill(p, len);
+
+		uint16_t ref = reference(p, len);
+
+		assert(same_sum(inet_csum_fold(inet_csum_add(0, p, len)), ref));
+
+		// two pieces, the second one swapped if it starts at an odd offset
+
+		int a = rand() % (len + 1);
+		uint32_t s1 = inet_csum_add(0, p, a);
+		uint32_t s2 = inet_csum_add(0, p + a, len - a);
+
+		if (a & 1)
+		{
+			s2 = inet_csum_swap(s2);
+		}
+
+		assert(same_sum(inet_csum_fold(s1 + s2), ref));
+
+		// copy and sum, any relative alignment
+
+		uint8_t * d = buf2 + 1 + rand() % 8;
+
+		memset(buf2, 0xEE, len + 16);
+
+		uint32_t c = inet_csum_copy(0, d, p, len);
+
+		assert(memcmp(d, p, len) == 0);
+		assert((d[-1] == 0xEE) && (d[len] == 0xEE));
+		assert(same_sum(inet_csum_fold(c), ref));
+
+		// a 16 and a 32 bit field changed, new checksum against recomputation
+
+		if (len >= 8)
+		{
+			uint8_t * w = buf + (off & ~1);
+			int even_len = len & ~1;
+			int f = 2 * (rand() % (even_len / 2));
+			int g = 2 * (rand() % (even_len / 2 - 1));
+			uint16_t old16, new16 = rand();
+			uint32_t old32, new32 = rand() * 65599u;
+
+			uint16_t csum = INET_CSUM_FINISH(inet_csum_add(0, w, even_len));
+
+			memcpy(&old16, w + f, 2);
+			memcpy(w + f, &new16, 2);
+			csum = inet_csum_update16(csum, old16, new16);
+
+			assert(same_sum(csum, INET_CSUM_FINISH(inet_csum_add(0, w, even_len))));
+
+			memcpy(&old32, w + g, 4);
+			memcpy(w + g, &new32, 4);
+			csum = inet_csum_update32(csum, old32, new32);
+
+			assert(same_sum(csum, INET_CSUM_FINISH(inet_csum_add(0, w, even_len))));
+
+			// data and checksum sum up to 0xFFFF
+
+			assert(inet_csum_fold(inet_csum_add(0, w, even_len) + csum) == 0xFFFF);
+		}
+	}
+
+	printf("reference == new: %d random sums at any address and length, in two pieces, copies and updates\n", n);
+}
+
+#endif
+
+
+int main (void)
+{
+#ifndef INET_CSUM_BYTE0
+	old_equals_new();
+	benchmark();
+#else
+	native();
+#endif
+
+	printf("all ok\n");
+	return 0;
+}
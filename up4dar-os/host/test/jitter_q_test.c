@@ -0,0 +1,271 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * jitter_q_test.c
+ *
+ * The jitter queue (jitter_q.c) with timing traces: 210 voice frames
+ * (10 superframes) and the end of transmission, one frame sent every
+ * 20ms, each delivered at a given tick. The playout takes one frame
+ * per tick after the frames of that tick were delivered. Traces with
+ * reordering, duplicates, a burst after a network stall and loss;
+ * the underrun, late and lost counts and the mean buffer depth of the
+ * played frames are compared with the values worked out by hand.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "up_dstar/jitter_q.h"
+
+
+#define FRAMES		210
+#define STOP_SEQ	FRAMES	// the end of transmission follows the last frame
+
+#define MAX_EVENTS	(2 * FRAMES + 1)
+
+struct event
+{
+	int tick;
+	int seq;
+};
+
+static struct event ev[MAX_EVENTS];
+static int num_ev;
+
+static void add (int tick, int seq)
+{
+	assert(num_ev < MAX_EVENTS);
+
+	ev[num_ev].tick = tick;
+	ev[num_ev].seq = seq;
+	num_ev ++;
+}
+
+// by tick, in the order they were added within a tick
+
+static int cmp_event (const void * a, const void * b)
+{
+	const struct event * x = a;
+	const struct event * y = b;
+
+	if (x->tick != y->tick)
+	{
+		return x->tick - y->tick;
+	}
+
+	return (x < y) ? -1 : 1;
+}
+
+
+// traces, frame i is sent at tick i
+
+static void clean (void)
+{
+	int i;
+
+	for (i=0; i < FRAMES; i++)
+	{
+		add(i, i);
+	}
+}
+
+// every 10th frame comes one tick late, after the next frame
+
+static void reorder (void)
+{
+	int i;
+
+	for (i=0; i < FRAMES; i++)
+	{
+		if ((i % 10) == 3)
+		{
+			add(i + 1, i + 1);
+			add(i + 1, i);
+			i ++;
+		}
+		else
+		{
+			add(i, i);
+		}
+	}
+}
+
+// every 7th frame twice, the copy one tick later (not played yet);
+// every 7th frame from 3 on, the copy three ticks later (already played)
+
+static void duplicates (void)
+{
+	int i;
+
+	for (i=0; i < FRAMES; i++)
+	{
+		add(i, i);
+
+		if ((i % 7) == 0)
+		{
+			add(i + 1, i);
+		}
+		else if ((i % 7) == 3)
+		{
+			add(i + 3, i);
+		}
+	}
+}
+
+// the network stalls for 100ms, frames 50 to 55 come together at tick 55
+
+static void burst (void)
+{
+	int i;
+
+	for (i=0; i < FRAMES; i++)
+	{
+		add(((i >= 50) && (i < 55)) ? 55 : i, i);
+	}
+}
+
+// every 10th frame is lost
+
+static void loss (void)
+{
+	int i;
+
+	for (i=0; i < FRAMES; i++)
+	{
+		if ((i % 10) != 5)
+		{
+			add(i, i);
+		}
+	}
+}
+
+
+static jitter_q_t q;
+
+static void run (const char * name, void (* trace) (void), int underrun, int late,
+	int lost, int duplicate, int slip, int played, int latency_sum)
+{
+	uint8_t voice[AMBE_Q_DATASIZE];
+	uint8_t data[3];
+	struct latency_tag tag = { 0 };
+	uint8_t pos;
+	int tick, e = 0, last_played = -1, stopped = 0;
+
+	num_ev = 0;
+	trace();
+	add(STOP_SEQ, STOP_SEQ);
+	qsort(ev, num_ev, sizeof ev[0], cmp_event);
+
+	memset(&q, 0, sizeof q);
+	jitter_q_initialize(&q);
+
+	for (tick=0; (tick < (2 * FRAMES)) && !stopped; tick++)
+	{
+		for (; (e < num_ev) && (ev[e].tick == tick); e++)
+		{
+			int seq = ev[e].seq;
+
+			if (seq == STOP_SEQ)
+			{
+				jitter_q_put_stop(&q, seq % JITTER_Q_FRAMES_PER_SUPERFRAME);
+			}
+			else
+			{
+				memset(voice, seq & 0xFF, sizeof voice);
+				jitter_q_put_voice(&q, seq % JITTER_Q_FRAMES_PER_SUPERFRAME, 1, voice,
+					tick * 20, &tag);
+			}
+		}
+
+		int r = jitter_q_get(&q, &pos, data, voice, &tag);
+
+		if (r == JITTER_Q_STOP)
+		{
+			stopped = 1;
+		}
+		else if ((r != JITTER_Q_NONE) && (r != JITTER_Q_MISSING))
+		{
+			// frames are played in order, with their position in the superframe
+			int seq = last_played + 1;
+
+			while ((seq & 0xFF) != voice[0])
+			{
+				seq ++;
+			}
+
+			assert(pos == (seq % JITTER_Q_FRAMES_PER_SUPERFRAME));
+			last_played = seq;
+		}
+	}
+
+	struct jitter_q_stats * s = &q.stats;
+
+	printf("%-10s underrun %2u, late %2u, lost %2u, duplicate %2u, slip %u, played %3u,"
+		" mean depth %5.2f frames (%d ms)\n",
+		name, s->underrun, s->late, s->lost, s->duplicate, s->slip, s->played,
+		(double) s->latency_sum / s->played, jitter_q_mean_latency_ms(&q));
+
+	assert(stopped && (last_played == (FRAMES - 1)));
+	assert(s->underrun == underrun);
+	assert(s->late == late);
+	assert(s->lost == lost);
+	assert(s->duplicate == duplicate);
+	assert(s->slip == slip);
+	assert(s->played == played);
+	assert(s->latency_sum == latency_sum);
+	assert(jitter_q_mean_latency_ms(&q) == ((latency_sum / played) * 20));
+}
+
+
+int main (void)
+{
+	// target depth 2 (no jitter while pre-buffering): frame i is played at
+	// tick i + 1, with frames i and i + 1 in the queue
+
+	run("clean", clean, 0, 0, 0, 0, 0, FRAMES, 2 * FRAMES);
+
+	// the frame before a late one is played with a depth of 1
+
+	run("reorder", reorder, 0, 0, 0, 0, 0, FRAMES, 2 * FRAMES - 21);
+
+	// 30 copies of frames still in the queue, 30 copies of played frames
+
+	run("duplicate", duplicates, 0, 30, 0, 30, 0, FRAMES, 2 * FRAMES);
+
+	// ticks 51..54 run empty, frames 50..53 are late. The second late frame
+	// in a row delays the playout by a superframe: 21 fill-in frames, then
+	// a depth of 23 up to frame 188, then the queue drains to the end.
+	// 49 * 2 + 1 (frame 49) + 135 * 23 (frames 54..188) + (2 + .. + 22)
+
+	run("burst", burst, 4 + 21, 4, 0, 0, 1, FRAMES - 4, 98 + 1 + 3105 + 252);
+
+	// a lost frame is counted when the next one is there, the frame before
+	// it is played with a depth of 1
+
+	run("loss", loss, 0, 0, 21, 0, 0, FRAMES - 21, 2 * (FRAMES - 21) - 21);
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,368 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * lastheard_test.c
+ *
+ * lastheard.c (included, the test looks at the hash table and the LRU
+ * list) against a reference model: random headers with eviction of
+ * the oldest station, end of transmission, SNMP table walk. Then the
+ * list is saved to and loaded from the SD card emulator, also after a
+ * save that was interrupted by removing the card.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "up_dstar/lastheard.c"
+
+#include "sd_card_emu.h"
+
+
+extern int32_t host_snmp_value;
+
+
+static int lh_get_value (int arg)
+{
+	uint8_t res[8];
+	int res_len;
+
+	snmp_get_lastheard(arg, res, &res_len, sizeof res);
+	return host_snmp_value;
+}
+
+static int lh_set_value (int arg, int value)
+{
+	uint8_t req[2] = { value >> 8, value & 0xFF };
+
+	return snmp_set_lastheard(arg, req, sizeof req);
+}
+
+
+// station n
+
+static void callsign (char * call, int n)
+{
+	char s[16];
+
+	snprintf(s, sizeof s, "DL%dABC      ", n);
+	memcpy(call, s, 8);
+}
+
+static void header (uint8_t * h, int n)
+{
+	memset(h, ' ', 39);
+	h[0] = h[1] = h[2] = 0;
+	memcpy(h + 3, "DB0ABC G", 8);
+	memcpy(h + 11, "DB0ABC B", 8);
+	callsign((char *) h + 27, n);
+	memcpy(h + 35, "UP4D", 4);
+}
+
+
+// reference model: stations in LRU order, newest first
+
+static int model[LH_NUM_ENTRIES];
+static int model_count;
+
+static void heard (int n)
+{
+	uint8_t h[39];
+	int i, pos = -1;
+
+	header(h, n);
+	lastheard_header(1 + (n & 1), h);
+
+	for (i=0; i < model_count; i++)
+	{
+		if (model[i] == n)
+		{
+			pos = i;
+		}
+	}
+
+	if (pos < 0)  // new station, the oldest one drops out of a full list
+	{
+		if (model_count < LH_NUM_ENTRIES)
+		{
+			model_count ++;
+		}
+
+		pos = model_count - 1;
+	}
+
+	memmove(model + 1, model, pos * sizeof (int));
+	model[0] = n;
+}
+
+static void clear (void)
+{
+	assert(lh_set_value(1, 0) == 0);
+	model_count = 0;
+}
+
+static void check (void)
+{
+	uint8_t info[LH_INFO_LEN];
+	char call[8];
+	int i, e, n = 0;
+
+	assert(num_entries == model_count);
+
+	for (e = newest; e != LH_NONE; e = entries[e].next)
+	{
+		callsign(call, model[n++]);
+		assert(memcmp(entries[e].call, call, 8) == 0);
+	}
+
+	assert(n == model_count);
+
+	for (i=0; i < model_count; i++)
+	{
+		callsign(call, model[i]);
+		assert(lastheard_find(call, info) == 0);
+		assert(memcmp(info, call, 8) == 0);
+	}
+
+	// every entry is reached from its home slot without a free slot in between
+
+	for (i=0; i < LH_HASH_SIZE; i++)
+	{
+		if (hash_tab[i] != 0)
+		{
+			int k = hash_tab[i] - 1;
+			int j = entries[k].home;
+
+			assert(entries[k].slot == i);
+			assert(entries[k].home == lh_hash(entries[k].call));
+
+			while (j != i)
+			{
+				assert(hash_tab[j] != 0);
+				j = (j + 1) & (LH_HASH_SIZE - 1);
+			}
+		}
+	}
+}
+
+static void expect_newest (int n, int station)
+{
+	uint8_t info[LH_INFO_LEN];
+	char call[8];
+
+	callsign(call, station);
+	assert(lastheard_get(n, info) == 0);
+	assert(memcmp(info, call, 8) == 0);
+}
+
+
+static void random_headers (void)
+{
+	uint8_t info[LH_INFO_LEN];
+	char call[8];
+	int i;
+
+	srand(1);
+
+	for (i=0; i < 200000; i++)
+	{
+		heard(rand() % ((i & 0x4000) ? 70 : 400));  // few and many more stations than entries
+
+		if ((i % 97) == 0)
+		{
+			check();
+		}
+	}
+
+	check();
+
+	// the end of a transmission goes to the station of its source
+
+	heard(5);
+	lastheard_end(2, 250, 123);
+	heard(6);
+	lastheard_end(1, 70000, 9);
+	lastheard_end(1, 5, 5);  // no transmission in progress
+
+	callsign(call, 5);
+	assert(lastheard_find(call, info) == 0);
+	assert((get16(info + 34) == 250) && (get16(info + 36) == 123) && (info[38] == 2));
+
+	callsign(call, 6);
+	assert(lastheard_find(call, info) == 0);
+	assert(get16(info + 34) == 0xFFFF);  // frames saturated
+	assert(memcmp(info + 8, "UP4D", 4) == 0);
+	assert(memcmp(info + 12, "DB0ABC B", 8) == 0);
+	assert(memcmp(info + 20, "DB0ABC G", 8) == 0);
+
+	printf("200000 random headers: LRU order and hash table equal to the model\n");
+}
+
+
+static void table_walk (void)
+{
+	uint8_t buf[200];
+	int n = 0, reads = 0;
+	int len;
+
+	assert(lh_set_value(2, 0) == 0);
+
+	do
+	{
+		snmp_get_lastheard_table(0, buf, &len, sizeof buf);
+		assert(len <= sizeof buf);
+
+		n += len / LH_INFO_LEN;
+		reads ++;
+	}
+	while (len > 0);
+
+	assert(n == LH_NUM_ENTRIES);
+	assert(lh_get_value(2) == 0);  // the walk starts again
+
+	printf("table walk: %d entries in %d reads\n", n, reads);
+}
+
+
+static void save_now (void)
+{
+	assert(lh_set_value(4, 1) == 0);
+	lastheard_service();
+	sd_emu_run_ms(200);
+	assert(io_state == LH_IO_IDLE);
+}
+
+static void persistence (void)
+{
+	uint8_t fmt[1] = { 2 };
+	uint8_t info[LH_INFO_LEN];
+	char call[8];
+
+	sd_card.num_blocks = 262144;
+	sd_card.img = calloc(sd_card.num_blocks, 512);
+	sd_card.sdhc = 1;
+	sd_card.read_access_us = 300;
+	sd_card.read_next_us = 50;
+	sd_card.write_busy_us = 200;
+	sd_card.single_busy_us = 1500;
+	sd_card.stop_busy_us = 500;
+
+	sdcard_init();
+
+	while (sdcard_num_blocks() == 0)
+	{
+		sd_emu_run();
+	}
+
+	sd_emu_run_ms(100);
+	assert(snmp_set_recorder(1, fmt, 1) == 0);  // format the area
+	sd_emu_run_ms(500);
+
+	lastheard_service();  // probe of both slots: nothing saved yet
+	sd_emu_run_ms(100);
+	assert((io_state == LH_IO_IDLE) && (aux_start != 0) && (save_seq == 1));
+
+	save_now();
+	assert(lh_get_value(4) == 1);
+
+	heard(1000);
+	heard(1001);
+	save_now();
+	assert(lh_get_value(4) == 2);
+
+	// the card is removed after two blocks of the next save
+
+	heard(2000);
+
+	long written = sd_card.blocks_written;
+
+	assert(lh_set_value(4, 1) == 0);
+	lastheard_service();
+
+	while (sd_card.blocks_written < (written + 2))
+	{
+		sd_emu_run();
+	}
+
+	sd_card.removed = 1;
+	sd_emu_run_ms(3000);
+	assert((io_state == LH_IO_IDLE) && (dirty == 1) && (lh_get_value(4) == 2));
+
+	lastheard_service();  // sees that the card has gone
+	assert(aux_start == 0);
+
+	// the list in RAM is lost, the card comes back: the last complete save is loaded
+
+	clear();
+	sd_emu_insert();
+
+	while (recorder_aux_start() == 0)
+	{
+		sd_emu_run();
+	}
+
+	lastheard_service();
+	sd_emu_run_ms(300);
+	assert(io_state == LH_IO_IDLE);
+
+	printf("interrupted save: %d entries of the previous save loaded\n", num_entries);
+	assert(num_entries == LH_NUM_ENTRIES);
+
+	expect_newest(0, 1001);
+	expect_newest(1, 1000);
+
+	callsign(call, 2000);
+	assert(lastheard_find(call, info) != 0);
+
+	callsign(call, 5);
+	assert(lastheard_find(call, info) == 0);
+	assert(get16(info + 34) == 250);
+
+	// loaded entries are older than the stations heard before the load
+
+	clear();
+	heard(3000);
+	save_now();
+
+	clear();
+	heard(4000);
+
+	aux_start = 0;  // card changed
+	lastheard_service();
+	sd_emu_run_ms(300);
+
+	assert(num_entries == 2);
+	expect_newest(0, 4000);
+	expect_newest(1, 3000);
+
+	printf("loaded entries behind the stations heard since the start\n");
+}
+
+
+int main (void)
+{
+	random_headers();
+	table_walk();
+	persistence();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * pdca_dbuf_test.c
+ *
+ * Double buffering of pdca_dbuf.c on a simulated PDCA: a TX channel
+ * sends a counting sequence, an RX channel receives one. Each step of
+ * the simulation is one transfer. The channel switches to the reload
+ * registers when the counter runs out, the reload-counter-zero
+ * interrupt calls the handler registered by pdca_dbuf_init(). The
+ * task runs a random number of transfers after the semaphore was
+ * given and fills (TX) or checks (RX) the buffer it gets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include <avr32/io.h>
+#include "intc.h"
+
+#include "up_io/pdca_dbuf.h"
+
+
+#define LEN		32		// transfers per buffer
+#define STEPS	1000000
+
+struct channel_model
+{
+	long underruns;		// transfer without a buffer
+	long switches;
+};
+
+static struct channel_model model[2];
+
+// interrupt mask from the enable and disable registers,
+// called after every firmware function that writes them
+
+static void update_imr (volatile avr32_pdca_channel_t * ch)
+{
+	ch->imr = (ch->imr | ch->ier) & ~ch->idr;
+	ch->ier = 0;
+	ch->idr = 0;
+}
+
+// one transfer of 32 bit, TX reads from memory, RX writes to memory
+
+static void dma_step (int c, uint32_t * io, int tx)
+{
+	volatile avr32_pdca_channel_t * ch = &AVR32_PDCA.channel[c];
+
+	if ((ch->cr & AVR32_PDCA_CR_TEN_MASK) == 0)
+		return;
+
+	if (ch->tcr == 0)
+	{
+		model[c].underruns ++;
+		return;
+	}
+
+	uint32_t * p = (uint32_t *) ch->mar;
+
+	if (tx)
+		*io = *p;
+	else
+		*p = *io;
+
+	ch->mar += 4;
+	ch->tcr --;
+
+	if ((ch->tcr == 0) && (ch->tcrr != 0))  // reload
+	{
+		ch->mar = ch->marr;
+		ch->tcr = ch->tcrr;
+		ch->tcrr = 0;
+		model[c].switches ++;
+	}
+}
+
+static void interrupts (void)
+{
+	int c, pending = 0;
+
+	for (c=0; c < 2; c++)
+	{
+		volatile avr32_pdca_channel_t * ch = &AVR32_PDCA.channel[c];
+
+		update_imr(ch);
+		ch->isr = (ch->tcrr == 0) ? AVR32_PDCA_ISR_RCZ_MASK : 0;
+
+		if (ch->isr & ch->imr)
+			pending = 1;
+	}
+
+	if (pending)
+	{
+		host_int_handler[AVR32_PDCA_IRQ_0]();
+	}
+}
+
+struct result
+{
+	long wakeups, tx_errors, rx_errors;
+	uint32_t tx_late, rx_late;
+};
+
+static void simulate (int max_latency, struct result * r)
+{
+	static uint32_t tb0[LEN], tb1[LEN], rb0[LEN], rb1[LEN];
+	xSemaphoreHandle sem;
+	pdca_dbuf_t tx, rx;
+	uint32_t tx_seq = LEN, tx_expect = 0, rx_seq = 0, rx_expect = 0;
+	int task_delay = -1, first_rx = 1;
+	long t;
+	int i;
+
+	memset(r, 0, sizeof (struct result));
+	memset((void *) &AVR32_PDCA, 0, sizeof AVR32_PDCA);
+	memset(model, 0, sizeof model);
+
+	vSemaphoreCreateBinary(sem);
+	xSemaphoreTake(sem, 0);
+
+	pdca_dbuf_init(&tx, 0, 0, AVR32_PDCA_TRANSFER_SIZE_WORD, tb0, tb1, LEN, sem);
+	pdca_dbuf_init(&rx, 1, 0, AVR32_PDCA_TRANSFER_SIZE_WORD, rb0, rb1, LEN, sem);
+	update_imr(&AVR32_PDCA.channel[0]);  // interrupts disabled by init
+	update_imr(&AVR32_PDCA.channel[1]);
+
+	for (i=0; i < LEN; i++)
+	{
+		tb0[i] = i;  // first buffer filled before the start
+	}
+
+	pdca_dbuf_start(&tx);
+	pdca_dbuf_start(&rx);
+
+	srand(3);
+
+	for (t=0; t < STEPS; t++)
+	{
+		uint32_t v = 0;
+
+		interrupts();
+
+		if ((task_delay < 0) && (xSemaphoreTake(sem, 0) == pdTRUE))
+		{
+			task_delay = rand() % (max_latency + 1);  // task gets the CPU later
+		}
+
+		if (task_delay == 0)
+		{
+			uint32_t * b;
+
+			task_delay = -1;
+			r->wakeups ++;
+
+			if ((b = pdca_dbuf_get(&tx)) != NULL)
+			{
+				for (i=0; i < LEN; i++)
+				{
+					b[i] = tx_seq++;
+				}
+			}
+
+			if ((b = pdca_dbuf_get(&rx)) != NULL)
+			{
+				if (first_rx)  // the reload of the second buffer, nothing received yet
+				{
+					first_rx = 0;
+				}
+				else
+				{
+					for (i=0; i < LEN; i++)
+					{
+						if (b[i] != rx_expect)
+							r->rx_errors ++;
+
+						rx_expect = b[i] + 1;
+					}
+				}
+			}
+		}
+		else if (task_delay > 0)
+		{
+			task_delay --;
+		}
+
+		dma_step(0, &v, 1);
+
+		if (v != tx_expect)
+			r->tx_errors ++;
+
+		tx_expect = v + 1;
+
+		v = rx_seq++;
+		dma_step(1, &v, 0);
+	}
+
+	r->tx_late = tx.late;
+	r->rx_late = rx.late;
+
+	assert((model[0].underruns == 0) && (model[1].underruns == 0));  // reload always in time
+	assert(model[0].switches == (STEPS / LEN));
+}
+
+int main (void)
+{
+	static const int latency[] = { 0, 1, 10, LEN - 2, LEN + 8, 3 * LEN };
+	struct result r;
+	int i;
+
+	for (i=0; i < (sizeof latency / sizeof latency[0]); i++)
+	{
+		simulate(latency[i], &r);
+
+		printf("task latency up to %3d transfers: %ld wakeups for %d buffers, errors tx %ld rx %ld, late tx %u rx %u\n",
+			latency[i], r.wakeups, STEPS / LEN, r.tx_errors, r.rx_errors, r.tx_late, r.rx_late);
+
+		if (latency[i] < (LEN - 1))
+		{
+			// one wakeup per buffer (both channels share the semaphore), sequences complete
+			assert((r.wakeups >= (STEPS / LEN - 1)) && (r.wakeups <= (STEPS / LEN)));
+			assert((r.tx_errors == 0) && (r.rx_errors == 0));
+			assert((r.tx_late == 0) && (r.rx_late == 0));
+		}
+		else
+		{
+			// the task missed buffers: counted as late
+			assert((r.tx_late > 0) && (r.rx_late > 0));
+		}
+	}
+
+	printf("all ok\n");
+	return 0;
+}
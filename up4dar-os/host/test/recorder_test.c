@@ -0,0 +1,371 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * recorder_test.c
+ *
+ * recorder.c on a file backed block device of 8192 blocks: format,
+ * RX and TX recordings, remount, playback onto the air and local, 700
+ * recordings that wrap the data ring and the index, a slow card, a
+ * write error and the parrot. Every frame played back is compared
+ * with the frame that was recorded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include "up_dstar/dstar.h"
+#include "up_dstar/ambe.h"
+#include "up_dstar/recorder.h"
+
+#include "up_net/snmp_data.h"
+
+
+#define CARD_BLOCKS		8192
+#define WRAP_RECORDINGS	700
+
+
+extern int32_t host_snmp_value;
+
+
+// block device
+
+static FILE * card;
+static long rd_calls, rd_blocks, wr_calls, wr_blocks;
+static int card_fail;
+
+static int card_read (uint32_t blk, uint8_t * buf, int count)
+{
+	if (card_fail)
+		return 1;
+
+	rd_calls ++;
+	rd_blocks += count;
+
+	return pread(fileno(card), buf, count * REC_BLOCK_SIZE, (off_t) blk * REC_BLOCK_SIZE)
+		!= (count * REC_BLOCK_SIZE);
+}
+
+static int card_write (uint32_t blk, const uint8_t * buf, int count)
+{
+	if (card_fail)
+		return 1;
+
+	wr_calls ++;
+	wr_blocks += count;
+
+	return pwrite(fileno(card), buf, count * REC_BLOCK_SIZE, (off_t) blk * REC_BLOCK_SIZE)
+		!= (count * REC_BLOCK_SIZE);
+}
+
+static struct rec_blkdev dev = { card_read, card_write, CARD_BLOCKS };
+
+static void remount (void)
+{
+	recorder_unmount();
+	recorder_mount(&dev);
+}
+
+
+// frame i of recording id
+
+static void frame (uint8_t * d, uint32_t id, uint32_t i)
+{
+	int k;
+
+	for (k=0; k < AMBE_Q_DATASIZE; k++)
+	{
+		d[k] = (uint8_t) (id * 31 + i * 7 + k * 13 + (i >> 8));
+	}
+}
+
+
+// decoder queue of ambe.c, full after 50 frames
+
+#define DECODER_Q_LEN	50
+
+static uint8_t decoder_q[DECODER_Q_LEN][AMBE_Q_DATASIZE];
+static int decoder_q_count;
+
+int ambe_input_data (const uint8_t * d, const struct latency_tag * tag)
+{
+	if (decoder_q_count >= DECODER_Q_LEN)
+		return 1;
+
+	memcpy(decoder_q[decoder_q_count++], d, AMBE_Q_DATASIZE);
+	return 0;
+}
+
+
+static int get_value (int arg)
+{
+	uint8_t res[8];
+	int res_len;
+
+	snmp_get_recorder(arg, res, &res_len, sizeof res);
+	return host_snmp_value;
+}
+
+static void set_value (int arg, int value)
+{
+	uint8_t req[2] = { value >> 8, value & 0xFF };
+
+	assert(snmp_set_recorder(arg, req, sizeof req) == 0);
+}
+
+static uint32_t get32 (const uint8_t * p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int list (uint8_t * buf, int maxlen)
+{
+	int len;
+
+	snmp_get_recorder_list(0, buf, &len, maxlen);
+	return len / REC_ENTRY_INFO_LEN;
+}
+
+// frame count of list entry n (newest first)
+
+static uint32_t list_frames (const uint8_t * buf, int n)
+{
+	return get32(buf + n * REC_ENTRY_INFO_LEN + 8) & 0xFFFFFF;
+}
+
+static uint8_t list_dir (const uint8_t * buf, int n)
+{
+	return buf[n * REC_ENTRY_INFO_LEN + 8];
+}
+
+
+static uint32_t next_id = 1;
+
+// a transmission, the SD card task runs every service_every frames
+
+static uint32_t record (uint8_t dir_source, int frames, int service_every)
+{
+	uint8_t header[39], d[AMBE_Q_DATASIZE];
+	int i;
+
+	memset(header, 'A' + (next_id % 26), sizeof header);
+
+	recorder_start(dir_source, header);
+
+	for (i=0; i < frames; i++)
+	{
+		frame(d, next_id, i);
+		recorder_put_frame(d);
+
+		if ((i % service_every) == 0)
+		{
+			recorder_service();
+		}
+	}
+
+	recorder_stop(dir_source);
+	recorder_service();
+
+	return next_id++;
+}
+
+// plays entry n and compares the frames, returns 1 if all are correct
+
+static int play_check (int n, int target, uint32_t id, int frames)
+{
+	uint8_t d[AMBE_Q_DATASIZE], e[AMBE_Q_DATASIZE];
+	int got = 0, bad = 0;
+	int k;
+
+	assert(recorder_play(n, target) == 0);
+	recorder_service();
+
+	if (target == REC_PLAY_TX)
+	{
+		while ((got <= frames) && (recorder_play_get(d) == 0))  // TX task: one frame per 20ms
+		{
+			frame(e, id, got);
+			bad += (memcmp(d, e, AMBE_Q_DATASIZE) != 0);
+			got ++;
+
+			recorder_service();
+		}
+	}
+	else
+	{
+		do
+		{
+			for (k=0; k < decoder_q_count; k++)  // decoder empties its queue
+			{
+				frame(e, id, got);
+				bad += (memcmp(decoder_q[k], e, AMBE_Q_DATASIZE) != 0);
+				got ++;
+			}
+
+			decoder_q_count = 0;
+			recorder_service();
+		}
+		while (decoder_q_count > 0);
+	}
+
+	if ((got != frames) || (bad != 0))
+	{
+		printf("play %d target %d: %d of %d frames, %d wrong\n", n, target, got, frames, bad);
+	}
+
+	return (got == frames) && (bad == 0);
+}
+
+
+int main (void)
+{
+	static uint32_t ids[WRAP_RECORDINGS];
+	static int frames_of[WRAP_RECORDINGS];
+	uint8_t buf[REC_RECENT * REC_ENTRY_INFO_LEN];
+	long total = 0;
+	int n, i, ok;
+
+	card = tmpfile();
+	assert(card != NULL);
+	assert(ftruncate(fileno(card), (off_t) CARD_BLOCKS * REC_BLOCK_SIZE) == 0);
+
+	// an unformatted card is not touched
+
+	recorder_mount(&dev);
+	assert(recorder_state() == REC_STATE_NO_AREA);
+	record(REC_RX|SOURCE_PHY, 100, 1);
+	assert(wr_calls == 0);
+	assert(get_value(3) == 0);
+
+	set_value(1, 2);  // format
+	recorder_service();
+	assert(recorder_state() == REC_STATE_READY);
+
+	uint32_t id_rx = record(REC_RX|SOURCE_PHY, 500, 1);
+	uint32_t id_tx = record(REC_TX, 123, 1);
+
+	assert(list(buf, sizeof buf) == 2);
+	assert((list_frames(buf, 0) == 123) && (list_dir(buf, 0) == REC_TX));
+	assert((list_frames(buf, 1) == 500) && (list_dir(buf, 1) == (REC_RX|SOURCE_PHY)));
+
+	rd_calls = rd_blocks = 0;
+	remount();
+	assert(recorder_state() == REC_STATE_READY);
+	assert(list(buf, sizeof buf) == 2);
+	printf("remount: 2 entries, read %ld blocks in %ld calls\n", rd_blocks, rd_calls);
+
+	assert(play_check(1, REC_PLAY_TX, id_rx, 500));
+	assert(play_check(0, REC_PLAY_LOCAL, id_tx, 123));
+	printf("playback onto the air and local: frames equal\n");
+
+	// wrap the data ring and the index, remount in between
+
+	srand(1);
+	wr_calls = wr_blocks = 0;
+
+	for (i=0; i < WRAP_RECORDINGS; i++)
+	{
+		frames_of[i] = 1 + rand() % 1500;
+		total += frames_of[i];
+		ids[i] = record((i & 1) ? REC_TX : (REC_RX|SOURCE_NET), frames_of[i], 1);
+
+		if (i == (WRAP_RECORDINGS / 2))
+		{
+			remount();
+		}
+	}
+
+	printf("%d recordings, %ld frames: %ld blocks in %ld write commands\n",
+		WRAP_RECORDINGS, total, wr_blocks, wr_calls);
+
+	n = list(buf, sizeof buf);
+	assert(n == REC_RECENT);
+
+	for (i=0, ok=0; i < n; i++)
+	{
+		int r = WRAP_RECORDINGS - 1 - i;
+
+		assert(list_frames(buf, i) == frames_of[r]);
+		ok += play_check(i, (i & 1) ? REC_PLAY_LOCAL : REC_PLAY_TX, ids[r], frames_of[r]);
+	}
+
+	assert(ok == n);
+	printf("after wrap: %d listed, all played back correctly\n", n);
+
+	remount();
+	assert(list(buf, sizeof buf) == REC_RECENT);
+	assert(play_check(0, REC_PLAY_TX, ids[WRAP_RECORDINGS - 1], frames_of[WRAP_RECORDINGS - 1]));
+
+	// slow card: the SD card task runs every 300 frames (6s), frames are dropped
+
+	int dropped = get_value(4);
+
+	record(REC_RX|SOURCE_PHY, 3000, 300);
+	dropped = get_value(4) - dropped;
+	list(buf, sizeof buf);
+	printf("slow card: %d of 3000 frames dropped, %u recorded\n", dropped, list_frames(buf, 0));
+	assert(dropped > 0);
+	assert((list_frames(buf, 0) + dropped) == 3000);
+
+	// write error, the card is initialized again and mounted
+
+	card_fail = 1;
+	record(REC_RX|SOURCE_PHY, 200, 1);
+	card_fail = 0;
+	assert(recorder_state() == REC_STATE_ERROR);
+
+	remount();
+	assert(recorder_state() == REC_STATE_READY);
+	recorder_service();  // blocks of the failed recording
+	list(buf, sizeof buf);
+	printf("write error: state error, after remount the newest entry has %u frames\n", list_frames(buf, 0));
+
+	// parrot: only streams received on the air are sent back
+
+	set_value(6, 1);
+
+	record(REC_RX|SOURCE_NET, 50, 1);
+	assert(!recorder_playing_tx());
+
+	uint32_t id_parrot = record(REC_RX|SOURCE_PHY, 77, 1);
+	assert(recorder_playing_tx());
+
+	uint8_t d[AMBE_Q_DATASIZE], e[AMBE_Q_DATASIZE];
+	int got = 0;
+
+	while (recorder_play_get(d) == 0)
+	{
+		frame(e, id_parrot, got++);
+		assert(memcmp(d, e, AMBE_Q_DATASIZE) == 0);
+		recorder_service();
+	}
+
+	assert(got == 77);
+	printf("parrot: reflector stream ignored, 77 frames received on the air sent back\n");
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,382 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ringbuf_test.c
+ *
+ * Ring buffer (ringbuf.c): unit tests, a random sequence of producer
+ * and consumer calls checked against the byte sequence, a producer
+ * and a consumer thread, and the throughput compared with the byte
+ * queue serial2.c had before (put_q/get_q).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "FreeRTOS.h"
+
+#include "host_time.h"
+
+#include "up_io/ringbuf.h"
+
+
+// the USART queue of serial2.c before the ring buffer
+
+#define USART_BUFLEN	200
+
+struct usartBuffer
+{
+	int input_ptr;
+	int output_ptr;
+	char buf[USART_BUFLEN];
+};
+
+static int put_q( struct usartBuffer * q, char c)
+{
+	int next_ptr = q->input_ptr;
+
+	next_ptr ++;
+
+	if (next_ptr >= USART_BUFLEN)
+	{
+		next_ptr = 0;
+	}
+
+	if (next_ptr == q->output_ptr) // queue is full
+	{
+		return 0;
+	}
+
+	q->buf[ q->input_ptr ] = c;
+	q->input_ptr = next_ptr;
+
+	return 1;
+}
+
+static int get_q( struct usartBuffer * q, char * c)
+{
+	if (q->input_ptr == q->output_ptr)
+	{
+		return 0; // queue empty
+	}
+
+	int next_ptr = q->output_ptr;
+
+	next_ptr ++;
+
+	if (next_ptr >= USART_BUFLEN)
+	{
+		next_ptr = 0;
+	}
+
+	*c = q->buf[ q->output_ptr ];
+	q->output_ptr = next_ptr;
+
+	return 1;
+}
+
+
+static uint8_t buf[256];
+
+static void unit_tests (void)
+{
+	ringbuf_t r;
+	uint8_t d[300], e[300], * p;
+	int i;
+
+	for (i=0; i < 300; i++)
+	{
+		d[i] = i * 7;
+	}
+
+	ringbuf_init(&r, buf, 256);
+	assert((ringbuf_count(&r) == 0) && (ringbuf_free(&r) == 256) && (ringbuf_get(&r, e) == 0));
+
+	// all bytes usable, overflow and high water counted
+	assert(ringbuf_write(&r, d, 300) == 256);
+	assert((ringbuf_count(&r) == 256) && (ringbuf_free(&r) == 0));
+	assert((r.overflow == 44) && (r.high_water == 256));
+	assert(ringbuf_put(&r, 1) == 0);
+	assert(r.overflow == 45);
+	assert((ringbuf_read(&r, e, 300) == 256) && (memcmp(d, e, 256) == 0));
+	assert(ringbuf_count(&r) == 0);
+
+	// indices wrap at 65536, blocks split at the end of the buffer
+	ringbuf_reset(&r);
+	r.in = r.out = 65530;
+	assert(ringbuf_write(&r, d, 100) == 100);
+	assert(ringbuf_count(&r) == 100);
+	assert((ringbuf_read(&r, e, 30) == 30) && (memcmp(d, e, 30) == 0));
+	assert((ringbuf_read(&r, e, 100) == 70) && (memcmp(d + 30, e, 70) == 0));
+	assert((r.in == 94) && (r.out == 94));
+
+	// spans: at most up to the end of the buffer
+	ringbuf_reset(&r);
+	r.in = r.out = 250;
+	assert(ringbuf_write_span(&r, &p) == 6);
+	assert(p == (buf + 250));
+	memcpy(p, d, 6);
+	ringbuf_commit(&r, 6);
+	assert(ringbuf_write_span(&r, &p) == 250);
+	assert(p == buf);
+	memcpy(p, d + 6, 10);
+	ringbuf_commit(&r, 10);
+	assert(ringbuf_read_span(&r, &p) == 6);
+	ringbuf_consume(&r, 6);
+	assert((ringbuf_read_span(&r, &p) == 10) && (memcmp(p, d + 6, 10) == 0));
+	ringbuf_consume(&r, 10);
+	assert(ringbuf_count(&r) == 0);
+
+	// single bytes: high water counted when the consumer reads the block
+	ringbuf_reset(&r);
+	for (i=0; i < 100; i++)
+	{
+		assert(ringbuf_put(&r, d[i]) == 1);
+	}
+	assert(r.high_water == 0);
+	assert((ringbuf_read_span(&r, &p) == 100) && (r.high_water == 100));
+	ringbuf_consume(&r, 100);
+
+	// DMA position: in follows the buffer position
+	ringbuf_reset(&r);
+	r.in = r.out = 300;
+	ringbuf_set_in_pos(&r, (300 + 10) & 255);
+	assert(ringbuf_count(&r) == 10);
+	ringbuf_set_in_pos(&r, (300 + 255) & 255);
+	assert(ringbuf_count(&r) == 255);
+
+	printf("unit tests ok\n");
+}
+
+// random producer and consumer calls, the bytes have to come out in order
+
+static void random_sequence (void)
+{
+	uint8_t src[300], dst[300], * p;
+	uint8_t wv = 0, rv = 0;
+	long total = 0;
+	ringbuf_t r;
+	int n, i, k;
+
+	ringbuf_init(&r, buf, 256);
+	srand(1);
+
+	for (k=0; k < 2000000; k++)
+	{
+		n = rand() % 300;
+
+		switch (rand() % 5)
+		{
+			case 0:
+				for (i=0; i < n; i++)
+				{
+					src[i] = wv + i;
+				}
+				n = ringbuf_write(&r, src, n);
+				wv += n;
+				total += n;
+				break;
+
+			case 1:
+				if (ringbuf_put(&r, wv))
+				{
+					wv ++;
+					total ++;
+				}
+				break;
+
+			case 2:
+				n = ringbuf_read(&r, dst, n);
+				for (i=0; i < n; i++)
+				{
+					assert(dst[i] == (uint8_t) (rv + i));
+				}
+				rv += n;
+				break;
+
+			case 3:
+				i = ringbuf_read_span(&r, &p);
+				n = (i < n) ? i : n;
+				for (i=0; i < n; i++)
+				{
+					assert(p[i] == (uint8_t) (rv + i));
+				}
+				ringbuf_consume(&r, n);
+				rv += n;
+				break;
+
+			case 4:
+				i = ringbuf_write_span(&r, &p);
+				n = (i < n) ? i : n;
+				for (i=0; i < n; i++)
+				{
+					p[i] = wv + i;
+				}
+				ringbuf_commit(&r, n);
+				wv += n;
+				total += n;
+				break;
+		}
+
+		assert(ringbuf_count(&r) == (uint8_t) (wv - rv) + ((ringbuf_count(&r) == 256) ? 256 : 0));
+	}
+
+	printf("random sequence: %ld bytes in order, high water %d\n", total, r.high_water);
+}
+
+// one producer and one consumer thread without locks
+
+#define THREAD_BYTES	10000000
+
+static ringbuf_t tr;
+
+static void * producer (void * arg)
+{
+	uint8_t src[64];
+	uint32_t v = 0;
+	int i;
+
+	while (v < THREAD_BYTES)
+	{
+		int n = 1 + (v % 61);
+
+		for (i=0; i < n; i++)
+		{
+			src[i] = v + i;
+		}
+
+		n = ringbuf_write(&tr, src, n);
+
+		if (n == 0)
+		{
+			sched_yield();  // buffer full
+		}
+
+		v += n;
+	}
+
+	return NULL;
+}
+
+static void threads (void)
+{
+	uint8_t dst[64];
+	uint32_t v = 0;
+	pthread_t t;
+	int i;
+
+	ringbuf_init(&tr, buf, 256);
+	pthread_create(&t, NULL, producer, NULL);
+
+	uint64_t t0 = host_nsec();
+
+	while (v < THREAD_BYTES)
+	{
+		int n = ringbuf_read(&tr, dst, 1 + (v % 37));
+
+		if (n == 0)
+		{
+			sched_yield();  // buffer empty
+		}
+
+		for (i=0; i < n; i++)
+		{
+			assert(dst[i] == (uint8_t) (v + i));
+		}
+
+		v += n;
+	}
+
+	uint64_t t1 = host_nsec();
+
+	pthread_join(t, NULL);
+
+	printf("two threads: %d bytes in order, %.0f MB/s\n", THREAD_BYTES,
+		THREAD_BYTES * 1000.0 / (t1 - t0));
+}
+
+// throughput in one thread: the old queue, the ring buffer by byte and by block
+
+#define BENCH_BYTES		20000000
+
+static void benchmark (void)
+{
+	static struct usartBuffer q;
+	uint8_t block[64];
+	char c = 0;
+	uint8_t d;
+	ringbuf_t r;
+	int i, k;
+
+	uint64_t t = host_nsec();
+	for (i=0; i < BENCH_BYTES; i += 16)
+	{
+		for (k=0; k < 16; k++)
+			put_q(&q, k);
+		for (k=0; k < 16; k++)
+		{
+			get_q(&q, &c);
+			host_sink += c;
+		}
+	}
+	double t_old = (double) (host_nsec() - t) / BENCH_BYTES;
+
+	ringbuf_init(&r, buf, 256);
+	t = host_nsec();
+	for (i=0; i < BENCH_BYTES; i += 16)
+	{
+		for (k=0; k < 16; k++)
+			ringbuf_put(&r, k);
+		for (k=0; k < 16; k++)
+		{
+			ringbuf_get(&r, &d);
+			host_sink += d;
+		}
+	}
+	double t_byte = (double) (host_nsec() - t) / BENCH_BYTES;
+
+	memset(block, 0x55, sizeof block);
+	t = host_nsec();
+	for (i=0; i < BENCH_BYTES; i += 16)
+	{
+		ringbuf_write(&r, block, 16);
+		ringbuf_read(&r, block, 16);
+		host_sink += block[3];
+	}
+	double t_block = (double) (host_nsec() - t) / BENCH_BYTES;
+
+	printf("put/get per byte: old queue %.2f ns/byte, ring buffer %.2f ns/byte;"
+		" 16 byte blocks %.2f ns/byte\n", t_old, t_byte, t_block);
+}
+
+int main (void)
+{
+	unit_tests();
+	random_sequence();
+	threads();
+	benchmark();
+
+	printf("all ok\n");
+	return 0;
+}
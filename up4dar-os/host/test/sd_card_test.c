@@ -0,0 +1,439 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * sd_card_test.c
+ *
+ * sdcard.c on the SD card emulator (stub/sd_card_emu.c) with a card of
+ * 64 MByte: initialization, data compared with a reference image,
+ * queued writes merged into one CMD25 stream, a read waiting for a
+ * queued write, read-ahead, sequential throughput at two SPI clocks,
+ * the recorder on the card, card removed and inserted again.
+ * sd_card_byte_test.c runs the same with a byte addressed card.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "up_dstar/ambe.h"
+#include "up_dstar/recorder.h"
+#include "up_io/sd_spi.h"
+#include "up_io/sdcard.h"
+#include "up_net/snmp_data.h"
+
+#include "sd_card_emu.h"
+
+
+#ifndef SD_CARD_TEST_SDHC
+#define SD_CARD_TEST_SDHC	1
+#endif
+
+#define NUM_BLOCKS	131072
+#define BLK(n)		((size_t) (n) * SDCARD_BLOCK_LEN)
+
+
+extern int32_t host_snmp_value;
+
+static uint8_t ref[BLK(NUM_BLOCKS)];
+static uint8_t buf[BLK(64)];
+static int callbacks;
+
+
+// decoder queue of ambe.c, big enough for a whole recording
+
+#define DECODER_Q_LEN	4000
+
+static uint8_t decoder_q[DECODER_Q_LEN][AMBE_Q_DATASIZE];
+static int decoder_q_count;
+
+int ambe_input_data (const uint8_t * d, const struct latency_tag * tag)
+{
+	if (decoder_q_count >= DECODER_Q_LEN)
+		return 1;
+
+	memcpy(decoder_q[decoder_q_count++], d, AMBE_Q_DATASIZE);
+	return 0;
+}
+
+
+static int sd_get (int arg)
+{
+	uint8_t res[8];
+	int res_len;
+
+	snmp_get_sdcard(arg, res, &res_len, sizeof res);
+	return host_snmp_value;
+}
+
+static int sd_set (int arg, int value)
+{
+	uint8_t req[2] = { value >> 8, value & 0xFF };
+
+	return snmp_set_sdcard(arg, req, sizeof req);
+}
+
+static int rec_get (int arg)
+{
+	uint8_t res[8];
+	int res_len;
+
+	snmp_get_recorder(arg, res, &res_len, sizeof res);
+	return host_snmp_value;
+}
+
+static void rec_set (int arg, int value)
+{
+	uint8_t req[2] = { value >> 8, value & 0xFF };
+
+	assert(snmp_set_recorder(arg, req, sizeof req) == 0);
+}
+
+
+static void callback (struct sdcard_request * req)
+{
+	callbacks ++;
+}
+
+static void request (struct sdcard_request * r, int op, uint32_t blk, uint8_t * b, int count)
+{
+	memset(r, 0, sizeof (struct sdcard_request));
+	r->op = op;
+	r->blk = blk;
+	r->buf = b;
+	r->count = count;
+	r->callback = callback;
+}
+
+static void wait_request (struct sdcard_request * r)
+{
+	int n = 0;
+
+	while (r->result == SDCARD_PENDING)
+	{
+		sd_emu_run();
+		assert(++n < 1000000);
+	}
+}
+
+static int io (int op, uint32_t blk, uint8_t * b, int count)
+{
+	struct sdcard_request r;
+
+	request(&r, op, blk, b, count);
+
+	if (sdcard_submit(&r) != 0)
+		return 1;
+
+	wait_request(&r);
+	return r.result;
+}
+
+static void fill (uint8_t * b, int len, int seed)
+{
+	int i;
+
+	for (i=0; i < len; i++)
+	{
+		b[i] = (uint8_t) (seed * 131 + i * 7 + (i >> 9));
+	}
+}
+
+// sequential transfer of total blocks in requests of count blocks with
+// gap ms between the requests, returns kByte/s without the gaps
+
+static double sequential (int op, uint32_t blk, int total, int count, int gap)
+{
+	uint64_t start = sd_emu_now;
+	int i;
+
+	for (i=0; i < total; i += count)
+	{
+		if (op == SDCARD_OP_WRITE)
+		{
+			fill(buf, BLK(count), blk + i);
+			memcpy(ref + BLK(blk + i), buf, BLK(count));
+		}
+
+		assert(io(op, blk + i, buf, count) == 0);
+
+		if (op == SDCARD_OP_READ)
+		{
+			assert(memcmp(buf, ref + BLK(blk + i), BLK(count)) == 0);
+		}
+
+		if (gap > 0)
+		{
+			sd_emu_run_ms(gap);
+			start += SD_EMU_MS(gap);
+		}
+	}
+
+	return (double) BLK(total) / ((double) (sd_emu_now - start) / configCPU_CLOCK_HZ) / 1000.0;
+}
+
+
+static void queued_writes (void)
+{
+	static uint8_t w[6][SDCARD_BLOCK_LEN];
+	struct sdcard_request r[6], rr;
+	long cmd25 = sd_card.cmds[25];
+	int k;
+
+	sd_emu_run_ms(300);  // stream of the last test closed
+
+	for (k=0; k < 6; k++)
+	{
+		fill(w[k], SDCARD_BLOCK_LEN, 77 + k);
+		memcpy(ref + BLK(5000 + k), w[k], SDCARD_BLOCK_LEN);
+
+		request(&r[k], SDCARD_OP_WRITE, 5000 + k, w[k], 1);
+		assert(sdcard_submit(&r[k]) == 0);
+	}
+
+	// a read of a queued block waits for the write
+
+	request(&rr, SDCARD_OP_READ, 5004, buf, 2);
+	callbacks = 0;
+	assert(sdcard_submit(&rr) == 0);
+
+	wait_request(&rr);
+
+	for (k=0; k < 6; k++)
+	{
+		wait_request(&r[k]);
+	}
+
+	assert((callbacks == 7) && (rr.result == 0));
+	assert(memcmp(buf, ref + BLK(5004), BLK(2)) == 0);
+	assert(memcmp(sd_card.img + BLK(5000), ref + BLK(5000), BLK(6)) == 0);
+
+	printf("6 queued writes: %ld CMD25, the read of a queued block got the new data\n",
+		sd_card.cmds[25] - cmd25);
+	assert((sd_card.cmds[25] - cmd25) == 1);
+}
+
+
+static void read_ahead (void)
+{
+	int hits = sd_get(6);
+	long blocks = sd_card.blocks_read;
+
+	sd_emu_run_ms(300);
+	sequential(SDCARD_OP_READ, 20000, 64, 2, 30);
+
+	hits = sd_get(6) - hits;
+	printf("read-ahead: %d of 64 blocks from the buffer, %ld blocks read from the card\n",
+		hits, sd_card.blocks_read - blocks);
+	assert(hits >= 48);
+
+	// a write into the read-ahead range invalidates it
+
+	assert(io(SDCARD_OP_READ, 30000, buf, 1) == 0);
+	sd_emu_run_ms(5);
+
+	fill(buf, SDCARD_BLOCK_LEN, 9);
+	memcpy(ref + BLK(30001), buf, SDCARD_BLOCK_LEN);
+	assert(io(SDCARD_OP_WRITE, 30001, buf, 1) == 0);
+
+	assert(io(SDCARD_OP_READ, 30001, buf, 1) == 0);
+	assert(memcmp(buf, ref + BLK(30001), SDCARD_BLOCK_LEN) == 0);
+}
+
+
+static void throughput (void)
+{
+	static const int clock_khz[] = { 2048, 4096 };
+	int c;
+
+	printf("clock     read 1 block / 16 blocks    write 1 block (stream closed) / 16 blocks\n");
+
+	for (c=0; c < 2; c++)
+	{
+		uint32_t base = 40000 + c * 8192;
+
+		assert(sd_set(1, clock_khz[c]) == 0);
+		sd_emu_run_ms(300);
+
+		double r1 = sequential(SDCARD_OP_READ, base, 512, 1, 0);
+		double r16 = sequential(SDCARD_OP_READ, base + 1000, 2048, 16, 0);
+
+		sd_emu_run_ms(300);
+
+		double w1 = sequential(SDCARD_OP_WRITE, base + 4000, 256, 1, 250);
+		double w16 = sequential(SDCARD_OP_WRITE, base + 5000, 2048, 16, 0);
+
+		printf("%4d kHz  %3.0f / %3.0f kB/s              %3.0f / %3.0f kB/s\n",
+			sd_get(1), r1, r16, w1, w16);
+
+		assert(sd_get(1) == clock_khz[c]);
+		assert(r1 > (clock_khz[c] / 8 * 0.9));  // read-ahead
+		assert(r16 > (clock_khz[c] / 8 * 0.9));
+		assert(w16 > (clock_khz[c] / 8 * 0.75));  // write-behind
+	}
+
+	assert(sd_set(1, 50) == 1);  // below the initialization clock
+	assert(sd_set(1, 30000) == 1);
+	assert(sd_set(2, 1000) == 1);
+
+	sd_emu_run_ms(300);
+	assert(memcmp(sd_card.img, ref, BLK(NUM_BLOCKS)) == 0);
+}
+
+
+static void recorder (void)
+{
+	uint8_t header[39], d[AMBE_Q_DATASIZE];
+	int frames = 600;
+	int k;
+
+	rec_set(1, 2);  // format
+	sd_emu_run_ms(500);
+	assert(rec_get(2) == REC_STATE_READY);
+
+	memset(header, 'X', sizeof header);
+	recorder_start(REC_RX, header);
+
+	for (k=0; k < frames; k++)
+	{
+		memset(d, k, sizeof d);
+		d[0] = k >> 8;
+		recorder_put_frame(d);
+		sd_emu_run_ms(20);
+	}
+
+	recorder_stop(REC_RX);
+	sd_emu_run_ms(500);
+	assert((rec_get(3) == 1) && (rec_get(4) == 0));  // one entry, no frame dropped
+
+	decoder_q_count = 0;
+	assert(recorder_play(0, REC_PLAY_LOCAL) == 0);
+
+	for (k=0; (k < 2000) && (decoder_q_count < frames); k++)
+	{
+		sd_emu_run_ms(20);
+	}
+
+	assert(decoder_q_count == frames);
+
+	for (k=0; k < frames; k++)
+	{
+		assert((decoder_q[k][0] == (uint8_t) (k >> 8)) && (decoder_q[k][1] == (uint8_t) k));
+	}
+
+	printf("recorder: %d frames recorded and played back\n", frames);
+
+	memcpy(ref, sd_card.img, BLK(NUM_BLOCKS));
+}
+
+
+static void card_removed (void)
+{
+	long cmd0 = sd_card.cmds[0];
+
+	sd_card.removed = 1;
+	assert(io(SDCARD_OP_READ, 100, buf, 4) == 1);
+
+	sd_emu_run_ms(3000);
+	assert(sdcard_num_blocks() == 0);
+	assert(sd_emu_spi_hz() <= SD_SPI_INIT_CLOCK);
+	assert(io(SDCARD_OP_READ, 100, buf, 1) == 1);  // no card
+
+	sd_emu_insert();
+
+	while (sdcard_num_blocks() == 0)
+	{
+		sd_emu_run();
+		assert(sd_emu_now < SD_EMU_MS(600000));
+	}
+
+	sd_emu_run_ms(100);
+	assert(sd_card.cmds[0] > cmd0);
+	assert((rec_get(2) == REC_STATE_READY) && (rec_get(3) == 1));
+	assert(io(SDCARD_OP_READ, 100, buf, 4) == 0);
+	assert(memcmp(buf, ref + BLK(100), BLK(4)) == 0);
+
+	printf("card removed and inserted: %d errors counted, mounted again\n", sd_get(8));
+}
+
+
+int main (void)
+{
+	struct sdcard_request r;
+	size_t i;
+
+	sd_card.img = malloc(BLK(NUM_BLOCKS));
+	sd_card.num_blocks = NUM_BLOCKS;
+	sd_card.sdhc = SD_CARD_TEST_SDHC;
+	sd_card.read_access_us = 300;
+	sd_card.read_next_us = 50;
+	sd_card.write_busy_us = 200;
+	sd_card.single_busy_us = 1500;
+	sd_card.stop_busy_us = 500;
+
+	srand(17);
+
+	for (i=0; i < BLK(NUM_BLOCKS); i++)
+	{
+		sd_card.img[i] = (uint8_t) (rand() >> 3);
+	}
+
+	memcpy(ref, sd_card.img, BLK(NUM_BLOCKS));
+
+	sdcard_init();
+
+	while (sdcard_num_blocks() == 0)
+	{
+		sd_emu_run();
+		assert(sd_emu_now < SD_EMU_MS(60000));
+	}
+
+	printf("%s card: initialized after %.2f s, clock %d kHz, %u blocks\n",
+		SD_CARD_TEST_SDHC ? "SDHC" : "byte addressed",
+		(double) sd_emu_now / configCPU_CLOCK_HZ, sd_get(1), sdcard_num_blocks());
+	assert(sd_get(1) == 4096);
+	assert(sdcard_num_blocks() == NUM_BLOCKS);
+
+	sd_emu_run_ms(100);
+	assert(rec_get(2) == REC_STATE_NO_AREA);  // the recorder found no area
+
+	assert(io(SDCARD_OP_READ, 1000, buf, 8) == 0);
+	assert(memcmp(buf, ref + BLK(1000), BLK(8)) == 0);
+	assert(io(SDCARD_OP_READ, NUM_BLOCKS - 1, buf, 1) == 0);
+	assert(memcmp(buf, ref + BLK(NUM_BLOCKS - 1), BLK(1)) == 0);
+
+	request(&r, SDCARD_OP_READ, NUM_BLOCKS - 1, buf, 2);
+	assert(sdcard_submit(&r) == 1);  // beyond the end of the card
+
+	queued_writes();
+	read_ahead();
+	throughput();
+	recorder();
+	card_removed();
+
+	printf("blocks read %d, written %d, stream commands %d\n", sd_get(4), sd_get(5), sd_get(7));
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,313 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * slowdata_test.c
+ *
+ * Slow data demultiplexer (slowdata.c) fed with superframes built like
+ * the slow data stream of a radio: text message, header retransmission,
+ * GPS-A sentence, fast data and squelch blocks, filler. Checks the
+ * handlers, the reassembly with missing frames and the counters.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "up_dstar/slowdata.h"
+#include "up_dstar/rx_dstar_crc_header.h"
+
+
+static char aprs[200];
+static int aprs_count;
+
+void aprs_send_user_report (uint8_t * gps_a_data, uint16_t gps_a_len)
+{
+	memcpy(aprs, gps_a_data, gps_a_len);
+	aprs[gps_a_len] = 0;
+	aprs_count ++;
+}
+
+static char text[SLOWDATA_TEXT_LEN + 1];
+static int text_flags;
+static uint8_t header[SLOWDATA_HEADER_LEN];
+static int header_res;
+static int header_count;
+static uint8_t other[10][SLOWDATA_BLOCK_LEN];
+static int other_count;
+
+static void text_handler (const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source)
+{
+	assert(len == SLOWDATA_TEXT_LEN);
+	memcpy(text, data, len);
+	text_flags = flags;
+}
+
+static void header_handler (const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source)
+{
+	assert(len == SLOWDATA_HEADER_LEN);
+	memcpy(header, data, len);
+	header_res = flags;
+	header_count ++;
+}
+
+static void gps_handler (const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source)
+{
+	assert(len == (flags & 0x07));
+	slowdata_data_input(data, len);
+}
+
+static void other_handler (const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source)
+{
+	assert(len == 5);
+	other[other_count][0] = flags;
+	memcpy(other[other_count] + 1, data, len);
+	other_count ++;
+}
+
+// slow data stream, a multiple of 10 blocks (superframes)
+
+static uint8_t stream[2000];
+static int stream_len;
+
+static void block (uint8_t mini_header, const uint8_t * d, int len)
+{
+	int i;
+
+	stream[stream_len++] = mini_header;
+
+	for (i=0; i < 5; i++)
+	{
+		stream[stream_len++] = (i < len) ? d[i] : 0x66;
+	}
+}
+
+static void blocks (uint8_t type, const uint8_t * d, int len)
+{
+	int i;
+
+	for (i=0; i < len; i += 5)
+	{
+		int n = ((len - i) < 5) ? (len - i) : 5;
+
+		block(type | n, d + i, n);
+	}
+}
+
+static void fill_superframe (void)
+{
+	while ((stream_len % (SLOWDATA_NUM_BLOCKS * SLOWDATA_BLOCK_LEN)) != 0)
+	{
+		block(0x66, NULL, 0);
+	}
+}
+
+// frame n of the stream (counted from 0, sync frames not counted) is lost,
+// last_pos < 20 ends every superframe early
+
+static void feed (int lost_frame, int last_pos)
+{
+	int off = 0, n = 0;
+
+	slowdata_rx_reset();
+
+	while (off < stream_len)
+	{
+		int pos;
+
+		slowdata_rx_frame(0, (const uint8_t *) "\x55\x2d\x16", 2);
+
+		for (pos=1; pos <= 20; pos++, off += 3, n++)
+		{
+			if (pos <= last_pos)
+			{
+				slowdata_rx_frame(pos, stream + off, (n == lost_frame) ? 0 : 2);
+			}
+		}
+
+		slowdata_analyze_stream();  // the task reads the GPS data every frame
+	}
+
+	slowdata_rx_frame(0, (const uint8_t *) "\x55\x2d\x16", 2);  // start of the next superframe
+	slowdata_analyze_stream();
+}
+
+static void clear (void)
+{
+	memset(&slowdata_stats, 0, sizeof slowdata_stats);
+	memset(text, 0, sizeof text);
+	text_flags = -1;
+	header_res = -1;
+	header_count = 0;
+	other_count = 0;
+	aprs[0] = 0;
+	aprs_count = 0;
+}
+
+static const char * message = "UP4DAR test message ";
+
+static uint8_t radio_header[SLOWDATA_HEADER_LEN];
+
+static char gps_a[200];
+
+static void build_stream (void)
+{
+	const char * line = ",DL1BFF>API510,DSTAR*:!5007.95N/00841.85E[/A=000394 UP4DAR\r";
+	uint16_t crc = RX_DSTAR_CRC_INIT;
+	const char * p;
+	unsigned short sum;
+	int i;
+
+	memcpy(radio_header, "\0\0\0DB0XYZ GDB0XYZ BCQCQCQ  DL1BFF  UP4D", 39);
+	sum = rx_dstar_crc_header(radio_header);
+	radio_header[39] = sum & 0xFF;
+	radio_header[40] = sum >> 8;
+
+	for (p=line + 1; *p; p++)  // CRC from the character after the comma, CR included
+	{
+		crc = rx_dstar_crc_update_byte(crc, *p);
+	}
+
+	sprintf(gps_a, "$$CRC%04X%s", rx_dstar_crc_final(crc), line);
+
+	stream_len = 0;
+
+	// superframe 1: text message
+	for (i=0; i < 4; i++)
+	{
+		block(SLOWDATA_TYPE_TEXT | i, (const uint8_t *) message + (i * 5), 5);
+	}
+	fill_superframe();
+
+	// superframes 2..: header, GPS-A, fast data and squelch code
+	blocks(SLOWDATA_TYPE_HEADER, radio_header, SLOWDATA_HEADER_LEN);
+	blocks(SLOWDATA_TYPE_GPS, (const uint8_t *) gps_a, strlen(gps_a));
+	block(SLOWDATA_TYPE_FAST1 | 0x0A, (const uint8_t *) "\x01\x02\x03\x04\x05", 5);
+	block(SLOWDATA_TYPE_SQUELCH | 0x02, (const uint8_t *) "\x12\x12\x66\x66\x66", 5);
+	fill_superframe();
+}
+
+// frame number of the first frame of block b
+
+#define BLOCK_FRAME(b)  ((b) * 2)
+
+int main (void)
+{
+	slowdataInit();
+	slowdata_register(SLOWDATA_TYPE_TEXT, text_handler);
+	slowdata_register(SLOWDATA_TYPE_HEADER, header_handler);
+	slowdata_register(SLOWDATA_TYPE_GPS, gps_handler);
+	slowdata_register(SLOWDATA_TYPE_FAST1, other_handler);
+	slowdata_register(SLOWDATA_TYPE_SQUELCH, other_handler);
+
+	build_stream();
+	printf("%d superframes of slow data\n", stream_len / 60);
+
+	// 1. complete stream
+
+	clear();
+	feed(-1, 20);
+	assert((strcmp(text, message) == 0) && (text_flags == 0x0F));
+	assert((header_count == 1) && (header_res == 0) && (memcmp(header, radio_header, SLOWDATA_HEADER_LEN) == 0));
+	assert((aprs_count == 1) && (strncmp(aprs, gps_a + 10, strlen(gps_a) - 11) == 0) && (strlen(aprs) == strlen(gps_a) - 11));
+	assert(other_count == 2);
+	assert(memcmp(other[0], "\x8A\x01\x02\x03\x04\x05", 6) == 0);
+	assert(memcmp(other[1], "\xC2\x12\x12\x66\x66\x66", 6) == 0);
+	assert((slowdata_stats.blocks == (stream_len / 6)) && (slowdata_stats.lost_blocks == 0));
+	assert((slowdata_stats.texts == 1) && (slowdata_stats.headers == 1) && (slowdata_stats.header_errors == 0));
+	assert(slowdata_stats.gps_dropped == 0);
+	printf("complete: text \"%s\", header %.8s, GPS-A \"%.30s...\", 2 other blocks\n",
+		text, header + 27, aprs);
+
+	// 2. text part 1 lost: message incomplete
+
+	clear();
+	feed(BLOCK_FRAME(1) + 1, 20);
+	assert((text_flags == 0x0D) && (slowdata_stats.texts == 0) && (slowdata_stats.lost_blocks == 1));
+	assert(header_count == 1);
+	printf("text part 1 lost: parts 0x%02X\n", text_flags);
+
+	// 3. a header block lost: no header
+
+	clear();
+	feed(60 / 3 + BLOCK_FRAME(3), 20);
+	assert((header_count == 0) && (slowdata_stats.headers == 0) && (slowdata_stats.lost_blocks == 1));
+	assert((text_flags == 0x0F) && (aprs_count == 1));
+	printf("header block lost: no header\n");
+
+	// 4. header with wrong CRC
+
+	clear();
+	stream[60 + 8 * SLOWDATA_BLOCK_LEN + 1] ^= 0x01;  // last header block: CRC high byte
+	feed(-1, 20);
+	stream[60 + 8 * SLOWDATA_BLOCK_LEN + 1] ^= 0x01;
+	assert((header_count == 1) && (header_res == 1) && (slowdata_stats.header_errors == 1));
+	printf("header with wrong CRC: reported with result 1\n");
+
+	// 5. GPS block lost: sentence not sent
+
+	clear();
+	feed(60 / 3 + BLOCK_FRAME(12), 20);
+	assert((aprs_count == 0) && (header_count == 1));
+	printf("GPS-A block lost: no report\n");
+
+	// 6. the end of every superframe is missing: processed at the next sync,
+	//    blocks 8 and 9 lost
+
+	clear();
+	feed(-1, 16);
+	assert(slowdata_stats.blocks == ((stream_len / 6) / 10) * 8);
+	assert((text_flags == 0x0F) && (header_count == 0));
+	printf("superframes end at pos 16: %u blocks processed\n", slowdata_stats.blocks);
+
+	// 7. GPS data of two superframes without analyze: FIFO full
+
+	clear();
+	stream_len = 0;
+	{
+		uint8_t g[50];
+
+		memset(g, 'x', sizeof g);
+		blocks(SLOWDATA_TYPE_GPS, g, 50);
+		blocks(SLOWDATA_TYPE_GPS, g, 50);
+	}
+	slowdata_rx_reset();
+	{
+		int off, pos;
+
+		for (off=0; off < stream_len; )
+		{
+			slowdata_rx_frame(0, NULL, 2);
+
+			for (pos=1; pos <= 20; pos++, off += 3)
+			{
+				slowdata_rx_frame(pos, stream + off, 2);
+			}
+		}
+	}
+	assert(slowdata_stats.gps_dropped == (100 - 64));
+	slowdata_analyze_stream();
+	printf("100 GPS bytes without analyze: %u dropped\n", slowdata_stats.gps_dropped);
+
+	printf("all ok\n");
+	return 0;
+}
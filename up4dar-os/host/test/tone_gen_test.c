@@ -0,0 +1,505 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * tone_gen_test.c
+ *
+ * Test and benchmark of tone_gen.c: the rendered scripts are written to
+ * a WAV file next to the test binary, the frequency and distortion of
+ * single tones, the DTMF tone pair and the CW timing are measured and
+ * the sample loop is compared with the old fixpoint_sin beep of the
+ * wm8510 task.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include "host_time.h"
+
+#include "up_dstar/tone_gen.h"
+#include "up_dstar/fixpoint_math.h"
+
+
+#define BLOCK		32		// samples per DMA buffer (AUDIO_Q_TRANSFERLEN)
+#define FS			TONE_SAMPLE_RATE
+#define MAX_SAMPLES	(FS * 12)
+#define ROUNDS		200000
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+static int16_t wav[FS * 30];
+static int wav_len;
+
+
+// render a script with silent input until the generator is idle
+
+static int render (const char * script, int volume, int16_t * s, int max)
+{
+	tone_gen_t g;
+	int n = 0;
+
+	tone_init(&g);
+	assert(tone_play(&g, script, volume) == 0);
+
+	while ((n + BLOCK) <= max)
+	{
+		memset(s + n, 0, BLOCK * sizeof s[0]);
+
+		if (tone_render(&g, s + n, BLOCK) == 0)
+			break;
+
+		n += BLOCK;
+	}
+
+	assert((n + BLOCK) <= max);
+
+	if ((wav_len + n + FS/4) <= (int) (sizeof wav / sizeof wav[0]))
+	{
+		memcpy(wav + wav_len, s, n * sizeof s[0]);
+		wav_len += n;
+		memset(wav + wav_len, 0, (FS/4) * sizeof s[0]);  // gap between the scripts
+		wav_len += FS/4;
+	}
+
+	return n;
+}
+
+
+static void put_le (FILE * f, uint32_t v, int bytes)
+{
+	while (bytes-- > 0)
+	{
+		fputc(v & 0xFF, f);
+		v >>= 8;
+	}
+}
+
+static void write_wav (const char * argv0)
+{
+	char path[256];
+	const char * slash = strrchr(argv0, '/');
+	int dir = (slash == NULL) ? 0 : (slash - argv0 + 1);
+	FILE * f;
+	int i;
+
+	snprintf(path, sizeof path, "%.*stone_gen_test.wav", dir, argv0);
+
+	f = fopen(path, "wb");
+	assert(f != NULL);
+
+	fputs("RIFF", f);
+	put_le(f, 36 + wav_len * 2, 4);
+	fputs("WAVEfmt ", f);
+	put_le(f, 16, 4);
+	put_le(f, 1, 2);		// PCM
+	put_le(f, 1, 2);		// mono
+	put_le(f, FS, 4);
+	put_le(f, FS * 2, 4);
+	put_le(f, 2, 2);
+	put_le(f, 16, 2);
+	fputs("data", f);
+	put_le(f, wav_len * 2, 4);
+
+	for (i=0; i < wav_len; i++)
+	{
+		put_le(f, (uint16_t) wav[i], 2);
+	}
+
+	assert(fclose(f) == 0);
+
+	printf("wav: %s, %d samples\n", path, wav_len);
+}
+
+
+// frequency from the first and the last rising zero crossing
+
+static double zero_crossing_hz (const int16_t * s, int n)
+{
+	double first = -1, last = 0;
+	int count = 0;
+	int i;
+
+	for (i=1; i < n; i++)
+	{
+		if ((s[i-1] < 0) && (s[i] >= 0))
+		{
+			double t = (i - 1) + (double) -s[i-1] / (s[i] - s[i-1]);
+
+			if (first < 0)
+			{
+				first = t;
+			}
+			last = t;
+			count ++;
+		}
+	}
+
+	assert(count > 2);
+
+	return (count - 1) * FS / (last - first);
+}
+
+
+// THD+N: power left after removing the best fitting sine of frequency hz
+
+static double thd_n_db (const int16_t * s, int n, double hz)
+{
+	double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, yy = 0;
+	double a, b, det, res = 0;
+	int i;
+
+	for (i=0; i < n; i++)
+	{
+		double si = sin(2 * M_PI * hz * i / FS);
+		double ci = cos(2 * M_PI * hz * i / FS);
+
+		ss += si * si;
+		cc += ci * ci;
+		sc += si * ci;
+		ys += s[i] * si;
+		yc += s[i] * ci;
+		yy += (double) s[i] * s[i];
+	}
+
+	det = ss * cc - sc * sc;
+	a = (ys * cc - yc * sc) / det;
+	b = (yc * ss - ys * sc) / det;
+
+	for (i=0; i < n; i++)
+	{
+		double e = s[i] - a * sin(2 * M_PI * hz * i / FS) - b * cos(2 * M_PI * hz * i / FS);
+
+		res += e * e;
+	}
+
+	return 10 * log10(res / yy);
+}
+
+
+static void single_tone (unsigned int hz)
+{
+	static int16_t s[MAX_SAMPLES];
+	char script[24];
+	int n;
+
+	snprintf(script, sizeof script, "T%u:10000", hz);
+	n = render(script, 50, s, MAX_SAMPLES);
+
+	assert(n >= 10 * FS);
+
+	// without the attack and the release
+	double f = zero_crossing_hz(s + FS, 8 * FS);
+	double thd = thd_n_db(s + FS, FS, hz);
+
+	printf("tone %u Hz: %.3f Hz, THD+N %.0f dB\n", hz, f, thd);
+
+	assert(fabs(f - hz) < 0.01);
+	assert(thd < -50);
+
+	// the old beep: whole degrees per sample
+	double old_hz = (double) ((360 * hz) / FS) * FS / 360;
+
+	printf("  old beep: %.3f Hz\n", old_hz);
+}
+
+
+// Goertzel power of one frequency, Hann window
+
+static double power_at (const int16_t * s, int n, double hz)
+{
+	double w = 2 * cos(2 * M_PI * hz / FS);
+	double q1 = 0, q2 = 0;
+	int i;
+
+	for (i=0; i < n; i++)
+	{
+		double win = 0.5 - 0.5 * cos(2 * M_PI * i / (n - 1));
+		double q0 = w * q1 - q2 + s[i] * win;
+
+		q2 = q1;
+		q1 = q0;
+	}
+
+	return q1 * q1 + q2 * q2 - w * q1 * q2;
+}
+
+static double peak_hz (const int16_t * s, int n, double from, double to)
+{
+	double best = from, best_p = 0;
+	double f;
+
+	for (f = from; f <= to; f += 0.01)
+	{
+		double p = power_at(s, n, f);
+
+		if (p > best_p)
+		{
+			best_p = p;
+			best = f;
+		}
+	}
+
+	return best;
+}
+
+
+// start and length of the runs above half amplitude
+
+static int runs (const int16_t * s, int n, int threshold, int * on, int * len, int max)
+{
+	int count = 0;
+	int state = 0;
+	int start = 0;
+	int i;
+
+	for (i=0; i < n; i++)
+	{
+		int k, m = 0;
+
+		for (k = i - 5; k < (i + 5); k++)  // one period of the CW tone
+		{
+			if ((k >= 0) && (k < n) && (abs(s[k]) > m))
+			{
+				m = abs(s[k]);
+			}
+		}
+
+		if ((m > threshold) != state)
+		{
+			if (count > 0 || state != 0)
+			{
+				assert(count < max);
+				on[count] = state;
+				len[count] = i - start;
+				count ++;
+			}
+			state = !state;
+			start = i;
+		}
+	}
+
+	if (state != 0)
+	{
+		assert(count < max);
+		on[count] = 1;
+		len[count] = n - start;
+		count ++;
+	}
+
+	return count;
+}
+
+
+static void dtmf (void)
+{
+	static int16_t s[MAX_SAMPLES];
+	int on[8], len[8];
+	int samples = TONE_DTMF_DEFAULT_MS * FS / 1000;
+	int n, count;
+
+	n = render("D1;", 50, s, MAX_SAMPLES);
+
+	count = runs(s, n, 50 * 100 / 4, on, len, 8);  // two tones, beating
+
+	assert(count == 1);
+	assert(abs(len[0] - samples) <= 30);
+
+	double lo = peak_hz(s, samples, 650, 740);
+	double hi = peak_hz(s, samples, 1150, 1260);
+	double p = power_at(s, samples, 697);
+
+	printf("dtmf 1: %.2f Hz, %.2f Hz, %d ms\n", lo, hi, len[0] * 1000 / FS);
+
+	assert(fabs(lo - 697) < 0.05);
+	assert(fabs(hi - 1209) < 0.05);
+
+	// the other row and column tones
+	assert(power_at(s, samples, 770) < (p / 1000));
+	assert(power_at(s, samples, 1336) < (p / 1000));
+}
+
+
+static void cw (void)
+{
+	static int16_t s[MAX_SAMPLES];
+	static const int expect_on[7] = { 1, 0, 1, 0, 1, 0, 1 };
+	static const int expect_dits[7] = { 1, 1, 3, 3, 1, 7, 1 };  // .- . .
+	int dit = 1200 * FS / 1000 / TONE_CW_DEFAULT_WPM;
+	int on[20], len[20];
+	int n, count, i;
+
+	n = render("CAE E;", 50, s, MAX_SAMPLES);
+
+	count = runs(s, n, 50 * 100 / 2, on, len, 20);
+
+	assert(count == 7);
+
+	printf("cw %d WPM:", TONE_CW_DEFAULT_WPM);
+
+	for (i=0; i < count; i++)
+	{
+		printf(" %s%.2f", on[i] ? "+" : "-", (double) len[i] / dit);
+
+		assert(on[i] == expect_on[i]);
+		assert(abs(len[i] - expect_dits[i] * dit) <= 10);
+	}
+
+	printf(" dits\n");
+}
+
+
+// the beep loop of the wm8510 task before tone_gen.c, one block
+
+static int beep_counter;
+static int beep_phase;
+static int beep_phase_incr;
+static int beep_volume;
+static int beep_fade_in;
+
+static void old_beep_start (int duration_ms, int frequency_hz, int volume_percent)
+{
+	beep_counter = (int64_t) duration_ms * FS / (configTICK_RATE_HZ * BLOCK);
+	beep_volume = volume_percent;
+	beep_phase = 0;
+	beep_phase_incr = (360 * frequency_hz) / FS;
+	beep_fade_in = 1;
+}
+
+static void old_beep_block (int16_t * tx_buf)
+{
+	if (beep_counter > 0)
+	{
+		int i;
+
+		for (i=0; i < BLOCK; i++)
+		{
+			int vol = beep_volume;
+
+			if (beep_counter == 1) // at the end of the beep
+			{
+				vol = (BLOCK - i) * beep_volume / BLOCK; // fade out
+			}
+			else if (beep_fade_in != 0) // start of beep
+			{
+				beep_fade_in = 0;
+				vol = (i + 1) * beep_volume / BLOCK; // fade in
+			}
+
+			tx_buf[i] = (tx_buf[i] / 2) +
+				(vol * fixpoint_sin(beep_phase)) / 100;
+			beep_phase += beep_phase_incr;
+			if (beep_phase >= 360)
+			{
+				beep_phase -= 360;
+			}
+		}
+
+		beep_counter --;
+	}
+}
+
+
+static void benchmark (void)
+{
+	static int16_t b[BLOCK];
+	tone_gen_t g;
+	long k;
+
+	old_beep_start(ROUNDS * BLOCK / 8 + 100, 1237, 50);
+
+	uint64_t t = host_nsec();
+
+	for (k=0; k < ROUNDS; k++)
+	{
+		b[k & (BLOCK - 1)] ^= 1;
+		old_beep_block(b);
+		host_sink += b[3];
+	}
+
+	double t_old = (double) (host_nsec() - t) / ROUNDS / BLOCK;
+
+	assert(beep_counter > 0);
+
+	tone_init(&g);
+	t = host_nsec();
+
+	for (k=0; k < ROUNDS; k++)
+	{
+		if ((k % 10000) == 0)  // 40 s per script
+		{
+			tone_play(&g, "T1237:60000", 50);
+		}
+
+		b[k & (BLOCK - 1)] ^= 1;
+		assert(tone_render(&g, b, BLOCK) != 0);
+		host_sink += b[3];
+	}
+
+	double t_new = (double) (host_nsec() - t) / ROUNDS / BLOCK;
+
+	tone_init(&g);
+	t = host_nsec();
+
+	for (k=0; k < ROUNDS; k++)
+	{
+		if ((k % 10000) == 0)  // 40 s per script
+		{
+			tone_play(&g, "T697,1209:60000", 50);
+		}
+
+		b[k & (BLOCK - 1)] ^= 1;
+		assert(tone_render(&g, b, BLOCK) != 0);
+		host_sink += b[3];
+	}
+
+	double t_two = (double) (host_nsec() - t) / ROUNDS / BLOCK;
+
+	printf("per sample: old beep %.1f ns, tone_gen %.1f ns, two tones %.1f ns\n",
+		t_old, t_new, t_two);
+}
+
+
+int main (int argc, char * argv[])
+{
+	(void) argc;
+
+	single_tone(1000);
+	single_tone(1237);
+	dtmf();
+	cw();
+
+	static int16_t s[MAX_SAMPLES];
+	render(TONE_SCRIPT_ROGER, 50, s, MAX_SAMPLES);
+
+	write_wav(argv[0]);
+
+	benchmark();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,388 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * udp4_flow_test.c
+ *
+ * Connected UDP flows of ipv4.c with the neighbor cache of ipneigh.c
+ * (included, the test uses its timer constants) and the MACB model: the frames of a flow are the same as the frames of the
+ * udp4_get_packet_mem() path but for the IP ID, the flow follows a new
+ * MAC addr of the gateway, a failed probe, neighbor discovery and a
+ * new IPv4 config. Then the time per packet of both paths to a
+ * reflector behind the gateway with a full neighbor cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "FreeRTOS.h"
+
+#include <asf.h>
+
+#include "up_net/ipneigh.c"
+
+#include "up_net/ipv4.h"
+#include "up_net/inet_csum.h"
+
+#include "macb_model.h"
+#include "host_time.h"
+
+
+static uint32_t sim_now;
+
+uint32_t host_sys_count (void)
+{
+	return sim_now;
+}
+
+
+// frames on the wire
+
+#define MAX_WIRE	8
+
+static uint8_t wire[MAX_WIRE][1600];
+static int wire_len[MAX_WIRE], num_wire;
+
+static void sent (const uint8_t * frame, int len)
+{
+	if (num_wire < MAX_WIRE)
+	{
+		memcpy(wire[num_wire], frame, len);
+		wire_len[num_wire] = len;
+	}
+
+	num_wire ++;
+}
+
+static void run (void)
+{
+	macb_poll(sim_now);
+	sim_now += configCPU_CLOCK_HZ / 100;
+	macb_tx_run(sim_now);
+	macb_eth_txmem_flush_q(sim_now);
+}
+
+
+static int arp_requests, arp_unicast;
+
+void arp_send_request (const ip_addr_t * a, int unicast, const mac_addr_t * m)
+{
+	arp_requests ++;
+	arp_unicast = unicast;
+}
+
+
+static int ip_header_ok (const uint8_t * f)
+{
+	return inet_csum_fold(inet_csum_add(0, f + 14, 20)) == 0xFFFF;
+}
+
+static int udp_checksum_ok (const uint8_t * f, int len)
+{
+	int udp_length = ((const uint16_t *) (f + 14)) [12];
+
+	if (udp_length != (len - 34))
+		return 0;
+
+	uint32_t sum = inet_csum_add(0, f + 26, 8) + 17 + udp_length;
+
+	sum = inet_csum_add(sum, f + 34, udp_length);
+
+	return inet_csum_fold(sum) == 0xFFFF;
+}
+
+// frames a and b are equal but for the IP ID and the IP header checksum
+
+static int same_datagram (int a, int b)
+{
+	return (wire_len[a] == wire_len[b]) &&
+		(memcmp(wire[a], wire[b], 18) == 0) &&
+		(memcmp(wire[a] + 20, wire[b] + 20, 4) == 0) &&
+		(memcmp(wire[a] + 26, wire[b] + 26, wire_len[a] - 26) == 0);
+}
+
+
+static const uint8_t dest[4] = { 80, 69, 86, 91 };  // reflector, not on the local subnet
+static const uint8_t gw[4] = { 192, 168, 1, 1 };
+
+static ip_addr_t ip (const uint8_t * a)
+{
+	ip_addr_t x;
+
+	memset(&x, 0, sizeof x);
+	memcpy(x.ipv4.addr, a, 4);
+	return x;
+}
+
+static mac_addr_t mac (int b)
+{
+	mac_addr_t m;
+
+	memset(&m, b, sizeof m);
+	return m;
+}
+
+// address from DHCP
+
+static void set_config (int host)
+{
+	static const uint8_t mask[4] = { 255, 255, 255, 0 };
+
+	memcpy(ipv4_addr, gw, 3);
+	ipv4_addr[3] = host;
+	memcpy(ipv4_netmask, mask, 4);
+	memcpy(ipv4_gw, gw, 4);
+}
+
+// ARP request of the gateway: a STALE entry
+
+static void gateway_heard (int mac_byte)
+{
+	ip_addr_t g = ip(gw);
+	mac_addr_t m = mac(mac_byte);
+
+	ipneigh_rx(&g, &m, 0);
+}
+
+static void service (int n)
+{
+	while (n-- > 0)
+	{
+		ipneigh_service();
+	}
+}
+
+static udp4_flow_t flow;
+
+// one packet of 20 bytes on the flow, returns the number of frames sent
+
+static int flow_packet (void)
+{
+	num_wire = 0;
+	udp4_flow_send(&flow, udp4_flow_get_packet_mem(&flow, 20));
+	run();
+
+	return num_wire;
+}
+
+
+static uint8_t payload[1500];
+
+
+static void same_frames (void)
+{
+	static uint8_t seg_mem[300];
+	eth_txmem_t seg;
+	int i;
+
+	memset(&flow, 0, sizeof flow);
+	assert(udp4_flow_get_packet_mem(&flow, 10) == NULL);  // closed
+
+	udp4_flow_connect(&flow, dest, 12345, 30051);
+
+	for (i=0; i < 20000; i++)
+	{
+		int h = rand() % 600;
+		int with_seg = (rand() % 3) == 0;
+		int seg_len = 1 + rand() % 300;
+		eth_txmem_t * a;
+		eth_txmem_t * b;
+
+		memcpy(seg_mem, payload + 700, seg_len);
+		eth_txmem_static_init(&seg, seg_mem, seg_len);
+
+		a = with_seg ? udp4_get_packet_mem_seg(h, &seg, 12345, 30051, dest) :
+			udp4_get_packet_mem(h, 12345, 30051, dest);
+		b = with_seg ? udp4_flow_get_packet_mem_seg(&flow, h, &seg) :
+			udp4_flow_get_packet_mem(&flow, h);
+
+		memcpy(a->data + 42, payload, h);
+		memcpy(b->data + 42, payload, h);
+
+		num_wire = 0;
+		udp4_calc_chksum_and_send(a, dest);
+		udp4_flow_send(&flow, b);
+		run();
+
+		assert((num_wire == 2) && same_datagram(0, 1));
+		assert(ip_header_ok(wire[1]) && udp_checksum_ok(wire[1], wire_len[1]));
+		assert(wire[1][0] == 0x22);
+	}
+
+	assert(flow.state == UDP4_FLOW_RESOLVED);
+
+	printf("%d flow frames equal to the udp4_get_packet_mem() frames but for the IP ID\n", i);
+}
+
+
+static void neighbor_changes (void)
+{
+	ip_addr_t g = ip(gw);
+	mac_addr_t m;
+
+	// the gateway answers the probe with a new MAC addr
+
+	arp_requests = 0;
+	service(PROBE_TIMER);
+	assert((arp_requests == 1) && (arp_unicast == 1));
+
+	m = mac(0x33);
+	ipneigh_rx(&g, &m, 1);
+
+	assert((flow_packet() == 1) && (wire[0][0] == 0x33));
+	printf("new MAC addr of the gateway used\n");
+
+	// no answer to the probes: INCOMPLETE, packets are dropped
+
+	service(REACHABLE_TIMER + PROBE_TIMER * PROBE_RETRY + 2);
+	assert((flow_packet() == 0) && (flow.state == UDP4_FLOW_OPEN));
+
+	// the entry is deleted, the next packet starts neighbor discovery
+	// and waits for the answer
+
+	service(INCOMPLETE_TIMER * INCOMPLETE_RETRY + 2);
+	arp_requests = 0;
+	assert(flow_packet() == 0);
+	assert((arp_requests == 1) && (arp_unicast == 0));
+
+	m = mac(0x44);
+	ipneigh_rx(&g, &m, 1);
+	run();
+	assert((num_wire == 1) && (wire[0][0] == 0x44) && udp_checksum_ok(wire[0], wire_len[0]));
+
+	assert((flow_packet() == 1) && (wire[0][0] == 0x44));
+	assert(flow.state == UDP4_FLOW_RESOLVED);
+
+	printf("failed probe: packets dropped, neighbor discovery, pending packet sent, flow resolved again\n");
+}
+
+
+static void config_changes (void)
+{
+	// DHCP: new address
+
+	set_config(77);
+	ipneigh_changed();
+
+	assert((flow_packet() == 1) && (wire[0][29] == 77));
+	assert(ip_header_ok(wire[0]) && udp_checksum_ok(wire[0], wire_len[0]));
+
+	// link lost: ipv4_init(), no gateway, packets are dropped
+
+	ipv4_init();
+	assert(flow_packet() == 0);
+
+	set_config(10);
+	ipneigh_changed();
+	gateway_heard(0x22);
+	assert((flow_packet() == 1) && (wire[0][0] == 0x22) && (wire[0][29] == 10));
+
+	printf("new IPv4 config and link loss\n");
+}
+
+
+// time from getting the buffer to eth_txmem_send() for a packet to the
+// reflector, five other neighbors in front of the gateway in the cache
+
+#define ROUNDS	20000
+
+static void benchmark (void)
+{
+	static const int sizes[] = { 27, 100, 519 };  // DExtra voice, DCS voice, DCS connect
+	int i, k;
+
+	ipneigh_init();
+
+	for (i=0; i < 5; i++)
+	{
+		uint8_t a[4] = { 192, 168, 1, 100 + i };
+		ip_addr_t x = ip(a);
+		mac_addr_t m = mac(i);
+
+		ipneigh_rx(&x, &m, 0);
+	}
+
+	gateway_heard(0x22);
+
+	for (i=0; i < (sizeof sizes / sizeof sizes[0]); i++)
+	{
+		int len = sizes[i];
+		uint64_t ns_old = 0, ns_flow = 0, c_old = 0, c_flow = 0;
+
+		for (k=0; k < ROUNDS; k++)
+		{
+			uint64_t t0 = host_nsec();
+			uint64_t c0 = host_cycles();
+
+			eth_txmem_t * p = udp4_get_packet_mem(len, 12345, 30051, dest);
+			memcpy(p->data + 42, payload, len);
+			udp4_calc_chksum_and_send(p, dest);
+
+			c_old += host_cycles() - c0;
+			ns_old += host_nsec() - t0;
+			run();
+
+			t0 = host_nsec();
+			c0 = host_cycles();
+
+			p = udp4_flow_get_packet_mem(&flow, len);
+			memcpy(p->data + 42, payload, len);
+			udp4_flow_send(&flow, p);
+
+			c_flow += host_cycles() - c0;
+			ns_flow += host_nsec() - t0;
+			run();
+		}
+
+		printf("UDP data %3d bytes: header per packet %4.0f ns, %4.0f cycles; flow %4.0f ns, %4.0f cycles\n",
+			len, (double) ns_old / ROUNDS, (double) c_old / ROUNDS,
+			(double) ns_flow / ROUNDS, (double) c_flow / ROUNDS);
+	}
+}
+
+
+int main (void)
+{
+	int i;
+
+	assert(eth_txmem_init() == 0);
+	ipv4_init();
+	macb_tx_sent = sent;
+
+	srand(5);
+
+	for (i=0; i < sizeof payload; i++)
+	{
+		payload[i] = rand();
+	}
+
+	set_config(10);
+	ipneigh_changed();
+	gateway_heard(0x22);
+
+	same_frames();
+	neighbor_changes();
+	config_changes();
+	benchmark();
+
+	printf("all ok\n");
+	return 0;
+}
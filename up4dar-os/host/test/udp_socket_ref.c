@@ -0,0 +1,93 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * udp_socket_ref.c
+ *
+ * Reference for udp_socket_test.c: the port demux of udp_input() in
+ * ipv4.c before udp_socket.c (walk of udp_socket_ports[], then the DNS
+ * requests of dns2.c)
+ */
+
+
+#include "FreeRTOS.h"
+
+
+#define NUM_UDP_SOCKETS   6
+
+static unsigned short udp_socket_ports[NUM_UDP_SOCKETS] = { 68, 161, 0, 0, 0 };
+
+
+#define DNS_NUMBER_OF_ENTRIES  7
+#define DNS_STATE_REQ_A		2
+
+struct dns2_cache
+{
+	uint16_t udp_local_port;
+	uint8_t state;
+	uint8_t reqname_len;
+};
+
+static struct dns2_cache dc[DNS_NUMBER_OF_ENTRIES];
+
+
+static int dns2_find_dns_port( uint16_t port )
+{
+	int i;
+	
+	for (i=0; i < DNS_NUMBER_OF_ENTRIES; i++)
+	{
+		struct dns2_cache * cur = dc + i;
+		
+		if ((cur->reqname_len > 0) && 
+			(cur->state == DNS_STATE_REQ_A) &&
+			(cur->udp_local_port == port))
+		{
+			return i;
+		}
+	}
+	
+	return -1; // not found
+}
+
+
+// socket index, 10 + DNS handle or -1
+
+static int __attribute__((noinline)) ref_udp_demux( int dest_port )
+{
+	int i;
+	
+	for (i=0; i < NUM_UDP_SOCKETS; i++)
+	{
+		if (dest_port == udp_socket_ports[i])
+		{
+			return i;
+		}
+	}
+	
+	int handle = dns2_find_dns_port(dest_port);
+	
+	if (handle >= 0)
+	{
+		return 10 + handle;
+	}
+	
+	return -1;
+}
@@ -0,0 +1,446 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * udp_socket_test.c
+ *
+ * udp_socket.c (included, the test walks the hash table): random bind
+ * and unbind against a table of the ports, many sockets in one chain,
+ * init of a bound socket, a receive queue shared by three sockets with
+ * full queue, too long datagrams and a socket unbound while datagrams
+ * wait, ipv4_init() after a link loss with other sockets in the chain
+ * of the SNMP port. Then the time of the port demux against the old
+ * array walk (udp_socket_ref.c).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "up_net/udp_socket.c"
+
+#include "up_io/eth_txmem.h"
+#include "up_net/ipneigh.h"
+#include "up_net/ipv4.h"
+
+#include "host_time.h"
+#include "udp_socket_ref.c"
+
+
+uint32_t host_sys_count (void)
+{
+	return 0;
+}
+
+
+// datagrams received by the input functions, socket s gets the bytes
+// s->arg + i from 10.0.0.<arg>
+
+#define MAX_GOT	16
+
+static int got_n, got_arg[MAX_GOT], got_len[MAX_GOT];
+
+static void input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	int i;
+
+	for (i=0; i < data_len; i++)
+	{
+		assert(data[i] == (uint8_t) (s->arg + i));
+	}
+
+	assert((ipv4_src_addr[0] == 10) && (ipv4_src_addr[3] == s->arg));
+
+	assert(got_n < MAX_GOT);
+	got_arg[got_n] = s->arg;
+	got_len[got_n] = data_len;
+	got_n ++;
+}
+
+
+#define NUM_SOCKETS	64
+
+static udp_socket_t sockets[NUM_SOCKETS];
+
+// socket number + 1 for every port, 0: not bound
+
+static int ref[65536];
+
+// every port finds its socket and every socket is in the chain of its
+// port, returns the number of bound sockets
+
+static int check_table (void)
+{
+	int i, n = 0, in_chains = 0;
+
+	for (i=1; i < 65536; i++)
+	{
+		udp_socket_t * s = udp_socket_find(i);
+
+		assert(ref[i] ? (s == (sockets + ref[i] - 1)) : (s == NULL));
+		n += (ref[i] != 0);
+	}
+
+	for (i=0; i < UDP_HASH_SIZE; i++)
+	{
+		udp_socket_t * s;
+
+		for (s = udp_hash[i]; s != NULL; s = s->next)
+		{
+			assert(UDP_HASH(s->port) == i);
+			assert(++in_chains <= n);
+		}
+	}
+
+	assert(in_chains == n);
+
+	return n;
+}
+
+static void unbind_all (void)
+{
+	int i;
+
+	for (i=0; i < NUM_SOCKETS; i++)
+	{
+		if (sockets[i].port != 0)
+		{
+			ref[sockets[i].port] = 0;
+		}
+
+		udp_socket_unbind(sockets + i);
+	}
+}
+
+
+static void bind_unbind (void)
+{
+	int i, k;
+
+	srand(7);
+
+	for (i=0; i < NUM_SOCKETS; i++)
+	{
+		udp_socket_init(sockets + i, input, i, 0);
+	}
+
+	for (k=0; k < 200000; k++)
+	{
+		udp_socket_t * s = sockets + rand() % NUM_SOCKETS;
+		int port = (rand() & 1) ? (1 + 16 * (rand() % 64)) : (1 + rand() % 65535);  // many ports in one chain
+
+		if (s->port != 0)
+		{
+			ref[s->port] = 0;
+		}
+
+		if ((rand() % 3) == 0)
+		{
+			udp_socket_unbind(s);
+			assert(s->port == 0);
+		}
+		else if (ref[port] != 0)
+		{
+			assert(udp_socket_bind(s, port) == -1);
+			assert(s->port == 0);  // unbound from the old port
+		}
+		else
+		{
+			assert(udp_socket_bind(s, port) == 0);
+			assert((s->port == port) && udp_socket_port_in_use(port));
+			ref[port] = (s - sockets) + 1;
+		}
+
+		if ((k & 255) == 0)
+		{
+			check_table();
+		}
+	}
+
+	ref[sockets[0].port] = 0;  // unbound by the failed bind
+	assert(udp_socket_bind(sockets, 0) == -1);
+	int n = check_table();
+
+	// init of a bound socket takes it out of its chain
+
+	for (i=0; i < NUM_SOCKETS; i++)
+	{
+		if (sockets[i].port != 0)
+		{
+			ref[sockets[i].port] = 0;
+			udp_socket_init(sockets + i, input, i, 0);
+			assert(sockets[i].port == 0);
+			check_table();
+		}
+	}
+
+	printf("bind and unbind: 200000 random operations, table equal to the reference, %d sockets unbound by init\n", n);
+}
+
+
+static void queue (void)
+{
+	static uint8_t mem[UDP_SOCKET_QUEUE_MEM(4, 100)];
+	udp_socket_queue_t q;
+	uint8_t src[4] = { 10, 0, 0, 0 };
+	uint8_t d[200];
+	uint32_t drops = 0;
+	int i, j, k;
+
+	udp_socket_queue_init(&q, mem, 4, 100);
+
+	for (i=0; i < 3; i++)
+	{
+		udp_socket_init(sockets + i, input, i + 1, 0);
+		udp_socket_set_queue(sockets + i, &q);
+		assert(udp_socket_bind(sockets + i, 5000 + i) == 0);
+	}
+
+	for (k=0; k < 1000; k++)
+	{
+		int n = rand() % 7;
+		int expect = 0, expect_arg[8], expect_len[8], expect_drops = 0;
+		uint32_t dropped = udp_stats.dropped;
+
+		for (j=0; j < n; j++)
+		{
+			udp_socket_t * s = udp_socket_lookup(5000 + rand() % 3);
+			int len = rand() % 120;
+
+			src[3] = s->arg;
+
+			for (i=0; i < len; i++)
+			{
+				d[i] = s->arg + i;
+			}
+
+			udp_socket_deliver(s, d, len, src, 1000 + j);
+
+			if ((len > 100) || (expect >= 4))
+			{
+				expect_drops ++;  // too long for a slot or queue full
+			}
+			else
+			{
+				expect_arg[expect] = s->arg;
+				expect_len[expect] = len;
+				expect ++;
+			}
+		}
+
+		got_n = 0;
+		assert(udp_socket_queue_service(&q) == expect);
+		assert(got_n == expect);
+
+		for (j=0; j < expect; j++)
+		{
+			assert((got_arg[j] == expect_arg[j]) && (got_len[j] == expect_len[j]));
+		}
+
+		assert((udp_stats.dropped - dropped) == expect_drops);
+		drops += expect_drops;
+	}
+
+	assert((sockets[0].drop_count + sockets[1].drop_count + sockets[2].drop_count) == drops);
+
+	// unbound while a datagram waits in the queue: input() is not called
+
+	src[3] = 2;
+
+	for (i=0; i < 5; i++)
+	{
+		d[i] = 2 + i;
+	}
+
+	udp_socket_deliver(sockets + 1, d, 5, src, 1);
+	udp_socket_unbind(sockets + 1);
+
+	got_n = 0;
+	assert((udp_socket_queue_service(&q) == 1) && (got_n == 0));
+	assert(udp_socket_lookup(5001) == NULL);
+
+	printf("shared queue: datagrams in order, %u dropped (full queue, too long), unbound socket skipped\n", drops);
+
+	for (i=0; i < 3; i++)
+	{
+		udp_socket_init(sockets + i, input, i, 0);  // no queue
+	}
+}
+
+
+// a port in the chain of port
+
+static int same_chain (int port, int n)
+{
+	int p;
+
+	for (p = 1024; n >= 0; p++)
+	{
+		if ((p != port) && (UDP_HASH(p) == UDP_HASH(port)) && (n-- == 0))
+		{
+			return p;
+		}
+	}
+
+	return 0;
+}
+
+static void link_loss (void)
+{
+	int p1 = same_chain(161, 0);
+	int p2 = same_chain(161, 1);
+
+	// sockets in front of and behind the SNMP socket in the chain
+
+	assert(udp_socket_bind(sockets, p1) == 0);
+	ipv4_init();
+	assert(udp_socket_bind(sockets + 1, p2) == 0);
+
+	udp_socket_t * snmp = udp_socket_lookup(161);
+	assert(snmp != NULL);
+
+	ipv4_init();
+	ipv4_init();
+
+	assert(udp_socket_lookup(161) == snmp);
+	assert(udp_socket_lookup(p1) == sockets);
+	assert(udp_socket_lookup(p2) == sockets + 1);
+
+	int n = 0;
+	udp_socket_t * s;
+
+	for (s = udp_hash[UDP_HASH(161)]; s != NULL; s = s->next)
+	{
+		assert(++n <= 3);
+	}
+
+	assert(n == 3);
+
+	udp_socket_unbind(sockets);
+	udp_socket_unbind(sockets + 1);
+
+	printf("ipv4_init() again: SNMP socket bound once, the other sockets of its chain kept\n");
+}
+
+
+// DHCP, SNMP, DCS, NTP, CCS and 7 DNS requests
+
+#define ROUNDS	1000000
+
+static void demux_benchmark (void)
+{
+	static const int fixed[] = { 68, 30051, 123, 30062 };  // SNMP is bound by ipv4_init()
+	int i, k;
+
+	udp_socket_ports[3] = 30051;
+	udp_socket_ports[4] = 123;
+	udp_socket_ports[5] = 30062;
+
+	for (i=0; i < 4; i++)
+	{
+		udp_socket_init(sockets + i, input, i, 0);
+		assert(udp_socket_bind(sockets + i, fixed[i]) == 0);
+	}
+
+	for (i=0; i < DNS_NUMBER_OF_ENTRIES; i++)
+	{
+		int p = udp_bind_new_srcport(sockets + 4 + i);
+
+		dc[i].udp_local_port = p;
+		dc[i].state = DNS_STATE_REQ_A;
+		dc[i].reqname_len = 10;
+	}
+
+	static const struct { const char * name; int port; } t[] =
+	{
+		{ "DHCP (first)", 68 },
+		{ "CCS (last array)", 30062 },
+		{ "DNS (last)", 0 },
+		{ "no socket", 9999 }
+	};
+
+	for (k=0; k < (sizeof t / sizeof t[0]); k++)
+	{
+		volatile int port = (t[k].port != 0) ? t[k].port : dc[DNS_NUMBER_OF_ENTRIES - 1].udp_local_port;
+		int found = 0;
+
+		assert((ref_udp_demux(port) >= 0) == (udp_socket_lookup(port) != NULL));
+
+		uint64_t c0 = host_cycles();
+		uint64_t t0 = host_nsec();
+
+		for (i=0; i < ROUNDS; i++)
+		{
+			found += (ref_udp_demux(port) >= 0);
+		}
+
+		double ns_old = (double) (host_nsec() - t0) / ROUNDS;
+		double c_old = (double) (host_cycles() - c0) / ROUNDS;
+
+		c0 = host_cycles();
+		t0 = host_nsec();
+
+		for (i=0; i < ROUNDS; i++)
+		{
+			found += (udp_socket_lookup(port) != NULL);
+		}
+
+		double ns_new = (double) (host_nsec() - t0) / ROUNDS;
+		double c_new = (double) (host_cycles() - c0) / ROUNDS;
+
+		host_sink += found;
+
+		printf("%-17s old %5.1f ns, %5.1f cycles; hash %5.1f ns, %5.1f cycles\n",
+			t[k].name, ns_old, c_old, ns_new, c_new);
+	}
+
+	int longest = 0;
+
+	for (i=0; i < UDP_HASH_SIZE; i++)
+	{
+		udp_socket_t * s;
+		int n = 0;
+
+		for (s = udp_hash[i]; s != NULL; s = s->next)
+		{
+			n ++;
+		}
+
+		if (n > longest)
+		{
+			longest = n;
+		}
+	}
+
+	printf("12 sockets, longest chain %d\n", longest);
+}
+
+
+int main (void)
+{
+	bind_unbind();
+	queue();
+	link_loss();
+	demux_benchmark();
+
+	printf("all ok\n");
+	return 0;
+}
@@ -0,0 +1,420 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dstar_replay.c
+ *
+ * Replays a capture of received D-STAR traffic (capture.c) through the
+ * receive path of dstar.c: every record goes to the rx_q_input function
+ * that recorded it, at its recorded arrival time, and rx_q_process()
+ * runs every 20ms like in the AMBE task. Runs in real time, faster or
+ * as fast as possible. Prints the frames played and the jitter buffer
+ * statistics of every transmission.
+ *
+ * Also writes synthetic captures (network stream with arrival jitter
+ * and packet loss) as input for jitter buffer changes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ctype.h>
+
+#include "up_dstar/dstar.c"
+
+void host_dstar_settings (void);
+
+#define MAX_RECORD_LEN	(CAPTURE_RECORD_HDRLEN + 39)
+
+static uint8_t * cap;
+static long cap_len;
+
+static int verbose;
+
+static int record_len (const uint8_t * r)
+{
+	static const uint8_t payload[5] = { 0, 39, 9, 3, 0 };
+	int type = r[0] >> 4;
+
+	if ((type < CAPTURE_HEADER) || (type > CAPTURE_STOP))
+		return -1;
+
+	return CAPTURE_RECORD_HDRLEN + payload[type];
+}
+
+static unsigned long record_tick (const uint8_t * r)
+{
+	return (((unsigned long) r[4]) << 24) | (r[5] << 16) | (r[6] << 8) | r[7];
+}
+
+static void read_capture (const char * fname, int hex)
+{
+	FILE * f = fopen(fname, "rb");
+	long size = 0;
+
+	if (f == NULL)
+	{
+		perror(fname);
+		exit(1);
+	}
+
+	cap = malloc(1 << 20);
+	cap_len = 0;
+
+	if (hex)  // every word of two hex digits is a byte (snmpget -Ox output)
+	{
+		char word[3];
+		int c, len = 0;
+
+		while ((c = getc(f)) != EOF)
+		{
+			if (isspace(c) || (c == '"'))
+			{
+				if ((len == 2) && isxdigit(word[0]) && isxdigit(word[1]) && (cap_len < (1 << 20)))
+				{
+					word[2] = 0;
+					cap[cap_len++] = strtol(word, NULL, 16);
+				}
+
+				len = 0;
+			}
+			else if (len < 3)
+			{
+				word[len++] = c;
+			}
+		}
+	}
+	else
+	{
+		while ((size = fread(cap + cap_len, 1, (1 << 20) - cap_len, f)) > 0)
+		{
+			cap_len += size;
+		}
+	}
+
+	fclose(f);
+}
+
+// statistics of the transmissions, printed when a stream ends
+
+static uint8_t was_active[RX_NUM_STREAMS];
+static uint32_t frames_played[RX_NUM_STREAMS + 1];
+static uint32_t frames_concealed;
+
+static const char * source_name (int source)
+{
+	return (source == SOURCE_PHY) ? "PHY" : "NET";
+}
+
+static void check_streams (void)
+{
+	int i;
+
+	for (i=0; i < RX_NUM_STREAMS; i++)
+	{
+		struct rx_stream * s = rx_streams + i;
+
+		if (was_active[i] && (s->active == 0))
+		{
+			struct jitter_q_stats * st = &s->q->stats;
+
+			printf("%8lu %s end of session %04x: %lu ms, received %u played %u late %u lost %u"
+				" duplicate %u underrun %u slip %u, mean latency %d ms, jitter %d us\n",
+				host_ticks, source_name(s->source), s->session, host_ticks - s->start_tick,
+				st->received, st->played, st->late, st->lost, st->duplicate, st->underrun,
+				st->slip, jitter_q_mean_latency_ms(s->q), jitter_q_jitter_usec(s->q));
+		}
+		else if ((was_active[i] == 0) && s->active)
+		{
+			printf("%8lu %s start of session %04x\n", host_ticks, source_name(s->source), s->session);
+		}
+
+		was_active[i] = s->active;
+	}
+}
+
+static void input_record (const uint8_t * r)
+{
+	uint8_t source = r[0] & 0x0F;
+	uint16_t session = (r[2] << 8) | r[3];
+
+	if ((source != SOURCE_PHY) && (source != SOURCE_NET))
+		return;
+
+	switch (r[0] >> 4)
+	{
+		case CAPTURE_HEADER:
+			rx_q_input_header(source, session, r[1], r + CAPTURE_RECORD_HDRLEN);
+			break;
+		case CAPTURE_VOICE:
+			rx_q_input_voice(source, session, r[1], r + CAPTURE_RECORD_HDRLEN);
+			break;
+		case CAPTURE_DATA:
+			rx_q_input_data(source, session, r[1], r + CAPTURE_RECORD_HDRLEN);
+			break;
+		case CAPTURE_STOP:
+			rx_q_input_stop(source, session, r[1]);
+			break;
+	}
+}
+
+static void replay (double speed)
+{
+	long ptr = 0;
+	unsigned long next_process;
+	int idle = 0;
+	int tail = 0;
+
+	if (cap_len < CAPTURE_RECORD_HDRLEN)
+		return;
+
+	host_ticks = record_tick(cap);
+	next_process = host_ticks;
+
+	// until 2 seconds without a stream after the last record, a stream
+	// that still waits for its pre-buffering is given up after a minute
+
+	while ((idle < 100) && (tail < 3000))
+	{
+		if ((ptr < cap_len) && (record_tick(cap + ptr) < next_process))
+		{
+			int len = record_len(cap + ptr);
+
+			if ((len < 0) || ((ptr + len) > cap_len))
+			{
+				fprintf(stderr, "bad record at offset %ld\n", ptr);
+				ptr = cap_len;
+				continue;
+			}
+
+			if (record_tick(cap + ptr) > host_ticks)
+			{
+				host_ticks = record_tick(cap + ptr);
+			}
+
+			input_record(cap + ptr);
+			ptr += len;
+		}
+		else
+		{
+			uint8_t pos, data[3], voice[AMBE_Q_DATASIZE];
+			int res;
+
+			host_ticks = next_process;
+			next_process += 20;
+
+			res = rx_q_process(&pos, data, voice);
+
+			if (res != 0)  // a missing frame is played as the LFI frame
+			{
+				int missing = (memcmp(voice, ambe_lfi_indicator, AMBE_Q_DATASIZE) == 0);
+
+				if (missing)
+				{
+					frames_concealed ++;
+				}
+				else
+				{
+					frames_played[res] ++;
+				}
+
+				if (verbose)
+				{
+					printf("%8lu %s %2d %s\n", host_ticks, source_name(res), pos,
+						missing ? "missing" : "voice");
+				}
+			}
+
+			idle = ((ptr >= cap_len) && (current_source == 0)) ? idle + 1 : 0;
+			tail = (ptr >= cap_len) ? tail + 1 : 0;
+
+			if (speed > 0)
+			{
+				usleep(20000 / speed);
+			}
+		}
+
+		check_streams();
+	}
+
+	if (current_source != 0)
+	{
+		printf("%8lu %s stream has not ended\n", host_ticks, source_name(current_source));
+	}
+
+	printf("played PHY %u NET %u, concealed %u\n", frames_played[SOURCE_PHY],
+		frames_played[SOURCE_NET], frames_concealed);
+	printf("arbitration: preempted %u, secondary streams %u, secondary frames %u, session drops %u\n",
+		rx_arb_stats.preempted, rx_arb_stats.secondary_streams, rx_arb_stats.secondary_frames,
+		rx_arb_stats.session_drop);
+}
+
+// synthetic network stream: 20ms frames, uniform arrival jitter, random loss
+
+struct gen_record
+{
+	unsigned long tick;
+	uint8_t r[MAX_RECORD_LEN];
+	int len;
+};
+
+static void gen_put (struct gen_record * g, int type, uint8_t pos, unsigned long tick, const uint8_t * payload, int len)
+{
+	g->tick = tick;
+	g->r[0] = (type << 4) | SOURCE_NET;
+	g->r[1] = pos;
+	g->r[2] = 0x12;
+	g->r[3] = 0x34;
+	g->r[4] = tick >> 24;
+	g->r[5] = tick >> 16;
+	g->r[6] = tick >> 8;
+	g->r[7] = tick;
+	memcpy(g->r + CAPTURE_RECORD_HDRLEN, payload, len);
+	g->len = CAPTURE_RECORD_HDRLEN + len;
+}
+
+static int gen_cmp (const void * a, const void * b)
+{
+	const struct gen_record * x = a;
+	const struct gen_record * y = b;
+
+	return (x->tick > y->tick) - (x->tick < y->tick);
+}
+
+static void generate (const char * fname, int frames, int jitter_ms, double loss)
+{
+	struct gen_record * g = calloc(2 * frames + 2, sizeof (struct gen_record));
+	uint8_t header[39], voice[AMBE_Q_DATASIZE], data[3] = { 0x16, 0x29, 0xf5 };
+	int i, n = 0;
+	FILE * f;
+
+	memset(header, ' ', sizeof header);
+	memset(voice, 0, sizeof voice);
+
+	gen_put(g + n++, CAPTURE_HEADER, 0, 1000, header, 39);
+
+	for (i=0; i <= frames; i++)
+	{
+		unsigned long tick = 1000 + 20 * i + (jitter_ms ? (rand() % (jitter_ms + 1)) : 0);
+		uint8_t pos = i % NUM_PACKETS_IN_FRAME;
+
+		if ((rand() / (RAND_MAX + 1.0)) < loss)
+			continue;
+
+		if (i == frames)
+		{
+			gen_put(g + n++, CAPTURE_STOP, pos, tick, NULL, 0);
+			break;
+		}
+
+		voice[0] = i >> 8;
+		voice[1] = i;
+		gen_put(g + n++, CAPTURE_VOICE, pos, tick, voice, AMBE_Q_DATASIZE);
+		gen_put(g + n++, CAPTURE_DATA, pos, tick, data, 3);
+	}
+
+	qsort(g, n, sizeof (struct gen_record), gen_cmp);
+
+	f = fopen(fname, "wb");
+
+	if (f == NULL)
+	{
+		perror(fname);
+		exit(1);
+	}
+
+	for (i=0; i < n; i++)
+	{
+		fwrite(g[i].r, 1, g[i].len, f);
+	}
+
+	fclose(f);
+	free(g);
+}
+
+static void usage (void)
+{
+	fprintf(stderr,
+		"usage: dstar_replay [-x] [-s speed] [-a] [-j min,max] [-v] capture\n"
+		"       dstar_replay -g capture [-n frames] [-J jitter_ms] [-L loss_percent] [-r seed]\n"
+		"  -x  capture is hex text (snmpget -Ox of the capture data OID)\n"
+		"  -s  1 = real time (default), 10 = ten times faster, 0 = as fast as possible\n"
+		"  -a  local RF first arbitration (default: first come)\n"
+		"  -j  jitter buffer depth in frames (default 2,42)\n"
+		"  -v  print every frame played\n"
+		"  -g  write a synthetic network stream\n");
+	exit(1);
+}
+
+int main (int argc, char ** argv)
+{
+	int c, hex = 0, frames = 1500, jitter_ms = 60;
+	int min_depth = -1, max_depth = -1, arbitration = 0;
+	double speed = 1, loss = 0.01;
+	const char * gen_file = NULL;
+
+	while ((c = getopt(argc, argv, "xs:aj:vg:n:J:L:r:")) != -1)
+	{
+		switch (c)
+		{
+			case 'x': hex = 1; break;
+			case 's': speed = atof(optarg); break;
+			case 'a': arbitration = 1; break;
+			case 'j':
+				if (sscanf(optarg, "%d,%d", &min_depth, &max_depth) != 2)
+					usage();
+				break;
+			case 'v': verbose = 1; break;
+			case 'g': gen_file = optarg; break;
+			case 'n': frames = atoi(optarg); break;
+			case 'J': jitter_ms = atoi(optarg); break;
+			case 'L': loss = atof(optarg) / 100; break;
+			case 'r': srand(atoi(optarg)); break;
+			default: usage();
+		}
+	}
+
+	if (gen_file != NULL)
+	{
+		generate(gen_file, frames, jitter_ms, loss);
+		return 0;
+	}
+
+	if (optind != (argc - 1))
+		usage();
+
+	read_capture(argv[optind], hex);
+
+	host_dstar_settings();
+
+	if (min_depth >= 0)
+	{
+		SETTING_CHAR(C_RX_JB_MIN_DEPTH) = min_depth;
+		SETTING_CHAR(C_RX_JB_MAX_DEPTH) = max_depth;
+	}
+
+	SETTING_CHAR(C_RX_ARBITRATION) = arbitration;
+
+	dstarInit(NULL);
+
+	replay(speed);
+
+	return 0;
+}
@@ -75,6 +75,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "up_app/a_lib.h"
 #include "up_app/a_lib_internal.h"
 #include "up_io/sdcard.h"
+#include "up_dstar/lastheard.h"
 
 #include "up_crypto/up_crypto_init.h"
 #include "up_net/dns2.h"
@@ -109,6 +110,27 @@ int snmp_get_voltage(int32_t arg, uint8_t * res, int * res_len, int maxlen)
 	return snmp_encode_int( voltage, res, res_len, maxlen );
 }
 
+int snmp_get_audio_q_stats(int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	audio_q_t * a = ((arg & 0x10) != 0) ? & audio_rx_q : & audio_tx_q;
+	
+	switch (arg & 0x0F)
+	{
+		case 1:
+			value = audio_q_drift_ppm(a);
+			break;
+		case 2:
+			value = a->underruns;
+			break;
+		case 3:
+			value = a->overruns;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
 
 static uint8_t remote_button_pressed;
 static uint8_t remote_button_screen;
@@ -798,6 +820,8 @@ static void vServiceTask( void *pvParameters )
 		
 		ntp_service();
 		
+		lastheard_service();
+		
 		/*
 		if (update)
 		{
@@ -902,9 +926,17 @@ static void vRXTXEthTask( void *pvParameters )
 	while (1)
 	{
 	//	debug1 ++;
-		eth_rx(); // receive packets
+		int more = eth_rx(ETH_RX_BUDGET); // receive packets
 		eth_txmem_flush_q();  // send frames in Q
-		vTaskDelay(1);
+		
+		if (more)
+		{
+			taskYIELD();  // let the other tasks run before the next batch
+		}
+		else
+		{
+			eth_wait(ETH_IDLE_TIMEOUT);
+		}
 	}		
 }
 
@@ -1259,7 +1291,7 @@ int main (void)
 
 	gps_init( externalComPort );
 	
-	// sdcard_init(& audio_tx_q);
+	sdcard_init();
 	
 	
 	crypto_init(& microphone);
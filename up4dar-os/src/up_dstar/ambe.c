@@ -41,8 +41,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "up_dstar/audio_q.h"
 #include "up_dstar/ambe_q.h"
+#include "up_dstar/ambe_plc.h"
+#include "up_dstar/audio_meter.h"
 #include "settings.h"
 #include "up_io/serial2.h"
+#include "up_io/pdca_dbuf.h"
 #include "fixpoint_math.h"
 
 
@@ -54,6 +57,10 @@ static uint32_t out_buf2[BUF_SIZE];
 static uint32_t in_buf1[BUF_SIZE];
 static uint32_t in_buf2[BUF_SIZE];
 
+static pdca_dbuf_t spi_tx;
+static pdca_dbuf_t spi_rx;
+static xSemaphoreHandle spi_sem;
+
 // static unsigned short * sound_buf;
 
 #define SOUND_BUF_SIZE 160
@@ -70,16 +77,6 @@ static audio_q_t * audio_input_q;
 static ambe_q_t ambe_output_q;
 static ambe_q_t * ambe_input_q;
 
-// our special LFI indicator:  {0x9E, 0x8D, 0x36, 0x98, 0x66, 0x1E, 0x3F, 0x23, 0xE4}
-static const uint8_t ambe_lfi_data_sd[36] = 
-  {0xF0, 0x0F, 0xFF, 0xF0, 0xF0, 0x00, 0xFF, 0x0F,
-	  0x00, 0xFF,
-	  0x0F, 0xF0, 0xF0, 0x0F, 0xF0, 0x00, 0x0F, 0xF0,
-	  0x0F, 0xF0, 0x00, 0x0F, 0xFF, 0xF0, 0x00, 0xFF,
-	  0xFF, 0xFF,
-	  0x00, 0xF0, 0x00, 0xFF, 0xFF, 0xF0, 0x0F, 0x00};  // SD version of LFI indicator
-	  
-
 static unsigned short int chan_tx_data[60] =
   {
 	0x13ec,
@@ -165,6 +162,10 @@ static int chan_tx_state = 0;
 static int16_t abuf[AUDIO_Q_TRANSFERLEN];
 static int16_t abuf_ptr;
 
+// time stamps of the last frame given to the decoder,
+// they go with the next block of decoded audio
+static struct latency_tag decoder_tag;
+
 static int16_t encbuf[AUDIO_Q_TRANSFERLEN];
 
 
@@ -325,6 +326,8 @@ static void put_sound_data( unsigned short d )
 		
 		chan_tx_state = 1; // send new request to AMBE
 		
+		ambe_plc_next_frame();
+		
 		counter ++;
 		
 		// vdisp_i2s(buf, 8, 10, 0, counter);
@@ -345,6 +348,68 @@ static void put_sound_data( unsigned short d )
 }
 
 
+static char audio_meter_max_value = 99;
+static char audio_meter_hold_timer = 0;
+
+static void show_audio_meter (audio_meter_t * m)
+{
+	int i;
+	
+	unsigned int v = (unsigned int) (-1 * m->rms);
+	
+	v /= 100;
+	
+	if (v < audio_meter_max_value)
+	{
+		
+		audio_meter_max_value = v;
+		audio_meter_hold_timer = 50;
+	}
+	
+	char buf[4];
+	vdisp_i2s(buf+1, 2, 10, 1, audio_meter_max_value);
+	buf[0] = '-';
+	vd_prints_xy(VDISP_AUDIO_LAYER, 69, 25, VDISP_FONT_6x8, m->clipped, buf);
+	
+	for (i=0; i < 104; i+=8)
+	{
+		int j;
+		int tmp_byte = 0;
+		
+		#define BIT7SET 0x80
+		
+		for (j=0; j < 8; j++)
+		{
+			int pixel = ((i+j) > v) ? BIT7SET : 0;
+			
+			if ((i+j) == audio_meter_max_value)
+			{
+				pixel = BIT7SET;
+			}
+			
+			tmp_byte = (tmp_byte >> 1) | pixel;
+		}
+		
+		#undef BIT7SET
+		
+		vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 36, 0, tmp_byte, 8);
+		vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 37, 0, tmp_byte, 8);
+		vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 38, 0, tmp_byte, 8);
+	}
+	
+	if (audio_meter_hold_timer > 0)
+	{
+		audio_meter_hold_timer --;
+	}
+	
+	if (audio_meter_hold_timer == 0)
+	{
+		audio_meter_max_value = 99;
+		m->clipped = 0;
+	}
+}
+
+
 static portTASK_FUNCTION( ambeTask, pvParameters )
 {
 	gpio_set_pin_low(AVR32_PIN_PB20); // RESETN
@@ -386,15 +451,11 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 		in_buf2[i] = 0;
 	}
 	
-	AVR32_PDCA.channel[0].mr = AVR32_PDCA_WORD; // 32 bit transfer
-	AVR32_PDCA.channel[0].psr = AVR32_PDCA_PID_SPI0_TX; // select peripherial
-	AVR32_PDCA.channel[0].mar = (unsigned long) out_buf1;
-	AVR32_PDCA.channel[0].tcr = BUF_SIZE ; 
-	
-	AVR32_PDCA.channel[1].mr = AVR32_PDCA_WORD; // 32 bit transfer
-	AVR32_PDCA.channel[1].psr = AVR32_PDCA_PID_SPI0_RX; // select peripherial
-	AVR32_PDCA.channel[1].mar = (unsigned long) in_buf1;
-	AVR32_PDCA.channel[1].tcr = BUF_SIZE ; 
+	// 32 bit transfers
+	pdca_dbuf_init( &spi_tx, 0, AVR32_PDCA_PID_SPI0_TX, AVR32_PDCA_WORD,
+		out_buf1, out_buf2, BUF_SIZE, spi_sem );
+	pdca_dbuf_init( &spi_rx, 1, AVR32_PDCA_PID_SPI0_RX, AVR32_PDCA_WORD,
+		in_buf1, in_buf2, BUF_SIZE, spi_sem );
 	
 	vTaskDelay(1);
 	gpio_set_pin_high(AVR32_PIN_PB20);
@@ -402,51 +463,20 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 
 	vTaskDelay(100);
 	
-	AVR32_PDCA.channel[1].cr = 1; // rx enable
-	AVR32_PDCA.channel[0].cr = 1; // tx enable
-	
-	
-	char buf_ready_rx = 1;
-	char buf_ready_tx = 1;
+	pdca_dbuf_start( &spi_rx );
+	pdca_dbuf_start( &spi_tx );
 	
 
-	int audio_meter_sample_counter = 0;
-#define AUDIO_METER_NUM_SAMPLES 160
-	
-	int audio_meter_square_sum = 0;
-	
-	char audio_meter_max_value = 0;
-	char audio_meter_hold_timer = 0;
-
-	char audio_clip = 0;
-
 	for( ;; )
 	{
-		vTaskDelay(1);
+		uint32_t * b;
 		
-		if ( (AVR32_PDCA.channel[0].tcrr == 0)
-			&& (AVR32_PDCA.channel[0].tcr < BUF_SIZE))
+		xSemaphoreTake( spi_sem, 100 ); // woken up by the PDCA interrupt
+		
+		b = (uint32_t *) pdca_dbuf_get( &spi_tx );  // buffer that has to be filled
+		
+		if (b != NULL)
 		{
-			switch (buf_ready_tx)
-			{
-				case 1:
-					AVR32_PDCA.channel[0].marr = (unsigned long) out_buf2;
-					buf_ready_tx = 2;
-					break;
-				case 2:
-					AVR32_PDCA.channel[0].marr = (unsigned long) out_buf1;
-					buf_ready_tx = 1;
-					break;
-			}
-			AVR32_PDCA.channel[0].tcrr = BUF_SIZE;
-			
-			uint32_t * b = out_buf1;
-			
-			if (buf_ready_tx == 2)
-			{
-				b = out_buf2;
-			}
-			
 			for (i=2; i < BUF_SIZE; i+=4)  // CHAN part of the buffer
 			{
 				switch (chan_tx_state)
@@ -493,83 +523,15 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 			
 			audio_q_get (audio_input_q, encbuf);
 			
+			if (audio_meter_block( audio_meter + AUDIO_METER_MIC, encbuf, AUDIO_Q_TRANSFERLEN ) != 0)
+			{
+				show_audio_meter( audio_meter + AUDIO_METER_MIC );
+			}
+			
 			for (i=0; i < BUF_SIZE; i+=4)  // CODEC part of the buffer
 			{
 				short sample = encbuf[ (i >> 2) ];
 				
-			
-				audio_meter_square_sum += (sample*sample) >> 7;
-				
-				audio_meter_sample_counter++;
-				
-				if (audio_meter_sample_counter >= AUDIO_METER_NUM_SAMPLES)
-				{
-					audio_meter_sample_counter = 0;
-					
-					//char buf[5];
-					
-					unsigned int v = (unsigned int) (-1 * fixpoint_milliBel( audio_meter_square_sum));
-					
-					//vdisp_i2s(buf, 4, 10, 1, v);
-					//vdisp_prints_xy(0, 32, VDISP_FONT_6x8, 0, buf);
-					//serial_puts(0, buf);
-					//serial_puts(0, "\n");
-					
-					v /= 100;
-					
-					if (v < audio_meter_max_value)
-					{
-						
-						audio_meter_max_value = v;
-						audio_meter_hold_timer = 50;
-					}
-					
-					char buf[4];
-					vdisp_i2s(buf+1, 2, 10, 1, audio_meter_max_value);
-					buf[0] = '-';
-					vd_prints_xy(VDISP_AUDIO_LAYER, 69, 25, VDISP_FONT_6x8, audio_clip, buf);
-					
-					for (i=0; i < 104; i+=8)
-					{
-						int j;
-						int tmp_byte = 0;
-						
-						#define BIT7SET 0x80
-						
-						for (j=0; j < 8; j++)
-						{
-							int pixel = ((i+j) > v) ? BIT7SET : 0;
-							
-							if ((i+j) == audio_meter_max_value)
-							{
-								pixel = BIT7SET;
-							}
-							
-							tmp_byte = (tmp_byte >> 1) | pixel;
-						}
-						
-						#undef BIT7SET
-						
-						vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 36, 0, tmp_byte, 8);
-						vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 37, 0, tmp_byte, 8);
-						vd_set_pixel(VDISP_AUDIO_LAYER, 105-i, 38, 0, tmp_byte, 8);
-					}
-					
-					if (audio_meter_hold_timer > 0)
-					{
-						audio_meter_hold_timer --;
-					}
-					
-					if (audio_meter_hold_timer == 0)
-					{
-						audio_meter_max_value = 99;
-						audio_clip = 0;
-					}
-					
-					audio_meter_square_sum = 0;
-				}
-
-
 				/*
 				if (sample > 3276)
 				{
@@ -585,15 +547,13 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 				b[i] = AMBE_CS_CODEC | ((unsigned short ) (sample * 10)); // x10 = 20dB Gain
 				*/
 				
-				if (sample > 8191)
+				if (sample > 8191)  // counted by the meter
 				{
 					sample = 8191;
-					audio_clip = 1;
 				}
 				else if (sample < -8191)
 				{
 					sample = -8191;
-					audio_clip = 1;
 				}
 				
 				b[i] = AMBE_CS_CODEC | ((unsigned short ) (sample * 4)); // x4 = 12dB Gain
@@ -625,13 +585,40 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 					else
 					{
 												
-						if (ambe_q_get_sd (& ambe_output_q, (uint8_t *) (chan_tx_data + 12)) == 0)
+						int frame_state = AMBE_PLC_FRAME_IDLE;
+						uint8_t ambe_frame[AMBE_Q_DATASIZE];
+						struct latency_tag frame_tag;
+						
+						if (ambe_q_get_tag (& ambe_output_q, ambe_frame, &frame_tag) == 0)
 						{
+#if LATENCY_STAMPS
+							if (frame_tag.ingress != 0)
+							{
+								latency_stage(&frame_tag, LATENCY_AMBE_Q);
+								decoder_tag = frame_tag;
+							}
+#endif
+							
 							 // if buffer not empty set silence_counter
 							silence_counter = 10;  // output audio for another 10 * AUDIO_Q_TRANSFERLEN samples
 													// after queue is empty
+													
+							if (memcmp(ambe_frame, ambe_lfi_indicator, AMBE_Q_DATASIZE) == 0)
+							{
+								frame_state = AMBE_PLC_FRAME_LOST;
+							}
+							else
+							{
+								frame_state = AMBE_PLC_FRAME_OK;
+							}
 						}
 						
+						ambe_plc_process(ambe_frame, frame_state);
+						
+						// the queue holds packed frames, the chip gets the SD format
+						// with the soft decision values of the PHY where available
+						ambe_sd_hold_get((uint8_t *) (chan_tx_data + 12), ambe_frame);
+						
 						if (silence_counter == 0) // no AMBE data received for some time
 						{
 							chan_tx_data[11] = 0x800b; // decoder,  do not set rate again, enable standard sleep mode
@@ -641,43 +628,17 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 							chan_tx_data[11] = 0x8003; // decoder,  do not set rate again							
 						}							
 						
-						if (memcmp((chan_tx_data + 12), ambe_lfi_data_sd, sizeof ambe_lfi_data_sd) == 0)
-						{
-							chan_tx_data[1] = 0x0080; // set lost frame indicator bit
-						}
-						else
-						{
-							chan_tx_data[1] = 0x0000; // clear lost frame indicator bit
-						}							
+						chan_tx_data[1] = 0x0000; // lost frames are concealed by ambe_plc, LFI bit not used
 					}
 					
 					break;
 			}
 		}
 		
-		if ( (AVR32_PDCA.channel[1].tcrr == 0)
-			&& (AVR32_PDCA.channel[1].tcr < BUF_SIZE))
+		b = (uint32_t *) pdca_dbuf_get( &spi_rx );  // buffer that has been received
+		
+		if (b != NULL)
 		{
-			switch (buf_ready_rx)
-			{
-				case 1:
-					AVR32_PDCA.channel[1].marr = (unsigned long) in_buf2;
-					buf_ready_rx = 2;
-					break;
-				case 2:
-					AVR32_PDCA.channel[1].marr = (unsigned long) in_buf1;
-					buf_ready_rx = 1;
-					break;
-			}
-			AVR32_PDCA.channel[1].tcrr = BUF_SIZE;
-			
-			uint32_t * b = in_buf1;
-			
-			if (buf_ready_rx == 2)
-			{
-				b = in_buf2;
-			}
-			
 			for (i=0; i < BUF_SIZE; i++)
 			{
 				if ((b[i] & 0x000F0000) == AMBE_CS_CODEC)
@@ -690,13 +651,17 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 					{
 						abuf_ptr = 0;
 						
+						LATENCY_STAGE(&decoder_tag, LATENCY_DECODER);
+						
 						if (silence_counter > 0)
 						{
 							silence_counter --;
 							
 							if (automute == 0)
 							{
-								audio_q_put( audio_output_q, abuf );
+								ambe_plc_apply_gain( abuf, AUDIO_Q_TRANSFERLEN );
+								audio_meter_block( audio_meter + AUDIO_METER_SPKR, abuf, AUDIO_Q_TRANSFERLEN );
+								audio_q_put_tag( audio_output_q, abuf, &decoder_tag );
 								
 								if (silence_counter == 0)
 								{
@@ -711,7 +676,9 @@ static portTASK_FUNCTION( ambeTask, pvParameters )
 							{  // automute running, extend mute if silence_counter > 0
 								automute = AUTOMUTE_VALUE;
 							}
-						}													
+						}
+						
+						LATENCY_CLEAR(&decoder_tag);  // only the first block after the frame
 					}
 				}
 				else if ((b[i] & 0x000F0000) == AMBE_CS_CHAN)
@@ -789,15 +756,9 @@ void ambe_stop_encode(void)
 
 
 
-void ambe_input_data( const uint8_t * d)
-{
-	ambe_q_put ( & ambe_output_q, d );
-}
-
-void ambe_input_data_sd( const uint8_t * d)
+int ambe_input_data( const uint8_t * d, const struct latency_tag * tag)
 {
-	ambe_q_put_sd ( & ambe_output_q, d );
-	// ambe_output_q.state = 1; // "fast" option
+	return ambe_q_put_tag ( & ambe_output_q, d, tag );
 }
 
 void ambe_init( audio_q_t * decoded_audio, audio_q_t * input_audio,
@@ -811,10 +772,15 @@ void ambe_init( audio_q_t * decoded_audio, audio_q_t * input_audio,
 	
 	ambe_q_initialize( & ambe_output_q );
 	
+	audio_meter_init( audio_meter + AUDIO_METER_MIC, 8192 );  // clipped before the 12dB gain
+	audio_meter_init( audio_meter + AUDIO_METER_SPKR, 32767 );
+	
 	ambe_input_q = microphone;
 	
 	ambe_encode = 0;
 	
+	vSemaphoreCreateBinary( spi_sem );
+	
 	xTaskCreate( ambeTask, ( signed char * ) "AMBE", configMINIMAL_STACK_SIZE, NULL,
 		 tskIDLE_PRIORITY + 2 , ( xTaskHandle * ) NULL );
 
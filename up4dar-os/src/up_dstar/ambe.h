@@ -36,8 +36,8 @@ void ambe_start_encode(void);
 void ambe_stop_encode(void);
 
 
-void ambe_input_data( const uint8_t * d);
-void ambe_input_data_sd( const uint8_t * d);
+// returns 0 if the frame was put into the decoder queue
+int ambe_input_data( const uint8_t * d, const struct latency_tag * tag);
 void ambe_init( audio_q_t * decoded_audio, audio_q_t * input_audio, ambe_q_t * microphone );
 void ambe_set_automute(int enable);
 void ambe_set_autoaprs(int enable);
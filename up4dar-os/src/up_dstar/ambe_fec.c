@@ -231,55 +231,63 @@ static const uint32_t decoding_table[2048] = {
 };
 
 
-static uint32_t calc_q( uint32_t p )
+// x^i mod g(x) for every bit of a Golay(23,12) codeword, g(x) = 0xC75.
+// The syndrome is the XOR of the entries of all set bits, so it is
+// calculated in constant time without the polynomial division.
+
+static const uint16_t syndrome_table[23] =
 {
-	uint32_t q = (1 << 22);
-	    
-	if (p >= (1 << 11))
+	0x001, 0x002, 0x004, 0x008, 0x010, 0x020, 0x040, 0x080,
+	0x100, 0x200, 0x400, 0x475, 0x49f, 0x54b, 0x6e3, 0x1b3,
+	0x366, 0x6cc, 0x1ed, 0x3da, 0x7b4, 0x31d, 0x63a
+};
+
+
+static uint32_t golay_syndrome( uint32_t block )
+{
+	uint32_t syndrome = 0;
+	int i;
+	
+	for (i=0; i < 23; i++)
 	{
-		while ((p & 0xfffff800) != 0)
-		{
-			while ((q & p) == 0)
-			{
-				q = q >> 1;
-			}
-			
-			p ^= (q/(1 << 11)) * 3189;
-		}
+		syndrome ^= syndrome_table[i] & (- ((block >> i) & 0x01));
 	}
 	
-	return p;
+	return syndrome;
+}
+
+
+static int bit_count( uint32_t v )
+{
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	v = (v + (v >> 4)) & 0x0f0f0f0f;
+	
+	return (v * 0x01010101) >> 24;
+}
+
+
+// returns the number of corrected bits
+
+static int golay2312 (uint32_t block, uint32_t * decoded)
+{
+	uint32_t error_pattern = decoding_table[golay_syndrome(block)];
+
+	*decoded = (block ^ error_pattern) >> 11;
+	
+	return bit_count(error_pattern);
 }
 
 
 static int golay2412 (uint32_t data, uint32_t * decoded)
 {
 	uint32_t block = (data >> 1) & 0x07fffff;
-	uint32_t corrected_block = block ^ decoding_table[calc_q(block)];
-
-	int errs = 0;
-	int parity_corr = 0;
-	int i;
+	uint32_t error_pattern = decoding_table[golay_syndrome(block)];
+	uint32_t corrected_block = block ^ error_pattern;
 
-	for (i = 0; i < 23; i++)
-	{
-		int mask = 1 << i;
-		
-		int bit_rcvd = block & mask;
-		int bit_corr = corrected_block & mask;
-		
-		if (bit_corr != 0)
-		{
-			parity_corr ++;
-		}
-		
-		if (bit_rcvd != bit_corr)
-		{
-			errs ++;
-		}
-	}
+	int errs = bit_count(error_pattern);
 	
-	if ((parity_corr & 0x01) != (data & 0x01))
+	if ((bit_count(corrected_block) & 0x01) != (data & 0x01))
 	{
 		errs ++;
 	}
@@ -290,9 +298,27 @@ static int golay2412 (uint32_t data, uint32_t * decoded)
 }
 
 
-int ambe_fec_decode_first_block (const uint8_t * d, uint32_t * first_block, uint32_t * last_block)
+// the second block is scrambled with a pseudo random sequence,
+// the seed is the data of the first block
+
+static uint32_t pn_sequence( uint32_t seed )
+{
+	uint32_t pr = seed << 4;
+	uint32_t mask = 0;
+	int i;
+	
+	for (i=22; i >= 0; i--)
+	{
+		pr = (173 * pr + 13849) & 0xffff;
+		mask |= (pr >> 15) << i;
+	}
+	
+	return mask;
+}
+
+
+static void ambe_fec_deinterleave (const uint8_t * d, uint32_t * bits)
 {
-	uint32_t bits[3];
 	int i;
 
 	for (i=0; i < 3; i++)
@@ -302,8 +328,16 @@ int ambe_fec_decode_first_block (const uint8_t * d, uint32_t * first_block, uint
 
 	for (i=0; i < 72; i++)
 	{
-		bits[ bit_pos1[i] ] |= (d[ i >> 3 ] & (0x80 >> (i & 0x07))) ? (1 << bit_pos2[i]) : 0;
+		bits[ bit_pos1[i] ] |= ((uint32_t) ((d[ i >> 3 ] >> (7 - (i & 0x07))) & 0x01)) << bit_pos2[i];
 	}
+}
+
+
+int ambe_fec_decode_first_block (const uint8_t * d, uint32_t * first_block, uint32_t * last_block)
+{
+	uint32_t bits[3];
+	
+	ambe_fec_deinterleave(d, bits);
 
 	*last_block = bits[2]; // without FEC
 
@@ -311,6 +345,26 @@ int ambe_fec_decode_first_block (const uint8_t * d, uint32_t * first_block, uint
 }
 
 
+int ambe_fec_decode (const uint8_t * d, uint32_t * blocks)
+{
+	uint32_t bits[3];
+	int errs;
+	
+	ambe_fec_deinterleave(d, bits);
+	
+	errs = golay2412( bits[0], blocks + 0 );
+	
+	// Golay(23,12), the lowest bit is not protected
+	uint32_t block = ((bits[1] >> 1) & 0x07fffff) ^ pn_sequence( blocks[0] );
+	
+	errs += golay2312( block, blocks + 1 );
+	
+	blocks[2] = bits[2]; // without FEC
+	
+	return errs;
+}
+
+
 static const char dtmfchar[] = " 123A456B789C*0#D";
 
 int dtmf_code_to_char (int code)
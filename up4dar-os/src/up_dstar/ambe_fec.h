@@ -29,8 +29,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define AMBE_FEC_H_
 
 
+#define AMBE_FEC_CHECKED_BITS  47   // Golay(24,12) + Golay(23,12) code bits of a frame
+
+
 int ambe_fec_decode_first_block (const uint8_t * d, uint32_t * first_block, uint32_t * last_block);
 
+// decodes both FEC blocks of a 9 byte AMBE frame, blocks[0..1] get the
+// 12 data bits, blocks[2] the unprotected bits.
+// returns the number of corrected bit errors (0..7)
+int ambe_fec_decode (const uint8_t * d, uint32_t * blocks);
+
 int dtmf_code_to_char (int code);
 int ambe_get_dtmf_code (const uint8_t * d);
 
@@ -0,0 +1,193 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_plc.c
+ *
+ * Packet loss concealment for the AMBE decoder path.
+ *
+ * A lost frame is replaced by the last good frame for up to
+ * AMBE_PLC_REPEAT_FRAMES frames. The decoded audio of the repeated
+ * frames is faded out step by step. Longer gaps are filled with
+ * AMBE silence (comfort silence).
+ *
+ * The gain of a frame has to be applied to the audio the AMBE chip
+ * returns one frame later. ambe_plc_next_frame() is called every
+ * 20ms when a new frame is requested from the chip and moves the gain
+ * values through this pipeline.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "gcc_builtin.h"
+
+#include "ambe_q.h"
+#include "ambe_plc.h"
+
+#include "up_net/snmp_data.h"
+
+
+struct ambe_plc_stats ambe_plc_stats;
+
+static uint8_t last_good[AMBE_Q_DATASIZE];
+static int have_last_good = 0;
+static int burst = 0;
+static volatile uint8_t reset_request = 0;
+
+static int gain_tx = AMBE_PLC_GAIN_UNITY;      // frame handed over to the AMBE chip
+static int gain_decode = AMBE_PLC_GAIN_UNITY;  // frame the AMBE chip is working on
+static int gain_out = AMBE_PLC_GAIN_UNITY;     // audio coming out of the AMBE chip
+static int gain_current = AMBE_PLC_GAIN_UNITY;
+
+#define GAIN_RAMP_STEP  8   // full ramp within 32 samples (4ms)
+
+static const short fade_gain[AMBE_PLC_REPEAT_FRAMES] =
+	{ 230, 181, 128, 90, 64 };   // approx. -1dB -3dB -6dB -9dB -12dB
+
+
+void ambe_plc_reset(void)
+{
+	reset_request = 1;  // the state belongs to the AMBE task, reset with the next frame
+}
+
+
+void ambe_plc_process(uint8_t * data, int frame_state)
+{
+	if (reset_request != 0)
+	{
+		reset_request = 0;
+		have_last_good = 0;
+		burst = 0;
+
+		memset(&ambe_plc_stats, 0, sizeof ambe_plc_stats);
+	}
+
+	switch (frame_state)
+	{
+		case AMBE_PLC_FRAME_OK:
+			memcpy(last_good, data, AMBE_Q_DATASIZE);
+			have_last_good = 1;
+			burst = 0;
+			gain_tx = AMBE_PLC_GAIN_UNITY;
+			ambe_plc_stats.frames ++;
+			break;
+
+		case AMBE_PLC_FRAME_LOST:
+			ambe_plc_stats.frames ++;
+			ambe_plc_stats.lost ++;
+
+			if (burst == 0)
+			{
+				ambe_plc_stats.bursts ++;
+			}
+
+			burst ++;
+
+			if (burst > ambe_plc_stats.max_burst)
+			{
+				ambe_plc_stats.max_burst = burst;
+			}
+
+			if ((have_last_good != 0) && (burst <= AMBE_PLC_REPEAT_FRAMES))
+			{
+				memcpy(data, last_good, AMBE_Q_DATASIZE);
+				gain_tx = fade_gain[burst - 1];
+				ambe_plc_stats.repeated ++;
+			}
+			else
+			{
+				memcpy(data, ambe_silence_data, AMBE_Q_DATASIZE);
+				gain_tx = 0;
+				ambe_plc_stats.muted ++;
+			}
+			break;
+
+		default: // AMBE_PLC_FRAME_IDLE, queue was empty
+			gain_tx = AMBE_PLC_GAIN_UNITY;
+			break;
+	}
+}
+
+
+void ambe_plc_next_frame(void)
+{
+	gain_out = gain_decode;
+	gain_decode = gain_tx;
+}
+
+
+void ambe_plc_apply_gain(int16_t * samples, int num_samples)
+{
+	int i;
+
+	if ((gain_current == AMBE_PLC_GAIN_UNITY) && (gain_out == AMBE_PLC_GAIN_UNITY))
+	{
+		return;
+	}
+
+	for (i=0; i < num_samples; i++)
+	{
+		if (gain_current < (gain_out - GAIN_RAMP_STEP))
+		{
+			gain_current += GAIN_RAMP_STEP;
+		}
+		else if (gain_current > (gain_out + GAIN_RAMP_STEP))
+		{
+			gain_current -= GAIN_RAMP_STEP;
+		}
+		else
+		{
+			gain_current = gain_out;
+		}
+
+		samples[i] = (samples[i] * gain_current) >> 8;
+	}
+}
+
+
+int snmp_get_plc_stats ( int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+
+	switch (arg)
+	{
+		case 1:
+			value = ambe_plc_stats.frames;
+			break;
+		case 2:
+			value = ambe_plc_stats.lost;
+			break;
+		case 3:
+			value = ambe_plc_stats.repeated;
+			break;
+		case 4:
+			value = ambe_plc_stats.muted;
+			break;
+		case 5:
+			value = ambe_plc_stats.bursts;
+			break;
+		case 6:
+			value = ambe_plc_stats.max_burst;
+			break;
+	}
+
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
@@ -0,0 +1,59 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ambe_plc.h
+ *
+ * Packet loss concealment for the AMBE decoder path
+ *
+ */
+
+
+#ifndef AMBE_PLC_H_
+#define AMBE_PLC_H_
+
+
+#define AMBE_PLC_REPEAT_FRAMES	5		// repeat last good frame (with fading) for 100ms
+
+#define AMBE_PLC_GAIN_UNITY		256
+
+#define AMBE_PLC_FRAME_IDLE		0		// no frame in the queue, silence is sent
+#define AMBE_PLC_FRAME_OK		1
+#define AMBE_PLC_FRAME_LOST		2
+
+
+struct ambe_plc_stats {
+	uint32_t frames;
+	uint32_t lost;
+	uint32_t repeated;
+	uint32_t muted;
+	uint32_t bursts;
+	uint32_t max_burst;
+};
+
+extern struct ambe_plc_stats ambe_plc_stats;
+
+// any task, the AMBE task resets the state before the next frame
+void ambe_plc_reset(void);
+void ambe_plc_process(uint8_t * data, int frame_state);
+void ambe_plc_next_frame(void);
+void ambe_plc_apply_gain(int16_t * samples, int num_samples);
+
+#endif /* AMBE_PLC_H_ */
@@ -102,26 +102,39 @@ void ambe_q_initialize( ambe_q_t * a )
 }
 
 
-int ambe_q_put_sd (ambe_q_t * a,  const uint8_t * data)
+int ambe_q_put_tag (ambe_q_t * a,  const uint8_t * data, const struct latency_tag * tag)
 {
 	int ret = 0;
 	
 	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
     {
-		if ((AMBE_Q_BUFLEN - a->count) >= AMBE_Q_DATASIZE_SD) // there is space in the buffer
+		if ((AMBE_Q_BUFLEN - a->count) >= AMBE_Q_DATASIZE) // there is space in the buffer
 		{
-			memcpy (a->buf + a->in_ptr, data, AMBE_Q_DATASIZE_SD);
+			memcpy (a->buf + a->in_ptr, data, AMBE_Q_DATASIZE);
 			
-			a->in_ptr += AMBE_Q_DATASIZE_SD;
+#if LATENCY_STAMPS
+			struct latency_tag * t = a->tag + (a->in_ptr / AMBE_Q_DATASIZE);
+			
+			if (tag != NULL)
+			{
+				*t = *tag;
+			}
+			else
+			{
+				LATENCY_CLEAR(t);
+			}
+#endif
+			
+			a->in_ptr += AMBE_Q_DATASIZE;
 			
 			if (a->in_ptr >= AMBE_Q_BUFLEN)
 			{
 				a->in_ptr = 0;
 			}
 			
-			a->count += AMBE_Q_DATASIZE_SD;
+			a->count += AMBE_Q_DATASIZE;
 			
-			if (a->count >= (AMBE_Q_DATASIZE_SD * 3)) // if 3 ambe records are in memory...
+			if (a->count >= (AMBE_Q_DATASIZE * 3)) // if 3 ambe records are in memory...
 			{
 				a->state = 1;  // ... start delivering via get method
 			}
@@ -143,30 +156,34 @@ int ambe_q_put_sd (ambe_q_t * a,  const uint8_t * data)
 
 int ambe_q_put (ambe_q_t * a,  const uint8_t * data)
 {
-	uint8_t buf[AMBE_Q_DATASIZE_SD];
-	ambe_expand_to_sd_data(buf, data);
-	return ambe_q_put_sd( a, buf );
+	return ambe_q_put_tag( a, data, NULL );
 }
 
 
-int ambe_q_get_sd (ambe_q_t * a,  uint8_t * data )
+int ambe_q_get_tag (ambe_q_t * a,  uint8_t * data, struct latency_tag * tag )
 {
 	int ret = 0;
 	
+	LATENCY_CLEAR(tag);
+	
 	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
     {
 		if ((a->count > 0) && (a->state == 1)) // there is data in the buffer
 		{
-			memcpy (data, a->buf + a->out_ptr, AMBE_Q_DATASIZE_SD);
+			memcpy (data, a->buf + a->out_ptr, AMBE_Q_DATASIZE);
 			
-			a->out_ptr += AMBE_Q_DATASIZE_SD;
+#if LATENCY_STAMPS
+			*tag = a->tag[a->out_ptr / AMBE_Q_DATASIZE];
+#endif
+			
+			a->out_ptr += AMBE_Q_DATASIZE;
 			
 			if (a->out_ptr >= AMBE_Q_BUFLEN)
 			{
 				a->out_ptr = 0;
 			}
 			
-			a->count -= AMBE_Q_DATASIZE_SD;
+			a->count -= AMBE_Q_DATASIZE;
 			
 			if (a->count <= 0)
 			{
@@ -175,7 +192,7 @@ int ambe_q_get_sd (ambe_q_t * a,  uint8_t * data )
 		}		
 		else
 		{
-			ambe_expand_to_sd_data( data, ambe_silence_data );
+			memcpy( data, ambe_silence_data, AMBE_Q_DATASIZE );
 			ret = 1;
 		}				
         xSemaphoreGive( a->mutex );
@@ -184,17 +201,106 @@ int ambe_q_get_sd (ambe_q_t * a,  uint8_t * data )
 	{
 		// should not happen: could not get Mutex
 		
-		ambe_expand_to_sd_data( data, ambe_silence_data );
+		memcpy( data, ambe_silence_data, AMBE_Q_DATASIZE );
 		ret = 1;
 	}
 	
 	return ret;
 }
 
-int ambe_q_get (ambe_q_t * a,  uint8_t * data)
+int ambe_q_get (ambe_q_t * a,  uint8_t * data )
+{
+	struct latency_tag tag;
+	
+	return ambe_q_get_tag( a, data, &tag );
+}
+
+
+struct ambe_sd_hold {
+	uint8_t data[AMBE_Q_DATASIZE];
+	uint8_t sd_data[AMBE_Q_DATASIZE_SD];
+};
+
+static struct ambe_sd_hold sd_hold[AMBE_SD_HOLD];
+static short sd_hold_in;
+static short sd_hold_out;
+static short sd_hold_count;  // 0: no search for network frames
+
+
+void ambe_sd_hold_put (const uint8_t * sd_data, const uint8_t * data)
+{
+	portENTER_CRITICAL();
+	
+	if (sd_hold_count >= AMBE_SD_HOLD)  // full: the oldest entry is overwritten
+	{
+		sd_hold_out ++;
+		
+		if (sd_hold_out >= AMBE_SD_HOLD)
+		{
+			sd_hold_out = 0;
+		}
+		
+		sd_hold_count --;
+	}
+	
+	memcpy (sd_hold[sd_hold_in].data, data, AMBE_Q_DATASIZE);
+	memcpy (sd_hold[sd_hold_in].sd_data, sd_data, AMBE_Q_DATASIZE_SD);
+	
+	sd_hold_in ++;
+	
+	if (sd_hold_in >= AMBE_SD_HOLD)
+	{
+		sd_hold_in = 0;
+	}
+	
+	sd_hold_count ++;
+	
+	portEXIT_CRITICAL();
+}
+
+
+int ambe_sd_hold_get (uint8_t * sd_data, const uint8_t * data)
 {
-	uint8_t buf[AMBE_Q_DATASIZE_SD];
-	int ret = ambe_q_get_sd( a, buf );
-	ambe_reduce_sd_data( data, buf );
+	int ret = 1;
+	int i;
+	
+	portENTER_CRITICAL();
+	
+	int k = sd_hold_out;
+	
+	for (i=0; i < sd_hold_count; i++)  // oldest first, the queues keep the order
+	{
+		if (memcmp(sd_hold[k].data, data, AMBE_Q_DATASIZE) == 0)
+		{
+			memcpy (sd_data, sd_hold[k].sd_data, AMBE_Q_DATASIZE_SD);
+			
+			// this one and the older ones (dropped on the way) are done
+			sd_hold_out = k + 1;
+			
+			if (sd_hold_out >= AMBE_SD_HOLD)
+			{
+				sd_hold_out = 0;
+			}
+			
+			sd_hold_count -= i + 1;
+			ret = 0;
+			break;
+		}
+		
+		k ++;
+		
+		if (k >= AMBE_SD_HOLD)
+		{
+			k = 0;
+		}
+	}
+	
+	portEXIT_CRITICAL();
+	
+	if (ret != 0)
+	{
+		ambe_expand_to_sd_data( sd_data, data );
+	}
+	
 	return ret;
 }
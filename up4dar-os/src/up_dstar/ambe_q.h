@@ -35,11 +35,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "semphr.h"
 
+#include "latency.h"
+
 #define AMBE_Q_DATASIZE  9
 
 #define AMBE_Q_DATASIZE_SD  (AMBE_Q_DATASIZE * 4)
 
-#define AMBE_Q_BUFLEN  (AMBE_Q_DATASIZE_SD * 50)
+#define AMBE_Q_BUFLEN  (AMBE_Q_DATASIZE * 50)  // frames are stored packed (9 bytes)
+#define AMBE_Q_FRAMES  (AMBE_Q_BUFLEN / AMBE_Q_DATASIZE)
 
 extern const uint8_t ambe_silence_data[AMBE_Q_DATASIZE];
 extern const uint8_t ambe_lfi_indicator[AMBE_Q_DATASIZE];
@@ -51,6 +54,9 @@ struct ambe_q {
 	short count;
 	short state;
 	xSemaphoreHandle mutex;
+#if LATENCY_STAMPS
+	struct latency_tag tag[AMBE_Q_FRAMES];
+#endif
 };
 
 typedef struct ambe_q ambe_q_t;
@@ -59,9 +65,25 @@ void ambe_q_initialize (ambe_q_t * a);
 int ambe_q_put (ambe_q_t * a, const uint8_t * data);
 int ambe_q_get (ambe_q_t * a, uint8_t * data);
 
+// same with the time stamps of the frame, tag may be NULL on put,
+// it is cleared on get if the frame has none
+int ambe_q_put_tag (ambe_q_t * a, const uint8_t * data, const struct latency_tag * tag);
+int ambe_q_get_tag (ambe_q_t * a, uint8_t * data, struct latency_tag * tag);
+
 int ambe_q_flush (ambe_q_t * a, int read_fast);
-int ambe_q_put_sd (ambe_q_t * a, const uint8_t * data);
-int ambe_q_get_sd (ambe_q_t * a, uint8_t * data );
 void ambe_expand_to_sd_data( uint8_t * sd_data, const uint8_t * inp_data);
 void ambe_reduce_sd_data( uint8_t * data, const uint8_t * sd_data);
+
+// soft decision values of the PHY frames, held while the packed frames pass
+// the jitter queue and ambe_q (a few frames at the steady rate of the PHY),
+// a frame that is not found any more gets hard bits
+
+#define AMBE_SD_HOLD  16
+
+// data: the packed frame (ambe_reduce_sd_data)
+void ambe_sd_hold_put (const uint8_t * sd_data, const uint8_t * data);
+
+// SD format of the frame for the AMBE chip: the held values if the frame
+// came from the PHY unchanged (return 0), else expanded hard bits (return 1)
+int ambe_sd_hold_get (uint8_t * sd_data, const uint8_t * data);
 #endif /* AMBE_Q_H_ */
\ No newline at end of file
@@ -0,0 +1,173 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * audio_meter.c
+ *
+ * The samples of a block are summed up in one loop (square sum, peak,
+ * clipped samples). Every AUDIO_METER_PERIOD samples the RMS and the
+ * peak level are converted to milliBel and stored in the history.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "audio_meter.h"
+#include "fixpoint_math.h"
+
+#include "up_net/snmp_data.h"
+
+
+audio_meter_t audio_meter[2];
+
+
+void audio_meter_init (audio_meter_t * m, int clip_level)
+{
+	int i;
+	
+	m->square_sum = 0;
+	m->peak_abs = 0;
+	m->num_samples = 0;
+	m->clip_level = clip_level;
+	m->clipped = 0;
+	m->clip_count = 0;
+	m->hist_pos = 0;
+	m->rms = fixpoint_milliBel(0);
+	m->peak = m->rms;
+	
+	for (i=0; i < AUDIO_METER_HISTORY; i++)
+	{
+		m->history[i].rms = m->rms;
+		m->history[i].peak = m->rms;
+	}
+}
+
+
+int audio_meter_block (audio_meter_t * m, const int16_t * samples, int len)
+{
+	uint32_t sum = 0;
+	int peak = 0;
+	int clip = 0;
+	int i;
+	
+	for (i=0; i < len; i++)
+	{
+		int s = samples[i];
+		int a = (s < 0) ? -s : s;
+		
+		sum += (uint32_t) (s * s) >> 7;
+		
+		if (a > peak)
+		{
+			peak = a;
+		}
+		
+		clip += (a >= m->clip_level);
+	}
+	
+	m->square_sum += sum;
+	
+	if (peak > m->peak_abs)
+	{
+		m->peak_abs = peak;
+	}
+	
+	if (clip != 0)
+	{
+		m->clip_count += clip;
+		m->clipped = 1;
+	}
+	
+	m->num_samples += len;
+	
+	if (m->num_samples < AUDIO_METER_PERIOD)
+		return 0;
+	
+	// square sum of a full scale signal has the same scale as square_sum
+	
+	int peak_level = fixpoint_milliBel(((m->peak_abs * m->peak_abs) >> 7) * AUDIO_METER_PERIOD);
+	
+	m->rms = fixpoint_milliBel(m->square_sum);
+	
+	if ((m->peak - AUDIO_METER_DECAY) > peak_level)
+	{
+		m->peak -= AUDIO_METER_DECAY;
+	}
+	else
+	{
+		m->peak = peak_level;
+	}
+	
+	m->history[m->hist_pos].rms = m->rms;
+	m->history[m->hist_pos].peak = peak_level;
+	m->hist_pos = (m->hist_pos + 1) & (AUDIO_METER_HISTORY - 1);
+	
+	m->square_sum = 0;
+	m->peak_abs = 0;
+	m->num_samples = 0;
+	
+	return 1;
+}
+
+
+int snmp_get_audio_meter (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	audio_meter_t * m = audio_meter + ((arg >> 4) & 0x01);  // meter in the upper nibble
+	
+	switch (arg & 0x0F)
+	{
+		case 1:
+			value = m->rms;
+			break;
+		case 2:
+			value = m->peak;
+			break;
+		case 3:
+			value = m->clip_count;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+
+// oldest measurement first, RMS and peak as 16 bit values (big endian)
+
+int snmp_get_audio_meter_history (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	audio_meter_t * m = audio_meter + (arg & 0x01);
+	int pos = m->hist_pos;
+	int len = 0;
+	int i;
+	
+	for (i=0; (i < AUDIO_METER_HISTORY) && ((len + 4) <= maxlen); i++)
+	{
+		const struct audio_meter_level * h = m->history + ((pos + i) & (AUDIO_METER_HISTORY - 1));
+		
+		res[len++] = ((uint16_t) h->rms) >> 8;
+		res[len++] = h->rms & 0xFF;
+		res[len++] = ((uint16_t) h->peak) >> 8;
+		res[len++] = h->peak & 0xFF;
+	}
+	
+	*res_len = len;
+	return 0;
+}
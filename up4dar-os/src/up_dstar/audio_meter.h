@@ -0,0 +1,71 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * audio_meter.h
+ *
+ * Audio level meter, computed once per block
+ *
+ */
+
+
+#ifndef AUDIO_METER_H_
+#define AUDIO_METER_H_
+
+
+#define AUDIO_METER_PERIOD		160		// samples per measurement (20ms)
+#define AUDIO_METER_HISTORY		16		// measurements kept (must be a power of two)
+#define AUDIO_METER_DECAY		40		// peak decay per measurement (milliBel), 20dB/s
+
+#define AUDIO_METER_MIC			0
+#define AUDIO_METER_SPKR		1
+
+
+// levels in milliBel relative to full scale (0 = full scale, about -9100 = silence)
+
+struct audio_meter_level {
+	int16_t rms;
+	int16_t peak;
+};
+
+typedef struct audio_meter
+{
+	uint32_t square_sum;		// (sample * sample) >> 7 of the current period
+	uint16_t peak_abs;			// max. abs(sample) of the current period
+	uint16_t num_samples;
+	uint16_t clip_level;		// abs(sample) >= clip_level is counted as clipped
+	uint8_t clipped;			// set when a sample was clipped, cleared by the display
+	uint8_t hist_pos;
+	uint32_t clip_count;
+	int16_t rms;				// last measurement
+	int16_t peak;				// peak with decay
+	struct audio_meter_level history[AUDIO_METER_HISTORY];
+} audio_meter_t;
+
+
+void audio_meter_init (audio_meter_t * m, int clip_level);
+
+// returns 1 if a measurement period is complete
+int audio_meter_block (audio_meter_t * m, const int16_t * samples, int len);
+
+
+extern audio_meter_t audio_meter[2];
+
+#endif /* AUDIO_METER_H_ */
@@ -33,74 +33,156 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "audio_q.h"
 
 
+// controller constants, found with a simulation of the two
+// sample clocks (up to +-1000 ppm) and 1 ms task jitter
+
+#define AUDIO_Q_LEVEL_SHIFT  5		// low pass of the fill level
+#define AUDIO_Q_KP_SHIFT  3		// proportional gain
+#define AUDIO_Q_KI_SHIFT  14		// integrator gain
+#define AUDIO_Q_MAX_ADJ  (AUDIO_Q_ONE / 200)   // +-0.5 %
+
+#define AUDIO_Q_MAX_OUT  (AUDIO_Q_TRANSFERLEN + 1)  // samples per put at max. step
+
+
 void audio_q_initialize (audio_q_t * a)
 {
 	a->mutex = xSemaphoreCreateMutex();
 	a->count = 0;
 	a->in_ptr = 0;
 	a->out_ptr = 0;
+	
+	a->pos = 0;
+	a->step = AUDIO_Q_ONE;
+	a->level = 0;
+	a->integ = 0;
+	a->last = 0;
+	a->underrun = 1;
+	a->underruns = 0;
+	a->overruns = 0;
+	
+	LATENCY_CLEAR(&a->tag);
 }
 
 
-/*
-int audio_error = 0;
+int audio_q_drift_ppm (const audio_q_t * a)
+{
+	return ((a->step - AUDIO_Q_ONE) * 15625L) >> (AUDIO_Q_FRAC_BITS - 6);  // 10^6 = 15625 * 2^6
+}
 
-int audio_max = 0;
-*/
 
-void audio_q_put (audio_q_t * a,  const short * samples)
+static void put_sample (audio_q_t * a, short s)
 {
-	int i;
+	a->buf[a->in_ptr] = s;
+	a->in_ptr ++;
+	if (a->in_ptr >= AUDIO_Q_BUFLEN)
+	{
+		a->in_ptr = 0;
+	}
+	a->count ++;
+}
+
+
+static void adjust_step (audio_q_t * a)
+{
+	int32_t err = (a->count - AUDIO_Q_TARGET) << 8;
+	int32_t adj;
+	
+	a->level += (err - a->level) >> AUDIO_Q_LEVEL_SHIFT;
+	
+	// large errors (restart, bursts) are not drift
+	if ((a->level > -(AUDIO_Q_TRANSFERLEN << 8)) && (a->level < (AUDIO_Q_TRANSFERLEN << 8)))
+	{
+		a->integ += a->level;
+	}
 	
+	if (a->integ > (AUDIO_Q_MAX_ADJ << AUDIO_Q_KI_SHIFT))
+	{
+		a->integ = AUDIO_Q_MAX_ADJ << AUDIO_Q_KI_SHIFT;
+	}
+	else if (a->integ < -(AUDIO_Q_MAX_ADJ << AUDIO_Q_KI_SHIFT))
+	{
+		a->integ = -(AUDIO_Q_MAX_ADJ << AUDIO_Q_KI_SHIFT);
+	}
+	
+	adj = (a->integ >> AUDIO_Q_KI_SHIFT) + (a->level >> AUDIO_Q_KP_SHIFT);
+	
+	if (adj > AUDIO_Q_MAX_ADJ)
+	{
+		adj = AUDIO_Q_MAX_ADJ;
+	}
+	else if (adj < -AUDIO_Q_MAX_ADJ)
+	{
+		adj = -AUDIO_Q_MAX_ADJ;
+	}
+	
+	// queue too full -> consume the input faster
+	a->step = AUDIO_Q_ONE + adj;
+}
+
+
+// the queue ran empty: start again at the target fill level with silence,
+// the controller keeps the drift it has learned
+
+static void restart (audio_q_t * a)
+{
+	while (a->count < AUDIO_Q_TARGET)
+	{
+		put_sample(a, 0);
+	}
+	
+	a->pos = 0;
+	a->level = 0;
+	a->last = 0;
+	a->underrun = 0;
+}
+
+
+void audio_q_put_tag (audio_q_t * a,  const short * samples, const struct latency_tag * tag)
+{
 	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
     {
-		if ((AUDIO_Q_BUFLEN - a->count) >= AUDIO_Q_TRANSFERLEN) // there is space in the buffer
+		if (a->underrun != 0)
 		{
-			for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
+			restart(a);
+		}
+		
+		if ((AUDIO_Q_BUFLEN - a->count) >= AUDIO_Q_MAX_OUT) // there is space in the buffer
+		{
+			int32_t pos = a->pos;
+			int32_t step;
+			
+			adjust_step(a);
+			step = a->step;
+			
+#if LATENCY_STAMPS
+			if ((tag != NULL) && (tag->ingress != 0) && (a->tag.ingress == 0))
 			{
-				/*
-				if (samples[i] > audio_max)
-				{
-					audio_max = samples[i];
-				}
-				*/
-				
-				a->buf[a->in_ptr] = samples[i];
-				a->in_ptr ++;
-				if (a->in_ptr >= AUDIO_Q_BUFLEN)
-				{
-					a->in_ptr = 0;
-				}
+				a->tag = *tag;
+				a->tag_count = a->count;
 			}
-			a->count += AUDIO_Q_TRANSFERLEN;
+#endif
+			
+			// output samples between input (i) and (i+1), i = -1 is the
+			// last sample of the previous block
 			
-			if (a->count < ((AUDIO_Q_TRANSFERLEN*2) -2) )  // add one sample
+			while (pos < ((AUDIO_Q_TRANSFERLEN - 1) << AUDIO_Q_FRAC_BITS))
 			{
-				a->buf[a->in_ptr] = samples[AUDIO_Q_TRANSFERLEN -1];
-				a->in_ptr ++;
-				if (a->in_ptr >= AUDIO_Q_BUFLEN)
-				{
-					a->in_ptr = 0;
-				}
-				a->count ++;
+				int i = pos >> AUDIO_Q_FRAC_BITS;
+				int x0 = (i < 0) ? a->last : samples[i];
+				int x1 = samples[i + 1];
+				int frac = (pos & (AUDIO_Q_ONE - 1)) >> (AUDIO_Q_FRAC_BITS - 15);
 				
-				// audio_error ++;
-			}
-			else if (a->count > (AUDIO_Q_BUFLEN - AUDIO_Q_TRANSFERLEN + 2)) // delete last sample
-			{
-				a->in_ptr --;
-				if (a->in_ptr < 0)
-				{
-					a->in_ptr = AUDIO_Q_BUFLEN -1;
-				}
-				a->count --;
+				put_sample(a, x0 + (((x1 - x0) * frac) >> 15));
 				
-				// audio_error ++;
+				pos += step;
 			}
+			
+			a->pos = pos - (AUDIO_Q_TRANSFERLEN << AUDIO_Q_FRAC_BITS);
+			a->last = samples[AUDIO_Q_TRANSFERLEN - 1];
 		}
 		else
 		{
-				// audio_error ++;
+			a->overruns ++;
 		}			
         xSemaphoreGive( a->mutex );
     }
@@ -113,6 +195,13 @@ void audio_q_put (audio_q_t * a,  const short * samples)
 
 
 
+void audio_q_put (audio_q_t * a,  const short * samples)
+{
+	audio_q_put_tag( a, samples, NULL );
+}
+
+
+
 static void fill_with_zeros (short * samples)
 {
 	int i;
@@ -125,10 +214,12 @@ static void fill_with_zeros (short * samples)
 
 
 
-void audio_q_get (audio_q_t * a,  short * samples)
+void audio_q_get_tag (audio_q_t * a,  short * samples, struct latency_tag * tag)
 {
 	int i;
 	
+	LATENCY_CLEAR(tag);
+	
 	if( xSemaphoreTake( a->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
     {
 		if (a->count >= AUDIO_Q_TRANSFERLEN) // there is data in the buffer
@@ -143,11 +234,31 @@ void audio_q_get (audio_q_t * a,  short * samples)
 				}
 			}
 			a->count -= AUDIO_Q_TRANSFERLEN;
+			
+#if LATENCY_STAMPS
+			if (a->tag.ingress != 0)
+			{
+				if (a->tag_count < AUDIO_Q_TRANSFERLEN) // tagged sample is in this block
+				{
+					*tag = a->tag;
+					LATENCY_CLEAR(&a->tag);
+				}
+				else
+				{
+					a->tag_count -= AUDIO_Q_TRANSFERLEN;
+				}
+			}
+#endif
 		}		
 		else
 		{
 			fill_with_zeros(samples);
 			
+			if (a->underrun == 0)
+			{
+				a->underrun = 1;
+				a->underruns ++;
+			}
 		}				
         xSemaphoreGive( a->mutex );
     }
@@ -159,3 +270,11 @@ void audio_q_get (audio_q_t * a,  short * samples)
 	}
 }
 
+
+
+void audio_q_get (audio_q_t * a,  short * samples)
+{
+	struct latency_tag tag;
+	
+	audio_q_get_tag( a, samples, &tag );
+}
@@ -34,17 +34,43 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "semphr.h"
 
+#include "latency.h"
+
 // #define AUDIO_Q_TRANSFERLEN 16
 #define AUDIO_Q_TRANSFERLEN 32
 
 #define AUDIO_Q_BUFLEN  (AUDIO_Q_TRANSFERLEN * 4)
 
+// fill level (samples) before audio_q_put, held by the resampler
+#define AUDIO_Q_TARGET  (AUDIO_Q_TRANSFERLEN + (AUDIO_Q_TRANSFERLEN / 2))
+
+#define AUDIO_Q_FRAC_BITS  20
+#define AUDIO_Q_ONE  (1L << AUDIO_Q_FRAC_BITS)
+
 struct audio_q {
 	short buf[AUDIO_Q_BUFLEN];
 	short in_ptr;
 	short out_ptr;
 	short count;
 	xSemaphoreHandle mutex;
+	
+	// drift compensation: the input is resampled with linear interpolation,
+	// step (input samples per output sample) is set by a PI controller
+	// from the fill level
+	int32_t pos;		// input position of the next output sample (fixpoint)
+	int32_t step;		// fixpoint, AUDIO_Q_ONE = no drift
+	int32_t level;		// filtered fill level error (1/256 samples)
+	int32_t integ;
+	short last;			// last input sample of the previous block
+	char underrun;
+	uint16_t underruns;
+	uint16_t overruns;
+	
+#if LATENCY_STAMPS
+	// one tagged block at a time, tag_count samples are in front of it
+	struct latency_tag tag;
+	short tag_count;
+#endif
 };
 
 typedef struct audio_q audio_q_t;
@@ -53,4 +79,12 @@ void audio_q_initialize (audio_q_t * a);
 void audio_q_put (audio_q_t * a, const short * samples);
 void audio_q_get (audio_q_t * a, short * samples);
 
+// same with the time stamps of the first sample of the block,
+// tag may be NULL on put, it is cleared on get if the block has none
+void audio_q_put_tag (audio_q_t * a, const short * samples, const struct latency_tag * tag);
+void audio_q_get_tag (audio_q_t * a, short * samples, struct latency_tag * tag);
+
+// drift between producer and consumer in ppm (positive: producer is faster)
+int audio_q_drift_ppm (const audio_q_t * a);
+
 #endif /* AUDIO_Q_H_ */
\ No newline at end of file
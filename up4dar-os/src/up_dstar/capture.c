@@ -0,0 +1,269 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * capture.c
+ *
+ * Capture ring for received D-STAR traffic.
+ *
+ * Every header, voice and data frame handed to the RX queues is stored
+ * with source, session and arrival time. When the ring is full the
+ * oldest records are overwritten.
+ *
+ * Readout via SNMP: stop the capture, set the read position (byte
+ * offset from the oldest record, start with 0) and get the data OID.
+ * It returns whole records only, the next read position is the old one
+ * plus the length of the returned data. An empty result marks the end.
+ */
+
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "gcc_builtin.h"
+
+#include "rtclock.h"
+#include "capture.h"
+
+#include "up_net/snmp_data.h"
+
+
+#define CAPTURE_MASK  (CAPTURE_BUFLEN - 1)
+
+#define CAPTURE_MAX_READ  1000  // bytes per SNMP get
+
+static uint8_t capture_buf[CAPTURE_BUFLEN];
+static int in_ptr;
+static int out_ptr;
+static int count;
+static int running;
+static int read_pos;
+static uint32_t dropped;
+
+static xSemaphoreHandle capture_mutex;
+
+
+static int payload_len (int type)
+{
+	switch (type)
+	{
+		case CAPTURE_HEADER:
+			return 39;
+		case CAPTURE_VOICE:
+			return 9;
+		case CAPTURE_DATA:
+			return 3;
+	}
+	
+	return 0;
+}
+
+static int record_len_at (int ptr)
+{
+	return CAPTURE_RECORD_HDRLEN + payload_len(capture_buf[ptr & CAPTURE_MASK] >> 4);
+}
+
+static void put_byte (uint8_t d)
+{
+	capture_buf[in_ptr] = d;
+	in_ptr = (in_ptr + 1) & CAPTURE_MASK;
+}
+
+static void clear_ring (void)
+{
+	in_ptr = 0;
+	out_ptr = 0;
+	count = 0;
+	read_pos = 0;
+}
+
+
+void capture_init(void)
+{
+	capture_mutex = xSemaphoreCreateMutex();
+	
+	clear_ring();
+	dropped = 0;
+	running = 1;
+}
+
+
+void capture_record(int type, uint8_t source, uint16_t session, uint8_t pos,
+	const uint8_t * payload)
+{
+	int i;
+	int len = payload_len(type);
+	unsigned long tick = rtclock_get_ticks();
+	
+	if (running == 0)
+		return;
+	
+	if( xSemaphoreTake( capture_mutex, 0 ) != pdTRUE )  // get Mutex, don't wait
+	{
+		dropped ++;
+		return;
+	}
+	
+	while ((CAPTURE_BUFLEN - count) < (CAPTURE_RECORD_HDRLEN + len))  // remove oldest records
+	{
+		int n = record_len_at(out_ptr);
+		
+		out_ptr = (out_ptr + n) & CAPTURE_MASK;
+		count -= n;
+	}
+	
+	put_byte( (type << 4) | (source & 0x0F) );
+	put_byte( pos );
+	put_byte( session >> 8 );
+	put_byte( session & 0xFF );
+	put_byte( tick >> 24 );
+	put_byte( (tick >> 16) & 0xFF );
+	put_byte( (tick >> 8) & 0xFF );
+	put_byte( tick & 0xFF );
+	
+	for (i=0; i < len; i++)
+	{
+		put_byte( payload[i] );
+	}
+	
+	count += CAPTURE_RECORD_HDRLEN + len;
+	
+	xSemaphoreGive( capture_mutex );
+}
+
+
+int snmp_get_capture (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = running;
+			break;
+		case 2:
+			value = count;
+			break;
+		case 3:
+			value = dropped;
+			break;
+		case 4:
+			value = read_pos;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+int snmp_set_capture (int32_t arg, const uint8_t * req, int req_len)
+{
+	int value = 0;
+	int i;
+	
+	if ((req_len < 1) || (req_len > 4))
+	{
+		return 1;
+	}
+	
+	for (i=0; i < req_len; i++)
+	{
+		value = (value << 8) | req[i];
+	}
+	
+	switch (arg)
+	{
+		case 1: // 0 = stop, 1 = run, 2 = clear and run
+			if (value == 2)
+			{
+				if( xSemaphoreTake( capture_mutex, 0 ) != pdTRUE )
+				{
+					return 1;
+				}
+				
+				clear_ring();
+				xSemaphoreGive( capture_mutex );
+				value = 1;
+			}
+			else if (value > 1)
+			{
+				return 1;
+			}
+			
+			running = value;
+			break;
+			
+		case 4:
+			if ((value < 0) || (value > count))
+			{
+				return 1;
+			}
+			
+			read_pos = value;
+			break;
+			
+		default:
+			return 1;
+	}
+	
+	return 0;
+}
+
+int snmp_get_capture_data (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int len = 0;
+	
+	if (maxlen > CAPTURE_MAX_READ)
+	{
+		maxlen = CAPTURE_MAX_READ;
+	}
+	
+	if( xSemaphoreTake( capture_mutex, 0 ) != pdTRUE )  // get Mutex, don't wait
+	{
+		return 1;
+	}
+	
+	if (read_pos <= count)
+	{
+		int ptr = out_ptr + read_pos;
+		int avail = count - read_pos;
+		
+		while (len < avail)
+		{
+			int n = record_len_at(ptr + len);
+			
+			if ((len + n) > maxlen)
+				break;
+			
+			len += n;
+		}
+		
+		int i;
+		
+		for (i=0; i < len; i++)
+		{
+			res[i] = capture_buf[(ptr + i) & CAPTURE_MASK];
+		}
+	}
+	
+	xSemaphoreGive( capture_mutex );
+	
+	*res_len = len;
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * capture.h
+ *
+ * Capture ring for received D-STAR traffic
+ *
+ */
+
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+
+#define CAPTURE_BUFLEN		8192	// must be a power of two
+
+// record format (all values big-endian):
+//
+//  byte 0      type (upper 4 bits) | source (lower 4 bits)
+//  byte 1      frame counter, CRC result for CAPTURE_HEADER
+//  byte 2..3   session
+//  byte 4..7   arrival time (rtclock ticks, ms)
+//  byte 8..    payload, length depends on the type
+
+#define CAPTURE_RECORD_HDRLEN	8
+
+#define CAPTURE_HEADER		1	// payload: 39 bytes radio header
+#define CAPTURE_VOICE		2	// payload: 9 bytes AMBE
+#define CAPTURE_DATA		3	// payload: 3 bytes slow data
+#define CAPTURE_STOP		4	// no payload
+
+void capture_init(void);
+void capture_record(int type, uint8_t source, uint16_t session, uint8_t pos,
+	const uint8_t * payload);
+
+#endif /* CAPTURE_H_ */
@@ -37,6 +37,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "up_net/ipneigh.h"
 #include "up_net/ipv4.h"
+#include "up_net/udp_socket.h"
 #include "up_net/snmp.h"
 
 #include "vdisp.h"
@@ -142,8 +143,18 @@ static void ccs_set_dns_name(void)
 	}
 }
 
+static udp_socket_t ccs_socket;
+
+static void ccs_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	ccs_input_packet(data, data_len, ipv4_src_addr);
+}
+
 void ccs_init(void)
 {
+	udp_socket_init(&ccs_socket, ccs_udp_input, 0, CCS_INPUT_READ_LEN);
+	
 	ccs_state = CCS_DISCONNECTED;
 	ccs_timeout_timer = 0;
 	// ccs_current_server = 0;
@@ -187,7 +198,7 @@ void ccs_service (void)
 		{
 			ccs_timeout_timer = 2; // 1 second
 			ccs_state = CCS_WAIT;
-			udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+			udp_socket_unbind(&ccs_socket); // stop receiving frames
 			vd_prints_xy(VDISP_DEBUG_LAYER, 104, 16, VDISP_FONT_6x8, 0, "NOWD");
 		}
 		else
@@ -215,7 +226,7 @@ void ccs_service (void)
 				ccs_timeout_timer = CCS_FAILURE_TIMEOUT;
 				ccs_state = CCS_WAIT;
 				// ccs_next_server();
-				udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+				udp_socket_unbind(&ccs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 16, VDISP_FONT_6x8, 0, "RQTO");
 			}
 			else
@@ -246,7 +257,7 @@ void ccs_service (void)
 			if (ccs_retry_counter == 0)
 			{
 				ccs_state = CCS_DISCONNECTED;
-				udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+				udp_socket_unbind(&ccs_socket); // stop receiving frames
 			}
 			else
 			{
@@ -298,7 +309,7 @@ void ccs_service (void)
 			{
 				memcpy (ccs_server_ipaddr, addrptr, 4); // use first address of DNS result
 				
-				udp_socket_ports[UDP_SOCKET_CCS] = udp_get_new_srcport();
+				udp_bind_new_srcport(&ccs_socket);
 				
 				ccs_send_connect();
 				
@@ -328,7 +339,7 @@ static void ccs_send_connect(void)
 {
 	
 		eth_txmem_t * packet = udp4_get_packet_mem( CCS_CONNECT_FRAME_SIZE,
-				 udp_socket_ports[UDP_SOCKET_CCS], CCS_UDP_PORT, ccs_server_ipaddr );
+				 ccs_socket.port, CCS_UDP_PORT, ccs_server_ipaddr );
 		
 		if (packet == NULL)
 		return;
@@ -349,7 +360,7 @@ static void ccs_send_info_frame(void)
 {
 	
 	eth_txmem_t * packet = udp4_get_packet_mem( CCS_INFO_FRAME_SIZE,
-	udp_socket_ports[UDP_SOCKET_CCS], CCS_UDP_PORT, ccs_server_ipaddr );
+	ccs_socket.port, CCS_UDP_PORT, ccs_server_ipaddr );
 	
 	if (packet == NULL)
 	return;
@@ -371,7 +382,7 @@ static void ccs_send_disconnect(void)
 {
 	
 	eth_txmem_t * packet = udp4_get_packet_mem( CCS_DISCONNECT_FRAME_SIZE,
-			 udp_socket_ports[UDP_SOCKET_CCS], CCS_UDP_PORT, ccs_server_ipaddr );
+			 ccs_socket.port, CCS_UDP_PORT, ccs_server_ipaddr );
 	
 	if (packet == NULL)
 	return;
@@ -392,7 +403,7 @@ static void ccs_keepalive_response(void)
 {
 	
 	eth_txmem_t * packet = udp4_get_packet_mem( CCS_KEEPALIVE_RESP_FRAME_SIZE,
-			 udp_socket_ports[UDP_SOCKET_CCS], CCS_UDP_PORT, ccs_server_ipaddr );
+			 ccs_socket.port, CCS_UDP_PORT, ccs_server_ipaddr );
 		
 	if (packet == NULL)
 	return;
@@ -434,7 +445,7 @@ void ccs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4
 			else
 			{
 				ccs_state = CCS_DISCONNECTED;
-				udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+				udp_socket_unbind(&ccs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 16, VDISP_FONT_6x8, 0, "NACK");
 			} 
 		}
@@ -443,7 +454,7 @@ void ccs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4
 			if (data[9] == ' ')
 			{
 				ccs_state = CCS_DISCONNECTED;
-				udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+				udp_socket_unbind(&ccs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 16, VDISP_FONT_6x8, 0, "DISC");
 			}
 		}
@@ -490,7 +501,7 @@ void ccs_stop(void)
 	}
 	else
 	{
-		udp_socket_ports[UDP_SOCKET_CCS] = 0; // stop receiving frames
+		udp_socket_unbind(&ccs_socket); // stop receiving frames
 		ccs_state = CCS_DISCONNECTED;
 	}
 }
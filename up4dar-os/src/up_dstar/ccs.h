@@ -35,6 +35,9 @@ void ccs_service (void);
 const char * ccs_current_servername(void);
 int ccs_is_connected (void);
 void ccs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4_src_addr);
+
+// ccs_input_packet() reads only the first bytes of a packet
+#define CCS_INPUT_READ_LEN	14
 void ccs_start (void);
 void ccs_stop(void);
 
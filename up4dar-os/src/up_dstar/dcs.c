@@ -41,6 +41,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "up_net/ipneigh.h"
 #include "up_net/ipv4.h"
+#include "up_net/udp_socket.h"
 #include "up_net/snmp.h"
 
 #include "vdisp.h"
@@ -145,9 +146,18 @@ static char current_server_type;
 #define NUM_SERVERS 30
 
 
-void dcs_init(void)
+static udp_socket_t dcs_socket;
+
+static void dcs_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
 {
+	dcs_input_packet(data, data_len, ipv4_src_addr);
+}
 
+void dcs_init(void)
+{
+	udp_socket_init(&dcs_socket, dcs_udp_input, 0, DCS_INPUT_READ_LEN);
+	
 	dcs_state = DCS_DISCONNECTED;	
 	
 	current_module = 'C';
@@ -186,6 +196,7 @@ void dcs_get_current_statustext (char * s)
 static uint8_t dcs_server_ipaddr[4];
 
 static void dcs_link_to (char module);
+static void dcs_flow_connect (void);
 
 static char dcs_server_dns_name[40]; // dns name of reflector e.g. "dcs001.xreflector.net"
 static int dns_handle;
@@ -260,7 +271,7 @@ void dcs_service (void)
 			{
 				dcs_timeout_timer = 2; // 1 second
 				dcs_state = DCS_WAIT;
-				udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+				udp_socket_unbind(&dcs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 8, VDISP_FONT_6x8, 0, "NOWD");
 			}
 			break;
@@ -277,7 +288,7 @@ void dcs_service (void)
 				{
 					dcs_timeout_timer = 20; // 10 seconds
 					dcs_state = DCS_WAIT;
-					udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+					udp_socket_unbind(&dcs_socket); // stop receiving frames
 					vd_prints_xy(VDISP_DEBUG_LAYER, 104, 8, VDISP_FONT_6x8, 0, "RQTO");
 				}
 				else
@@ -299,7 +310,7 @@ void dcs_service (void)
 				if (dcs_retry_counter == 0)
 				{
 					dcs_state = DCS_DISCONNECTED;
-					udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+					udp_socket_unbind(&dcs_socket); // stop receiving frames
 				}
 				else
 				{
@@ -345,13 +356,18 @@ void dcs_service (void)
 					dcs_timeout_timer = 30; // 15 seconds
 					dcs_state = DCS_WAIT;
 				}
+				else if ((current_server_type == SERVER_TYPE_DEXTRA) &&
+					(udp_socket_bind(&dcs_socket, DEXTRA_UDP_PORT) != 0)) // fixed port is in use
+				{
+					dcs_timeout_timer = 4; // 2 seconds
+					dcs_state = DCS_WAIT;
+				}
 				else
 				{
 					memcpy (dcs_server_ipaddr, addrptr, 4); // use first address of DNS result
-					dcs_udp_local_port = (current_server_type == SERVER_TYPE_DEXTRA) ? DEXTRA_UDP_PORT : udp_get_new_srcport();
-					
-					udp_socket_ports[UDP_SOCKET_DCS] = dcs_udp_local_port;
+					dcs_udp_local_port = (current_server_type == SERVER_TYPE_DEXTRA) ? DEXTRA_UDP_PORT : udp_bind_new_srcport(&dcs_socket);
 					
+					dcs_flow_connect();
 					dcs_link_to(current_module);
 					
 					dcs_state = DCS_CONNECT_REQ_SENT;
@@ -376,7 +392,7 @@ void dcs_service (void)
 				{
 					dcs_state = DCS_REJECT_WAIT;
 					dcs_timeout_timer = DCS_REJECT_TIMEOUT;
-					udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+					udp_socket_unbind(&dcs_socket); // stop receiving frames
 				}
 				else
 				{
@@ -446,7 +462,7 @@ void dcs_off(void)
 		default:
 		
 			dcs_state = DCS_DISCONNECTED;
-			udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+			udp_socket_unbind(&dcs_socket); // stop receiving frames
 			break;
 	}
 }
@@ -496,7 +512,7 @@ void dcs_over(void)
 	else
 	{
 		dcs_state = DCS_DISCONNECTED;
-		udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+		udp_socket_unbind(&dcs_socket); // stop receiving frames
 	}
 }
 
@@ -566,7 +582,7 @@ void dcs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4
 			if (data[9] == ' ')
 			{
 				dcs_state = DCS_DISCONNECTED;
-				udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+				udp_socket_unbind(&dcs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 8, VDISP_FONT_6x8, 0, "DISC");
 			}
 		}
@@ -576,7 +592,7 @@ void dcs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4
 			{
 				dcs_state = DCS_REJECT_WAIT;
 				dcs_timeout_timer = DCS_REJECT_TIMEOUT;
-				udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+				udp_socket_unbind(&dcs_socket); // stop receiving frames
 				vd_prints_xy(VDISP_DEBUG_LAYER, 104, 8, VDISP_FONT_6x8, 0, "REJW");
 			}
 		}
@@ -587,13 +603,13 @@ void dcs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4
 		if (dcs_state == DCS_DISCONNECT_REQ_SENT)
 		{
 			dcs_state = DCS_DISCONNECTED;
-			udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+			udp_socket_unbind(&dcs_socket); // stop receiving frames
 		}
 		else if (dcs_state == DCS_REJECTED)
 		{
 			dcs_state = DCS_REJECT_WAIT;
 			dcs_timeout_timer = DCS_REJECT_TIMEOUT;
-			udp_socket_ports[UDP_SOCKET_DCS] = 0; // stop receiving frames
+			udp_socket_unbind(&dcs_socket); // stop receiving frames
 		}
 	}
 /*	else if (data_len == 9)  // keep alive packet (old version)
@@ -655,16 +671,30 @@ void dcs_select_reflector (short server_num, char module, char server_type)
 #define DCS_VOICE_FRAME_SIZE  (100)
 
 
-static eth_txmem_t * dcs_get_packet_mem (int udp_size)
+// all frames to the reflector use the same addresses and ports,
+// the headers and the MAC addr of the next hop are cached in the flow
+static udp4_flow_t dcs_flow;
+
+static void dcs_flow_connect (void)
 {
 	short port = (current_server_type != SERVER_TYPE_DEXTRA) ? DCS_UDP_PORT : DEXTRA_UDP_PORT;
-	return udp4_get_packet_mem( udp_size, dcs_udp_local_port, port, dcs_server_ipaddr );
+	udp4_flow_connect( &dcs_flow, dcs_server_ipaddr, dcs_udp_local_port, port );
+}
+
+static eth_txmem_t * dcs_get_packet_mem (int udp_size)
+{
+	return udp4_flow_get_packet_mem( &dcs_flow, udp_size );
 	
 }
 
+static eth_txmem_t * dcs_get_packet_mem_seg (int udp_size, eth_txmem_t * seg)
+{
+	return udp4_flow_get_packet_mem_seg( &dcs_flow, udp_size, seg );
+}
+
 static void dcs_calc_chksum_and_send (eth_txmem_t * packet, int udp_size)
 {
-	udp4_calc_chksum_and_send(packet, dcs_server_ipaddr);
+	udp4_flow_send(&dcs_flow, packet);
 	
 		
 }
@@ -694,11 +724,38 @@ static void infocpy ( uint8_t * mem )
 #define DCS_CONNECT_FRAME_SIZE		519
 #define DCS_DISCONNECT_FRAME_SIZE		19
 
+#define DCS_INFO_SIZE  (DCS_CONNECT_FRAME_SIZE - DCS_DISCONNECT_FRAME_SIZE)
+
+// the HTML info of the connect frame is built once and sent as a
+// payload segment, it is not copied into every connect request
+static uint8_t dcs_info_mem[DCS_INFO_SIZE];
+static eth_txmem_t dcs_info_seg;
+
+static eth_txmem_t * dcs_info_segment (void)
+{
+	if (dcs_info_seg.data == NULL)
+	{
+		infocpy(dcs_info_mem);
+		eth_txmem_static_init(&dcs_info_seg, dcs_info_mem, DCS_INFO_SIZE);
+	}
+	
+	return &dcs_info_seg;
+}
+
 static void dcs_link_to (char module)
 {
 	int size = (current_server_type == SERVER_TYPE_DEXTRA) ? DEXTRA_CONNECT_SIZE :
 	   ((module == ' ') ? DCS_DISCONNECT_FRAME_SIZE : DCS_CONNECT_FRAME_SIZE);
-	eth_txmem_t * packet = dcs_get_packet_mem(size);
+	eth_txmem_t * packet;
+	
+	if (size == DCS_CONNECT_FRAME_SIZE)
+	{
+		packet = dcs_get_packet_mem_seg(DCS_DISCONNECT_FRAME_SIZE, dcs_info_segment());
+	}
+	else
+	{
+		packet = dcs_get_packet_mem(size);
+	}
 	
 	if (packet == NULL)
 	{
@@ -740,10 +797,6 @@ static void dcs_link_to (char module)
 		memcpy(d + 11, buf, 7);
 		d[18] = ' ';
 		d[18] = '@';
-		if (size > 19)
-		{
-			infocpy(d + 19);
-		}
 	}
 	
 	dcs_calc_chksum_and_send(packet, size);
@@ -42,6 +42,11 @@ extern char repeater_callsign[];
 void dcs_init(void);
 void dcs_service (void);
 void dcs_input_packet ( const uint8_t * data, int data_len, const uint8_t * ipv4_src_addr);
+
+// dcs_input_packet() reads only the first bytes of a packet (DCS voice
+// frame up to byte 60), longer packets are passed in place even if
+// they wrap at the end of the Ethernet receive ring
+#define DCS_INPUT_READ_LEN	61
 void dcs_off (void);
 void dcs_over(void);
 bool dcs_changed(void);
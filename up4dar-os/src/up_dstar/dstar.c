@@ -53,6 +53,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "up_dstar/r2cs.h"
 
 #include "slowdata.h"
+#include "jitter_q.h"
+#include "ambe_plc.h"
+#include "capture.h"
+#include "ambe_fec.h"
+#include "recorder.h"
+#include "lastheard.h"
 
 
 static xQueueHandle dstarQueue;
@@ -222,119 +228,39 @@ static void printHeader( int ypos, unsigned char crc_result, const unsigned char
 }
 
 
-static unsigned char sdHeaderBuf[41];
-static unsigned char sdHeaderPos = 0;
+// handlers of the slow data demultiplexer
 
-static unsigned char sdTypeFlag = 0;
-static unsigned char sdData[6];  // +1 because of mkPrintableString
-
-
-static unsigned char checkSDHeaderCRC(void) 
+static void sd_text_handler( const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source )
 {
-	unsigned short sum = rx_dstar_crc_header(sdHeaderBuf);
-	
-	if (sdHeaderBuf[39] != (sum & 0xFF))
-	{
-		return 1;		
-	}
+	char part[6];  // +1 because of mkPrintableString
+	int i;
 	
-	if (sdHeaderBuf[40] != ((sum >> 8) & 0xFF))
+	for (i=0; i < 4; i++)
 	{
-		return 1;		
+		if (flags & (1 << i))
+		{
+			memcpy(part, data + (i * 5), 5);
+			mkPrintableString(part, 5);
+			
+			vdisp_prints_xy( i * 30, 56, VDISP_FONT_6x8, 0, part );
+		}
 	}
-	
-	return 0;
 }
 
-static void processSDHeader( unsigned char len )
+static void sd_header_handler( const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source )
 {
-	int i;
-	
-	if ((len < 1) || (len > 5))
-	{
-		sdHeaderPos = 0;  // reset
-		return;
-	}
-	
-	if ((sdHeaderPos + len) > (sizeof sdHeaderBuf))
-	{
-		sdHeaderPos = 0;  // reset
-		return;
-	}
-	
-	for (i=0; i < len; i++)
-	{
-		sdHeaderBuf[sdHeaderPos + i] = sdData[i];
-	}
-	
-	sdHeaderPos += len;
-	
-	if (sdHeaderPos == 41)
-	{
-		unsigned char res = checkSDHeaderCRC();
-		
-		printHeader(9, res, sdHeaderBuf);
-		sdHeaderPos = 0;
-	}
-	
-	if (len < 5)  // last frame always shorter than 5
-	{
-		sdHeaderPos = 0;
-	}
+	printHeader(9, flags, data);
 }
 
-
-
-
-
-static void processSlowData( unsigned char sdPos, const unsigned char * sd, unsigned char source )
-{	
-	if (sdPos & 1)
-	{	
-		sdTypeFlag = sd[0];
-		sdData[0] = sd[1];
-		sdData[1] = sd[2];
-	}
-	else
-	{	
-		sdData[2] = sd[0];
-		sdData[3] = sd[1];
-		sdData[4] = sd[2];
-		
-		unsigned char len;
-		
-		len = sdTypeFlag & 0x07;  // ignore Bit 3
-		
-		if (len > 5) // invalid length
-		{
-			len = 0;  
-		}
-		
-		switch (sdTypeFlag & 0xF0)
-		{
-			case 0x30:
-				if (source == SOURCE_PHY)
-				{
-					slowdata_data_input(sdData, len);	
-				}
-				break;
-				
-			case 0x50:
-				processSDHeader(len);
-				break;
-				
-			case 0x40:
-				if ((sdTypeFlag & 0x0C) == 0)
-				{
-					mkPrintableString((char *) sdData, 5);
-					
-					vdisp_prints_xy( ((sdTypeFlag & 0x03) * 30), 56, VDISP_FONT_6x8, 0, (char *) sdData );
-				}
-				break;
-		}
+static void sd_gps_handler( const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source )
+{
+	if (source == SOURCE_PHY)
+	{
+		slowdata_data_input(data, len);
 	}
 }
 
+
 static U32 voicePackets = 0;
 static U32 syncPackets = 0;
 
@@ -347,8 +273,6 @@ static unsigned char frameSync[FRAMESYNC_LEN];
 
 static char pos_in_frame = 0;
 
-#define SOURCE_STOP	3
-
 static void rx_q_input_stop( uint8_t source, uint16_t session, uint8_t pos );
 
 
@@ -367,7 +291,7 @@ static void dstarStateChange(unsigned char n)
 			}
 			voicePackets = 0;
 			syncPackets = 0;
-			sdHeaderPos = 0;
+			slowdata_rx_reset();
 			pos_in_frame = 0;
 			
 			// vdisp_save_buf();
@@ -774,87 +698,364 @@ int snmp_set_phy_sysparam_raw (int32_t arg, const uint8_t * req, int req_len)
 #define POS_LAST  (NUM_PACKETS_IN_FRAME - 1)
 
 
-struct rx_q_buffer {
+// Every source has its own receive stream. If PHY and network receive at
+// the same time only one stream (the primary) is played, the other one is
+// handed over to the secondary consumer (e.g. forwarding to the reflector).
+
+#define RX_NUM_STREAMS  SOURCE_NET   // one stream for each source
+
+struct rx_stream {
+	jitter_q_t * q;
+	uint16_t session;
 	uint8_t source;
-	uint8_t data[3];
-	uint8_t voice[36];
-	};
-	
-static struct rx_q_buffer * rx_q_buffers[4] = { 0, 0, 0, 0 };
+	uint8_t active;
+	uint8_t secondary;    // stream lost the arbitration
+	uint8_t num_empty;
+	unsigned long start_tick;
+	unsigned long next_tick;   // playout time of the next secondary frame
+	uint32_t fec_frames;       // frames checked by the AMBE FEC (this transmission)
+	uint32_t fec_errors;       // bit errors corrected by the AMBE FEC
+};
+
+struct rx_arb_stats {
+	uint32_t preempted;
+	uint32_t secondary_streams;
+	uint32_t secondary_frames;
+	uint32_t session_drop;   // voice frames of a second session on a busy source
+};
+
+static struct rx_stream rx_streams[RX_NUM_STREAMS];
+static struct rx_arb_stats rx_arb_stats;
+static rx_q_secondary_func_t rx_q_secondary = 0;
+
+#define RX_STREAM(src)  (rx_streams + ((src) - 1))
 
 int dstar_pos_not_correct = 0;
 
 static uint8_t current_source = 0;
-static uint16_t current_session = 0;
-static uint8_t current_pos = 0;
 static uint8_t current_rx_buf = 0;
-static uint8_t current_tx_buf = 0;
-static uint8_t num_empty = 0;
-static int num_written = 0;
+static uint8_t last_rx_pos = 0;
+
 
-static int tx_count_offset = 0;
-static int rx_count_offset = 0;
+static uint8_t last_valid_source = 0;
 
+#define CALC_XPOS(a,b) (((a)<<1) + ((b)*42))
+#define SEQ_TO_BUF(s)  (((s) / NUM_PACKETS_IN_FRAME) & 1)
 
-/*
-static void rx_q_clean(void)
+// bit error rate of the stream in 0.01%
+
+static int32_t rx_stream_ber(const struct rx_stream * s)
 {
-	int i;
+	uint32_t bits = (s->fec_frames * AMBE_FEC_CHECKED_BITS) / 100;
+	
+	if (bits == 0)
+		return 0;
+		
+	return (s->fec_errors * 100) / bits;
+}
+
+static void rx_stream_end(struct rx_stream * s)
+{
+	s->active = 0;
+	s->num_empty = 0;
 	
-	for (i=0; i < NUM_PACKETS_IN_FRAME; i++)
+	lastheard_end(s->source, s->fec_frames, rx_stream_ber(s));
+}
+
+static void rx_q_print_stats(void)
+{
+	char buf[6];
+	jitter_q_t * q = RX_STREAM(current_source)->q;
+	
+	vd_prints_xy(VDISP_DEBUG_LAYER, 0, 34, VDISP_FONT_4x6, 0, "JB");
+	vdisp_i2s(buf, 2, 10, 0, jitter_q_depth(q));
+	vd_prints_xy(VDISP_DEBUG_LAYER, 12, 34, VDISP_FONT_4x6, 0, buf);
+	vdisp_i2s(buf, 2, 10, 0, q->target_depth);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 24, 34, VDISP_FONT_4x6, 0, buf);
+	vdisp_i2s(buf, 5, 10, 0, jitter_q_jitter_usec(q));
+	vd_prints_xy(VDISP_DEBUG_LAYER, 36, 34, VDISP_FONT_4x6, 0, buf);
+	vdisp_i2s(buf, 5, 10, 0, q->stats.late);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 60, 34, VDISP_FONT_4x6, 0, buf);
+	vdisp_i2s(buf, 5, 10, 0, q->stats.lost);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 84, 34, VDISP_FONT_4x6, 0, buf);
+	vdisp_i2s(buf, 3, 10, 0, rx_arb_stats.secondary_streams);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 108, 34, VDISP_FONT_4x6, 0, buf);
+	
+	int32_t ber = rx_stream_ber(RX_STREAM(current_source));
+	
+	vd_prints_xy(VDISP_DEBUG_LAYER, 0, 40, VDISP_FONT_4x6, 0, "BER");
+	vdisp_i2s(buf, 2, 10, 0, ber / 100);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 16, 40, VDISP_FONT_4x6, 0, buf);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 24, 40, VDISP_FONT_4x6, 0, ".");
+	vdisp_i2s(buf, 2, 10, 1, ber % 100);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 28, 40, VDISP_FONT_4x6, 0, buf);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 36, 40, VDISP_FONT_4x6, 0, "%");
+	vdisp_i2s(buf, 5, 10, 0, RX_STREAM(current_source)->fec_errors);
+	vd_prints_xy(VDISP_DEBUG_LAYER, 60, 40, VDISP_FONT_4x6, 0, buf);
+	
+#if LATENCY_STAMPS
+	vd_prints_xy(VDISP_DEBUG_LAYER, 84, 40, VDISP_FONT_4x6, 0, "L");
+	vdisp_i2s(buf, 4, 10, 0, latency_mean_ms(LATENCY_TOTAL));  // input -> codec (ms)
+	vd_prints_xy(VDISP_DEBUG_LAYER, 88, 40, VDISP_FONT_4x6, 0, buf);
+#endif
+}
+
+void rx_q_set_secondary(rx_q_secondary_func_t func)
+{
+	rx_q_secondary = func;
+}
+
+// get the next frame of a stream, the stream is switched off at its end
+
+static int rx_stream_get(struct rx_stream * s, uint8_t * pos, uint8_t * data, uint8_t * voice,
+	struct latency_tag * tag)
+{
+	int res = jitter_q_get(s->q, pos, data, voice, tag);
+	
+	switch (res)
 	{
-		rx_q_buf[i].source = 0;
+		case JITTER_Q_NONE: // idle or pre-buffering
+			break;
+			
+		case JITTER_Q_STOP:
+			rx_stream_end(s);
+			break;
+			
+		case JITTER_Q_MISSING:
+			s->num_empty ++;
+			
+			if (s->num_empty > 25) // too many empty frames
+			{
+				jitter_q_reset(s->q);
+				rx_stream_end(s);
+			}
+			break;
+			
+		default:
+			s->num_empty = 0;
+			
+			{
+				uint32_t blocks[3];
+				s->fec_errors += ambe_fec_decode(voice, blocks);
+				s->fec_frames ++;
+			}
+			break;
+	}
+	
+	return res;
+}
+
+static int rx_stream_priority(const struct rx_stream * s)
+{
+	if ((SETTING_CHAR(C_RX_ARBITRATION) != 0) && (s->source == SOURCE_PHY))
+	{
+		return 1;  // local RF first
+	}
+	
+	return 0;  // first come, first served
+}
+
+static void rx_stream_to_secondary(struct rx_stream * s)
+{
+	s->secondary = 1;
+	s->next_tick = rtclock_get_ticks();
+	rx_arb_stats.secondary_streams ++;
+	
+	if (rx_q_secondary != 0)
+	{
+		rx_q_secondary( s->source, RX_Q_SECONDARY_START, 0, 0, 0 );
 	}
 }
-*/
 
+// select the primary stream, returns 1 if the current stream was preempted
 
-static int p_max = 0;
+static int rx_q_arbitrate(void)
+{
+	int i;
+	struct rx_stream * best = 0;
+	
+	for (i=0; i < RX_NUM_STREAMS; i++)
+	{
+		struct rx_stream * s = rx_streams + i;
+		
+		if ((s->active == 0) || (s->secondary != 0))
+			continue;
+		
+		if ((best == 0) ||
+			(rx_stream_priority(s) > rx_stream_priority(best)) ||
+			((rx_stream_priority(s) == rx_stream_priority(best)) &&
+				(((long) (s->start_tick - best->start_tick)) < 0)))
+		{
+			best = s;
+		}
+	}
+	
+	if (best == 0)
+		return 0;
+	
+	if (current_source != 0)
+	{
+		struct rx_stream * cur = RX_STREAM(current_source);
+		
+		if ((best != cur) && (rx_stream_priority(best) > rx_stream_priority(cur)))
+		{
+			rx_stream_to_secondary(cur);
+			rx_arb_stats.preempted ++;
+			current_source = 0; // best stream is selected on the next call
+			return 1;
+		}
+		
+		best = cur;
+	}
+	else
+	{
+		current_source = best->source;
+		ambe_plc_reset();
+		slowdata_rx_reset();
+	}
+	
+	for (i=0; i < RX_NUM_STREAMS; i++)
+	{
+		struct rx_stream * s = rx_streams + i;
+		
+		if ((s != best) && (s->active != 0) && (s->secondary == 0))
+		{
+			rx_stream_to_secondary(s);
+		}
+	}
+	
+	return 0;
+}
 
-static void set_tx_buf(int p)
+static void rx_stream_forward(struct rx_stream * s)
 {
-	if (p > p_max)
+	uint8_t p;
+	uint8_t rx_data[3];
+	uint8_t rx_voice[AMBE_Q_DATASIZE];
+	struct latency_tag tag;  // not measured, secondary streams are not played
+	
+	int res = rx_stream_get(s, &p, rx_data, rx_voice, &tag);
+	
+	if (res == JITTER_Q_NONE)
+		return;
+	
+	if (s->active == 0) // end of the stream
+	{
+		s->secondary = 0;
+		
+		if (rx_q_secondary != 0)
+		{
+			rx_q_secondary( s->source, RX_Q_SECONDARY_END, 0, 0, 0 );
+		}
+		return;
+	}
+	
+	if (p == 0)
 	{
-		p_max = p;
+		rx_data[0] =  0x55 ^ 0x70;  // sync pattern
+		rx_data[1] =  0x2d ^ 0x4F;
+		rx_data[2] =  0x16 ^ 0x93;
 	}
 	
-	if (p < (p_max - 1))
+	if (res == JITTER_Q_MISSING)
 	{
-		p_max = p;
-		current_tx_buf ^= 1;
-		tx_count_offset += 21;
+		memcpy( rx_voice, ambe_lfi_indicator, AMBE_Q_DATASIZE );
 	}
 	
-	if (p_max < 0)
+	rx_arb_stats.secondary_frames ++;
+	
+	if (rx_q_secondary != 0)
 	{
-		p_max = 0;
+		rx_q_secondary( s->source, RX_Q_SECONDARY_FRAME, p, rx_data, rx_voice );
 	}
 }
 
-static uint8_t last_valid_source = 0;
+// play the secondary streams in real time (at most two frames per call)
 
-int rx_q_process(uint8_t * pos, uint8_t * data, uint8_t * voice)
+static void rx_q_serve_secondary(void)
 {
-	// if (num_written < 8)  // pre-queue at least 8 ambe frames
-	//	return 0;
+	int i;
+	unsigned long now = rtclock_get_ticks();
 	
-	if (num_written == 0)
-		return 0;
+	for (i=0; i < RX_NUM_STREAMS; i++)
+	{
+		struct rx_stream * s = rx_streams + i;
+		int n = 0;
+		
+		while ((s->active != 0) && (s->secondary != 0) &&
+			(((long) (now - s->next_tick)) >= 0) && (n < 2))
+		{
+			rx_stream_forward(s);
+			s->next_tick += 20;
+			n ++;
+		}
 		
-	struct rx_q_buffer * rx_q_buf = rx_q_buffers[current_rx_buf];
+		if (((long) (now - s->next_tick)) > 0) // too late, don't catch up
+		{
+			s->next_tick = now;
+		}
+	}
+}
+
+static uint8_t rec_source; // source that is recorded, 0 = none
 
-/*		
-	char tmp_buf[6];
+static void rx_q_record(uint8_t source, const uint8_t * voice)
+{
+	if (rec_source != source)
+	{
+		uint8_t crc_result;
+		uint8_t header[39];
+		
+		rx_q_get_header(source, &crc_result, header);
+		recorder_start(REC_RX | source, header);
+		rec_source = source;
+	}
 	
-	vdisp_i2s( tmp_buf, 5, 10, 0, num_written );
-	vd_prints_xy(VDISP_DEBUG_LAYER, 108, 28, VDISP_FONT_4x6, 0, tmp_buf );
-	*/
-	switch (rx_q_buf[current_pos].source)
+	recorder_put_frame(voice);
+}
+
+static void rx_q_record_stop(void)
+{
+	if (rec_source != 0)
+	{
+		recorder_stop(REC_RX | rec_source);
+		rec_source = 0;
+	}
+}
+
+int rx_q_process(uint8_t * pos, uint8_t * data, uint8_t * voice)
+{
+	uint8_t p;
+	uint8_t rx_data[3];
+	uint8_t rx_voice[AMBE_Q_DATASIZE];
+	struct latency_tag tag;
+	
+	rx_q_serve_secondary();
+	
+	if (rx_q_arbitrate() != 0) // current stream was preempted
+	{
+		rx_q_record_stop();
+		last_valid_source = 0;
+		return 0;
+	}
+	
+	if (current_source == 0)
+	{
+		return 0;
+	}
+	
+	struct rx_stream * s = RX_STREAM(current_source);
+	
+	int res = rx_stream_get(s, &p, rx_data, rx_voice, &tag);
+	
+	switch (res)
 	{
+		case JITTER_Q_NONE: // idle or pre-buffering
+			return 0;
+			
 		case SOURCE_NET:
 		case SOURCE_PHY:
-			num_empty = 0;
-			last_valid_source = rx_q_buf[current_pos].source;
+			last_valid_source = res;
 			if (((hotspot_mode || repeater_mode)) && (last_valid_source == SOURCE_PHY))
 			{
 				feedback_call = false;
@@ -862,105 +1063,154 @@ int rx_q_process(uint8_t * pos, uint8_t * data, uint8_t * voice)
 			}
 			break;
 			
-		case SOURCE_STOP:
+		case JITTER_Q_STOP:
 			if (((hotspot_mode || repeater_mode)) && (last_valid_source == SOURCE_PHY))
 			{
 				feedback_call = true;	
 				phy_rx = false;
 			}
+			rx_q_record_stop();
 			current_source = 0; // switch off
-			num_written = 0; // stop processing
-			rx_q_buf[current_pos].source = 0; 
 			last_valid_source = 0;
-			current_pos = 0;
-			current_rx_buf = 0;
-			num_empty = 0;
-			rx_count_offset = 0;
 			return 0;
 			
-		default: // zero
+		default: // JITTER_Q_MISSING
 			
-			if (current_pos != 0)
-			{
-				rx_q_buf[current_pos].data[0] =  0x66;  // NOP
-				rx_q_buf[current_pos].data[1] =  0x66;
-				rx_q_buf[current_pos].data[2] =  0x66;
-			}
-		
-			ambe_expand_to_sd_data( rx_q_buf[current_pos].voice, ambe_lfi_indicator );
-		
-			num_empty ++;
-		
-			if (num_empty > 25) // too many empty frames
+			if (s->active == 0) // too many empty frames
 			{
+				rx_q_record_stop();
 				current_source = 0; // switch off
-				num_written = 0; // stop processing
 				last_valid_source = 0;
-				current_pos = 0;
-				current_rx_buf = 0;
-				num_empty = 0;
-				rx_count_offset = 0;
 				return 0;
 			}
 			
-			if ((rx_count_offset + current_pos) > (tx_count_offset + p_max))
-			{
-				set_tx_buf(-5); // insert empty 21 frames
-			}
+			memcpy( rx_voice, ambe_lfi_indicator, AMBE_Q_DATASIZE );
+			res = 0;
 			break;
-	}	
-		
-	if (current_pos != 0) // if not the sync position
+	}
+	
+	if (p < last_rx_pos)
 	{
-		processSlowData( current_pos, rx_q_buf[current_pos].data, rx_q_buf[current_pos].source );
+		current_rx_buf ^= 1;
 	}
-	else
+	last_rx_pos = p;
+		
+	slowdata_rx_frame( p, rx_data, res );
+	
+	if (p == 0) // sync position
 	{
-		rx_q_buf[0].data[0] =  0x55 ^ 0x70;  // sync pattern
-		rx_q_buf[0].data[1] =  0x2d ^ 0x4F;
-		rx_q_buf[0].data[2] =  0x16 ^ 0x93;
+		rx_data[0] =  0x55 ^ 0x70;  // sync pattern
+		rx_data[1] =  0x2d ^ 0x4F;
+		rx_data[2] =  0x16 ^ 0x93;
+		
+		rx_q_print_stats();
 	}		
 	
-	 
-	ambe_input_data_sd( rx_q_buf[current_pos].voice );
+	
+	rx_q_record( current_source, rx_voice );
+	
+	LATENCY_STAGE(&tag, LATENCY_JITTER_Q);
+	
+	ambe_input_data( rx_voice, &tag );
 	
 	if (pos != NULL)
 	{
-		*pos = current_pos;
+		*pos = p;
 	}
 	
 	if (data != NULL)
 	{
-		memcpy (data, rx_q_buf[current_pos].data, 3);
+		memcpy (data, rx_data, 3);
 	}
 	
 	if (voice != NULL)
 	{
-		ambe_reduce_sd_data( voice, rx_q_buf[current_pos].voice );
+		memcpy (voice, rx_voice, AMBE_Q_DATASIZE);
 	}
 	
+	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_rx_buf), 1, 0, 0, 1);
+	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_rx_buf), 3, 0, 0, 1);
+	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_rx_buf), 4, 0, 0, 1);
+	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_rx_buf), 5, 0, 0, 1);
 	
-	rx_q_buf[current_pos].source = 0; // mark this position as "processed"
-
-#define CALC_XPOS(a,b) (((a)<<1) + ((b)*42))
+	if (p < POS_LAST)
+	{
+		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p + 1, current_rx_buf), 5, 0, 1, 1);
+	}
+	else
+	{
+		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(0, current_rx_buf ^ 1), 5, 0, 1, 1);
+	}
+	
+	return last_valid_source;
+}
 
-	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(current_pos, current_rx_buf), 1, 0, 0, 1);
-	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(current_pos, current_rx_buf), 3, 0, 0, 1);
-	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(current_pos, current_rx_buf), 4, 0, 0, 1);
-	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(current_pos, current_rx_buf), 5, 0, 0, 1);
+int snmp_get_rx_stats ( int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	jitter_q_t * q = RX_STREAM(arg >> 4)->q;  // source in the upper nibble
 	
-	current_pos ++;
-	if (current_pos >= NUM_PACKETS_IN_FRAME)
+	switch (arg & 0x0F)
 	{
-		current_pos = 0;
-		current_rx_buf ^= 1; 
-		rx_count_offset += 21;
+		case 1:
+			value = q->stats.received;
+			break;
+		case 2:
+			value = q->stats.played;
+			break;
+		case 3:
+			value = q->stats.late;
+			break;
+		case 4:
+			value = q->stats.lost;
+			break;
+		case 5:
+			value = q->stats.duplicate;
+			break;
+		case 6:
+			value = q->stats.underrun;
+			break;
+		case 7:
+			value = q->stats.slip;
+			break;
+		case 8:
+			value = jitter_q_jitter_usec(q);
+			break;
+		case 9:
+			value = jitter_q_mean_latency_ms(q);
+			break;
+		case 10:
+			value = RX_STREAM(arg >> 4)->fec_errors;
+			break;
+		case 11:
+			value = rx_stream_ber(RX_STREAM(arg >> 4));
+			break;
 	}
 	
-	vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(current_pos, current_rx_buf), 5, 0, 1, 1);
-	 
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+int snmp_get_rx_arb_stats ( int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = rx_arb_stats.preempted;
+			break;
+		case 2:
+			value = rx_arb_stats.secondary_streams;
+			break;
+		case 3:
+			value = rx_arb_stats.secondary_frames;
+			break;
+		case 4:
+			value = rx_arb_stats.session_drop;
+			break;
+	}
 	
-	return last_valid_source;
+	return snmp_encode_int( value, res, res_len, maxlen );
 }
 
 bool dstarFeedbackCall(void)
@@ -984,56 +1234,65 @@ int dstarFeedbackHeader(void)
 	return feedback_header;
 }
 
-static void rx_q_input_stop( uint8_t source, uint16_t session, uint8_t pos ) 
+// the stream of source/session, 0 if the frame is not wanted
+
+static struct rx_stream * rx_q_stream( uint8_t source, uint16_t session )
 {
 	if (dcs_mode && (!(hotspot_mode || repeater_mode)) && (source == SOURCE_PHY))
-		return;
+		return 0;
 		
-	if ((source == current_source) && (session == current_session))
+	struct rx_stream * s = RX_STREAM(source);
+	
+	if ((s->active == 0) || (s->session != session))
+		return 0;
+	
+	return s;
+}
+
+static void rx_q_input_stop( uint8_t source, uint16_t session, uint8_t pos ) 
+{
+	capture_record( CAPTURE_STOP, source, session, pos, 0 );
+	
+	struct rx_stream * s = rx_q_stream( source, session );
+	
+	if (s != 0)
 	{
-		// current_source = 0;
-		
 		int p = pos & 0x1F;
 		
-		if (p >= NUM_PACKETS_IN_FRAME)
-		return;
-		
-		set_tx_buf(p);
-		
-		struct rx_q_buffer * rx_q_buf = rx_q_buffers[current_tx_buf];
+		int32_t seq = jitter_q_put_stop(s->q, p);
 		
-		rx_q_buf[p].source = SOURCE_STOP;
-		
-		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_tx_buf), 4, 0, 1, 1);
+		if ((seq >= 0) && (s->secondary == 0))
+		{
+			vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, SEQ_TO_BUF(seq)), 4, 0, 1, 1);
+		}
 	}
 }
 
 static void rx_q_input_data( uint8_t source, uint16_t session, uint8_t pos, const uint8_t * data )
 {
-	if (dcs_mode && (!(hotspot_mode || repeater_mode)) && (source == SOURCE_PHY))
-		return;
-		
-	if ((source == current_source) && (session == current_session))
+	capture_record( CAPTURE_DATA, source, session, pos, data );
+	
+	struct rx_stream * s = rx_q_stream( source, session );
+	
+	if (s != 0)
 	{
 		int p = pos & 0x1F;
 		
-		if (p >= NUM_PACKETS_IN_FRAME)
-			return;
-			
-		set_tx_buf(p);
-		
-		struct rx_q_buffer * rx_q_buf = rx_q_buffers[current_tx_buf];
+		int32_t seq = jitter_q_put_data(s->q, p, data);
 		
-		memcpy (rx_q_buf[p].data, data, 3);
-		
-		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_tx_buf), 3, 0, 1, 1);
+		if ((seq >= 0) && (s->secondary == 0))
+		{
+			vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, SEQ_TO_BUF(seq)), 3, 0, 1, 1);
+		}
 	}
 }
 
 
 
-static void rx_q_input_voice_sd ( uint8_t source, uint16_t session, uint8_t pos, const uint8_t * data )
+static void rx_q_input_voice ( uint8_t source, uint16_t session, uint8_t pos, const uint8_t * data )
 {
+	capture_record( CAPTURE_VOICE, source, session, pos, data );
+	
 	if (dcs_mode && (!(hotspot_mode || repeater_mode)) && (source == SOURCE_PHY))
 		return;
 		
@@ -1042,52 +1301,60 @@ static void rx_q_input_voice_sd ( uint8_t source, uint16_t session, uint8_t pos,
 	if (p >= NUM_PACKETS_IN_FRAME)
 		return;
 		
-	if (current_source == 0) // start new transmission
-	{
-		current_source = source;
-		current_session = session;
-		current_pos = pos;
-		current_tx_buf = 0;
-		tx_count_offset = 0;
-		p_max = 0;
-		num_empty = 0;
-		num_written = 0;
-	}
+	struct rx_stream * s = RX_STREAM(source);
 	
-	if ((source == current_source) && (session == current_session))
+	if (s->active == 0) // start new transmission
 	{
+		s->session = session;
+		s->secondary = 0;
+		s->num_empty = 0;
+		s->start_tick = rtclock_get_ticks();
+		s->fec_frames = 0;
+		s->fec_errors = 0;
 		
-			
-		set_tx_buf(p);
-			
-		struct rx_q_buffer * rx_q_buf = rx_q_buffers[current_tx_buf];
-		
-		rx_q_buf[p].source = source;
-		memcpy (rx_q_buf[p].voice, data, 36);
-		num_written ++;
-		
-		
-		
-		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, current_tx_buf), 1, 0, 1, 1);
+		jitter_q_reset(s->q);
+		jitter_q_set_depth(s->q, SETTING_CHAR(C_RX_JB_MIN_DEPTH), SETTING_CHAR(C_RX_JB_MAX_DEPTH));
 		
+		s->active = 1;
+	}
+	else if (s->session != session)
+	{
+		rx_arb_stats.session_drop ++;
+		return;
+	}
+	
+	struct latency_tag tag;
+	
+	LATENCY_GET_INPUT(source, &tag);
+	LATENCY_STAGE(&tag, LATENCY_INPUT);
+	
+	int32_t seq = jitter_q_put_voice(s->q, p, source, data, rtclock_get_ticks(), &tag);
+	
+	if ((seq >= 0) && (s->secondary == 0))
+	{
+		vd_set_pixel(VDISP_AUDIO_LAYER, CALC_XPOS(p, SEQ_TO_BUF(seq)), 1, 0, 1, 1);
 	}
 }
 
-static void rx_q_input_voice( uint8_t source, uint16_t session, uint8_t pos, const uint8_t * data )
+// the PHY delivers the SD format, the queues hold packed frames,
+// the soft decision values wait for the frame in ambeTask
+
+static void rx_q_input_voice_sd ( uint8_t source, uint16_t session, uint8_t pos, const uint8_t * data )
 {
-	uint8_t sdbuf[36];
+	uint8_t buf[AMBE_Q_DATASIZE];
 	
-	ambe_expand_to_sd_data( sdbuf, data );
+	ambe_reduce_sd_data( buf, data );
+	ambe_sd_hold_put( data, buf );
 	
-	rx_q_input_voice_sd ( source, session, pos, sdbuf );
+	rx_q_input_voice ( source, session, pos, buf );
 }
 
 static void rx_q_input_progress ( uint8_t source, uint16_t session, int packet_num )
 {
-	if (dcs_mode && (!(hotspot_mode || repeater_mode)) && (source == SOURCE_PHY))
+	if (source != current_source)
 		return;
 		
-	if ((source == current_source) && (session == current_session))
+	if (rx_q_stream( source, session ) != 0)
 	{
 		int secs = packet_num / 50;
 		
@@ -1105,8 +1372,15 @@ static struct rx_q_header_struct  rx_q_header[SOURCE_NET + 1];
 
 static void rx_q_input_header( uint8_t source, uint16_t session, uint8_t crc_result, const uint8_t * data )
 {
+	capture_record( CAPTURE_HEADER, source, session, crc_result, data );
+	
 	rx_q_header[source].crc_result = crc_result;
 	memcpy( rx_q_header[source].data, data, 39 );
+	
+	if (crc_result == 0)
+	{
+		lastheard_header( source, data );
+	}
 
 }
 
@@ -1218,7 +1492,6 @@ static void processPacket(void)
 				
 				if ( (dp.data[0] == 0x20) && (dp.dataLen >= 37) )
 				{
-					// ambe_input_data_sd( dp.data + 1 );
 					rx_q_input_voice_sd ( SOURCE_PHY, 0, pos_in_frame, dp.data + 1 );
 					
 					pos_in_frame ++;
@@ -1444,6 +1717,8 @@ static portTASK_FUNCTION( dstarRXTask, pvParameters )
 	{
 		if( xQueueReceive( dstarQueue, &dp, 500 ) )
 		{
+			LATENCY_SET_INPUT(SOURCE_PHY, &dp.tag);
+			
 			processPacket();
 		}
 		else
@@ -1483,6 +1758,20 @@ void dstar_get_header(uint8_t rx_source, uint8_t * crc_result, uint8_t * header_
 	}
 }
 
+// header of a source without printing it, used for the secondary stream
+
+void rx_q_get_header(uint8_t rx_source, uint8_t * crc_result, uint8_t * header_data)
+{
+	*crc_result = rx_q_header[rx_source].crc_result;
+	
+	if (*crc_result == 0) // header was OK, not yet seen
+	{
+		*crc_result = DSTAR_HEADER_OK;
+	}
+	
+	memcpy (header_data, rx_q_header[rx_source].data, 39);
+}
+
 /*
 
 static portTASK_FUNCTION( dstarRXTask2, pvParameters )
@@ -1554,7 +1843,7 @@ void dstarProcessDCSPacket( const uint8_t * data )
 	{
 		dcs_last_session = dcs_session;
 		
-		sdHeaderPos = 0;
+		slowdata_rx_reset();
 		
 		/*
 		vdisp_clear_rect (0, 0, 128, 64);
@@ -1683,7 +1972,7 @@ void dstarProcessDExtraPacket(const uint8_t* data)
 		{
 			dcs_last_session = dcs_session;
 
-			sdHeaderPos = 0;
+			slowdata_rx_reset();
 			dextra_packet_counter = 0;
 			
 			rx_q_input_header ( SOURCE_NET, dcs_session, 0, data + 15 );
@@ -1735,13 +2024,21 @@ void dstarInit( xQueueHandle dq )
 	
 	dstarQueue = dq;
 	
-	rx_q_buffers[0] = (struct rx_q_buffer * ) pvPortMalloc ( NUM_PACKETS_IN_FRAME * (sizeof (struct rx_q_buffer)));
-	rx_q_buffers[1] = (struct rx_q_buffer * ) pvPortMalloc ( NUM_PACKETS_IN_FRAME * (sizeof (struct rx_q_buffer)));
-	rx_q_buffers[2] = (struct rx_q_buffer * ) pvPortMalloc ( NUM_PACKETS_IN_FRAME * (sizeof (struct rx_q_buffer)));
-	rx_q_buffers[3] = (struct rx_q_buffer * ) pvPortMalloc ( NUM_PACKETS_IN_FRAME * (sizeof (struct rx_q_buffer)));
+	for (i=0; i < RX_NUM_STREAMS; i++)
+	{
+		rx_streams[i].source = i + 1;
+		rx_streams[i].q = (jitter_q_t *) pvPortMalloc ( sizeof (jitter_q_t) );
+		jitter_q_initialize(rx_streams[i].q);
+	}
 	
 
 	
+	capture_init();
+	
+	slowdata_register( SLOWDATA_TYPE_TEXT, sd_text_handler );
+	slowdata_register( SLOWDATA_TYPE_HEADER, sd_header_handler );
+	slowdata_register( SLOWDATA_TYPE_GPS, sd_gps_handler );
+	
 	snmpReqQueue = xQueueCreate( 3, sizeof (struct snmpReq) );
 	
 	xTaskCreate( dstarRXTask, ( signed char * ) "DstarRx", configMINIMAL_STACK_SIZE, NULL,
@@ -31,11 +31,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define DSTAR_H_
 
 
+#include "latency.h"
+
+
 struct dstarPacket
 {
 	unsigned char cmdByte;
 	unsigned char dataLen;
 	unsigned char data[100];
+#if LATENCY_STAMPS
+	struct latency_tag tag;  // time of the ETX
+#endif
 };
 
 #define SOURCE_PHY	1
@@ -69,6 +75,17 @@ void dstarProcessDCSPacket( const uint8_t * data );
 void dstarProcessDExtraPacket(const uint8_t* data);
 int rx_q_process(uint8_t * pos, uint8_t * data, uint8_t * voice);
 
+// events for the consumer of a stream that lost the RX arbitration
+#define RX_Q_SECONDARY_START	1
+#define RX_Q_SECONDARY_FRAME	2
+#define RX_Q_SECONDARY_END		3
+
+typedef void (* rx_q_secondary_func_t) (uint8_t source, int event, uint8_t pos,
+	const uint8_t * data, const uint8_t * voice);
+
+void rx_q_set_secondary(rx_q_secondary_func_t func);
+void rx_q_get_header(uint8_t rx_source, uint8_t * crc_result, uint8_t * header_data);
+
 void let_header_expire(void);
 void dstar_get_header(uint8_t rx_source, uint8_t * crc_result, uint8_t * header_data);
 void dstar_print_diagram(void);
@@ -0,0 +1,195 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dtmf.c
+ *
+ * DTMF detection on AMBE frames.
+ *
+ * The DTMF codes of the last DTMF_WINDOW frames are kept in a ring,
+ * the number of frames per code is updated when a frame enters and
+ * leaves the window. A digit is detected when it has on_count frames
+ * in the window and at least min_gap frames have passed since the end
+ * of the last digit. The digit ends when it has no more than off_count
+ * frames in the window.
+ *
+ * Detected digits are put into a small event queue, the command
+ * interpreter (dtmf_cmd_exec) takes them out after the transmission.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "ambe_fec.h"
+#include "dtmf.h"
+
+
+static uint8_t history[DTMF_WINDOW];
+static uint8_t history_pos;
+static uint8_t histogram[DTMF_NUM_CODES];
+
+static uint8_t on_count;
+static uint8_t off_count;
+static uint8_t min_gap;
+
+static uint8_t active_code;		// digit currently detected, 0 = none
+static uint16_t gap;			// frames since the end of the last digit
+static uint16_t frame;
+
+static struct dtmf_event event_q[DTMF_EVENT_Q_SIZE];
+static uint8_t event_in;
+static uint8_t event_out;
+
+
+void dtmf_detect_init(int on, int off, int g)
+{
+	int i;
+
+	if ((on < 1) || (on > DTMF_WINDOW)) // setting not initialized
+	{
+		on = DTMF_DEFAULT_ON_COUNT;
+		off = DTMF_DEFAULT_OFF_COUNT;
+	}
+
+	if (off >= on)
+	{
+		off = on - 1;
+	}
+	else if (off < 0)
+	{
+		off = 0;
+	}
+
+	on_count = on;
+	off_count = off;
+	min_gap = (g < 0) ? 0 : g;
+
+	for (i=0; i < DTMF_WINDOW; i++)
+	{
+		history[i] = 0;
+	}
+
+	for (i=0; i < DTMF_NUM_CODES; i++)
+	{
+		histogram[i] = 0;
+	}
+
+	histogram[0] = DTMF_WINDOW; // window is filled with "no DTMF"
+	history_pos = 0;
+
+	active_code = 0;
+	gap = min_gap;
+	frame = 0;
+
+	event_in = 0;
+	event_out = 0;
+}
+
+
+static void put_event(char digit)
+{
+	uint8_t next = (event_in + 1) & (DTMF_EVENT_Q_SIZE - 1);
+
+	if (next == event_out) // queue full, digit is dropped
+		return;
+
+	event_q[event_in].digit = digit;
+	event_q[event_in].frame = frame;
+	event_in = next;
+}
+
+
+int dtmf_detect_code(int code)
+{
+	int digit = 0;
+
+	if ((code < 0) || (code >= DTMF_NUM_CODES))
+	{
+		code = 0;
+	}
+
+	histogram[history[history_pos]] --;
+	history[history_pos] = code;
+	histogram[code] ++;
+
+	history_pos ++;
+	if (history_pos >= DTMF_WINDOW)
+	{
+		history_pos = 0;
+	}
+
+	if (active_code != 0)
+	{
+		if ((histogram[active_code] <= off_count) ||
+			((code != active_code) && (histogram[code] >= on_count)))
+		{
+			active_code = 0;  // end of the digit
+			gap = 0;
+		}
+	}
+
+	// only the code of this frame can reach the threshold
+
+	if ((active_code == 0) && (code != 0) &&
+		(histogram[code] >= on_count) && (gap >= min_gap))
+	{
+		active_code = code;
+		digit = dtmf_code_to_char(code);
+		put_event(digit);
+	}
+
+	if ((active_code == 0) && (gap < 0xFFFF))
+	{
+		gap ++;
+	}
+
+	frame ++;
+
+	return digit;
+}
+
+
+int dtmf_detect(const uint8_t * ambe_data, int * digit)
+{
+	int code = 0;
+
+	*digit = 0;
+
+	if (frame < DTMF_DETECT_TIME)
+	{
+		code = ambe_get_dtmf_code(ambe_data);
+
+		*digit = dtmf_detect_code(code);
+	}
+
+	return code;
+}
+
+
+int dtmf_get_event(struct dtmf_event * ev)
+{
+	if (event_out == event_in)
+		return 0;
+
+	*ev = event_q[event_out];
+	event_out = (event_out + 1) & (DTMF_EVENT_Q_SIZE - 1);
+
+	return 1;
+}
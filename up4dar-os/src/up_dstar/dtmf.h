@@ -0,0 +1,64 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dtmf.h
+ *
+ * DTMF detection on AMBE frames
+ *
+ */
+
+
+#ifndef DTMF_H_
+#define DTMF_H_
+
+
+#define DTMF_WINDOW			5		// sliding window (frames)
+#define DTMF_NUM_CODES		17		// 0 = no DTMF, 1..16 = digit
+#define DTMF_DETECT_TIME	250		// only the first 5 seconds of a transmission
+
+#define DTMF_DEFAULT_ON_COUNT	3
+#define DTMF_DEFAULT_OFF_COUNT	2
+
+#define DTMF_EVENT_Q_SIZE	8		// must be a power of two
+
+
+struct dtmf_event {
+	char digit;
+	uint16_t frame;		// frame number within the transmission
+};
+
+// on_count:  frames of a digit in the window to detect it
+// off_count: the digit ends when it has no more than off_count frames in the window
+// min_gap:   frames between the end of a digit and the next digit
+
+void dtmf_detect_init(int on_count, int off_count, int min_gap);
+
+// returns the DTMF code of the frame (0 = no DTMF),
+// *digit is the digit detected with this frame or 0
+int dtmf_detect(const uint8_t * ambe_data, int * digit);
+
+// returns the digit detected with this frame, 0 if none
+int dtmf_detect_code(int code);
+
+// returns 1 if an event was taken from the queue
+int dtmf_get_event(struct dtmf_event * ev);
+
+#endif /* DTMF_H_ */
@@ -0,0 +1,476 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * jitter_q.c
+ *
+ * Adaptive playout buffer for received D-STAR voice frames.
+ *
+ * Frames are stored by an absolute sequence number which is
+ * reconstructed from the 0..20 frame counter of the D-STAR stream.
+ * The playout starts when the buffer holds "target_depth" frames.
+ * target_depth follows the measured interarrival jitter and is kept
+ * between min_depth and max_depth. Later changes of the playout delay
+ * are only done in steps of one superframe (21 frames) so that the
+ * position of the slow data in the superframe is preserved.
+ *
+ * The code does not depend on any hardware, the arrival time of
+ * each frame is supplied by the caller.
+ */
+
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "gcc_builtin.h"
+
+#include "jitter_q.h"
+
+
+#define JITTER_Q_MASK  (JITTER_Q_SLOTS - 1)
+
+#define STATE_IDLE		0
+#define STATE_PREBUFFER	1
+#define STATE_PLAY		2
+
+#define SLIP_THRESHOLD	2	// late frames in a row before the playout is delayed
+
+#define FRAME_USEC	20000
+
+#define SEQ_START  (JITTER_Q_FRAMES_PER_SUPERFRAME * 4)  // keep sequence numbers positive
+
+
+static void clear_slot (struct jitter_q_slot * s, int32_t seq)
+{
+	s->seq = seq;
+	s->source = 0;
+	s->data[0] = 0x66;  // NOP
+	s->data[1] = 0x66;
+	s->data[2] = 0x66;
+}
+
+static void reset_queue (jitter_q_t * q)
+{
+	int i;
+
+	for (i=0; i < JITTER_Q_SLOTS; i++)
+	{
+		clear_slot( q->slot + i, -1 );
+	}
+
+	q->state = STATE_IDLE;
+	q->stop_seen = 0;
+	q->stall = 0;
+	q->late_in_row = 0;
+	q->last_arrival_seq = -1;
+}
+
+static void calc_target_depth (jitter_q_t * q)
+{
+	// three times the mean deviation covers nearly all arrivals
+	int d = q->min_depth + ((3 * (q->jitter >> 4)) + FRAME_USEC - 1) / FRAME_USEC;
+
+	if (d > q->max_depth)
+	{
+		d = q->max_depth;
+	}
+
+	q->target_depth = d;
+}
+
+
+void jitter_q_set_depth (jitter_q_t * q, int min_depth, int max_depth)
+{
+	if (min_depth < 1)
+	{
+		min_depth = JITTER_Q_DEFAULT_MIN_DEPTH;
+	}
+
+	if ((max_depth < min_depth) || (max_depth > (JITTER_Q_SLOTS - JITTER_Q_REORDER_WINDOW - 1)))
+	{
+		max_depth = JITTER_Q_DEFAULT_MAX_DEPTH;
+
+		if (max_depth < min_depth)
+		{
+			max_depth = min_depth;
+		}
+	}
+
+	q->min_depth = min_depth;
+	q->max_depth = max_depth;
+
+	calc_target_depth(q);
+}
+
+
+void jitter_q_initialize (jitter_q_t * q)
+{
+	q->mutex = xSemaphoreCreateMutex();
+
+	memset( & q->stats, 0, sizeof q->stats );
+	q->jitter = 0;
+	q->in_seq = SEQ_START;
+	q->out_seq = SEQ_START;
+
+	jitter_q_set_depth( q, JITTER_Q_DEFAULT_MIN_DEPTH, JITTER_Q_DEFAULT_MAX_DEPTH );
+
+	reset_queue(q);
+}
+
+
+void jitter_q_reset (jitter_q_t * q)
+{
+	if( xSemaphoreTake( q->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		reset_queue(q);
+		xSemaphoreGive( q->mutex );
+	}
+}
+
+
+// map the frame counter of the stream (0..20) to an absolute sequence number.
+// returns -1 if the frame has to be dropped
+
+static int32_t get_seq (jitter_q_t * q, uint8_t pos)
+{
+	int32_t seq;
+
+	if (pos >= JITTER_Q_FRAMES_PER_SUPERFRAME)
+	{
+		return -1;
+	}
+
+	if (q->state == STATE_IDLE)  // first frame of a new stream
+	{
+		seq = SEQ_START + pos;
+
+		q->in_seq = seq;
+		q->out_seq = seq;
+		q->state = STATE_PREBUFFER;
+
+		calc_target_depth(q);
+
+		return seq;
+	}
+
+	seq = q->in_seq - (q->in_seq % JITTER_Q_FRAMES_PER_SUPERFRAME) + pos;
+
+	if (seq > (q->in_seq + JITTER_Q_REORDER_WINDOW))
+	{
+		seq -= JITTER_Q_FRAMES_PER_SUPERFRAME;
+	}
+	else if (seq < (q->in_seq - JITTER_Q_REORDER_WINDOW))
+	{
+		seq += JITTER_Q_FRAMES_PER_SUPERFRAME;
+	}
+
+	if (seq < q->out_seq)  // too late, this frame was already played (or concealed)
+	{
+		q->stats.late ++;
+		q->late_in_row ++;
+
+		if ((q->late_in_row >= SLIP_THRESHOLD) && (q->state == STATE_PLAY) && (q->stall == 0)
+			&& ((q->in_seq - q->out_seq + 1 + JITTER_Q_FRAMES_PER_SUPERFRAME) <= q->max_depth))
+		{
+			// the delay is too short for this connection: play one superframe of
+			// fill-in frames, the stream keeps its position in the superframe
+			q->stall = JITTER_Q_FRAMES_PER_SUPERFRAME;
+			q->late_in_row = 0;
+			q->stats.slip ++;
+		}
+
+		return -1;
+	}
+
+	if ((seq - q->out_seq) >= JITTER_Q_SLOTS)  // far ahead of the playout: resync
+	{
+		q->stats.lost += (seq - q->out_seq) - q->target_depth + 1;
+		q->out_seq = seq - q->target_depth + 1;
+	}
+
+	if (seq > q->in_seq)
+	{
+		q->in_seq = seq;
+	}
+
+	return seq;
+}
+
+static struct jitter_q_slot * get_slot (jitter_q_t * q, int32_t seq)
+{
+	struct jitter_q_slot * s = q->slot + (seq & JITTER_Q_MASK);
+
+	if (s->seq != seq) // slot contains old data
+	{
+		clear_slot(s, seq);
+	}
+
+	return s;
+}
+
+static void update_jitter (jitter_q_t * q, int32_t seq, unsigned long arrival_ms)
+{
+	if (seq <= q->last_arrival_seq) // only in-order frames give a usable measurement
+	{
+		return;
+	}
+
+	if (q->last_arrival_seq >= 0)
+	{
+		long d = ((long) (arrival_ms - q->last_arrival)) * 1000
+			- (seq - q->last_arrival_seq) * FRAME_USEC;
+
+		if (d < 0)
+		{
+			d = -d;
+		}
+
+		q->jitter += d - ((q->jitter + 8) >> 4);
+	}
+
+	q->last_arrival = arrival_ms;
+	q->last_arrival_seq = seq;
+}
+
+
+int32_t jitter_q_put_voice (jitter_q_t * q, uint8_t pos, uint8_t source, const uint8_t * voice,
+	unsigned long arrival_ms, const struct latency_tag * tag)
+{
+	int32_t seq = -1;
+
+	if( xSemaphoreTake( q->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		seq = get_seq(q, pos);
+
+		if (seq >= 0)
+		{
+			struct jitter_q_slot * s = get_slot(q, seq);
+
+			q->late_in_row = 0;
+
+			if (s->source != 0)
+			{
+				q->stats.duplicate ++;
+				seq = -1;
+			}
+			else
+			{
+				s->source = source;
+				memcpy (s->voice, voice, AMBE_Q_DATASIZE);
+#if LATENCY_STAMPS
+				s->tag = *tag;
+#endif
+				q->stats.received ++;
+
+				update_jitter(q, seq, arrival_ms);
+
+				if (q->state == STATE_PREBUFFER)
+				{
+					calc_target_depth(q);
+				}
+			}
+		}
+
+		xSemaphoreGive( q->mutex );
+	}
+
+	return seq;
+}
+
+
+int32_t jitter_q_put_data (jitter_q_t * q, uint8_t pos, const uint8_t * data)
+{
+	int32_t seq = -1;
+
+	if( xSemaphoreTake( q->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		if (q->state != STATE_IDLE)
+		{
+			seq = get_seq(q, pos);
+
+			if (seq >= 0)
+			{
+				struct jitter_q_slot * s = get_slot(q, seq);
+
+				memcpy (s->data, data, 3);
+			}
+		}
+
+		xSemaphoreGive( q->mutex );
+	}
+
+	return seq;
+}
+
+
+int32_t jitter_q_put_stop (jitter_q_t * q, uint8_t pos)
+{
+	int32_t seq = -1;
+
+	if( xSemaphoreTake( q->mutex, 0 ) == pdTRUE )  // get Mutex, don't wait
+	{
+		if (q->state != STATE_IDLE)
+		{
+			seq = get_seq(q, pos);
+
+			if (seq >= 0)
+			{
+				struct jitter_q_slot * s = get_slot(q, seq);
+
+				s->source = JITTER_Q_STOP;
+				q->stop_seen = 1;
+			}
+		}
+
+		xSemaphoreGive( q->mutex );
+	}
+
+	return seq;
+}
+
+
+int jitter_q_get (jitter_q_t * q, uint8_t * pos, uint8_t * data, uint8_t * voice,
+	struct latency_tag * tag)
+{
+	int ret = JITTER_Q_NONE;
+
+	LATENCY_CLEAR(tag);
+
+	if( xSemaphoreTake( q->mutex, 0 ) != pdTRUE )  // get Mutex, don't wait
+	{
+		return JITTER_Q_NONE;
+	}
+
+	if (q->state == STATE_PREBUFFER)
+	{
+		if (((q->in_seq - q->out_seq + 1) >= q->target_depth) || (q->stop_seen != 0))
+		{
+			q->state = STATE_PLAY;
+		}
+	}
+
+	if (q->state == STATE_PLAY)
+	{
+		if (q->stall > 0)
+		{
+			// keep the frame counter running, out_seq - stall is congruent to
+			// the frames that were played before
+			*pos = (q->out_seq - q->stall) % JITTER_Q_FRAMES_PER_SUPERFRAME;
+			data[0] = 0x66;  // NOP
+			data[1] = 0x66;
+			data[2] = 0x66;
+			q->stall --;
+			q->stats.underrun ++;
+			ret = JITTER_Q_MISSING;
+		}
+		else
+		{
+			struct jitter_q_slot * s = q->slot + (q->out_seq & JITTER_Q_MASK);
+
+			*pos = q->out_seq % JITTER_Q_FRAMES_PER_SUPERFRAME;
+
+			if ((s->seq == q->out_seq) && (s->source != 0))
+			{
+				ret = s->source;
+
+				if (ret == JITTER_Q_STOP)
+				{
+					reset_queue(q);
+				}
+				else
+				{
+					memcpy (data, s->data, 3);
+					memcpy (voice, s->voice, AMBE_Q_DATASIZE);
+#if LATENCY_STAMPS
+					*tag = s->tag;
+#endif
+
+					q->stats.played ++;
+					q->stats.latency_sum += q->in_seq - q->out_seq + 1;
+				}
+			}
+			else
+			{
+				if (s->seq == q->out_seq)
+				{
+					memcpy (data, s->data, 3);  // data without voice
+				}
+				else
+				{
+					data[0] = 0x66;  // NOP
+					data[1] = 0x66;
+					data[2] = 0x66;
+				}
+
+				if (q->in_seq > q->out_seq)
+				{
+					q->stats.lost ++;  // later frames are already there
+				}
+				else
+				{
+					q->stats.underrun ++;  // buffer ran empty
+				}
+
+				ret = JITTER_Q_MISSING;
+			}
+
+			if (ret != JITTER_Q_STOP)
+			{
+				s->source = 0;
+				q->out_seq ++;
+
+				if (q->out_seq > (q->in_seq + 1))
+				{
+					q->in_seq = q->out_seq - 1;
+				}
+			}
+		}
+	}
+
+	xSemaphoreGive( q->mutex );
+
+	return ret;
+}
+
+
+int jitter_q_depth (jitter_q_t * q)
+{
+	if (q->state == STATE_IDLE)
+	{
+		return 0;
+	}
+
+	return q->in_seq - q->out_seq + 1;
+}
+
+int jitter_q_jitter_usec (jitter_q_t * q)
+{
+	return q->jitter >> 4;
+}
+
+int jitter_q_mean_latency_ms (jitter_q_t * q)
+{
+	if (q->stats.played == 0)
+	{
+		return 0;
+	}
+
+	return (q->stats.latency_sum / q->stats.played) * (FRAME_USEC / 1000);
+}
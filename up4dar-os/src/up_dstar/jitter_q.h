@@ -0,0 +1,113 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * jitter_q.h
+ *
+ * Adaptive playout buffer for received D-STAR voice frames
+ *
+ */
+
+
+#ifndef JITTER_Q_H_
+#define JITTER_Q_H_
+
+
+#include <FreeRTOS.h>
+
+#include "semphr.h"
+
+#include "ambe_q.h"
+#include "latency.h"
+
+
+#define JITTER_Q_SLOTS				64		// must be a power of two
+#define JITTER_Q_FRAMES_PER_SUPERFRAME	21
+
+#define JITTER_Q_REORDER_WINDOW		10		// frames, must be < (FRAMES_PER_SUPERFRAME / 2)
+
+#define JITTER_Q_DEFAULT_MIN_DEPTH	2		// frames (20ms each)
+#define JITTER_Q_DEFAULT_MAX_DEPTH	42
+
+// return values of jitter_q_get() besides the source tag of a played frame
+#define JITTER_Q_NONE		0		// idle or still pre-buffering
+#define JITTER_Q_MISSING	0xFE	// frame not available, caller has to conceal
+#define JITTER_Q_STOP		0xFF	// end of transmission reached
+
+
+struct jitter_q_slot {
+	int32_t seq;
+	uint8_t source;   // 0 = no voice in this slot
+	uint8_t data[3];
+	uint8_t voice[AMBE_Q_DATASIZE];
+#if LATENCY_STAMPS
+	struct latency_tag tag;
+#endif
+};
+
+struct jitter_q_stats {
+	uint32_t received;
+	uint32_t played;
+	uint32_t late;
+	uint32_t lost;
+	uint32_t duplicate;
+	uint32_t underrun;
+	uint32_t slip;
+	uint32_t latency_sum;   // sum of buffer depth (frames) seen by every played frame
+};
+
+struct jitter_q {
+	struct jitter_q_slot slot[JITTER_Q_SLOTS];
+	int32_t in_seq;    // highest sequence number received
+	int32_t out_seq;   // next sequence number to be played
+	short state;
+	short stop_seen;
+	short target_depth;
+	short min_depth;
+	short max_depth;
+	short stall;       // filler frames still to be played (superframe slip)
+	short late_in_row;
+	long jitter;       // interarrival jitter (RFC 3550) in usec, multiplied by 16
+	unsigned long last_arrival;
+	int32_t last_arrival_seq;
+	struct jitter_q_stats stats;
+	xSemaphoreHandle mutex;
+};
+
+typedef struct jitter_q jitter_q_t;
+
+void jitter_q_initialize (jitter_q_t * q);
+void jitter_q_set_depth (jitter_q_t * q, int min_depth, int max_depth);
+void jitter_q_reset (jitter_q_t * q);
+
+int32_t jitter_q_put_voice (jitter_q_t * q, uint8_t pos, uint8_t source, const uint8_t * voice,
+	unsigned long arrival_ms, const struct latency_tag * tag);
+int32_t jitter_q_put_data (jitter_q_t * q, uint8_t pos, const uint8_t * data);
+int32_t jitter_q_put_stop (jitter_q_t * q, uint8_t pos);
+
+// tag is set to the time stamps of the voice frame, cleared if there is none
+int jitter_q_get (jitter_q_t * q, uint8_t * pos, uint8_t * data, uint8_t * voice,
+	struct latency_tag * tag);
+
+int jitter_q_depth (jitter_q_t * q);
+int jitter_q_jitter_usec (jitter_q_t * q);
+int jitter_q_mean_latency_ms (jitter_q_t * q);
+
+#endif /* JITTER_Q_H_ */
@@ -0,0 +1,803 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * lastheard.c
+ *
+ * Last-heard list. The entries are in a fixed array, a hash table with
+ * open addressing (linear probing) finds the entry of a callsign. The
+ * entries are also in a doubly linked list, newest first. When the
+ * array is full the oldest entry is reused, its hash slot is freed by
+ * moving the following entries of the probe sequence back (no deleted
+ * markers, the probe sequences stay short). Update and lookup are O(1),
+ * they run in the RX path with interrupts disabled for a few microseconds.
+ *
+ * The list is written to the aux area of the recorder (the area was
+ * formatted via SNMP, nothing else on the card is touched). There are
+ * two slots, a save goes to the older one, block 0 last, so the slot
+ * becomes valid only when it is complete. All transfers are queued to
+ * the SD card task, the next block is started in the completion callback.
+ */
+
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "gcc_builtin.h"
+
+#include "rtclock.h"
+#include "recorder.h"
+#include "lastheard.h"
+
+#include "up_io/sdcard.h"
+#include "up_net/snmp_data.h"
+
+
+#define LH_NONE				0xFF
+#define LH_NUM_SOURCES		3		// SOURCE_PHY, SOURCE_NET (dstar.h)
+
+// block of a slot (values big-endian):
+//  byte 0..3    magic
+//  byte 4..7    sequence number of the save
+//  byte 8       version
+//  byte 9       block number within the slot
+//  byte 10      number of entries in the block
+//  byte 12..    entries (LH_INFO_LEN bytes each)
+//  byte 508..511  checksum of bytes 0..507
+
+#define LH_VERSION			1
+#define LH_BLOCK_HDRLEN		12
+#define LH_ENTRIES_PER_BLOCK	((REC_BLOCK_SIZE - LH_BLOCK_HDRLEN - 4) / LH_INFO_LEN)
+#define LH_CHECKSUM_POS		(REC_BLOCK_SIZE - 4)
+
+#define LH_IO_IDLE			0
+#define LH_IO_PROBE			1	// block 0 of both slots
+#define LH_IO_LOAD			2
+#define LH_IO_SAVE			3
+
+static const char lh_magic[] = "UPLH";
+
+struct lh_entry
+{
+	char call[8];
+	char ext[4];
+	char rpt1[8];
+	char rpt2[8];
+	uint32_t time;
+	uint16_t count;
+	uint16_t duration;
+	uint16_t ber;
+	uint8_t source;
+	uint8_t slot;		// position in the hash table
+	uint8_t home;		// hash of the callsign
+	uint8_t prev;		// newer entry
+	uint8_t next;		// older entry
+};
+
+static struct lh_entry entries[LH_NUM_ENTRIES];
+static uint8_t hash_tab[LH_HASH_SIZE];	// entry + 1, 0 = free
+static uint8_t newest = LH_NONE;
+static uint8_t oldest = LH_NONE;
+static uint8_t num_entries;
+
+static char cur_call[LH_NUM_SOURCES][8];	// transmission in progress
+
+static volatile uint8_t dirty;
+static volatile uint8_t save_request;
+static uint8_t walk_pos;	// SNMP table walk
+
+static struct sdcard_request io_req;
+static uint8_t io_buf[REC_BLOCK_SIZE];
+static volatile uint8_t io_state = LH_IO_IDLE;
+static uint8_t io_slot;
+static uint8_t io_blk;
+static uint32_t aux_start;		// card the list was loaded from, 0 = not loaded
+static uint32_t probe_seq[2];
+static uint32_t save_seq;		// of the next save
+static uint8_t save_slot;
+static uint8_t save_order[LH_NUM_ENTRIES];	// entries at the start of the save
+static uint8_t save_count;
+static portTickType save_time;
+static uint32_t saves;
+
+
+static void put32 (uint8_t * p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static uint32_t get32 (const uint8_t * p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put16 (uint8_t * p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static uint16_t get16 (const uint8_t * p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+
+// FNV-1a
+
+static uint8_t lh_hash (const char * call)
+{
+	uint32_t h = 2166136261UL;
+	int i;
+	
+	for (i=0; i < 8; i++)
+	{
+		h ^= (uint8_t) call[i];
+		h *= 16777619UL;
+	}
+	
+	return (h ^ (h >> 16)) & (LH_HASH_SIZE - 1);
+}
+
+
+static int lh_lookup (const char * call)
+{
+	int i = lh_hash(call);
+	
+	for (;;) // there is always a free slot
+	{
+		int e = hash_tab[i];
+		
+		if (e == 0)
+			return -1;
+		
+		if (memcmp(entries[e - 1].call, call, 8) == 0)
+			return e - 1;
+		
+		i = (i + 1) & (LH_HASH_SIZE - 1);
+	}
+}
+
+
+static void lh_hash_remove (int e)
+{
+	int i = entries[e].slot;
+	int j = i;
+	
+	hash_tab[i] = 0;
+	
+	for (;;)
+	{
+		j = (j + 1) & (LH_HASH_SIZE - 1);
+		
+		int k = hash_tab[j];
+		
+		if (k == 0)
+			break;
+		
+		// the entry can move to the free slot if the slot is on its probe sequence
+		if (((j - entries[k - 1].home) & (LH_HASH_SIZE - 1)) >= ((j - i) & (LH_HASH_SIZE - 1)))
+		{
+			hash_tab[i] = k;
+			entries[k - 1].slot = i;
+			hash_tab[j] = 0;
+			i = j;
+		}
+	}
+}
+
+
+static void lh_unlink (int e)
+{
+	struct lh_entry * p = entries + e;
+	
+	if (p->prev == LH_NONE)
+	{
+		newest = p->next;
+	}
+	else
+	{
+		entries[p->prev].next = p->next;
+	}
+	
+	if (p->next == LH_NONE)
+	{
+		oldest = p->prev;
+	}
+	else
+	{
+		entries[p->next].prev = p->prev;
+	}
+}
+
+
+static void lh_link_newest (int e)
+{
+	entries[e].prev = LH_NONE;
+	entries[e].next = newest;
+	
+	if (newest == LH_NONE)
+	{
+		oldest = e;
+	}
+	else
+	{
+		entries[newest].prev = e;
+	}
+	
+	newest = e;
+}
+
+
+static void lh_link_oldest (int e)
+{
+	entries[e].next = LH_NONE;
+	entries[e].prev = oldest;
+	
+	if (oldest == LH_NONE)
+	{
+		newest = e;
+	}
+	else
+	{
+		entries[oldest].next = e;
+	}
+	
+	oldest = e;
+}
+
+
+// new entry for call, the oldest one is reused if the list is full
+// (only for a new station, not for entries loaded from the card)
+
+static int lh_new (const char * call, int is_new)
+{
+	int e;
+	
+	if (num_entries < LH_NUM_ENTRIES)
+	{
+		e = num_entries;
+		num_entries ++;
+	}
+	else
+	{
+		if (is_new == 0)
+			return -1;
+		
+		e = oldest;
+		lh_unlink(e);
+		lh_hash_remove(e);
+	}
+	
+	struct lh_entry * p = entries + e;
+	
+	memset(p, 0, sizeof (struct lh_entry));
+	memcpy(p->call, call, 8);
+	
+	int i = lh_hash(call);
+	
+	p->home = i;
+	
+	while (hash_tab[i] != 0)
+	{
+		i = (i + 1) & (LH_HASH_SIZE - 1);
+	}
+	
+	hash_tab[i] = e + 1;
+	p->slot = i;
+	
+	if (is_new)
+	{
+		lh_link_newest(e);
+	}
+	else
+	{
+		lh_link_oldest(e);
+	}
+	
+	return e;
+}
+
+
+static void lh_clear (void)
+{
+	memset(hash_tab, 0, sizeof hash_tab);
+	newest = LH_NONE;
+	oldest = LH_NONE;
+	num_entries = 0;
+	memset(cur_call, 0, sizeof cur_call);
+}
+
+
+static void lh_info (const struct lh_entry * p, uint8_t * info)
+{
+	memcpy(info, p->call, 8);
+	memcpy(info + 8, p->ext, 4);
+	memcpy(info + 12, p->rpt1, 8);
+	memcpy(info + 20, p->rpt2, 8);
+	put32(info + 28, p->time);
+	put16(info + 32, p->count);
+	put16(info + 34, p->duration);
+	put16(info + 36, p->ber);
+	info[38] = p->source;
+	info[39] = 0;
+}
+
+
+// ----- RX path -----
+
+void lastheard_header (uint8_t source, const uint8_t * header)
+{
+	const char * call = (const char *) header + 27;
+	
+	if ((source >= LH_NUM_SOURCES) || (call[0] == ' ') || (call[0] == 0))
+		return;
+	
+	portENTER_CRITICAL();
+	
+	int e = lh_lookup(call);
+	
+	if (e < 0)
+	{
+		e = lh_new(call, 1);
+	}
+	else if (e != newest)
+	{
+		lh_unlink(e);
+		lh_link_newest(e);
+	}
+	
+	struct lh_entry * p = entries + e;
+	
+	memcpy(p->rpt2, header + 3, 8);
+	memcpy(p->rpt1, header + 11, 8);
+	memcpy(p->ext, header + 35, 4);
+	p->time = the_clock;
+	p->count ++;
+	p->duration = 0;
+	p->ber = 0;
+	p->source = source;
+	
+	memcpy(cur_call[source], call, 8);
+	dirty = 1;
+	
+	portEXIT_CRITICAL();
+}
+
+
+void lastheard_end (uint8_t source, uint32_t frames, uint16_t ber)
+{
+	if ((source >= LH_NUM_SOURCES) || (cur_call[source][0] == 0))
+		return;
+	
+	portENTER_CRITICAL();
+	
+	int e = lh_lookup(cur_call[source]);
+	
+	if (e >= 0)
+	{
+		entries[e].duration = (frames > 0xFFFF) ? 0xFFFF : frames;
+		entries[e].ber = ber;
+		dirty = 1;
+	}
+	
+	cur_call[source][0] = 0;
+	
+	portEXIT_CRITICAL();
+}
+
+
+// ----- any task -----
+
+int lastheard_count (void)
+{
+	return num_entries;
+}
+
+
+int lastheard_get (int n, uint8_t * info)
+{
+	int res = 1;
+	
+	portENTER_CRITICAL();
+	
+	int e = newest;
+	
+	while ((n > 0) && (e != LH_NONE))
+	{
+		e = entries[e].next;
+		n --;
+	}
+	
+	if ((n == 0) && (e != LH_NONE))
+	{
+		lh_info(entries + e, info);
+		res = 0;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return res;
+}
+
+
+int lastheard_find (const char * call, uint8_t * info)
+{
+	int res = 1;
+	
+	portENTER_CRITICAL();
+	
+	int e = lh_lookup(call);
+	
+	if (e >= 0)
+	{
+		lh_info(entries + e, info);
+		res = 0;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return res;
+}
+
+
+// ----- SD card -----
+
+static uint32_t lh_checksum (const uint8_t * p)
+{
+	uint32_t sum = 0;
+	int i;
+	
+	for (i=0; i < LH_CHECKSUM_POS; i += 4)
+	{
+		sum = ((sum << 1) | (sum >> 31)) + get32(p + i);
+	}
+	
+	return sum;
+}
+
+
+static int lh_block_valid (const uint8_t * p, int blk)
+{
+	return (memcmp(p, lh_magic, 4) == 0) &&
+		(p[8] == LH_VERSION) &&
+		(p[9] == blk) &&
+		(p[10] <= LH_ENTRIES_PER_BLOCK) &&
+		(get32(p + LH_CHECKSUM_POS) == lh_checksum(p));
+}
+
+
+// loaded entries are older than the ones heard since the start
+
+static void lh_merge_block (const uint8_t * p)
+{
+	int i;
+	
+	for (i=0; i < p[10]; i++)
+	{
+		const uint8_t * info = p + LH_BLOCK_HDRLEN + (i * LH_INFO_LEN);
+		
+		portENTER_CRITICAL();
+		
+		if (lh_lookup((const char *) info) < 0)
+		{
+			int e = lh_new((const char *) info, 0);
+			
+			if (e >= 0)
+			{
+				struct lh_entry * q = entries + e;
+				
+				memcpy(q->ext, info + 8, 4);
+				memcpy(q->rpt1, info + 12, 8);
+				memcpy(q->rpt2, info + 20, 8);
+				q->time = get32(info + 28);
+				q->count = get16(info + 32);
+				q->duration = get16(info + 34);
+				q->ber = get16(info + 36);
+				q->source = info[38];
+			}
+		}
+		
+		portEXIT_CRITICAL();
+	}
+}
+
+
+static void lh_fill_block (int blk)
+{
+	int n = 0;
+	int r;
+	
+	memset(io_buf, 0, REC_BLOCK_SIZE);
+	memcpy(io_buf, lh_magic, 4);
+	put32(io_buf + 4, save_seq);
+	io_buf[8] = LH_VERSION;
+	io_buf[9] = blk;
+	
+	for (r = blk * LH_ENTRIES_PER_BLOCK; (r < save_count) && (n < LH_ENTRIES_PER_BLOCK); r++)
+	{
+		portENTER_CRITICAL();
+		lh_info(entries + save_order[r], io_buf + LH_BLOCK_HDRLEN + (n * LH_INFO_LEN));
+		portEXIT_CRITICAL();
+		n ++;
+	}
+	
+	io_buf[10] = n;
+	put32(io_buf + LH_CHECKSUM_POS, lh_checksum(io_buf));
+}
+
+
+static void lh_io_error (void)
+{
+	if (io_state == LH_IO_SAVE)
+	{
+		dirty = 1; // save again later, to the same slot
+	}
+	else
+	{
+		aux_start = 0; // load again
+	}
+	
+	io_state = LH_IO_IDLE;
+}
+
+
+static void lh_submit (int op, int slot, int blk)
+{
+	io_slot = slot;
+	io_blk = blk;
+	
+	io_req.op = op;
+	io_req.blk = aux_start + (slot * LH_SLOT_BLOCKS) + blk;
+	io_req.count = 1;
+	
+	if (sdcard_submit(& io_req) != 0)
+	{
+		lh_io_error();
+	}
+}
+
+
+// SD card task
+
+static void lh_io_done (struct sdcard_request * req)
+{
+	if (req->result != 0)
+	{
+		lh_io_error();
+		return;
+	}
+	
+	switch (io_state)
+	{
+		case LH_IO_PROBE:
+			probe_seq[io_slot] = lh_block_valid(io_buf, 0) ? get32(io_buf + 4) : 0;
+			
+			if (io_slot == 0)
+			{
+				lh_submit(SDCARD_OP_READ, 1, 0);
+				return;
+			}
+			
+			io_slot = (probe_seq[1] > probe_seq[0]) ? 1 : 0;
+			save_seq = probe_seq[io_slot] + 1;
+			save_slot = io_slot ^ 1;
+			
+			if (probe_seq[io_slot] == 0) // nothing saved yet
+			{
+				break;
+			}
+			
+			io_state = LH_IO_LOAD;
+			lh_submit(SDCARD_OP_READ, io_slot, 0);
+			return;
+		
+		case LH_IO_LOAD:
+			if (lh_block_valid(io_buf, io_blk) && (get32(io_buf + 4) == probe_seq[io_slot]))
+			{
+				lh_merge_block(io_buf);
+			}
+			
+			if ((io_blk + 1) < LH_SLOT_BLOCKS)
+			{
+				lh_submit(SDCARD_OP_READ, io_slot, io_blk + 1);
+				return;
+			}
+			break;
+		
+		case LH_IO_SAVE:
+			if (io_blk > 0)
+			{
+				lh_fill_block(io_blk - 1);
+				lh_submit(SDCARD_OP_WRITE, io_slot, io_blk - 1);
+				return;
+			}
+			
+			save_slot ^= 1;
+			save_seq ++;
+			saves ++;
+			break;
+	}
+	
+	io_state = LH_IO_IDLE;
+}
+
+
+static void lh_save (void)
+{
+	int e;
+	
+	portENTER_CRITICAL();
+	
+	save_count = 0;
+	
+	for (e = newest; e != LH_NONE; e = entries[e].next)
+	{
+		save_order[save_count] = e;
+		save_count ++;
+	}
+	
+	dirty = 0;
+	
+	portEXIT_CRITICAL();
+	
+	save_time = xTaskGetTickCount();
+	
+	io_state = LH_IO_SAVE;
+	lh_fill_block(LH_SLOT_BLOCKS - 1);
+	lh_submit(SDCARD_OP_WRITE, save_slot, LH_SLOT_BLOCKS - 1);
+}
+
+
+void lastheard_service (void)
+{
+	if (io_state != LH_IO_IDLE)
+		return;
+	
+	uint32_t aux = recorder_aux_start();
+	
+	if (aux != aux_start) // card changed
+	{
+		aux_start = aux;
+		
+		if (aux != 0)
+		{
+			io_req.buf = io_buf;
+			io_req.callback = lh_io_done;
+			
+			io_state = LH_IO_PROBE;
+			lh_submit(SDCARD_OP_READ, 0, 0);
+		}
+		return;
+	}
+	
+	if ((aux_start != 0) && (dirty || save_request) &&
+		(save_request || ((xTaskGetTickCount() - save_time) >= (LH_SAVE_INTERVAL * configTICK_RATE_HZ))))
+	{
+		save_request = 0;
+		lh_save();
+	}
+}
+
+
+int snmp_get_lastheard (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = num_entries;
+			break;
+		
+		case 2:
+			value = walk_pos;
+			break;
+		
+		case 4:
+			value = saves;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+
+int snmp_set_lastheard (int32_t arg, const uint8_t * req, int req_len)
+{
+	int value = 0;
+	int i;
+	
+	if ((req_len < 1) || (req_len > 4))
+	{
+		return 1;
+	}
+	
+	for (i=0; i < req_len; i++)
+	{
+		value = (value << 8) | req[i];
+	}
+	
+	switch (arg)
+	{
+		case 1: // 0 = clear the list
+			if (value != 0)
+			{
+				return 1;
+			}
+			
+			portENTER_CRITICAL();
+			lh_clear();
+			dirty = 1;
+			portEXIT_CRITICAL();
+			walk_pos = 0;
+			break;
+		
+		case 2:
+			if ((value < 0) || (value >= LH_NUM_ENTRIES))
+			{
+				return 1;
+			}
+			
+			walk_pos = value;
+			break;
+		
+		case 4: // 1 = save now
+			if (value != 1)
+			{
+				return 1;
+			}
+			
+			save_request = 1;
+			break;
+		
+		default:
+			return 1;
+	}
+	
+	return 0;
+}
+
+
+// entries from the walk position on, as many as fit into the response,
+// every read moves the position, an empty string ends the walk
+
+int snmp_get_lastheard_table (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int len = 0;
+	
+	while (((len + LH_INFO_LEN) <= maxlen) && (lastheard_get(walk_pos, res + len) == 0))
+	{
+		len += LH_INFO_LEN;
+		walk_pos ++;
+	}
+	
+	if (len == 0)
+	{
+		walk_pos = 0;
+	}
+	
+	*res_len = len;
+	return 0;
+}
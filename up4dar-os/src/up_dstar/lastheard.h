@@ -0,0 +1,74 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * lastheard.h
+ *
+ * Stations heard on RF and from the network
+ *
+ */
+
+
+#ifndef LASTHEARD_H_
+#define LASTHEARD_H_
+
+
+#define LH_NUM_ENTRIES		64		// max. 255
+#define LH_HASH_SIZE		128		// slots, power of two, at least 2 * LH_NUM_ENTRIES
+
+// entry as stored and returned (values big-endian)
+//
+//  byte 0..7    callsign (MY)
+//  byte 8..11   callsign extension (MY2)
+//  byte 12..19  RPT1
+//  byte 20..27  RPT2
+//  byte 28..31  last heard (seconds of the real time clock, start of the transmission)
+//  byte 32..33  number of transmissions
+//  byte 34..35  duration of the last transmission (frames, 20ms)
+//  byte 36..37  BER of the last transmission (0.01%)
+//  byte 38      source (SOURCE_PHY / SOURCE_NET)
+//  byte 39      0
+
+#define LH_INFO_LEN			40
+
+// the list is saved to the aux area of the recorder on the SD card,
+// two copies, the newer valid one is loaded
+
+#define LH_SLOT_BLOCKS		6
+#define LH_SAVE_INTERVAL	300		// seconds between saves (if the list has changed)
+
+
+// RX path, the header with correct CRC starts a transmission
+void lastheard_header (uint8_t source, const uint8_t * header);
+void lastheard_end (uint8_t source, uint32_t frames, uint16_t ber);
+
+// n = 0 is the station heard last, returns 0 if the entry exists
+int lastheard_get (int n, uint8_t * info);
+
+// returns 0 if the callsign (8 characters) is in the list
+int lastheard_find (const char * call, uint8_t * info);
+
+int lastheard_count (void);
+
+// service task: loads the list when the card is ready, saves it periodically
+void lastheard_service (void);
+
+#endif /* LASTHEARD_H_ */
@@ -0,0 +1,177 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * latency.c
+ *
+ * A voice frame gets a time stamp when its last byte has been received
+ * (ETX from the PHY, Ethernet frame taken from the MACB). The tag
+ * travels with the frame through the jitter queue and the AMBE queue.
+ * The audio of a frame can't be followed sample by sample, the tag is
+ * attached to the first audio block the decoder delivers after it got
+ * the frame and this block is followed through the audio queue up to
+ * the codec DMA buffer. At the end of every stage the time since the
+ * end of the previous stage is put into the histogram of the stage.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include <asf.h>
+
+#include "latency.h"
+
+#include "up_net/snmp_data.h"
+
+
+#define LATENCY_UNIT_SHIFT	12		// cycles -> 1/16 ms
+#define LATENCY_MS_SHIFT	4		// 1/16 ms -> ms
+
+
+#if LATENCY_STAMPS
+
+struct latency_tag latency_input[3];
+
+struct latency_stats latency_stats[LATENCY_NUM_STAGES];
+
+
+void latency_stamp (struct latency_tag * t)
+{
+	uint32_t now = Get_sys_count() | 1;  // 0 is "no time stamp"
+	
+	t->ingress = now;
+	t->last = now;
+}
+
+
+static void add_value (struct latency_stats * st, uint32_t cycles)
+{
+	uint32_t v = cycles >> LATENCY_UNIT_SHIFT;
+	uint32_t ms = v >> LATENCY_MS_SHIFT;
+	int b = 0;
+	
+	while ((ms != 0) && (b < (LATENCY_NUM_BUCKETS - 1)))
+	{
+		ms >>= 1;
+		b ++;
+	}
+	
+	st->hist[b] ++;
+	
+	if (v > st->max)
+	{
+		st->max = v;
+	}
+	
+	if (st->sum > 0x7FFFFFFF)  // keep the mean, forget old values
+	{
+		st->sum >>= 1;
+		st->count >>= 1;
+	}
+	
+	st->sum += v;
+	st->count ++;
+}
+
+
+void latency_stage (struct latency_tag * t, int stage)
+{
+	if (t->ingress == 0)
+		return;
+	
+	uint32_t now = Get_sys_count();
+	
+	add_value(latency_stats + stage, now - t->last);
+	
+	t->last = now;
+	
+	if (stage == LATENCY_AUDIO_Q)  // last stage
+	{
+		add_value(latency_stats + LATENCY_TOTAL, now - t->ingress);
+		t->ingress = 0;
+	}
+}
+
+
+static int mean (const struct latency_stats * st)  // 1/16 ms
+{
+	if (st->count == 0)
+		return 0;
+	
+	return st->sum / st->count;
+}
+
+
+int latency_mean_ms (int stage)
+{
+	return mean(latency_stats + stage) >> LATENCY_MS_SHIFT;
+}
+
+#endif
+
+
+// stage in the upper nibble: 1 = mean (usec), 2 = max. (usec)
+
+int snmp_get_latency (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+#if LATENCY_STAMPS
+	const struct latency_stats * st = latency_stats + (((arg >> 4) & 0x0F) % LATENCY_NUM_STAGES);
+	
+	switch (arg & 0x0F)
+	{
+		case 1:
+			value = (mean(st) * 125) >> 1;  // 1/16 ms = 62.5 usec
+			break;
+		case 2:
+			value = (st->max * 125) >> 1;
+			break;
+	}
+#endif
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+
+// frames per bucket as 32 bit values (big endian)
+
+int snmp_get_latency_hist (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int len = 0;
+	
+#if LATENCY_STAMPS
+	const struct latency_stats * st = latency_stats + (arg % LATENCY_NUM_STAGES);
+	int i;
+	
+	for (i=0; (i < LATENCY_NUM_BUCKETS) && ((len + 4) <= maxlen); i++)
+	{
+		uint32_t v = st->hist[i];
+		
+		res[len++] = v >> 24;
+		res[len++] = (v >> 16) & 0xFF;
+		res[len++] = (v >> 8) & 0xFF;
+		res[len++] = v & 0xFF;
+	}
+#endif
+	
+	*res_len = len;
+	return 0;
+}
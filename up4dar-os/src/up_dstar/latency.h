@@ -0,0 +1,99 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * latency.h
+ *
+ * Latency of received voice frames, from the input (PHY or network)
+ * to the codec DMA buffer
+ *
+ */
+
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+
+// 0 = no time stamps (production builds), all LATENCY_... macros are empty,
+// the Debug configuration of the project sets LATENCY_STAMPS=1
+#ifndef LATENCY_STAMPS
+#define LATENCY_STAMPS  0
+#endif
+
+
+// stages, a stage ends where the next one begins
+
+#define LATENCY_INPUT		0	// serial port / Ethernet -> jitter queue
+#define LATENCY_JITTER_Q	1	// jitter queue -> AMBE queue
+#define LATENCY_AMBE_Q		2	// AMBE queue -> AMBE decoder
+#define LATENCY_DECODER		3	// AMBE decoder -> audio queue
+#define LATENCY_AUDIO_Q		4	// audio queue -> codec DMA buffer
+#define LATENCY_TOTAL		5	// serial port / Ethernet -> codec DMA buffer
+
+#define LATENCY_NUM_STAGES	6
+
+// bucket 0: < 1ms, bucket n: 2^(n-1) .. (2^n)-1 ms, the last bucket takes the rest
+#define LATENCY_NUM_BUCKETS	12
+
+
+// time stamps are taken from the CPU cycle counter (65536 cycles = 1ms),
+// ingress == 0 means the frame has no time stamp
+
+struct latency_tag {
+	uint32_t ingress;
+	uint32_t last;		// end of the previous stage
+};
+
+struct latency_stats {
+	uint32_t count;
+	uint32_t sum;		// 1/16 ms
+	uint32_t max;		// 1/16 ms
+	uint32_t hist[LATENCY_NUM_BUCKETS];
+};
+
+
+#if LATENCY_STAMPS
+
+// time of the frame that is currently processed, per source (SOURCE_PHY, SOURCE_NET)
+extern struct latency_tag latency_input[3];
+
+extern struct latency_stats latency_stats[LATENCY_NUM_STAGES];
+
+void latency_stamp (struct latency_tag * t);
+void latency_stage (struct latency_tag * t, int stage);
+int latency_mean_ms (int stage);
+
+#define LATENCY_STAMP(t)			latency_stamp(t)
+#define LATENCY_STAGE(t, stage)		latency_stage((t), (stage))
+#define LATENCY_SET_INPUT(src, t)	latency_input[src] = *(t)
+#define LATENCY_GET_INPUT(src, t)	*(t) = latency_input[src]
+#define LATENCY_CLEAR(t)			(t)->ingress = 0
+
+#else
+
+#define LATENCY_STAMP(t)
+#define LATENCY_STAGE(t, stage)
+#define LATENCY_SET_INPUT(src, t)
+#define LATENCY_GET_INPUT(src, t)
+#define LATENCY_CLEAR(t)
+
+#endif
+
+#endif /* LATENCY_H_ */
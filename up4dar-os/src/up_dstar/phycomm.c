@@ -135,6 +135,8 @@ static void rxByte ( unsigned char d )
 				{
 					counter ++;
 					
+					LATENCY_STAMP(&dp.tag);
+					
 					if (! (xQueueSend( dstarQueue, &dp, 0) == pdTRUE))
 					{
 						errorCounter ++;
@@ -220,20 +222,29 @@ static void hexRx( char c )
 }
 */
 
+#define RX_CHUNK_SIZE  32
+
 static portTASK_FUNCTION( vComRxTask, pvParameters )
 {
-	char cByteRxed;
+	char rx_chunk[RX_CHUNK_SIZE];
 	short timeout_counter = 0;
 
 	for( ;; )
 	{
 		if (serial_rx_char_available(xPort))
 		{
+			int n;
+			
 			timeout_counter = 0;
 			
-			while (serial_getc(xPort, &cByteRxed) == 1)
+			while ((n = serial_read(xPort, rx_chunk, sizeof rx_chunk)) > 0)
 			{
-				rxByte(cByteRxed);
+				int i;
+				
+				for (i=0; i < n; i++)
+				{
+					rxByte(rx_chunk[i]);
+				}
 			}
 		}
 		else // no chars available
@@ -256,12 +267,7 @@ static portTASK_FUNCTION( vComRxTask, pvParameters )
 
 void phyCommSend (const char * buf, int len)
 {
-	int i;
-	
-	for (i=0; i < len; i++)
-	{
-		serial_putc_tmo( xPort, buf[i], 500 );  // half a second...
-	}
+	serial_write_tmo( xPort, buf, len, 500 );  // half a second...
 }
 
 
@@ -270,32 +276,49 @@ void phyCommSend (const char * buf, int len)
 #define STX 0x02
 #define ETX 0x03
 
+#define TX_CHUNK_SIZE  64
+
+// the stuffed frame is collected in chunks and written as a block
+
 void phyCommSendCmd (const char * cmd, int len)
 {
+	char chunk[TX_CHUNK_SIZE];
 	const char * p = cmd;
+	int n = 0;
 	int i;
 	
-	serial_putc_tmo( xPort, DLE, 50 );
-	serial_putc_tmo( xPort, STX, 50 );
+	chunk[n++] = DLE;
+	chunk[n++] = STX;
 	
 	for (i=0; i < len; i++)
 	{
 		char d = *p;
 		
-		if (d == DLE)
+		if (n > (TX_CHUNK_SIZE - 2)) // no room for a stuffed DLE
 		{
-			serial_putc_tmo( xPort, DLE, 50 );
-			serial_putc_tmo( xPort, DLE, 50 );
+			serial_write_tmo( xPort, chunk, n, 50 );
+			n = 0;
 		}
-		else
+		
+		if (d == DLE)
 		{
-			serial_putc_tmo( xPort, d, 50 );
+			chunk[n++] = DLE;
 		}
+		
+		chunk[n++] = d;
 		p++;
 	}
 	
-	serial_putc_tmo( xPort, DLE, 50 );
-	serial_putc_tmo( xPort, ETX, 50 );
+	if (n > (TX_CHUNK_SIZE - 2))
+	{
+		serial_write_tmo( xPort, chunk, n, 50 );
+		n = 0;
+	}
+	
+	chunk[n++] = DLE;
+	chunk[n++] = ETX;
+	
+	serial_write_tmo( xPort, chunk, n, 50 );
 }
 
 
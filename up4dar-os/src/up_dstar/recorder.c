@@ -0,0 +1,1003 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * recorder.c
+ *
+ * Every received and transmitted stream is written to a log-structured
+ * area on the SD card. The TX task packs the AMBE frames into 512 byte
+ * blocks and puts complete blocks into a small ring, it never waits for
+ * the card. The SD card task takes all blocks of a recording that are in
+ * the ring and writes them with one multi-block write to the data ring
+ * on the card. When the recording has ended its index entry (header,
+ * position and length) is written, so the last recordings can be
+ * listed and played without reading the data area.
+ *
+ * The player reads a recording with multi-block reads and feeds the
+ * frames either into the AMBE decoder (local playback) or to the TX task
+ * (playback onto the air, parrot and beacon).
+ */
+
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include "gcc_builtin.h"
+
+#include "ambe.h"
+#include "dstar.h"
+#include "rtclock.h"
+#include "recorder.h"
+
+#include "up_net/snmp_data.h"
+
+
+#define REC_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
+
+#define REC_VERSION			2
+#define REC_AUX_START		(1 + REC_INDEX_BLOCKS)
+#define REC_DATA_START		(REC_AUX_START + REC_AUX_BLOCKS)
+#define REC_MAX_FRAMES		0xFFFFFF	// 24 bit in the index entry, about 93 hours
+
+static const char rec_magic[] = "UP4DREC ";
+
+
+static const struct rec_blkdev * dev;
+static volatile uint8_t state = REC_STATE_NO_CARD;
+
+static uint32_t area_start;
+static uint32_t area_blocks;
+static uint32_t data_blocks;
+static uint32_t data_written;	// blocks written to the data ring, counts up
+
+static uint8_t blk_buf[REC_BLOCK_SIZE];
+static uint8_t play_buf[REC_PLAY_BLOCKS * REC_BLOCK_SIZE];
+
+static uint8_t recent[REC_RECENT][REC_ENTRY_LEN];
+static uint8_t recent_pos;		// slot of the next entry
+static uint8_t recent_count;
+
+static uint8_t rec_enable = 1;
+static uint8_t parrot;
+static volatile uint8_t format_request;
+static volatile int play_request = -1;	// (target << 8) | n, 0 = stop
+
+static uint32_t frames_dropped;
+static uint32_t play_underruns;
+
+
+// recorder -> SD card task
+
+static uint8_t ring[REC_RING_BLOCKS][REC_BLOCK_SIZE];
+static volatile uint8_t ring_in;
+static volatile uint8_t ring_out;
+
+static uint8_t entry_q[2][REC_ENTRY_LEN];	// finished recordings
+static volatile uint8_t entry_in;
+static volatile uint8_t entry_out;
+
+static uint32_t next_seq;
+static uint32_t start_seq;		// recording whose first block was written last
+static uint32_t start_blk;
+
+static struct {
+	uint8_t active;
+	uint8_t * blk;			// block being filled, NULL if the ring was full
+	uint16_t block;			// block number within the recording
+	uint16_t pos;			// frames in the block
+	uint32_t frames;
+	uint8_t entry[REC_ENTRY_LEN];
+} rec;
+
+
+// player -> TX task
+
+static uint8_t play_q[REC_PLAY_FRAMES][AMBE_Q_DATASIZE];
+static volatile uint8_t play_in;
+static volatile uint8_t play_out;
+
+static struct {
+	volatile uint8_t target;	// 0 = idle
+	uint8_t nblk;			// blocks in play_buf
+	uint8_t cur;			// next block in play_buf
+	uint16_t block;			// expected block number within the recording
+	uint32_t seq;
+	uint32_t blk;			// next block to read
+	uint32_t frames;		// frames not yet taken from play_buf
+	const uint8_t * ptr;
+	int avail;				// frames at ptr
+} play;
+
+
+
+static void put32 (uint8_t * p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = (v >> 16) & 0xFF;
+	p[2] = (v >> 8) & 0xFF;
+	p[3] = v & 0xFF;
+}
+
+static uint32_t get32 (const uint8_t * p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put16 (uint8_t * p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v & 0xFF;
+}
+
+static uint16_t get16 (const uint8_t * p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t entry_frames (const uint8_t * e)
+{
+	return get32(e + 8) & REC_MAX_FRAMES;
+}
+
+static uint32_t entry_blocks (const uint8_t * e)
+{
+	return (entry_frames(e) + REC_FRAMES_PER_BLOCK - 1) / REC_FRAMES_PER_BLOCK;
+}
+
+// the data of the entry has not been overwritten yet
+static int entry_valid (const uint8_t * e)
+{
+	return (get32(e) != 0) &&
+		(((data_written - get32(e + 4)) + entry_blocks(e)) <= data_blocks);
+}
+
+
+
+// ----- TX task -----
+
+static void commit_block (void)
+{
+	if (rec.blk != NULL)
+	{
+		put16(rec.blk + 6, rec.pos);
+		
+		memset(rec.blk + REC_BLOCK_HDRLEN + (rec.pos * AMBE_Q_DATASIZE), 0,
+			REC_BLOCK_SIZE - REC_BLOCK_HDRLEN - (rec.pos * AMBE_Q_DATASIZE));
+		
+		REC_BARRIER();
+		ring_in ++;
+		
+		rec.block ++;
+	}
+	
+	rec.blk = NULL;
+	rec.pos = 0;
+}
+
+
+static void finish_recording (void)
+{
+	rec.active = 0;
+	
+	if (rec.pos > 0)
+	{
+		commit_block();
+	}
+	
+	if (rec.frames == 0)
+		return;
+	
+	if (((uint8_t) (entry_in - entry_out)) >= 2) // should not happen
+	{
+		frames_dropped += rec.frames;
+		return;
+	}
+	
+	uint8_t * e = entry_q[entry_in & 1];
+	
+	memcpy(e, rec.entry, REC_ENTRY_LEN);
+	put32(e + 8, (rec.entry[8] << 24) | rec.frames);
+	
+	REC_BARRIER();
+	entry_in ++;
+}
+
+
+void recorder_start (uint8_t dir_source, const uint8_t * header)
+{
+	if (rec.active != 0)
+	{
+		finish_recording();
+	}
+	
+	if ((rec_enable == 0) || (state != REC_STATE_READY))
+		return;
+	
+	memset(rec.entry, 0, REC_ENTRY_LEN);
+	put32(rec.entry, next_seq);
+	rec.entry[8] = dir_source;
+	put32(rec.entry + 12, the_clock);
+	memcpy(rec.entry + 16, header, 39);
+	
+	next_seq ++;
+	if (next_seq == 0) // 0 is the empty slot
+	{
+		next_seq = 1;
+	}
+	
+	rec.blk = NULL;
+	rec.block = 0;
+	rec.pos = 0;
+	rec.frames = 0;
+	rec.active = 1;
+}
+
+
+void recorder_put_frame (const uint8_t * ambe_data)
+{
+	if ((rec.active == 0) || (rec.frames >= REC_MAX_FRAMES))
+		return;
+	
+	if (rec.blk == NULL)
+	{
+		if (((uint8_t) (ring_in - ring_out)) >= REC_RING_BLOCKS) // card is too slow
+		{
+			frames_dropped ++;
+			return;
+		}
+		
+		rec.blk = ring[ring_in & (REC_RING_BLOCKS - 1)];
+		
+		memcpy(rec.blk, rec.entry, 4); // sequence number
+		put16(rec.blk + 4, rec.block);
+	}
+	
+	memcpy(rec.blk + REC_BLOCK_HDRLEN + (rec.pos * AMBE_Q_DATASIZE), ambe_data, AMBE_Q_DATASIZE);
+	
+	rec.pos ++;
+	rec.frames ++;
+	
+	if (rec.pos >= REC_FRAMES_PER_BLOCK)
+	{
+		commit_block();
+	}
+}
+
+
+void recorder_stop (uint8_t dir_source)
+{
+	if ((rec.active != 0) && (rec.entry[8] == dir_source))
+	{
+		finish_recording();
+	}
+}
+
+
+int recorder_playing_tx (void)
+{
+	return (play.target == REC_PLAY_TX) || (play_in != play_out);
+}
+
+
+int recorder_play_get (uint8_t * data)
+{
+	uint8_t running = (play.target == REC_PLAY_TX);
+	
+	REC_BARRIER();
+	
+	uint8_t out = play_out;
+	
+	if (play_in == out)
+	{
+		if (running) // card was too slow, keep the transmitter on
+		{
+			memcpy(data, ambe_silence_data, AMBE_Q_DATASIZE);
+			play_underruns ++;
+			return 0;
+		}
+		
+		return 1;
+	}
+	
+	memcpy(data, play_q[out & (REC_PLAY_FRAMES - 1)], AMBE_Q_DATASIZE);
+	
+	REC_BARRIER();
+	play_out = out + 1;
+	
+	return 0;
+}
+
+
+
+// ----- any task -----
+
+int recorder_state (void)
+{
+	return state;
+}
+
+
+uint32_t recorder_aux_start (void)
+{
+	if (state != REC_STATE_READY)
+		return 0;
+	
+	return area_start + REC_AUX_START;
+}
+
+
+int recorder_get_entry (int n, uint8_t * info)
+{
+	int res = 1;
+	
+	if ((n < 0) || (n >= REC_RECENT))
+		return 1;
+	
+	portENTER_CRITICAL();
+	
+	if (n < recent_count)
+	{
+		const uint8_t * e = recent[(recent_pos - 1 - n) & (REC_RECENT - 1)];
+		
+		if (entry_valid(e))
+		{
+			memcpy(info, e, REC_ENTRY_INFO_LEN);
+			res = 0;
+		}
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return res;
+}
+
+
+int recorder_play (int n, int target)
+{
+	if ((n < 0) || (n >= REC_RECENT) ||
+		((target != REC_PLAY_LOCAL) && (target != REC_PLAY_TX)))
+		return 1;
+	
+	if (state != REC_STATE_READY)
+		return 1;
+	
+	play_request = (target << 8) | n;
+	return 0;
+}
+
+
+void recorder_play_stop (void)
+{
+	play_request = 0;
+}
+
+
+
+// ----- SD card task -----
+
+static int dev_read (uint32_t blk, uint8_t * buf, int count)
+{
+	if (dev->read(area_start + blk, buf, count) != 0)
+	{
+		state = REC_STATE_ERROR;
+		return 1;
+	}
+	
+	return 0;
+}
+
+
+static int dev_write (uint32_t blk, const uint8_t * buf, int count)
+{
+	if (dev->write(area_start + blk, buf, count) != 0)
+	{
+		state = REC_STATE_ERROR;
+		return 1;
+	}
+	
+	return 0;
+}
+
+
+static void add_recent (const uint8_t * e)
+{
+	portENTER_CRITICAL();
+	
+	memcpy(recent[recent_pos & (REC_RECENT - 1)], e, REC_ENTRY_LEN);
+	recent_pos ++;
+	
+	if (recent_count < REC_RECENT)
+	{
+		recent_count ++;
+	}
+	
+	portEXIT_CRITICAL();
+}
+
+
+static void play_start (const uint8_t * e, int target)
+{
+	play.target = 0;
+	
+	if (!entry_valid(e))
+		return;
+	
+	play.seq = get32(e);
+	play.blk = get32(e + 4);
+	play.frames = entry_frames(e);
+	play.block = 0;
+	play.nblk = 0;
+	play.cur = 0;
+	play.avail = 0;
+	
+	REC_BARRIER();
+	play.target = target;
+}
+
+
+// The index block of the entry is built from the newest entries in RAM,
+// the other slots of the block are cleared. They hold the oldest entries,
+// which would be overwritten by the next recordings anyway.
+
+static int write_entry (uint8_t * e)
+{
+	uint32_t seq = get32(e);
+	
+	if (seq != start_seq) // no data block was written
+		return 0;
+	
+	put32(e + 4, start_blk);
+	add_recent(e);
+	
+	int blk = (seq % REC_INDEX_ENTRIES) / REC_ENTRIES_PER_BLOCK;
+	int i;
+	
+	memset(blk_buf, 0, REC_BLOCK_SIZE);
+	
+	for (i=0; i < recent_count; i++)
+	{
+		const uint8_t * r = recent[i];
+		uint32_t s = get32(r);
+		
+		if ((int) ((s % REC_INDEX_ENTRIES) / REC_ENTRIES_PER_BLOCK) == blk)
+		{
+			memcpy(blk_buf + ((s % REC_ENTRIES_PER_BLOCK) * REC_ENTRY_LEN), r, REC_ENTRY_LEN);
+		}
+	}
+	
+	if (dev_write(1 + blk, blk_buf, 1) != 0)
+		return 1;
+	
+	// only streams received on the air, a reflector stream would be sent back
+	if (parrot && ((e[8] & (REC_RX|SOURCE_PHY)) == (REC_RX|SOURCE_PHY)) && (play.target == 0))
+	{
+		play_start(e, REC_PLAY_TX);
+	}
+	
+	return 0;
+}
+
+
+static int write_data (const uint8_t * buf, int count)
+{
+	while (count > 0)
+	{
+		uint32_t pos = data_written % data_blocks;
+		int n = count;
+		
+		if (n > (int) (data_blocks - pos)) // end of the data ring
+		{
+			n = data_blocks - pos;
+		}
+		
+		if (dev_write(REC_DATA_START + pos, buf, n) != 0)
+			return 1;
+		
+		data_written += n;
+		buf += n * REC_BLOCK_SIZE;
+		count -= n;
+	}
+	
+	return 0;
+}
+
+
+static int write_pending (void)
+{
+	for (;;)
+	{
+		uint8_t out = ring_out;
+		int avail = (uint8_t) (ring_in - out);
+		int pos = out & (REC_RING_BLOCKS - 1);
+		int ended = 0;
+		
+		// the entry is written when all blocks of the recording are on the card,
+		// i.e. before the first block of the next recording
+		
+		if (entry_in != entry_out)
+		{
+			uint8_t * e = entry_q[entry_out & 1];
+			
+			if ((avail == 0) || (get32(ring[pos]) != get32(e)))
+			{
+				if (write_entry(e) != 0)
+					return 1;
+				
+				REC_BARRIER();
+				entry_out ++;
+				continue;
+			}
+			
+			ended = 1;
+		}
+		
+		if (avail == 0)
+			break;
+		
+		// blocks of one recording up to the end of the ring
+		
+		int n = avail;
+		
+		if (n > (REC_RING_BLOCKS - pos))
+		{
+			n = REC_RING_BLOCKS - pos;
+		}
+		
+		uint32_t seq = get32(ring[pos]);
+		int i = 1;
+		
+		while ((i < n) && (get32(ring[pos + i]) == seq))
+		{
+			i ++;
+		}
+		
+		n = i;
+		
+		// wait for more blocks of a running recording
+		
+		if ((n < REC_WRITE_BLOCKS) && (n == avail) && (ended == 0))
+			break;
+		
+		if (get16(ring[pos] + 4) == 0) // first block of the recording
+		{
+			start_seq = seq;
+			start_blk = data_written;
+		}
+		
+		if (write_data(ring[pos], n) != 0)
+			return 1;
+		
+		REC_BARRIER();
+		ring_out = out + n;
+	}
+	
+	return 0;
+}
+
+
+static int play_output (const uint8_t * d)
+{
+	if (play.target == REC_PLAY_LOCAL)
+	{
+		return ambe_input_data(d, NULL);
+	}
+	
+	uint8_t in = play_in;
+	
+	if (((uint8_t) (in - play_out)) >= REC_PLAY_FRAMES)
+		return 1;
+	
+	memcpy(play_q[in & (REC_PLAY_FRAMES - 1)], d, AMBE_Q_DATASIZE);
+	
+	REC_BARRIER();
+	play_in = in + 1;
+	
+	return 0;
+}
+
+
+static void play_service (void)
+{
+	int req = play_request;
+	
+	if (req >= 0)
+	{
+		uint8_t info[REC_ENTRY_LEN];
+		
+		play_request = -1;
+		play.target = 0;
+		
+		if ((req > 0xFF) && (recorder_get_entry(req & 0xFF, info) == 0))
+		{
+			play_start(info, req >> 8);
+		}
+	}
+	
+	while (play.target != 0)
+	{
+		if (play.avail > 0)
+		{
+			if (play_output(play.ptr) != 0) // queue is full, continue later
+				return;
+			
+			play.ptr += AMBE_Q_DATASIZE;
+			play.avail --;
+			continue;
+		}
+		
+		if (play.frames == 0) // end of the recording
+			break;
+		
+		if (play.cur < play.nblk)
+		{
+			const uint8_t * b = play_buf + (play.cur * REC_BLOCK_SIZE);
+			int n = get16(b + 6);
+			
+			play.cur ++;
+			
+			if ((get32(b) != play.seq) || (get16(b + 4) != play.block)) // overwritten
+				break;
+			
+			if (n > (int) play.frames)
+			{
+				n = play.frames;
+			}
+			
+			play.block ++;
+			play.frames -= n;
+			play.ptr = b + REC_BLOCK_HDRLEN;
+			play.avail = n;
+			continue;
+		}
+		
+		uint32_t pos = play.blk % data_blocks;
+		int n = (play.frames + REC_FRAMES_PER_BLOCK - 1) / REC_FRAMES_PER_BLOCK;
+		
+		if (n > REC_PLAY_BLOCKS)
+		{
+			n = REC_PLAY_BLOCKS;
+		}
+		
+		if (n > (int) (data_blocks - pos))
+		{
+			n = data_blocks - pos;
+		}
+		
+		if ((data_written - play.blk) > data_blocks) // overwritten
+			break;
+		
+		if (dev_read(REC_DATA_START + pos, play_buf, n) != 0)
+			break;
+		
+		play.blk += n;
+		play.nblk = n;
+		play.cur = 0;
+	}
+	
+	play.target = 0;
+}
+
+
+static int format_area (void)
+{
+	int i;
+	
+	play.target = 0;
+	
+	memset(play_buf, 0, sizeof play_buf);
+	
+	for (i=0; i < (REC_INDEX_BLOCKS + REC_AUX_BLOCKS); i += REC_PLAY_BLOCKS)
+	{
+		if (dev_write(1 + i, play_buf, REC_PLAY_BLOCKS) != 0)
+			return 1;
+	}
+	
+	memset(blk_buf, 0, REC_BLOCK_SIZE);
+	memcpy(blk_buf, rec_magic, 8);
+	put32(blk_buf + 8, REC_VERSION);
+	put32(blk_buf + 12, area_blocks);
+	put32(blk_buf + 16, REC_INDEX_BLOCKS);
+	put32(blk_buf + 20, data_blocks);
+	put32(blk_buf + 24, REC_AUX_BLOCKS);
+	
+	if (dev_write(0, blk_buf, 1) != 0)
+		return 1;
+	
+	portENTER_CRITICAL();
+	recent_pos = 0;
+	recent_count = 0;
+	portEXIT_CRITICAL();
+	
+	data_written = 0;
+	start_seq = 0;
+	
+	if (next_seq == 0)
+	{
+		next_seq = 1;
+	}
+	
+	return 0;
+}
+
+
+void recorder_mount (const struct rec_blkdev * d)
+{
+	uint32_t max_seq = 0;
+	const uint8_t * newest = NULL;
+	int last_blk = -1;
+	int i, j;
+	
+	dev = d;
+	
+	area_blocks = REC_AREA_BLOCKS;
+	
+	if (dev->num_blocks < (2 * REC_AREA_BLOCKS)) // small card, use the upper half
+	{
+		area_blocks = dev->num_blocks / 2;
+	}
+	
+	area_start = dev->num_blocks - area_blocks;
+	data_blocks = area_blocks - REC_DATA_START;
+	
+	state = REC_STATE_NO_AREA;
+	
+	portENTER_CRITICAL();
+	recent_pos = 0;
+	recent_count = 0;
+	portEXIT_CRITICAL();
+	
+	start_seq = 0;
+	play.target = 0;
+	
+	if (area_blocks <= (REC_DATA_START + REC_PLAY_BLOCKS)) // card is too small
+	{
+		state = REC_STATE_ERROR;
+		return;
+	}
+	
+	if (dev_read(0, blk_buf, 1) != 0)
+		return;
+	
+	if ((memcmp(blk_buf, rec_magic, 8) != 0) ||
+		(get32(blk_buf + 8) != REC_VERSION) ||
+		(get32(blk_buf + 12) != area_blocks) ||
+		(get32(blk_buf + 16) != REC_INDEX_BLOCKS) ||
+		(get32(blk_buf + 20) != data_blocks) ||
+		(get32(blk_buf + 24) != REC_AUX_BLOCKS))
+		return;
+	
+	// find the newest entry
+	
+	for (i=0; i < REC_INDEX_BLOCKS; i += REC_PLAY_BLOCKS)
+	{
+		if (dev_read(1 + i, play_buf, REC_PLAY_BLOCKS) != 0)
+			return;
+		
+		for (j=0; j < (REC_PLAY_BLOCKS * REC_ENTRIES_PER_BLOCK); j++)
+		{
+			uint32_t s = get32(play_buf + (j * REC_ENTRY_LEN));
+			
+			if (s > max_seq)
+			{
+				max_seq = s;
+			}
+		}
+	}
+	
+	// load the newest entries, oldest first
+	
+	for (i=REC_RECENT - 1; i >= 0; i--)
+	{
+		uint32_t s = max_seq - i;
+		int slot = s % REC_INDEX_ENTRIES;
+		
+		if (max_seq <= ((uint32_t) i)) // seq 0 is not used
+			continue;
+		
+		if ((slot / REC_ENTRIES_PER_BLOCK) != last_blk)
+		{
+			last_blk = slot / REC_ENTRIES_PER_BLOCK;
+			
+			if (dev_read(1 + last_blk, blk_buf, 1) != 0)
+				return;
+		}
+		
+		const uint8_t * e = blk_buf + ((slot % REC_ENTRIES_PER_BLOCK) * REC_ENTRY_LEN);
+		
+		if (get32(e) == s)
+		{
+			add_recent(e);
+			newest = recent[(recent_pos - 1) & (REC_RECENT - 1)];
+		}
+	}
+	
+	// the next recording starts behind the newest one
+	
+	data_written = 0;
+	
+	if ((newest != NULL) && (get32(newest) == max_seq))
+	{
+		data_written = get32(newest + 4) + entry_blocks(newest);
+	}
+	
+	// blocks of the ring that were not written before the card was
+	// mounted again keep their sequence numbers
+	
+	if (next_seq <= max_seq)
+	{
+		next_seq = max_seq + 1;
+	}
+	
+	if (next_seq == 0)
+	{
+		next_seq = 1;
+	}
+	
+	state = REC_STATE_READY;
+}
+
+
+void recorder_unmount (void)
+{
+	state = REC_STATE_NO_CARD;
+	play.target = 0;
+}
+
+
+void recorder_service (void)
+{
+	if (format_request != 0)
+	{
+		format_request = 0;
+		
+		if (((state == REC_STATE_NO_AREA) || (state == REC_STATE_READY)) &&
+			(format_area() == 0))
+		{
+			state = REC_STATE_READY;
+		}
+	}
+	
+	if (state != REC_STATE_READY)
+		return;
+	
+	if (write_pending() != 0)
+		return;
+	
+	play_service();
+}
+
+
+
+int snmp_get_recorder (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = rec_enable;
+			break;
+		
+		case 2:
+			value = state;
+			break;
+		
+		case 3:
+			value = recent_count;
+			break;
+		
+		case 4:
+			value = frames_dropped;
+			break;
+		
+		case 5:
+			value = play.target;
+			break;
+		
+		case 6:
+			value = parrot;
+			break;
+		
+		case 7:
+			value = play_underruns;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+
+int snmp_set_recorder (int32_t arg, const uint8_t * req, int req_len)
+{
+	int value = 0;
+	int i;
+	
+	if ((req_len < 1) || (req_len > 4))
+	{
+		return 1;
+	}
+	
+	for (i=0; i < req_len; i++)
+	{
+		value = (value << 8) | req[i];
+	}
+	
+	switch (arg)
+	{
+		case 1: // 0 = off, 1 = on, 2 = format the area and switch on
+			if (value > 2)
+			{
+				return 1;
+			}
+			
+			if (value == 2)
+			{
+				if ((state != REC_STATE_NO_AREA) && (state != REC_STATE_READY))
+				{
+					return 1;
+				}
+				
+				format_request = 1;
+				value = 1;
+			}
+			
+			rec_enable = value;
+			break;
+		
+		case 5: // (target << 8) | n, 0 = stop
+			if (value == 0)
+			{
+				recorder_play_stop();
+			}
+			else if (recorder_play(value & 0xFF, value >> 8) != 0)
+			{
+				return 1;
+			}
+			break;
+		
+		case 6:
+			parrot = (value != 0);
+			break;
+		
+		default:
+			return 1;
+	}
+	
+	return 0;
+}
+
+
+int snmp_get_recorder_list (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int len = 0;
+	int n;
+	
+	for (n=0; (n < REC_RECENT) && ((len + REC_ENTRY_INFO_LEN) <= maxlen); n++)
+	{
+		if (recorder_get_entry(n, res + len) == 0)
+		{
+			len += REC_ENTRY_INFO_LEN;
+		}
+	}
+	
+	*res_len = len;
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * recorder.h
+ *
+ * QSO recorder and player, AMBE frames are stored on the SD card
+ *
+ */
+
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+
+#define REC_BLOCK_SIZE		512
+
+// recorder area (block numbers relative to the start of the area):
+//
+//  block 0                       superblock, written by recorder_format
+//  block 1 .. REC_INDEX_BLOCKS   index, one entry per recording
+//  next REC_AUX_BLOCKS           used by the last-heard list (lastheard.c)
+//  following blocks              data ring, written like a log
+//
+// The area is at the end of the card. It is used only if the superblock
+// is found, so a card is never written before it was formatted via SNMP.
+
+#define REC_AREA_BLOCKS		65536	// 32 MByte, about 20 hours
+#define REC_INDEX_BLOCKS	32
+#define REC_AUX_BLOCKS		16
+#define REC_ENTRY_LEN		64
+#define REC_ENTRIES_PER_BLOCK	(REC_BLOCK_SIZE / REC_ENTRY_LEN)
+#define REC_INDEX_ENTRIES	(REC_INDEX_BLOCKS * REC_ENTRIES_PER_BLOCK)
+
+// index entry (all values big-endian), the entry of a recording is written
+// when the recording ends, the slot is (seq % REC_INDEX_ENTRIES)
+//
+//  byte 0..3    sequence number, 0 = empty slot
+//  byte 4..7    first data block (counts up, position in the ring is modulo the ring size)
+//  byte 8       direction and source (REC_RX / REC_TX | SOURCE_PHY / SOURCE_NET)
+//  byte 9..11   number of frames
+//  byte 12..15  start time (seconds of the real time clock)
+//  byte 16..54  radio header (flags, RPT2, RPT1, YOUR, MY, MY2)
+
+#define REC_ENTRY_INFO_LEN	55	// bytes of the entry that are used
+
+#define REC_RX		0x10
+#define REC_TX		0x20
+
+// data block: 8 bytes header (sequence number of the recording, block
+// number within the recording, number of frames) and 56 AMBE frames
+
+#define REC_BLOCK_HDRLEN	8
+#define REC_FRAMES_PER_BLOCK	((REC_BLOCK_SIZE - REC_BLOCK_HDRLEN) / AMBE_Q_DATASIZE)
+
+#define REC_RING_BLOCKS		4	// blocks between recorder and SD card task, must be a power of two
+#define REC_WRITE_BLOCKS	2	// blocks written at once, unless the recording has ended
+#define REC_PLAY_BLOCKS		2	// blocks read at once by the player
+#define REC_PLAY_FRAMES		64	// frames between player and TX task, must be a power of two
+#define REC_RECENT			16	// newest index entries kept in RAM
+
+// playback targets
+#define REC_PLAY_LOCAL		1	// AMBE decoder -> speaker
+#define REC_PLAY_TX			2	// TX task -> PHY and/or reflector
+
+// recorder_state
+#define REC_STATE_NO_CARD		0
+#define REC_STATE_NO_AREA		1	// card found, recorder area not formatted
+#define REC_STATE_READY			2
+#define REC_STATE_ERROR			3	// read or write error
+
+
+// block device, functions return 0 on success
+
+struct rec_blkdev {
+	int (* read) (uint32_t blk, uint8_t * buf, int count);
+	int (* write) (uint32_t blk, const uint8_t * buf, int count);
+	uint32_t num_blocks;
+};
+
+
+// SD card task: mount after the card was initialized, service periodically
+
+void recorder_mount (const struct rec_blkdev * dev);
+void recorder_unmount (void);
+void recorder_service (void);
+int recorder_state (void);
+
+// first block of the aux area on the card, 0 if the area is not ready
+uint32_t recorder_aux_start (void);
+
+// TX task (received and transmitted streams), never waits for the card,
+// a new recording ends the previous one, stop ends only the recording
+// of the same direction and source
+
+void recorder_start (uint8_t dir_source, const uint8_t * header);
+void recorder_put_frame (const uint8_t * ambe_data);
+void recorder_stop (uint8_t dir_source);
+
+// n = 0 is the newest recording, returns 0 if the request was accepted
+int recorder_play (int n, int target);
+void recorder_play_stop (void);
+
+// TX task: returns 1 while a recording is played onto the air
+int recorder_playing_tx (void);
+
+// TX task: next frame of the playback, returns 0 on success,
+// 1 if the playback has ended
+int recorder_play_get (uint8_t * data);
+
+// copies index entry n (0 = newest) to info (REC_ENTRY_INFO_LEN bytes),
+// returns 0 if the entry exists
+int recorder_get_entry (int n, uint8_t * info);
+
+#endif /* RECORDER_H_ */
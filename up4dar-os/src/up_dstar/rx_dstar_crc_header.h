@@ -30,7 +30,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define RX_DSTAR_CRC_HEADER_H_
 
 
+// 1 = table with 256 entries (512 bytes flash), 0 = 16 entries (32 bytes, two lookups per byte)
+#ifndef RX_DSTAR_CRC_BYTE_TABLE
+#define RX_DSTAR_CRC_BYTE_TABLE  1
+#endif
+
+#define RX_DSTAR_CRC_INIT  0xffff
+
 unsigned short rx_dstar_crc_header(const unsigned char* header);
 unsigned short rx_dstar_crc_data(const unsigned char* data, int num);
 
+// incremental calculation:
+//   crc = RX_DSTAR_CRC_INIT;
+//   crc = rx_dstar_crc_update(crc, data, num);  (as often as needed)
+//   sum = rx_dstar_crc_final(crc);
+
+unsigned short rx_dstar_crc_update(unsigned short crc, const unsigned char* data, int num);
+unsigned short rx_dstar_crc_update_byte(unsigned short crc, unsigned char d);
+
+#define rx_dstar_crc_final(crc)  ((unsigned short) ((crc) ^ 0xffff))
+
 #endif /* RX_DSTAR_CRC_HEADER_H_ */
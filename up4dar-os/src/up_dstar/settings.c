@@ -79,7 +79,13 @@ const limits_t short_values_limits[NUM_SHORT_VALUES] = {
 	// #define S_RPTR_BEEP_DURATION			9
 	{  20,		500,		100  },
 	// #define S_REF_SERVER_NUM				10
-	{  1,		999,		1  }
+	{  1,		999,		1  },
+	// #define S_DTMF_ON_COUNT				11
+	{  1,		5,		3  },
+	// #define S_DTMF_OFF_COUNT				12
+	{  0,		4,		2  },
+	// #define S_DTMF_MIN_GAP				13
+	{  0,		50,		0  }
 };
 
 const limits_t char_values_limits[NUM_CHAR_VALUES] = {
@@ -128,6 +134,12 @@ const limits_t char_values_limits[NUM_CHAR_VALUES] = {
 	// #define C_REF_TIMER					21
 	{  0,		1,		0	  },
 	// #define C_RMU_QRG_STEP				22
+	{  0,		1,		0	  },
+	// #define C_RX_JB_MIN_DEPTH			23
+	{  1,		21,		2	  },
+	// #define C_RX_JB_MAX_DEPTH			24
+	{  2,		53,		42	  },
+	// #define C_RX_ARBITRATION			25
 	{  0,		1,		0	  }
 };
 
@@ -111,6 +111,9 @@ extern const limits_t char_values_limits[NUM_CHAR_VALUES];
 #define S_RPTR_BEEP_FREQUENCY		8
 #define S_RPTR_BEEP_DURATION		9
 #define S_REF_SERVER_NUM			10
+#define S_DTMF_ON_COUNT				11 // frames of a digit in the DTMF window
+#define S_DTMF_OFF_COUNT			12
+#define S_DTMF_MIN_GAP				13 // frames between two digits
 
 
 // CHAR values
@@ -137,6 +140,9 @@ extern const limits_t char_values_limits[NUM_CHAR_VALUES];
 #define C_RMU_ENABLED				20
 #define C_REF_TIMER					21
 #define C_RMU_QRG_STEP              22
+#define C_RX_JB_MIN_DEPTH			23
+#define C_RX_JB_MAX_DEPTH			24
+#define C_RX_ARBITRATION			25 // 0 = first come, 1 = local RF first
 
 
 // BOOL values
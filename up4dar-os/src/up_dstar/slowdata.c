@@ -35,49 +35,47 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gcc_builtin.h"
 #include "aprs.h"
 
+#include "up_net/snmp_data.h"
+#include "up_io/ringbuf.h"
 
 
-#define SLOWDATA_FIFO_BYTES  15
 
-static unsigned char slowDataFIFO[SLOWDATA_FIFO_BYTES];
-static short slowDataFIFOinPtr;
-static short slowDataFIFOoutPtr;
+struct slowdata_stats slowdata_stats;
+
+static slowdata_handler_t handlers[16];  // index: mini header type >> 4
+
+// superframe that is being received
+
+static uint8_t sf_data[SLOWDATA_NUM_BLOCKS * SLOWDATA_BLOCK_LEN];
+static uint32_t sf_valid;		// bit n: frame at position n received
+static uint8_t sf_source;
+static uint8_t sf_last_pos;
+
+static uint8_t text_buf[SLOWDATA_TEXT_LEN];
+static uint8_t text_valid;
+
+static uint8_t header_buf[SLOWDATA_HEADER_LEN];
+static uint8_t header_pos;
+static unsigned short header_crc;
+
+
+#define SLOWDATA_FIFO_BYTES  64   // GPS data of one superframe (max. 50 bytes)
+
+static uint8_t slowDataFIFO_buf[SLOWDATA_FIFO_BYTES];
+static ringbuf_t slowDataFIFO;
 
 #define SLOWDATA_GPSA_BUFLEN  100
 
 static char * slowDataGPSA;
 static short slowDataGPSA_ptr;
 static short slowDataGPSA_state;
+static unsigned short slowDataGPSA_crc;
 
-static void slowdata_add_byte(unsigned char d)
+void slowdata_data_input( const unsigned char * data, unsigned char len )
 {
-	short tmp_ptr = slowDataFIFOinPtr;
-	
-	tmp_ptr ++;
+	int n = ringbuf_write( & slowDataFIFO, data, len );
 	
-	if (tmp_ptr >= SLOWDATA_FIFO_BYTES)
-	{
-		tmp_ptr = 0;
-	}
-	
-	if (tmp_ptr == slowDataFIFOoutPtr) // buffer is full
-	{
-		return;
-	}
-	
-	slowDataFIFO[slowDataFIFOinPtr] = d;
-	slowDataFIFOinPtr = tmp_ptr;
-}
-
-
-void slowdata_data_input( unsigned char * data, unsigned char len )
-{
-	int i;
-	
-	for (i=0; i < len; i++)
-	{
-		slowdata_add_byte(data[i]);
-	}
+	slowdata_stats.gps_dropped += len - n;
 }
 
 
@@ -85,16 +83,11 @@ static char crc[5];
 
 void slowdata_analyze_stream(void)
 {
-	while (slowDataFIFOoutPtr != slowDataFIFOinPtr)
+	uint8_t c;
+	
+	while (ringbuf_get( & slowDataFIFO, & c ) == 1)
 	{
-		char d = (char) slowDataFIFO[slowDataFIFOoutPtr];
-		
-		slowDataFIFOoutPtr++;
-		
-		if (slowDataFIFOoutPtr >= SLOWDATA_FIFO_BYTES)
-		{
-			slowDataFIFOoutPtr = 0;
-		}
+		char d = (char) c;
 		
 		switch (slowDataGPSA_state)
 		{
@@ -193,6 +186,7 @@ void slowdata_analyze_stream(void)
 				{
 					slowDataGPSA_state = 10;
 					slowDataGPSA_ptr = 0;
+					slowDataGPSA_crc = RX_DSTAR_CRC_INIT;
 				}
 				else
 				{
@@ -210,6 +204,7 @@ void slowdata_analyze_stream(void)
 					{
 						slowDataGPSA[slowDataGPSA_ptr] = d;
 						slowDataGPSA_ptr ++;
+						slowDataGPSA_crc = rx_dstar_crc_update_byte(slowDataGPSA_crc, d);
 					}
 				}
 				else  //  everything else including CR
@@ -224,7 +219,7 @@ void slowdata_analyze_stream(void)
 						// crc[4] = 0;
 						// vd_prints_xy(VDISP_NODEINFO_LAYER, 80, 16, VDISP_FONT_6x8, 0, crc);
 						
-						unsigned short sum = rx_dstar_crc_data((unsigned char *) slowDataGPSA, slowDataGPSA_ptr);
+						unsigned short sum = rx_dstar_crc_final(rx_dstar_crc_update_byte(slowDataGPSA_crc, d));
 						char buf[5];
 						vdisp_i2s(buf, 4, 16, 1, sum);
 						
@@ -243,6 +238,222 @@ void slowdata_analyze_stream(void)
 }
 
 
+void slowdata_register( uint8_t type, slowdata_handler_t func )
+{
+	handlers[type >> 4] = func;
+}
+
+
+static void call_handler( uint8_t type, const uint8_t * data, uint8_t len, uint8_t flags )
+{
+	slowdata_handler_t func = handlers[type >> 4];
+	
+	if (func != 0)
+	{
+		func( data, len, flags, sf_source );
+	}
+}
+
+
+static void process_header_block( const uint8_t * d, uint8_t len )
+{
+	int i;
+	
+	if ((len < 1) || (len > 5) || ((header_pos + len) > SLOWDATA_HEADER_LEN))
+	{
+		header_pos = 0;  // reset
+		return;
+	}
+	
+	if (header_pos == 0)
+	{
+		header_crc = RX_DSTAR_CRC_INIT;
+	}
+	
+	for (i=0; i < len; i++)
+	{
+		header_buf[header_pos + i] = d[i];
+		
+		if ((header_pos + i) < 39)  // CRC is calculated as the header comes in
+		{
+			header_crc = rx_dstar_crc_update_byte(header_crc, d[i]);
+		}
+	}
+	
+	header_pos += len;
+	
+	if (header_pos == SLOWDATA_HEADER_LEN)
+	{
+		unsigned short sum = rx_dstar_crc_final(header_crc);
+		uint8_t res = ((header_buf[39] == (sum & 0xFF)) &&
+			(header_buf[40] == ((sum >> 8) & 0xFF))) ? 0 : 1;
+		
+		if (res == 0)
+		{
+			slowdata_stats.headers ++;
+		}
+		else
+		{
+			slowdata_stats.header_errors ++;
+		}
+		
+		call_handler( SLOWDATA_TYPE_HEADER, header_buf, SLOWDATA_HEADER_LEN, res );
+		header_pos = 0;
+	}
+	
+	if (len < 5)  // last block always shorter than 5
+	{
+		header_pos = 0;
+	}
+}
+
+
+static void process_superframe(void)
+{
+	int i;
+	uint8_t text_changed = 0;
+	
+	for (i=0; i < SLOWDATA_NUM_BLOCKS; i++)
+	{
+		const uint8_t * b = sf_data + (i * SLOWDATA_BLOCK_LEN);
+		uint32_t frames = 3 << ((i << 1) + 1);  // positions 2i+1 and 2i+2
+		
+		if ((sf_valid & frames) != frames)
+		{
+			if ((sf_valid & frames) != 0)
+			{
+				slowdata_stats.lost_blocks ++;
+			}
+			header_pos = 0;  // header can't be completed
+			continue;
+		}
+		
+		slowdata_stats.blocks ++;
+		
+		uint8_t type = b[0] & 0xF0;
+		uint8_t len = b[0] & 0x07;  // ignore Bit 3
+		
+		if (len > 5) // invalid length
+		{
+			len = 0;
+		}
+		
+		switch (type)
+		{
+			case SLOWDATA_TYPE_GPS:
+				call_handler( type, b + 1, len, b[0] );
+				break;
+				
+			case SLOWDATA_TYPE_HEADER:
+				process_header_block( b + 1, len );
+				break;
+				
+			case SLOWDATA_TYPE_TEXT:
+				if ((b[0] & 0x0C) == 0)
+				{
+					int part = b[0] & 0x03;
+					
+					memcpy( text_buf + (part * 5), b + 1, 5 );
+					
+					if ((text_valid != 0x0F) && ((text_valid | (1 << part)) == 0x0F))
+					{
+						slowdata_stats.texts ++;  // message complete
+					}
+					
+					text_valid |= 1 << part;
+					text_changed = 1;
+				}
+				break;
+				
+			case SLOWDATA_TYPE_FILLER:
+				break;
+				
+			default: // fast data, squelch code and unknown types
+				call_handler( type, b + 1, SLOWDATA_BLOCK_LEN - 1, b[0] );
+				break;
+		}
+	}
+	
+	if (text_changed != 0)
+	{
+		call_handler( SLOWDATA_TYPE_TEXT, text_buf, SLOWDATA_TEXT_LEN, text_valid );
+	}
+	
+	sf_valid = 0;
+	sf_source = 0;
+}
+
+
+void slowdata_rx_reset(void)
+{
+	sf_valid = 0;
+	sf_source = 0;
+	sf_last_pos = 0;
+	
+	text_valid = 0;
+	header_pos = 0;
+}
+
+
+// pos 0 is the sync frame, the slow data of pos 1..20 is collected and
+// processed at the end of the superframe. source 0 = frame is missing
+
+void slowdata_rx_frame( uint8_t pos, const uint8_t * data, uint8_t source )
+{
+	if ((pos <= sf_last_pos) && (sf_valid != 0))  // end of the superframe was missing
+	{
+		process_superframe();
+	}
+	
+	sf_last_pos = pos;
+	
+	if ((pos == 0) || (pos > (SLOWDATA_NUM_BLOCKS * 2)))
+		return;
+	
+	if (source != 0)
+	{
+		memcpy( sf_data + ((pos - 1) * 3), data, 3 );
+		sf_valid |= 1 << pos;
+		sf_source = source;
+	}
+	
+	if (pos == (SLOWDATA_NUM_BLOCKS * 2))
+	{
+		process_superframe();
+	}
+}
+
+
+int snmp_get_slowdata_stats ( int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+
+	switch (arg)
+	{
+		case 1:
+			value = slowdata_stats.blocks;
+			break;
+		case 2:
+			value = slowdata_stats.lost_blocks;
+			break;
+		case 3:
+			value = slowdata_stats.texts;
+			break;
+		case 4:
+			value = slowdata_stats.headers;
+			break;
+		case 5:
+			value = slowdata_stats.header_errors;
+			break;
+		case 6:
+			value = slowdata_stats.gps_dropped;
+			break;
+	}
+
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
+
+
 void slowdataInit(void)
 {
 	
@@ -251,7 +462,7 @@ void slowdataInit(void)
 	slowDataGPSA_ptr = 0;
 	slowDataGPSA_state = 0;
 	
-	slowDataFIFOinPtr = 0;
-	slowDataFIFOoutPtr = 0;
+	ringbuf_init( & slowDataFIFO, slowDataFIFO_buf, SLOWDATA_FIFO_BYTES );
 	
+	slowdata_rx_reset();
 }
\ No newline at end of file
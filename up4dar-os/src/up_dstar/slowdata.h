@@ -28,7 +28,45 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef SLOWDATA_H_
 #define SLOWDATA_H_
 
-void slowdata_data_input( unsigned char * data, unsigned char len );
+// slow data of a superframe: 20 frames with 3 bytes each,
+// two frames form a 6 byte block that starts with the mini header
+
+#define SLOWDATA_BLOCK_LEN		6
+#define SLOWDATA_NUM_BLOCKS		10
+
+#define SLOWDATA_TYPE_GPS		0x30
+#define SLOWDATA_TYPE_TEXT		0x40
+#define SLOWDATA_TYPE_HEADER	0x50
+#define SLOWDATA_TYPE_FILLER	0x60
+#define SLOWDATA_TYPE_FAST1		0x80
+#define SLOWDATA_TYPE_FAST2		0x90
+#define SLOWDATA_TYPE_SQUELCH	0xC0
+
+#define SLOWDATA_TEXT_LEN		20
+#define SLOWDATA_HEADER_LEN		41
+
+// handler for one mini header type, flags depend on the type:
+//   SLOWDATA_TYPE_TEXT    bit 0..3: parts of the message received, 0x0F = complete
+//   SLOWDATA_TYPE_HEADER  CRC result, 0 = OK
+//   other types           mini header
+typedef void (* slowdata_handler_t) (const uint8_t * data, uint8_t len, uint8_t flags, uint8_t source);
+
+struct slowdata_stats {
+	uint32_t blocks;
+	uint32_t lost_blocks;		// at least one of the two frames was missing
+	uint32_t texts;				// complete text messages
+	uint32_t headers;			// headers with correct CRC
+	uint32_t header_errors;
+	uint32_t gps_dropped;		// GPS bytes not stored (FIFO full)
+};
+
+extern struct slowdata_stats slowdata_stats;
+
+void slowdata_register( uint8_t type, slowdata_handler_t func );
+void slowdata_rx_reset(void);
+void slowdata_rx_frame( uint8_t pos, const uint8_t * data, uint8_t source );
+
+void slowdata_data_input( const unsigned char * data, unsigned char len );
 void slowdataInit(void);
 void slowdata_analyze_stream(void);
 
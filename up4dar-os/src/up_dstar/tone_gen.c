@@ -0,0 +1,598 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * tone_gen.c
+ *
+ * Direct digital synthesis: every oscillator has a 32 bit phase
+ * accumulator, the upper bits address a quarter wave table. The
+ * envelope is computed once per block (or per part of a block if a
+ * step or a ramp ends inside the block), the loop over the samples
+ * only adds the envelope step.
+ *
+ * The sequencer reads the script step by step, CW and DTMF text is
+ * expanded into tone and pause steps while it is played.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "gcc_builtin.h"
+
+#include "tone_gen.h"
+
+
+#define TONE_TABLE_SIZE		(1 << TONE_TABLE_BITS)
+
+#define TONE_INCR_PER_HZ	536871UL	// 2^32 / TONE_SAMPLE_RATE
+#define TONE_MAX_HZ			((TONE_SAMPLE_RATE / 2) - 1)
+
+#define MS_TO_SAMPLES(ms)	((uint32_t) (ms) * (TONE_SAMPLE_RATE / 1000))
+
+#define STATE_IDLE		0
+#define STATE_RUN		1
+#define STATE_END		2	// end of the script, release of the last tone
+
+#define MODE_SCRIPT		0
+#define MODE_CW			1
+#define MODE_DTMF		2
+
+
+// sin(0..90 degrees) * 32767
+
+static const int16_t quarter_sin[TONE_TABLE_SIZE + 1] = {
+     0,   201,   402,   603,   804,  1005,  1206,  1407,  1608,  1809,
+  2009,  2210,  2410,  2611,  2811,  3012,  3212,  3412,  3612,  3811,
+  4011,  4210,  4410,  4609,  4808,  5007,  5205,  5404,  5602,  5800,
+  5998,  6195,  6393,  6590,  6786,  6983,  7179,  7375,  7571,  7767,
+  7962,  8157,  8351,  8545,  8739,  8933,  9126,  9319,  9512,  9704,
+  9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+ 11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462,
+ 13645, 13828, 14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269,
+ 15446, 15623, 15800, 15976, 16151, 16325, 16499, 16673, 16846, 17018,
+ 17189, 17360, 17530, 17700, 17869, 18037, 18204, 18371, 18537, 18703,
+ 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000, 20159, 20317,
+ 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+ 22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311,
+ 23452, 23592, 23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680,
+ 24811, 24942, 25072, 25201, 25329, 25456, 25582, 25708, 25832, 25955,
+ 26077, 26198, 26319, 26438, 26556, 26674, 26790, 26905, 27019, 27133,
+ 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001, 28105, 28208,
+ 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+ 29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037,
+ 30117, 30195, 30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783,
+ 30852, 30919, 30985, 31050, 31113, 31176, 31237, 31297, 31356, 31414,
+ 31470, 31526, 31580, 31633, 31685, 31736, 31785, 31833, 31880, 31926,
+ 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250, 32285, 32318,
+ 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+ 32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737,
+ 32745, 32752, 32757, 32761, 32765, 32766, 32767
+};
+
+
+// Morse code: the elements start at bit 0 (1 = dah), the highest
+// bit set marks the end of the character
+
+static const uint8_t morse_letters[26] = {
+	0x06, 0x11, 0x15, 0x09, 0x02, 0x14, 0x0B, 0x10, 0x04, 0x1E, 0x0D, 0x12, 0x07,
+	0x05, 0x0F, 0x16, 0x1B, 0x0A, 0x08, 0x03, 0x0C, 0x18, 0x0E, 0x19, 0x1D, 0x13
+};
+
+static const uint8_t morse_digits[10] = {
+	0x3F, 0x3E, 0x3C, 0x38, 0x30, 0x20, 0x21, 0x23, 0x27, 0x2F
+};
+
+
+static const char dtmf_keys[16] = {
+	'1', '2', '3', 'A',
+	'4', '5', '6', 'B',
+	'7', '8', '9', 'C',
+	'*', '0', '#', 'D'
+};
+
+static const uint16_t dtmf_row_hz[4] = { 697, 770, 852, 941 };
+static const uint16_t dtmf_col_hz[4] = { 1209, 1336, 1477, 1633 };
+
+
+
+static inline int table_sin (uint32_t phase)
+{
+	uint32_t i = phase >> (32 - 2 - TONE_TABLE_BITS);  // quadrant and table index
+	int idx = i & (TONE_TABLE_SIZE - 1);
+	int v;
+	
+	if (i & TONE_TABLE_SIZE)  // 2nd and 4th quadrant
+	{
+		idx = TONE_TABLE_SIZE - idx;
+	}
+	
+	v = quarter_sin[idx];
+	
+	return (i & (TONE_TABLE_SIZE << 1)) ? -v : v;  // 3rd and 4th quadrant
+}
+
+
+static uint32_t hz_to_incr (unsigned int hz)
+{
+	if (hz > TONE_MAX_HZ)
+	{
+		hz = TONE_MAX_HZ;
+	}
+	
+	return hz * TONE_INCR_PER_HZ;
+}
+
+
+void tone_init (tone_gen_t * g)
+{
+	int i;
+	
+	for (i=0; i < TONE_NUM_OSC; i++)
+	{
+		g->osc[i].phase = 0;
+		g->osc[i].incr = 0;
+	}
+	
+	g->env = 0;
+	g->env_rate = 0;
+	g->amp = 0;
+	g->keyed = 0;
+	g->state = STATE_IDLE;
+	g->step_samples = 0;
+	g->script[0] = 0;
+	g->pos = g->script;
+	g->mode = MODE_SCRIPT;
+	g->pending = 0;
+}
+
+
+int tone_play (tone_gen_t * g, const char * script, int volume_percent)
+{
+	int len = strlen(script);
+	
+	if (len >= TONE_SCRIPT_LEN)
+		return 1;
+	
+	if (volume_percent <= 0)
+		return 0;
+	
+	if (volume_percent > 100)
+	{
+		volume_percent = 100;
+	}
+	
+	portENTER_CRITICAL();  // the audio task may copy the pending script right now
+	
+	memcpy(g->pending_script, script, len + 1);
+	g->pending_amp = volume_percent * 100;  // 100% = 10000
+	g->pending = 1;
+	
+	portEXIT_CRITICAL();
+	
+	return 0;
+}
+
+
+static char * put_num (char * p, unsigned int n)
+{
+	char tmp[10];
+	int i = 0;
+	
+	do
+	{
+		tmp[i++] = '0' + (n % 10);
+		n /= 10;
+	} while (n > 0);
+	
+	while (i > 0)
+	{
+		*(p++) = tmp[--i];
+	}
+	
+	return p;
+}
+
+
+void tone_beep (tone_gen_t * g, int duration_ms, int frequency_hz, int volume_percent)
+{
+	char s[24];
+	char * p = s;
+	
+	if ((duration_ms <= 0) || (frequency_hz <= 0))
+		return;
+	
+	*(p++) = 'T';
+	p = put_num(p, frequency_hz);
+	*(p++) = ':';
+	p = put_num(p, duration_ms);
+	*p = 0;
+	
+	tone_play(g, s, volume_percent);
+}
+
+
+static unsigned int parse_num (const char ** p)
+{
+	unsigned int n = 0;
+	
+	while ((**p >= '0') && (**p <= '9'))
+	{
+		if (n < 60000)
+		{
+			n = n * 10 + (**p - '0');
+		}
+		(*p) ++;
+	}
+	
+	return n;
+}
+
+
+static void key (tone_gen_t * g, int keyed, uint32_t samples)
+{
+	g->keyed = keyed;
+	g->step_samples = samples;
+}
+
+
+static uint8_t morse_code (char c)
+{
+	if ((c >= 'a') && (c <= 'z'))
+	{
+		c -= 'a' - 'A';
+	}
+	
+	if ((c >= 'A') && (c <= 'Z'))
+		return morse_letters[c - 'A'];
+	
+	if ((c >= '0') && (c <= '9'))
+		return morse_digits[c - '0'];
+	
+	switch (c)
+	{
+		case '/':	return 0x29;
+		case '?':	return 0x4C;
+		case '.':	return 0x6A;
+		case ',':	return 0x73;
+		case '=':	return 0x31;
+	}
+	
+	return 0;
+}
+
+
+// end of a CW or DTMF text: returns 0, pos is behind the ';'
+
+static int text_end (tone_gen_t * g)
+{
+	if (*g->pos == ';')
+	{
+		g->pos ++;
+	}
+	
+	g->mode = MODE_SCRIPT;
+	return 0;
+}
+
+
+// dit: 1, dah: 3, gap between elements: 1, characters: 3, words: 7 dits
+
+static int next_cw_step (tone_gen_t * g)
+{
+	if (g->cw_gap != 0)
+	{
+		g->cw_gap = 0;
+		key(g, 0, g->cw_dit);
+		return 1;
+	}
+	
+	if (g->cw_code == 1)  // end of the character
+	{
+		g->cw_code = 0;
+		key(g, 0, 2 * g->cw_dit);
+		return 1;
+	}
+	
+	while (g->cw_code == 0)
+	{
+		char c = *g->pos;
+		
+		if ((c == 0) || (c == ';'))
+			return text_end(g);
+		
+		g->pos ++;
+		
+		if (c == ' ')
+		{
+			key(g, 0, 4 * g->cw_dit);
+			return 1;
+		}
+		
+		g->cw_code = morse_code(c);  // unknown characters are skipped
+	}
+	
+	key(g, 1, (g->cw_code & 1) ? (3 * g->cw_dit) : g->cw_dit);
+	g->cw_code >>= 1;
+	g->cw_gap = 1;
+	
+	return 1;
+}
+
+
+static int next_dtmf_step (tone_gen_t * g)
+{
+	if (g->cw_gap != 0)
+	{
+		g->cw_gap = 0;
+		key(g, 0, MS_TO_SAMPLES(TONE_DTMF_DEFAULT_MS));
+		return 1;
+	}
+	
+	while (1)
+	{
+		char c = *g->pos;
+		int i;
+		
+		if ((c == 0) || (c == ';'))
+			return text_end(g);
+		
+		g->pos ++;
+		
+		for (i=0; i < 16; i++)
+		{
+			if (dtmf_keys[i] == c)
+			{
+				g->osc[0].incr = hz_to_incr(dtmf_row_hz[i >> 2]);
+				g->osc[1].incr = hz_to_incr(dtmf_col_hz[i & 3]);
+				key(g, 1, MS_TO_SAMPLES(TONE_DTMF_DEFAULT_MS));
+				g->cw_gap = 1;
+				return 1;
+			}
+		}
+	}
+}
+
+
+static int next_script_step (tone_gen_t * g)
+{
+	unsigned int n;
+	
+	while (1)
+	{
+		char c = *g->pos;
+		
+		if (c == 0)
+			return 0;
+		
+		g->pos ++;
+		
+		switch (c)
+		{
+			case 'T':
+				g->osc[0].incr = hz_to_incr(parse_num(&g->pos));
+				g->osc[1].incr = 0;
+				
+				if (*g->pos == ',')
+				{
+					g->pos ++;
+					g->osc[1].incr = hz_to_incr(parse_num(&g->pos));
+				}
+				
+				if (*g->pos == ':')
+				{
+					g->pos ++;
+				}
+				
+				key(g, 1, MS_TO_SAMPLES(parse_num(&g->pos)));
+				return 1;
+				
+			case 'P':
+				key(g, 0, MS_TO_SAMPLES(parse_num(&g->pos)));
+				return 1;
+				
+			case 'W':
+				n = parse_num(&g->pos);
+				if (n > 0)
+				{
+					g->cw_dit = MS_TO_SAMPLES(1200) / n;
+				}
+				break;
+				
+			case 'K':
+				g->cw_incr = hz_to_incr(parse_num(&g->pos));
+				break;
+				
+			case 'C':
+				g->mode = MODE_CW;
+				g->cw_code = 0;
+				g->cw_gap = 0;
+				g->osc[0].incr = g->cw_incr;
+				g->osc[1].incr = 0;
+				
+				if (next_cw_step(g) != 0)
+					return 1;
+				break;
+				
+			case 'D':
+				g->mode = MODE_DTMF;
+				g->cw_gap = 0;
+				
+				if (next_dtmf_step(g) != 0)
+					return 1;
+				break;
+				
+			default:  // blanks, unknown characters
+				break;
+		}
+	}
+}
+
+
+static int next_step (tone_gen_t * g)
+{
+	switch (g->mode)
+	{
+		case MODE_CW:
+			if (next_cw_step(g) != 0)
+				return 1;
+			break;
+			
+		case MODE_DTMF:
+			if (next_dtmf_step(g) != 0)
+				return 1;
+			break;
+	}
+	
+	return next_script_step(g);
+}
+
+
+static void start_script (tone_gen_t * g)
+{
+	portENTER_CRITICAL();
+	
+	memcpy(g->script, g->pending_script, TONE_SCRIPT_LEN);
+	g->amp = g->pending_amp;
+	g->pending = 0;
+	
+	portEXIT_CRITICAL();
+	
+	g->env_rate = (((int32_t) g->amp) << 16) / TONE_RAMP_SAMPLES;
+	g->pos = g->script;
+	g->mode = MODE_SCRIPT;
+	g->cw_dit = MS_TO_SAMPLES(1200) / TONE_CW_DEFAULT_WPM;
+	g->cw_incr = hz_to_incr(TONE_CW_DEFAULT_HZ);
+	g->state = STATE_RUN;
+	
+	key(g, 0, 0);  // the envelope goes on from a tone that is still playing
+}
+
+
+// n samples with constant envelope step (rate)
+
+static void render_segment (tone_gen_t * g, int16_t * s, int n, int32_t rate)
+{
+	uint32_t p0 = g->osc[0].phase;
+	uint32_t p1 = g->osc[1].phase;
+	uint32_t i0 = g->osc[0].incr;
+	uint32_t i1 = g->osc[1].incr;
+	int32_t env = g->env;
+	int i;
+	
+	if ((env == 0) && (rate == 0))  // pause
+	{
+		for (i=0; i < n; i++)
+		{
+			s[i] >>= 1;
+		}
+		return;
+	}
+	
+	if (i1 == 0)  // one tone
+	{
+		for (i=0; i < n; i++)
+		{
+			s[i] = (s[i] >> 1) + ((table_sin(p0) * (env >> 16)) >> 15);
+			p0 += i0;
+			env += rate;
+		}
+	}
+	else  // two tones, half amplitude each
+	{
+		for (i=0; i < n; i++)
+		{
+			int v = (table_sin(p0) + table_sin(p1)) >> 1;
+			
+			s[i] = (s[i] >> 1) + ((v * (env >> 16)) >> 15);
+			p0 += i0;
+			p1 += i1;
+			env += rate;
+		}
+	}
+	
+	g->osc[0].phase = p0;
+	g->osc[1].phase = p1;
+	g->env = env;
+}
+
+
+int tone_render (tone_gen_t * g, int16_t * samples, int len)
+{
+	if (g->pending != 0)
+	{
+		start_script(g);
+	}
+	
+	if (g->state == STATE_IDLE)
+		return 0;
+	
+	while (len > 0)
+	{
+		if (g->step_samples == 0)
+		{
+			if (g->state == STATE_END)
+			{
+				g->state = STATE_IDLE;
+				g->env = 0;
+				break;
+			}
+			
+			if (next_step(g) == 0)
+			{
+				g->state = STATE_END;
+				key(g, 0, TONE_RAMP_SAMPLES);  // release
+			}
+			continue;
+		}
+		
+		int n = (g->step_samples < (uint32_t) len) ? g->step_samples : len;
+		int32_t target = (g->keyed != 0) ? (((int32_t) g->amp) << 16) : 0;
+		int32_t d = target - g->env;
+		int32_t rate = 0;
+		int ramp_end = 0;
+		
+		// envelope: straight line from the current value towards the target
+		if (d != 0)
+		{
+			int32_t r = ((d > 0) ? d : -d) / g->env_rate + 1;
+			
+			rate = (d > 0) ? g->env_rate : -g->env_rate;
+			
+			if (r <= n)  // target is reached in this segment
+			{
+				n = r;
+				ramp_end = 1;
+			}
+		}
+		
+		render_segment(g, samples, n, rate);
+		
+		if (ramp_end != 0)
+		{
+			g->env = target;
+		}
+		
+		samples += n;
+		len -= n;
+		g->step_samples -= n;
+	}
+	
+	return 1;
+}
@@ -0,0 +1,99 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * tone_gen.h
+ *
+ * Tone generator (beeps, CW, DTMF) for the speaker
+ *
+ */
+
+
+#ifndef TONE_GEN_H_
+#define TONE_GEN_H_
+
+
+#define TONE_SAMPLE_RATE	8000
+#define TONE_NUM_OSC		2		// tones at the same time (DTMF)
+#define TONE_TABLE_BITS		8		// quarter wave table with 256 steps
+#define TONE_RAMP_SAMPLES	40		// attack and release time (5ms)
+#define TONE_SCRIPT_LEN		80
+
+#define TONE_CW_DEFAULT_WPM		20
+#define TONE_CW_DEFAULT_HZ		800
+#define TONE_DTMF_DEFAULT_MS	80		// tone and pause of a DTMF digit
+
+
+// Script, steps are separated by blanks:
+//
+//   T<hz>[,<hz>]:<ms>   tone (one or two frequencies)
+//   P<ms>               pause
+//   W<wpm>              CW speed
+//   K<hz>               CW pitch
+//   C<text>;            CW text (A-Z, 0-9, / ? . , = and blanks)
+//   D<digits>;          DTMF digits (0-9, *, #, A-D)
+//
+// e.g. "T1200:60 P20 T900:80" or "P200 CDL1BFF/P;" or "D*123#;"
+
+#define TONE_SCRIPT_ROGER	"T1200:60 P20 T900:80"
+
+
+struct tone_osc {
+	uint32_t phase;		// 2^32 = one period
+	uint32_t incr;		// phase increment per sample
+};
+
+typedef struct tone_gen
+{
+	struct tone_osc osc[TONE_NUM_OSC];
+	int32_t env;				// amplitude (output units << 16)
+	int32_t env_rate;			// change of env per sample during attack/release
+	int16_t amp;				// amplitude while keyed (output units)
+	uint8_t keyed;
+	uint8_t state;
+	uint32_t step_samples;		// samples left in the current step
+	
+	char script[TONE_SCRIPT_LEN];
+	const char * pos;			// next step of the script
+	uint8_t mode;				// script, CW or DTMF text
+	uint8_t cw_code;			// elements of the current character
+	uint8_t cw_gap;				// element gap pending
+	uint16_t cw_dit;			// samples
+	uint32_t cw_incr;
+	
+	// new script from another task, taken at the next block,
+	// both sides copy it in a critical section
+	char pending_script[TONE_SCRIPT_LEN];
+	int16_t pending_amp;
+	volatile uint8_t pending;
+} tone_gen_t;
+
+
+void tone_init (tone_gen_t * g);
+
+// volume 0..100, returns 1 if the script is too long
+int tone_play (tone_gen_t * g, const char * script, int volume_percent);
+void tone_beep (tone_gen_t * g, int duration_ms, int frequency_hz, int volume_percent);
+
+// adds the tones to the samples (input at half level while a script runs),
+// returns 0 if idle (samples unchanged)
+int tone_render (tone_gen_t * g, int16_t * samples, int len);
+
+#endif /* TONE_GEN_H_ */
@@ -58,10 +58,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gpio.h"
 #include "up_dstar/urcall.h"
 #include "ambe_fec.h"
+#include "dtmf.h"
 #include "up_dstar/slowdata.h"
 #include "ccs.h"
+#include "recorder.h"
 
 static ambe_q_t * microphone;
+static int tx_playback; // frames come from a recording instead of the microphone
 static uint8_t rx_data[3];
 static uint8_t rx_voice[9];
 static uint8_t rx_header[39];
@@ -70,14 +73,7 @@ static uint8_t header_crc_result;
 #define MAX_DTMF_COMMAND  6
 static char dtmf_cmd_string[MAX_DTMF_COMMAND + 1];
 static uint8_t dtmf_cmd_ptr = 0;
-#define MAX_DTMF_HISTORY  5
-static uint8_t dtmf_history[MAX_DTMF_HISTORY];
-#define DTMF_THRESHOLD  3
-#define DTMF_HISTOGRAM_SIZE  17
-static uint8_t dtmf_histogram[DTMF_HISTOGRAM_SIZE];
-static uint8_t dtmf_counter = 0;
-#define DTMF_DETECT_TIME 250
-static uint8_t dtmf_tone_detected = 0;
+static uint8_t dtmf_disp_ptr = 0;
 static int send_as_broadcast = 1;
 static int header_reason = 1;
 static int suppress_user_feedback = 0;
@@ -198,15 +194,8 @@ static const uint8_t end_sequence_d[3] = {
 	0x55 ^ 0x93
 };
 
-static void phy_start_tx(void)
+static void build_tx_header(void)
 {
-
-	// Schalte UP4DAR auf Senden um
-	
-    send_cmd(tx_on, 1);
-	
-	// Bereite einen Header vor
-	
 	header[0] = 0x20;
 	header[1] = (SETTING_CHAR(C_DV_DIRECT) == 1) ? 0 :	// "1st control byte"
 				  (1 << 6)	// Setze den Repeater-Flag
@@ -252,6 +241,14 @@ static void phy_start_tx(void)
 	for (short i=0; i<CALLSIGN_EXT_LENGTH; ++i){
 		header[36+i] = settings.s.my_ext[i];
 	}
+}
+
+static void phy_start_tx(void)
+{
+
+	// Schalte UP4DAR auf Senden um
+	
+    send_cmd(tx_on, 1);
 	
 	// Bis zu 70ms kann man sich Zeit lassen, bevor die Header-Daten uebergeben werden.
 	// Die genaue Wartezeit ist natruerlich von TX-DELAY abhaengig.
@@ -570,59 +567,48 @@ void send_feedback(void)
 
 static void dtmf_decode_init(void)
 {
-	dtmf_tone_detected = 0;
 	strncpy(dtmf_cmd_string, "      ", MAX_DTMF_COMMAND);
 	dtmf_cmd_ptr = 0;
-	memset(dtmf_history, 0, MAX_DTMF_HISTORY);
-	dtmf_counter = 0;
+	dtmf_disp_ptr = 0;
+	
+	dtmf_detect_init(SETTING_SHORT(S_DTMF_ON_COUNT), SETTING_SHORT(S_DTMF_OFF_COUNT),
+		SETTING_SHORT(S_DTMF_MIN_GAP));
 }
 
 
 static int dtmf_decode(const uint8_t * ambe_data)
 {
-	int i;
-	int dtmf_code = 0;
+	int digit;
+	int dtmf_code = dtmf_detect(ambe_data, &digit);
 	
-	if (dtmf_counter < DTMF_DETECT_TIME)
+	if ((digit != 0) && (dtmf_disp_ptr < MAX_DTMF_COMMAND)) // only draw the new digit
 	{
-		dtmf_counter ++;
-	
-		dtmf_code = ambe_get_dtmf_code(ambe_data);
-	
-		dtmf_history[dtmf_counter % MAX_DTMF_HISTORY] = dtmf_code;
-	
-		memset(dtmf_histogram, 0, DTMF_HISTOGRAM_SIZE);
+		char buf[2];
+		
+		buf[0] = digit;
+		buf[1] = 0;
+		vd_prints_xy(VDISP_AUDIO_LAYER, dtmf_disp_ptr * 6, 48, VDISP_FONT_6x8, 0, buf);
+		dtmf_disp_ptr ++;
+	}
 	
-		for (i=0; i < MAX_DTMF_HISTORY; i++)
-		{
-			dtmf_histogram[dtmf_history[i]] ++;
-		}
+	return dtmf_code;
+}
+
+// build the command string from the digits detected during the transmission
+
+static void dtmf_cmd_collect(void)
+{
+	struct dtmf_event ev;
 	
-		
-		for (i=0; i < DTMF_HISTOGRAM_SIZE; i++)
+	while (dtmf_get_event(&ev) != 0)
+	{
+		if (dtmf_cmd_ptr < MAX_DTMF_COMMAND)
 		{
-			if (dtmf_histogram[i] >= DTMF_THRESHOLD)
-			{
-				if (i != dtmf_tone_detected)
-				{
-					dtmf_tone_detected = i;
-					
-					if ((i > 0) && (dtmf_cmd_ptr < MAX_DTMF_COMMAND))
-					{
-						dtmf_cmd_string[dtmf_cmd_ptr] = dtmf_code_to_char(dtmf_tone_detected);
-						dtmf_cmd_ptr++;
-						dtmf_cmd_string[dtmf_cmd_ptr] = 0;
-					}
-				}
-				
-				break;
-			}
+			dtmf_cmd_string[dtmf_cmd_ptr] = ev.digit;
+			dtmf_cmd_ptr++;
+			dtmf_cmd_string[dtmf_cmd_ptr] = 0;
 		}
-	
-		vd_prints_xy(VDISP_AUDIO_LAYER, 0, 48, VDISP_FONT_6x8, 0, dtmf_cmd_string);
 	}
-	
-	return dtmf_code;
 }
 
 
@@ -667,6 +653,8 @@ static void parse_number(const char * s, int len, int * num, char * dcs_room)
 
 static void dtmf_cmd_exec(void)
 {
+	dtmf_cmd_collect();
+	
 	if (dtmf_cmd_string[0] != 32) // a DTMF string was received
 	{
 		int len = strlen(dtmf_cmd_string);
@@ -743,6 +731,102 @@ static void dtmf_cmd_exec(void)
 	}	
 }
 
+// command transmissions (link, unlink etc.) and traffic for the local repeater
+
+static int header_not_forwarded( uint8_t crc_result, const uint8_t * header )
+{
+	return ((crc_result == DSTAR_HEADER_OK) &&
+		((header[26] == 'I') ||
+		(header[26] == 'U') ||
+		(header[26] == 'L') ||
+		(((repeater_mode &&
+		(header[10] != 0x47)) ||
+		((hotspot_mode) &&
+		(header[0] & 0x40))) &&
+		((header[0] & 0x08) == 0))));
+}
+
+
+static int sec_session_id;
+static int sec_forward = 0;
+static uint8_t sec_frame_counter;
+static uint8_t sec_header[39];
+static uint8_t sec_crc_result;
+
+// PHY stream that lost the RX arbitration against a network stream:
+// forward it to the reflector instead of dropping it
+
+static void rx_secondary_forward( uint8_t source, int event, uint8_t pos,
+	const uint8_t * data, const uint8_t * voice )
+{
+	switch (event)
+	{
+		case RX_Q_SECONDARY_START:
+			sec_forward = 0;
+			
+			if ((source == SOURCE_PHY) && (hotspot_mode || repeater_mode))
+			{
+				rx_q_get_header(source, &sec_crc_result, sec_header);
+				
+				if (!header_not_forwarded(sec_crc_result, sec_header))
+				{
+					sec_forward = 1;
+					sec_session_id = crypto_get_random_16bit();
+					sec_frame_counter = 0;
+				}
+			}
+			break;
+			
+		case RX_Q_SECONDARY_FRAME:
+			if (sec_forward != 0)
+			{
+				sec_frame_counter = pos;
+				
+				send_dcs_hotspot(  sec_session_id, 0, pos, data, voice, 
+					sec_crc_result, sec_header );
+			}
+			break;
+			
+		case RX_Q_SECONDARY_END:
+			if ((sec_forward != 0) && dcs_is_connected())
+			{
+				sec_frame_counter = (sec_frame_counter + 1) % 21;
+				
+				send_dcs_hotspot(  sec_session_id, 0, sec_frame_counter, end_sequence_d, ambe_silence_data, 
+					sec_crc_result, sec_header );
+				
+				sec_frame_counter = (sec_frame_counter + 1) % 21;
+				
+				send_dcs_hotspot(  sec_session_id, 1, sec_frame_counter, end_sequence_d, end_sequence_v, 
+					sec_crc_result, sec_header );
+			}
+			
+			sec_forward = 0;
+			break;
+	}
+}
+
+
+
+// next AMBE frame to send, from the microphone or from a recording,
+// returns 0 on success
+
+static int tx_get_frame(uint8_t * d)
+{
+	if (tx_playback)
+	{
+		return recorder_play_get(d);
+	}
+	
+	if (ambe_q_get(microphone, d) != 0)
+	{
+		return 1;
+	}
+	
+	recorder_put_frame(d);
+	return 0;
+}
+
 static void vTXTask( void *pvParameters )
 {
 	int tx_state = 0;
@@ -787,7 +871,9 @@ static void vTXTask( void *pvParameters )
 			tx_info_off();
 			ambe_ref_timer_break(0);
 			
-			if (PTT_CONDITION  // PTT pressed
+			tx_playback = recorder_playing_tx();
+			
+			if ((PTT_CONDITION || tx_playback)  // PTT pressed or playback of a recording
 			 && (memcmp(settings.s.my_callsign, "NOCALL  ", CALLSIGN_LENGTH) != 0))
 			{
 				
@@ -795,7 +881,14 @@ static void vTXTask( void *pvParameters )
 				
 				ambe_set_automute(0); // switch off automute
 				tx_state = 1;
-				ambe_start_encode();
+				
+				build_tx_header();
+				
+				if (!tx_playback)
+				{
+					ambe_start_encode();
+					recorder_start(REC_TX, (const uint8_t *) header + 1);
+				}
 						
 				if (!dcs_mode || hotspot_mode || repeater_mode)
 				{
@@ -885,15 +978,7 @@ static void vTXTask( void *pvParameters )
 							
 							// vd_prints_xy(VDISP_DEBUG_LAYER, 108, 22, VDISP_FONT_4x6, 0, "ON " );
 							
-							if ((header_crc_result == DSTAR_HEADER_OK) &&
-								((rx_header[26] == 'I') ||
-								(rx_header[26] == 'U') ||
-								(rx_header[26] == 'L') ||
-								(((repeater_mode &&
-								(rx_header[10] != 0x47)) ||
-								((hotspot_mode) &&
-								(rx_header[0] & 0x40))) &&
-								((rx_header[0] & 0x08) == 0))))
+							if (header_not_forwarded(header_crc_result, rx_header))
 							{
 								tx_state = 11; // don't forward transmission
 																
@@ -977,7 +1062,7 @@ static void vTXTask( void *pvParameters )
 		case 1:  // PTT on
 			tx_info_on();
 			ambe_ref_timer_break(1);
-			if ((!PTT_CONDITION) && (tx_min_count <= 0))  // PTT released
+			if ((!PTT_CONDITION) && (!tx_playback) && (tx_min_count <= 0))  // PTT released
 			{
 				tx_state = 2;
 				ambe_stop_encode();
@@ -989,9 +1074,10 @@ static void vTXTask( void *pvParameters )
 					tx_min_count--;
 				}
 				
-				if (ambe_q_get(microphone, dcs_ambe_data) != 0) // queue unexpectedly empty
+				if (tx_get_frame(dcs_ambe_data) != 0) // queue unexpectedly empty or end of the playback
 				{
 					ambe_stop_encode();
+					recorder_stop(REC_TX);
 					if (dcs_mode && dcs_is_connected())
 					{
 						memcpy(dcs_ambe_data, ambe_silence_data, 9);
@@ -1049,8 +1135,10 @@ static void vTXTask( void *pvParameters )
 			break;
 				
 		case 2: // PTT off, drain microphone data
-			if (ambe_q_get(microphone, dcs_ambe_data) != 0) // queue empty
+			if (tx_get_frame(dcs_ambe_data) != 0) // queue empty
 			{
+				recorder_stop(REC_TX);
+				
 				if (dcs_mode && dcs_is_connected())
 				{
 					memcpy(dcs_ambe_data, ambe_silence_data, 9);
@@ -1302,6 +1390,8 @@ void txtask_init( ambe_q_t * mic )
 	{
 		repeater_callsign[7] = DEFAULT_REPEATER_MODULE_CHAR; // my repeater module
 	}
+	rx_q_set_secondary( rx_secondary_forward );
+	
 	xTaskCreate( vTXTask, (signed char *) "TX", 300, ( void * ) 0, tskIDLE_PRIORITY + 1, ( xTaskHandle * ) NULL );
 	
 }
\ No newline at end of file
@@ -29,9 +29,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "task.h"
+#include "semphr.h"
 
 
 #include <asf.h>
+#include "intc.h"
 
 #include "board.h"
 #include "gpio.h"
@@ -47,6 +49,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "up_net/arp.h"
 
+#include "up_dstar/dstar.h"
+#include "up_dstar/latency.h"
+
+#include "up_net/snmp_data.h"
+
 
 U32 eth_counter = 0;
 U32 eth_counter2 = 0;
@@ -55,6 +62,34 @@ U32 eth_counter3 = 0;
 int eth_ptr = 0;
 
 
+// the MACB interrupt (frame received, frame sent) wakes the Ethernet task,
+// the task sleeps in eth_wait() while nothing happens
+
+static xSemaphoreHandle eth_sem;
+
+static volatile uint32_t eth_irq_time;  // cycle counter at the RX interrupt, 0 = none
+
+static struct eth_rx_stats
+{
+	uint32_t wakes;
+	uint32_t timeouts;
+	uint32_t frames;
+	uint32_t budget_hits;	// wakes that ended with frames left in the ring
+	uint32_t overruns;		// RSR.OVR or RSR.BNA set
+	uint32_t resyncs;		// ring searched for the next frame
+	uint32_t lat_sum;		// interrupt -> task (cycles)
+	uint32_t lat_count;
+	uint32_t lat_max;
+	uint32_t wrapped;		// frames in two pieces
+	uint32_t copied;		// frames in two pieces that had to be copied
+	uint32_t no_buffer;		// frames in two pieces dropped, too long for the copy
+} eth_rx_stats;
+
+#define ETH_RX_INT_MASK  (AVR32_MACB_IER_RCOMP_MASK | AVR32_MACB_IER_RXUBR_MASK | \
+							AVR32_MACB_IER_ROVR_MASK)
+#define ETH_TX_INT_MASK  (AVR32_MACB_IER_TCOMP_MASK | AVR32_MACB_IER_TXUBR_MASK)
+
+
 /*
 
 static unsigned char vdisp_frame[1024 + 42 + 320] =
@@ -84,7 +119,7 @@ static unsigned char vdisp_frame[1024 + 42 + 320] =
 #define RECV_BUF_COUNT  48
 #define RECV_BUF_SIZE	128
 
-static unsigned char rx_mem[(RECV_BUF_COUNT * RECV_BUF_SIZE) + 1540];  // 64 * 128  + 1 Frame
+static unsigned char rx_mem[(RECV_BUF_COUNT * RECV_BUF_SIZE) + 8];  // + 8 byte alignment
 
 static unsigned long rx_buffer_q[RECV_BUF_COUNT * 2];
 
@@ -93,9 +128,43 @@ unsigned char mac_addr[6] = { 0xDE, 0x1B, 0xFF, 0x00, 0x00, 0x00 };
 
 
 
+#if __GNUC__
+__attribute__((__noinline__))
+#endif
+static portBASE_TYPE eth_int_non_naked (void)
+{
+	portBASE_TYPE task_woken = pdFALSE;
+	
+	unsigned long isr = AVR32_MACB.isr;  // clear on read
+	
+	if (((isr & ETH_RX_INT_MASK) != 0) && (eth_irq_time == 0))
+	{
+		eth_irq_time = Get_sys_count() | 1;
+	}
+	
+	xSemaphoreGiveFromISR( eth_sem, &task_woken );
+	
+	return task_woken;
+}
+
+
+#if __GNUC__
+__attribute__((__naked__))
+#endif
+static void eth_int (void)
+{
+	portENTER_SWITCHING_ISR();
+	eth_int_non_naked();
+	portEXIT_SWITCHING_ISR();
+}
+
+
 //void eth_init(unsigned char ** p)
 void eth_init(void)
 {	
+	vSemaphoreCreateBinary( eth_sem );
+	xSemaphoreTake( eth_sem, 0 );
+	
 	
 	// Ethernet MAC address
 	memcpy(mac_addr + 3, (unsigned char *) 0x80800204, 3); // first 3 bytes of CPU id
@@ -123,12 +192,7 @@ void eth_init(void)
 		*p = vdisp_frame + 42;
 	}  */
 	
-	unsigned long rx_addr = ((unsigned long) & rx_mem) & 0xFFFFFFFC; 
-	
-	if (rx_addr & 0x04)
-	{
-		rx_addr += 4;  // align to 8 byte boundary
-	}
+	unsigned long rx_addr = (((unsigned long) & rx_mem) + 7) & 0xFFFFFFF8;  // align to 8 byte boundary
 	
 	int i;
 	
@@ -153,10 +217,20 @@ void eth_init(void)
 	AVR32_MACB.sa1t	= mac_addr[4] |
 						(mac_addr[5] << 8);
 						
-	AVR32_MACB.NCR.re = 1;  // receive enable
-
 	eth_ptr = 0;
 	
+	AVR32_MACB.idr = 0xFFFFFFFF;
+	
+	portENTER_CRITICAL();
+	
+	INTC_register_interrupt( (__int_handler) &eth_int, AVR32_MACB_IRQ, AVR32_INTC_INT1 );
+	
+	portEXIT_CRITICAL();
+	
+	AVR32_MACB.ier = ETH_RX_INT_MASK | ETH_TX_INT_MASK;
+	
+	AVR32_MACB.NCR.re = 1;  // receive enable
+	
 	/*
 	// 2kHz tone:
 	for (i=(1024 + 42); i < (sizeof vdisp_frame); i+=8)
@@ -241,19 +315,58 @@ void eth_set_src_mac_and_type(uint8_t * data, uint16_t ethType)
 
 
 
-static void process_frame (unsigned char * p, int len)
+// wrapped frames are copied here, not to a TX buffer: a busy TX path
+// must not drop DHCP, SNMP, DNS or ICMP frames. One buffer is enough,
+// the Ethernet task processes one frame at a time.
+
+#define RX_LINEAR_SIZE  1540
+
+static uint8_t rx_linear_buf[RX_LINEAR_SIZE];
+
+const uint8_t * eth_rx_frame_linear (eth_rx_frame_t * f)
+{
+	if (f->len1 >= f->len)
+	{
+		return f->data;
+	}
+	
+	if (f->len > RX_LINEAR_SIZE)
+	{
+		eth_rx_stats.no_buffer ++;
+		return NULL;
+	}
+	
+	memcpy(rx_linear_buf, f->data, f->len1);
+	memcpy(rx_linear_buf + f->len1, f->data2, f->len - f->len1);
+	
+	f->data = rx_linear_buf;
+	f->len1 = f->len;
+	
+	eth_rx_stats.copied ++;
+	
+	return f->data;
+}
+
+
+static void process_frame (eth_rx_frame_t * f)
 {
+	unsigned char * p = (unsigned char *) f->data;
+	
 	//eth_counter ++;
 	
+	// D-STAR frames are processed right away, the time stamp is the time
+	// this task found the frame (the RX interrupt wakes the task)
+	LATENCY_STAMP(latency_input + SOURCE_NET);
+	
 	switch (((unsigned short *)p)[6])
 	{
 		case 0x86dd: // IPv6
 			break;
 		case 0x0800: // IPv4
-			ipv4_input(p+14, len - 14, p);
+			ipv4_input(f);
 			break;
 		case 0x0806: // ARP
-			if (len >= 42)
+			if (f->len >= 42)
 			{
 				arp_process_packet(p);
 			}
@@ -262,67 +375,78 @@ static void process_frame (unsigned char * p, int len)
 }
 
 
-void eth_rx (void)
+// the MACB writes the frames in ring order, the next frame always starts
+// at eth_ptr. The whole ring is only searched after an overrun or when
+// the MACB had no free buffer.
+
+static void rx_resync (void)
 {
-	if (AVR32_MACB.RSR.rec == 1) 
-	{
-		AVR32_MACB.RSR.rec = 1;  // bit loeschen
-		
+	int count = RECV_BUF_COUNT;
+	int start = eth_ptr;
 	
-		
-		while(1)
+	while ((rx_buffer_q[ (eth_ptr << 1) ] & 0x01) == 0) // fertigen buffer suchen
+	{
+		eth_ptr ++;
+		if (eth_ptr >= RECV_BUF_COUNT)
 		{
-			
-		
-		int count = RECV_BUF_COUNT;
+			eth_ptr = 0;
+		}
 		
+		count --;
+		if (count <= 0)  // genau RECV_BUF_COUNT pruefen, dann steht eth_ptr
+			// wieder an der stelle, an der der naechste startblock reingeschrieben wird
+		{
+			return;
+		}
+	}
+	
+	if (eth_ptr != start)
+	{
+		eth_rx_stats.resyncs ++;
+	}
+}
+
+
+int eth_rx (int budget)
+{
+	int frames = 0;
+	
+	unsigned long rsr = AVR32_MACB.rsr;
+	
+	AVR32_MACB.rsr = rsr;  // bits loeschen
+	
+	if ((rsr & (AVR32_MACB_RSR_OVR_MASK | AVR32_MACB_RSR_BNA_MASK)) != 0)
+	{
+		eth_rx_stats.overruns ++;
+		rx_resync();
+	}
+	
+	while (frames < budget)
+	{
 		while (1)
 		{
-			
-			while ((rx_buffer_q[ (eth_ptr << 1) ] & 0x01) == 0) // fertigen buffer suchen
+			if ((rx_buffer_q[ (eth_ptr << 1) ] & 0x01) == 0)
 			{
+				return 0;  // no more frames
+			}
 			
-				eth_ptr ++;
-				if (eth_ptr >= RECV_BUF_COUNT)
-				{
-					eth_ptr = 0;
-				}
-			
+			if ((rx_buffer_q[ (eth_ptr << 1) +1 ] & 0x4000) != 0) // start buffer
+				break;
 			
-				count --;
-				if (count <= 0)  // genau RECV_BUF_COUNT pruefen, sonst ist man
-				   // bei einem leeren buffer nicht genau an der stelle wo dann der
-				   // naechste startblock reingeschrieben wuerde. die naechste
-				   // if anweisung macht dann das paket kaputt.
-				{
-					// einmal alles durchgesucht, keinen fertigen buffer gefunden!
-				
-					return;
-				//	eth_counter ++;  // mitzaehlen, wie oft das passiert
-				//	return;
-				}
-			}
-		
-			if ((rx_buffer_q[ (eth_ptr << 1) +1 ] & 0x4000) == 0) // not start buffer
-			{	
 			// der gefundene buffer ist kein start buffer!
-				rx_buffer_q[ (eth_ptr << 1) ] &= (~ 0x01);  //freigeben und weitersuchen
-				
-				eth_counter3 ++;
+			rx_buffer_q[ (eth_ptr << 1) ] &= (~ 0x01);  //freigeben und weitersuchen
+			
+			eth_ptr ++;
+			if (eth_ptr >= RECV_BUF_COUNT)
+			{
+				eth_ptr = 0;
 			}
-			else
-				break;
-		}		
-				
-		/*
-		if ((rx_buffer_q[ (eth_ptr << 1) ] & 0x01) == 0)  // buffer nicht fertig -> break
-			break;
-		*/
-		
-		
+			
+			eth_counter3 ++;
+		}
 		
 		int start_buffer = eth_ptr;
-		count = 13; // irgendwo in den naechsten 13 buffern muss der stop-buffer sein
+		int count = 13; // irgendwo in den naechsten 13 buffern muss der stop-buffer sein
 		
 		int rx_error = 0;
 		
@@ -339,7 +463,6 @@ void eth_rx (void)
 			{
 				// keinen stop buffer gefunden
 				eth_counter2 ++;  // mitzaehlen, wie oft das passiert
-				// free_buffer(0, RECV_BUF_COUNT);
 				
 				free_buffer(start_buffer, eth_ptr); // alles bis hier hin freigeben
 				rx_error = 1;
@@ -348,13 +471,12 @@ void eth_rx (void)
 			
 			if ((rx_buffer_q[ (eth_ptr << 1) ] & 0x01) == 0)
 			{
-				// dieser buffer ist gar nicht gefuellt, der frame war vielleicht
-				// noch gar nicht fertig empfangen
+				// dieser buffer ist gar nicht gefuellt, der frame ist noch
+				// nicht fertig empfangen, das RCOMP interrupt weckt den task wieder
 				eth_ptr = start_buffer;  // zurueck auf den letzten start_buffer
 				
-				
 				eth_counter2 ++;  // mitzaehlen, wie oft das passiert
-				return;
+				return 0;
 			}
 			
 			if ((rx_buffer_q[ (eth_ptr << 1) +1 ] & 0x4000) != 0) // wir suchen einen stopbuffer
@@ -378,22 +500,25 @@ void eth_rx (void)
 		//   start_buffer  anfang
 		//   eth_ptr    ende
 		
-		int packet_len = rx_buffer_q[(eth_ptr << 1) +1] & 0x7FF;
+		eth_rx_frame_t f;
+		
+		f.data = (const uint8_t *) (rx_buffer_q[start_buffer << 1] & 0xFFFFFFFC);
+		f.len = rx_buffer_q[(eth_ptr << 1) +1] & 0x7FF;
+		f.len1 = f.len;
+		f.data2 = NULL;
 		
 		if (eth_ptr < start_buffer)  // buffer wrap trat auf
 		{
-			unsigned char * s_buf = ((unsigned char *) (rx_buffer_q[0] & (~0x07)));
-			memcpy ( s_buf + (RECV_BUF_COUNT * RECV_BUF_SIZE), s_buf, packet_len );
-			// Daten vom Anfang an's Ende kopieren, damit der Frame in einem Stueck ist
-		}			
+			// der Rest des Frames steht am Anfang des Rings
+			f.len1 = (RECV_BUF_COUNT - start_buffer) * RECV_BUF_SIZE;
+			f.data2 = (const uint8_t *) (rx_buffer_q[0] & 0xFFFFFFFC);
+			
+			eth_rx_stats.wrapped ++;
+		}
 		
 		// Frame bearbeiten
 		
-		process_frame ((unsigned char *) (rx_buffer_q[start_buffer << 1] & 0xFFFFFFFC),
-		   packet_len);
-		
-		//eth_counter ++;
-		//
+		process_frame (& f);
 		
 		eth_ptr ++;
 		if (eth_ptr >= RECV_BUF_COUNT)
@@ -403,13 +528,115 @@ void eth_rx (void)
 		
 		free_buffer(start_buffer, eth_ptr);
 		
+		frames ++;
+		eth_rx_stats.frames ++;
+	}
+	
+	eth_rx_stats.budget_hits ++;
+	
+	return 1;  // budget used up, more frames may be waiting
+}
+
+
+void eth_wait (portTickType timeout)
+{
+	if (xSemaphoreTake( eth_sem, timeout ) != pdTRUE)
+	{
+		eth_rx_stats.timeouts ++;
+		return;
+	}
+	
+	eth_rx_stats.wakes ++;
+	
+	uint32_t t = eth_irq_time;
+	
+	if (t != 0)
+	{
+		eth_irq_time = 0;
+		
+		uint32_t cycles = Get_sys_count() - t;
+		
+		if (cycles > eth_rx_stats.lat_max)
+		{
+			eth_rx_stats.lat_max = cycles;
+		}
 		
-		} // while(1)		
+		eth_rx_stats.lat_sum += cycles;
+		eth_rx_stats.lat_count ++;
 		
+		if (eth_rx_stats.lat_sum > 0x40000000)
+		{
+			eth_rx_stats.lat_sum >>= 1;
+			eth_rx_stats.lat_count >>= 1;
+		}
 	}
+}
+
+
+void eth_wakeup (void)
+{
+	xSemaphoreGive( eth_sem );
+}
+
 
+// cycles -> microseconds (65536 cycles = 1ms)
+#define ETH_CYCLES_TO_US(c)		(((c) * 125) >> 13)
+
+int snmp_get_eth_rx (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
 	
+	switch (arg)
+	{
+		case 1:
+			value = eth_rx_stats.wakes;
+			break;
+		
+		case 2:
+			value = eth_rx_stats.timeouts;
+			break;
+		
+		case 3:
+			value = eth_rx_stats.frames;
+			break;
+		
+		case 4:
+			value = eth_rx_stats.budget_hits;
+			break;
+		
+		case 5:
+			value = eth_rx_stats.overruns;
+			break;
+		
+		case 6:
+			value = eth_rx_stats.resyncs;
+			break;
+		
+		case 7:
+			if (eth_rx_stats.lat_count > 0)
+			{
+				value = ETH_CYCLES_TO_US(eth_rx_stats.lat_sum / eth_rx_stats.lat_count);
+			}
+			break;
+		
+		case 8:
+			value = ETH_CYCLES_TO_US(eth_rx_stats.lat_max);
+			break;
+		
+		case 9:
+			value = eth_rx_stats.wrapped;
+			break;
+		
+		case 10:
+			value = eth_rx_stats.copied;
+			break;
+		
+		case 11:
+			value = eth_rx_stats.no_buffer;
+			break;
+	}
 	
+	return snmp_encode_int( value, res, res_len, maxlen );
 }
 
 /*
@@ -33,7 +33,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 void eth_init(void);
 
 
-void eth_rx (void);
+// a received frame, a frame that wraps at the end of the receive ring is
+// in two pieces. The first piece has at least the first 128 bytes (one
+// receive buffer), so the Ethernet, IPv4 and UDP headers are always in
+// the first piece.
+
+typedef struct eth_rx_frame
+{
+	const uint8_t * data;	// first piece
+	int len;				// length of the frame
+	int len1;				// bytes in the first piece (len if the frame doesn't wrap)
+	const uint8_t * data2;	// the rest of the frame (start of the ring)
+} eth_rx_frame_t;
+
+// returns the frame in one piece, a wrapped frame is copied to a buffer
+// reserved for this (valid while the frame is processed). NULL if the
+// frame is longer than the buffer.
+const uint8_t * eth_rx_frame_linear (eth_rx_frame_t * f);
+
+
+// frames processed per wake of the Ethernet task, a broadcast storm
+// can't keep the task busy for longer than that
+#define ETH_RX_BUDGET		8
+
+// the task wakes up at least this often (ticks) even without interrupts
+#define ETH_IDLE_TIMEOUT	100
+
+// returns 1 if the budget was used up and frames may be left in the ring
+int eth_rx (int budget);
+
+// sleep until the MACB interrupt or eth_wakeup()
+void eth_wait (portTickType timeout);
+void eth_wakeup (void);
 
 void eth_set_src_mac_and_type(uint8_t * data, uint16_t ethType);
 
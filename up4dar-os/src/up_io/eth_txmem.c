@@ -31,15 +31,45 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "task.h"
 
 
+#include <asf.h>
+
 #include "eth_txmem.h"
 
 #include "gcc_builtin.h"
 
+#include "up_net/snmp_data.h"
+#include "up_net/inet_csum.h"
+
+
+// TX descriptor ring: the MACB sends the frames from descriptor to
+// descriptor and stops at a descriptor with the used bit set. Frames are
+// appended at tx_head while the MACB is running, TSTART restarts it if it
+// had stopped. After a frame was sent the MACB sets the used bit again,
+// the buffer is freed as soon as its own descriptor is done.
+//
+// A frame uses one descriptor for the buffer and one for each payload
+// segment. The MACB sets the used bit only on the first descriptor of a
+// frame, the other descriptors are set to used when the frame is reclaimed,
+// so every free descriptor has the used bit set.
+
+#define TX_BUFFER_Q_LEN		24
+
+#define TX_USED		0x80000000
+#define TX_WRAP		0x40000000
+#define TX_LAST		0x00008000   // last buffer of the frame
+
+#define TX_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
 
-#define TX_BUFFER_Q_LEN		15
+// TSR: retry limit exceeded, buffers exhausted mid frame, underrun
+#define TX_ERRORS	(AVR32_MACB_TSR_RLE_MASK | AVR32_MACB_TSR_BEX_MASK | AVR32_MACB_TSR_UND_MASK)
 
 static unsigned long tx_buffer_q[TX_BUFFER_Q_LEN * 2];
 
+static eth_txmem_t * tx_slot[TX_BUFFER_Q_LEN];  // frame of each first descriptor, NULL for segments
+
+static int tx_head;   // next descriptor to fill
+static int tx_tail;   // oldest descriptor that was not reclaimed
+static int tx_count;  // descriptors owned by the MACB or not reclaimed
 
 
 
@@ -57,30 +87,60 @@ const static txmem_mem_cfg_t mem_cfg[NUM_MEM_CFG] = {
 	{ 1540,   3  }	// 3 buffers with 1540 byte
 };
 
-static eth_txmem_t * txmem_pool[NUM_MEM_CFG];
+static eth_txmem_t * free_list[NUM_MEM_CFG];  // free buffers of each size
 
 
 #define TXMEM_FREE  1
 #define TXMEM_ALLOC 2
-#define TXMEM_IN_TXQ 3
 #define TXMEM_IN_HARDWARE_Q 4
 
-static xQueueHandle  tx_q;
+
+static struct txmem_stats
+{
+	uint32_t frames;
+	uint32_t ring_full;		// frames not sent, no free descriptor
+	uint32_t no_mem;		// eth_txmem_get() without result
+	uint32_t errors;		// TX stopped by an error, ring restarted
+	uint32_t lat_sum;		// eth_txmem_send() -> buffer reclaimed (cycles)
+	uint32_t lat_count;
+	uint32_t lat_max;
+	uint16_t max_count;		// max. descriptors in use
+} txmem_stats;
+
+
+static void tx_ring_reset (void)
+{
+	int i;
+	
+	for (i=0; i < TX_BUFFER_Q_LEN; i++)
+	{
+		tx_buffer_q[ (i << 1) + 0 ] = 0;
+		tx_buffer_q[ (i << 1) + 1 ] = TX_USED;
+		tx_slot[i] = NULL;
+	}
+	
+	tx_buffer_q[ ((TX_BUFFER_Q_LEN - 1) << 1) + 1 ] |= TX_WRAP;
+	
+	tx_head = 0;
+	tx_tail = 0;
+	tx_count = 0;
+	
+	AVR32_MACB.tbqp = (unsigned long) & tx_buffer_q; // reset buffer and internal pointer
+}
+
 
 int eth_txmem_init(void)
 {
 	int i;
 	int j;
 	
-	AVR32_MACB.tbqp = (unsigned long) & tx_buffer_q;
-	
-	tx_q = xQueueCreate( 10, sizeof (eth_txmem_t *) );
+	tx_ring_reset();
 	
 	for (i=0; i < NUM_MEM_CFG; i++)
 	{	
-		txmem_pool[i] = (eth_txmem_t *) pvPortMalloc ( mem_cfg[i].num * (sizeof (eth_txmem_t)));
+		eth_txmem_t * pool = (eth_txmem_t *) pvPortMalloc ( mem_cfg[i].num * (sizeof (eth_txmem_t)));
 	
-		if (txmem_pool[i] == NULL)
+		if (pool == NULL)
 			return -1;
 			
 		uint8_t * data = (uint8_t *) pvPortMalloc ( mem_cfg[i].num *  mem_cfg[i].size );
@@ -88,139 +148,372 @@ int eth_txmem_init(void)
 		if (data == NULL)
 			return -1;
 		
-		for (j=0; j < mem_cfg[i].num; j++)
+		free_list[i] = NULL;
+		
+		for (j=mem_cfg[i].num - 1; j >= 0; j--)
 		{
-			txmem_pool[i][j].state = TXMEM_FREE;
-			txmem_pool[i][j].tx_size = 0;
-			txmem_pool[i][j].data = data + (j * mem_cfg[i].size);
+			pool[j].state = TXMEM_FREE;
+			pool[j].tx_size = 0;
+			pool[j].data = data + (j * mem_cfg[i].size);
+			pool[j].pool = i;
+			pool[j].next = free_list[i];
+			free_list[i] = pool + j;
 		}	
 	}
 	
 	return 0;
 }
 
-// extern int maxTXQ;
 
-static void eth_txmem_cleanup (void)
+// drop a reference, in a critical section
+static void txmem_put (eth_txmem_t * packet)
 {
 	int i;
-	int j;
-	for (i=0; i < NUM_MEM_CFG; i++)
-	{	
-		for (j=0; j < mem_cfg[i].num; j++)
+	
+	packet->refs --;
+	
+	if (packet->refs != 0)
+		return;  // still used by another frame
+	
+	for (i=0; i < packet->num_seg; i++)
+	{
+		txmem_put(packet->seg[i]);  // segments have no segments, no deeper recursion
+	}
+	
+	packet->num_seg = 0;
+	
+	if (packet->pool == ETH_TXMEM_STATIC)
+		return;
+	
+	packet->state = TXMEM_FREE;
+	packet->next = free_list[packet->pool];
+	free_list[packet->pool] = packet;
+}
+
+
+// free the buffers of all frames the MACB has sent, in a critical section
+static void tx_reclaim (void)
+{
+	while (tx_count > 0)
+	{
+		int i = tx_tail;
+		
+		if ((tx_buffer_q[ (i << 1) + 1 ] & TX_USED) == 0)
+			break;  // not sent yet
+		
+		eth_txmem_t * p = tx_slot[i];
+		int n = 1 + p->num_seg;  // descriptors of this frame
+		
+		uint32_t cycles = Get_sys_count() - p->t_send;
+		
+		if (cycles > txmem_stats.lat_max)
+		{
+			txmem_stats.lat_max = cycles;
+		}
+		
+		txmem_stats.lat_sum += cycles;
+		txmem_stats.lat_count ++;
+		
+		if (txmem_stats.lat_sum > 0x40000000)
+		{
+			txmem_stats.lat_sum >>= 1;
+			txmem_stats.lat_count >>= 1;
+		}
+		
+		tx_slot[i] = NULL;
+		txmem_put(p);
+		
+		tx_count -= n;
+		
+		while (n > 0)
 		{
-			if (txmem_pool[i][j].state == TXMEM_IN_HARDWARE_Q)
+			tx_buffer_q[ (i << 1) + 1 ] |= TX_USED;  // segment descriptors
+			
+			i ++;
+			if (i >= TX_BUFFER_Q_LEN)
 			{
-				txmem_pool[i][j].state = TXMEM_FREE;
-				
-				// maxTXQ --;
+				i = 0;
 			}
+			
+			n --;
 		}
-	}					
+		
+		tx_tail = i;
+	}
 }
 
 
 void eth_txmem_free (eth_txmem_t * packet)
 {
-	packet->state = TXMEM_FREE;
-	
-	// maxTXQ --;
+	portENTER_CRITICAL();
+	txmem_put(packet);
+	portEXIT_CRITICAL();
 }
 
-eth_txmem_t * eth_txmem_get (int size)
+
+eth_txmem_t * eth_txmem_get_raw (int size)
 {
 	int i;
-	int j;
+	eth_txmem_t * p = NULL;
+	
+	portENTER_CRITICAL();
+	
 	for (i=0; i < NUM_MEM_CFG; i++)
 	{
 		if (mem_cfg[i].size < size)  // look for smallest buffer size that fits
 			continue;
-			
-		for (j=0; j < mem_cfg[i].num; j++)
+		
+		if (free_list[i] == NULL)
 		{
-			if (txmem_pool[i][j].state == TXMEM_FREE)
-			{
-				txmem_pool[i][j].state = TXMEM_ALLOC;
-				txmem_pool[i][j].tx_size = size;
-				
-				memset(txmem_pool[i][j].data, 0, size); // initialize with 0
-			//	maxTXQ ++;
-				return & txmem_pool[i][j];
-			}
+			tx_reclaim();  // frames sent since the last wake of the Ethernet task
 		}
-	}	
+		
+		p = free_list[i];
+		
+		if (p != NULL)
+		{
+			free_list[i] = p->next;
+			p->state = TXMEM_ALLOC;
+			p->tx_size = size;
+			p->refs = 1;
+			p->num_seg = 0;
+			break;
+		}
+	}
 	
-	return 0;	
+	if (p == NULL)
+	{
+		txmem_stats.no_mem ++;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return p;
 }
 
 
-int eth_txmem_send (eth_txmem_t * packet)
+eth_txmem_t * eth_txmem_get (int size)
 {
-	eth_txmem_t * p = packet;
-	
-	p->state = TXMEM_IN_TXQ;
+	eth_txmem_t * p = eth_txmem_get_raw(size);
 	
-	if( xQueueSend( tx_q, &p, 0 ) != pdPASS )
+	if (p != NULL)
 	{
-		// TODO: error handling
-		// queue is full, release buffer
-		p->state = TXMEM_FREE; 
-	//	maxTXQ --;
+		memset(p->data, 0, size); // initialize with 0
+	}
+	
+	return p;
+}
+
+
+void eth_txmem_static_init (eth_txmem_t * seg, uint8_t * data, int len)
+{
+	seg->data = data;
+	seg->tx_size = len;
+	seg->state = TXMEM_ALLOC;
+	seg->pool = ETH_TXMEM_STATIC;
+	seg->refs = 1;  // reference of the owner, never dropped
+	seg->num_seg = 0;
+	seg->sum = inet_csum_fold(inet_csum_add(0, data, len));
+}
+
+
+int eth_txmem_add_seg (eth_txmem_t * packet, eth_txmem_t * seg)
+{
+	if (packet->num_seg >= ETH_TXMEM_MAX_SEG)
 		return -1;
-	}		
+	
+	portENTER_CRITICAL();
+	seg->refs ++;
+	portEXIT_CRITICAL();
+	
+	packet->seg[packet->num_seg] = seg;
+	packet->num_seg ++;
 	
 	return 0;
 }
 
 
-static int eth_tx_active = 0;
+int eth_txmem_frame_len (const eth_txmem_t * packet)
+{
+	int len = packet->tx_size;
+	int i;
+	
+	for (i=0; i < packet->num_seg; i++)
+	{
+		len += packet->seg[i]->tx_size;
+	}
+	
+	return len;
+}
+
 
-void eth_txmem_flush_q (void)
+static void tx_set_descriptor (int i, const eth_txmem_t * p, unsigned long flags)
+{
+	tx_buffer_q[ (i << 1) + 0 ] = (unsigned long) p->data;
+	
+	TX_BARRIER();  // address first, then hand the descriptor to the MACB
+	
+	tx_buffer_q[ (i << 1) + 1 ] = ((unsigned long) p->tx_size) | flags |
+		((i == (TX_BUFFER_Q_LEN - 1)) ? TX_WRAP : 0);
+}
+
+
+int eth_txmem_send (eth_txmem_t * packet)
 {
-	int count = 0;
+	int n = 1 + packet->num_seg;  // descriptors of this frame
 	
-	if (eth_tx_active != 0)
+	portENTER_CRITICAL();
+	
+	if ((tx_count + n) > TX_BUFFER_Q_LEN)
 	{
-		if ((AVR32_MACB.tsr & 0x08) != 0) // TGO set -> TX active
-		{
-			return;  // don't write anything to tx_buffer_q while MACB is working
-		}
-		else
+		tx_reclaim();
+	}
+	
+	if ((tx_count + n) > TX_BUFFER_Q_LEN)
+	{
+		txmem_stats.ring_full ++;
+		txmem_put(packet);  // ring is full, release buffer
+		portEXIT_CRITICAL();
+		return -1;
+	}
+	
+	int first = tx_head;
+	int i = first;
+	int k;
+	
+	tx_slot[first] = packet;
+	packet->state = TXMEM_IN_HARDWARE_Q;
+	packet->t_send = Get_sys_count();
+	
+	// segments first, the MACB must not start the frame before
+	// all of its descriptors are ready
+	for (k=0; k < packet->num_seg; k++)
+	{
+		i ++;
+		if (i >= TX_BUFFER_Q_LEN)
 		{
-			eth_tx_active = 0;
-			eth_txmem_cleanup(); // free used memory
+			i = 0;
 		}
+		
+		tx_set_descriptor(i, packet->seg[k], (k == (packet->num_seg - 1)) ? TX_LAST : 0);
+	}
+	
+	TX_BARRIER();
+	
+	tx_set_descriptor(first, packet, (packet->num_seg == 0) ? TX_LAST : 0);
+	
+	i ++;
+	if (i >= TX_BUFFER_Q_LEN)
+	{
+		i = 0;
+	}
+	
+	tx_head = i;
+	tx_count += n;
+	
+	if (tx_count > txmem_stats.max_count)
+	{
+		txmem_stats.max_count = tx_count;
 	}
 	
+	txmem_stats.frames ++;
+	
+	AVR32_MACB.NCR.tstart = 1; // transmit frames (no effect if the MACB is running)
+	
+	portEXIT_CRITICAL();
+	
+	return 0;
+}
+
+
+void eth_txmem_flush_q (void)
+{
+	unsigned long tsr = AVR32_MACB.tsr;
 	
+	portENTER_CRITICAL();
 	
-	while(count < TX_BUFFER_Q_LEN)
+	if ((tsr & TX_ERRORS) != 0)
 	{
-		eth_txmem_t * p;
+		// the MACB has stopped and goes back to the start of the ring,
+		// the frames in the ring are lost
+		AVR32_MACB.tsr = tsr;  // clear bits
 		
-		if( xQueueReceive( tx_q, &p, 0 ) != pdPASS)
-			break;  // queue is empty
+		while (tx_count > 0)
+		{
+			if (tx_slot[tx_tail] != NULL)  // first descriptor of a frame
+			{
+				txmem_put(tx_slot[tx_tail]);
+			}
+			
+			tx_tail ++;
+			if (tx_tail >= TX_BUFFER_Q_LEN)
+			{
+				tx_tail = 0;
+			}
 			
-		tx_buffer_q[ (count << 1) + 0 ] = (unsigned long) p->data;
-		tx_buffer_q[ (count << 1) + 1 ] = ((unsigned long) p->tx_size) | 0x00008000; // last buffer of this frame
+			tx_count --;
+		}
 		
-		p->state = TXMEM_IN_HARDWARE_Q;
+		tx_ring_reset();
 		
-		count ++;
+		txmem_stats.errors ++;
+	}
+	else
+	{
+		tx_reclaim();
+		
+		// a TSTART while the MACB was stopping on a used descriptor is
+		// ignored, the frames in the ring would wait for the next send
+		if ((tx_count > 0) && ((AVR32_MACB.tsr & AVR32_MACB_TSR_TGO_MASK) == 0))
+		{
+			AVR32_MACB.NCR.tstart = 1;
+		}
 	}
 	
+	portEXIT_CRITICAL();
+}
+
+
+// cycles -> microseconds (65536 cycles = 1ms)
+#define TXMEM_CYCLES_TO_US(c)		(((c) * 125) >> 13)
+
+int snmp_get_eth_tx (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
 	
-	
-	if (count > 0)
+	switch (arg)
 	{
-		AVR32_MACB.tbqp = (unsigned long) & tx_buffer_q; // reset buffer and internal pointer
+		case 1:
+			value = txmem_stats.frames;
+			break;
+		
+		case 2:
+			value = txmem_stats.ring_full;
+			break;
+		
+		case 3:
+			value = txmem_stats.no_mem;
+			break;
+		
+		case 4:
+			if (txmem_stats.lat_count > 0)
+			{
+				value = TXMEM_CYCLES_TO_US(txmem_stats.lat_sum / txmem_stats.lat_count);
+			}
+			break;
+		
+		case 5:
+			value = TXMEM_CYCLES_TO_US(txmem_stats.lat_max);
+			break;
 		
-		tx_buffer_q[ ((count - 1) << 1) + 1 ] |= 0x40000000; // set wrap bit on last buffer
-		AVR32_MACB.NCR.tstart = 1; // transmit frames
+		case 6:
+			value = txmem_stats.max_count;
+			break;
 		
-		eth_tx_active = 1;
+		case 7:
+			value = txmem_stats.errors;
+			break;
 	}
 	
-	// extern int debug1;
-	// debug1 = eth_tx_active;
+	return snmp_encode_int( value, res, res_len, maxlen );
 }
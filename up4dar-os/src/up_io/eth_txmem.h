@@ -30,20 +30,57 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ETH_TXMEM_H_
 #define ETH_TXMEM_H_
 
+#define ETH_TXMEM_MAX_SEG	2		// payload segments per frame
+
+#define ETH_TXMEM_STATIC	0xFF	// pool of a segment that is never freed
+
 typedef struct eth_txmem
 {
 	uint8_t * data;
 	uint16_t tx_size;
 	uint16_t state;
+	struct eth_txmem * next;	// free list
+	uint32_t t_send;			// cycle counter at eth_txmem_send()
+	uint8_t pool;
+	uint8_t refs;				// the buffer is freed when the last reference is dropped
+	uint8_t num_seg;
+	uint16_t sum;				// checksum partial sum of a static segment
+	struct eth_txmem * seg[ETH_TXMEM_MAX_SEG];  // sent after data, in the same frame
 	
 } eth_txmem_t;
 
 
 int eth_txmem_init(void);
+
+// buffer filled with zeros
 eth_txmem_t * eth_txmem_get (int size);
+
+// buffer not initialized, for callers that write every byte
+eth_txmem_t * eth_txmem_get_raw (int size);
+
+// the frame is appended to the TX ring right away, the buffer is
+// freed after it was sent. Returns -1 (buffer freed) if the ring is full.
 int eth_txmem_send (eth_txmem_t * packet);
+
+// Ethernet task: free the buffers of sent frames, restart after TX errors
 void eth_txmem_flush_q (void);
+
+// drops one reference (the segments of a frame are released with it)
 void eth_txmem_free (eth_txmem_t * packet);
 
+// A payload segment is an eth_txmem buffer that is appended to one or
+// more frames without copying. Each frame holds a reference until the
+// frame was sent. Segments from eth_txmem_get() are freed by the last
+// eth_txmem_free(), static segments are never freed. The data of a
+// segment must not change while a frame refers to it.
+
+void eth_txmem_static_init (eth_txmem_t * seg, uint8_t * data, int len);
+
+// returns -1 if the frame has ETH_TXMEM_MAX_SEG segments already
+int eth_txmem_add_seg (eth_txmem_t * packet, eth_txmem_t * seg);
+
+// length of the frame including the segments
+int eth_txmem_frame_len (const eth_txmem_t * packet);
+
 
 #endif /* ETH_TXMEM_H_ */
\ No newline at end of file
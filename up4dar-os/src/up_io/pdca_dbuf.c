@@ -0,0 +1,177 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * pdca_dbuf.c
+ *
+ * Each channel works on two buffers. While the PDCA transfers the current
+ * buffer the other one is in the reload registers. When the PDCA switches
+ * over, the reload counter becomes zero and the interrupt puts the buffer
+ * just finished back into the reload registers. The task is woken up by
+ * the semaphore and processes that buffer (fills it for TX, reads it for
+ * RX) while the PDCA works on the other one.
+ */
+
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <avr32/io.h>
+#include "intc.h"
+
+#include "pdca_dbuf.h"
+
+#include "up_net/snmp_data.h"
+
+
+static pdca_dbuf_t * channels[PDCA_DBUF_MAX_CHANNEL];
+
+
+void pdca_dbuf_reload (pdca_dbuf_t * d, volatile avr32_pdca_channel_t * ch)
+{
+	uint8_t n = d->next;
+	
+	ch->marr = (unsigned long) d->buf[n];
+	ch->tcrr = d->len;  // clears RCZ
+	
+	if (d->pending != 0)
+	{
+		d->late ++;
+	}
+	
+	d->work = n;
+	d->pending = 1;
+	d->next = n ^ 1;
+}
+
+
+#if __GNUC__
+__attribute__((__noinline__))
+#endif
+static portBASE_TYPE pdca_dbuf_int_non_naked (void)
+{
+	portBASE_TYPE task_woken = pdFALSE;
+	int i;
+	
+	for (i=0; i < PDCA_DBUF_MAX_CHANNEL; i++)
+	{
+		pdca_dbuf_t * d = channels[i];
+		
+		if (d != NULL)
+		{
+			volatile avr32_pdca_channel_t * ch = & AVR32_PDCA.channel[i];
+			
+			if ((ch->isr & ch->imr & AVR32_PDCA_ISR_RCZ_MASK) != 0)
+			{
+				pdca_dbuf_reload(d, ch);
+				
+				xSemaphoreGiveFromISR( d->sem, &task_woken );
+			}
+		}
+	}
+	
+	return task_woken;
+}
+
+
+#if __GNUC__
+__attribute__((__naked__))
+#endif
+static void pdca_dbuf_int (void)
+{
+	portENTER_SWITCHING_ISR();
+	pdca_dbuf_int_non_naked();
+	portEXIT_SWITCHING_ISR();
+}
+
+
+void pdca_dbuf_init (pdca_dbuf_t * d, int channel, int pid, int size,
+		void * buf0, void * buf1, int len, xSemaphoreHandle sem)
+{
+	volatile avr32_pdca_channel_t * ch = & AVR32_PDCA.channel[channel];
+	
+	d->channel = channel;
+	d->buf[0] = buf0;
+	d->buf[1] = buf1;
+	d->len = len;
+	d->sem = sem;
+	d->next = 1;
+	d->work = 1;
+	d->pending = 0;
+	d->late = 0;
+	
+	ch->idr = 0xFFFFFFFF;
+	ch->mr = size;
+	ch->psr = pid;
+	ch->mar = (unsigned long) buf0;
+	ch->tcr = len;
+	
+	portENTER_CRITICAL();
+	
+	channels[channel] = d;
+	
+	// all PDCA channels are in the same interrupt group
+	INTC_register_interrupt( (__int_handler) &pdca_dbuf_int,
+			AVR32_PDCA_IRQ_0 + channel, AVR32_INTC_INT1 );
+	
+	portEXIT_CRITICAL();
+}
+
+
+void pdca_dbuf_start (pdca_dbuf_t * d)
+{
+	volatile avr32_pdca_channel_t * ch = & AVR32_PDCA.channel[d->channel];
+	
+	ch->cr = AVR32_PDCA_CR_TEN_MASK;  // enable transfer
+	ch->ier = AVR32_PDCA_IER_RCZ_MASK;  // reload register is empty -> interrupt
+}
+
+
+void * pdca_dbuf_get (pdca_dbuf_t * d)
+{
+	void * b = NULL;
+	
+	portENTER_CRITICAL();
+	
+	if (d->pending != 0)
+	{
+		b = d->buf[d->work];
+		d->pending = 0;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return b;
+}
+
+
+int snmp_get_pdca_dbuf_stats (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	pdca_dbuf_t * d = channels[arg & (PDCA_DBUF_MAX_CHANNEL - 1)];
+	
+	if (d != NULL)
+	{
+		value = d->late;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
@@ -0,0 +1,69 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * pdca_dbuf.h
+ *
+ * PDCA double buffering, the reload registers are refilled
+ * in the reload-counter-zero interrupt
+ *
+ */
+
+
+#ifndef PDCA_DBUF_H_
+#define PDCA_DBUF_H_
+
+#include <avr32/io.h>
+
+#include "semphr.h"
+
+
+#define PDCA_DBUF_MAX_CHANNEL  4   // channels 0 .. 3 (AMBE SPI and SSC)
+
+
+typedef struct pdca_dbuf
+{
+	uint8_t channel;
+	volatile uint8_t next;		// buffer for the next reload
+	volatile uint8_t work;		// buffer the task has to process
+	volatile uint8_t pending;	// work buffer not yet taken by the task
+	uint16_t len;				// transfers per buffer
+	void * buf[2];
+	xSemaphoreHandle sem;		// given by the interrupt, may be shared by channels
+	uint32_t late;				// reload while the task was still busy
+} pdca_dbuf_t;
+
+
+// the channel is set up with buf0 as the current buffer, it is
+// started with pdca_dbuf_start()
+
+void pdca_dbuf_init (pdca_dbuf_t * d, int channel, int pid, int size,
+		void * buf0, void * buf1, int len, xSemaphoreHandle sem);
+
+void pdca_dbuf_start (pdca_dbuf_t * d);
+
+// reload-counter-zero: put the next buffer into the reload registers,
+// the buffer becomes the work buffer (called by the interrupt handler)
+void pdca_dbuf_reload (pdca_dbuf_t * d, volatile avr32_pdca_channel_t * ch);
+
+// returns the work buffer or NULL if there is no new one
+void * pdca_dbuf_get (pdca_dbuf_t * d);
+
+#endif /* PDCA_DBUF_H_ */
@@ -0,0 +1,198 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ringbuf.c
+ *
+ * Byte ring buffer for one producer and one consumer, the block
+ * functions (ringbuf_put() and ringbuf_get() are inline in ringbuf.h).
+ *
+ * Block functions copy at most two contiguous spans, there is no
+ * per-byte modulo or branch.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "gcc_builtin.h"
+
+#include "ringbuf.h"
+
+
+
+void ringbuf_init (ringbuf_t * r, uint8_t * buf, int size)
+{
+	r->buf = buf;
+	r->mask = size - 1;
+
+	ringbuf_reset(r);
+}
+
+
+void ringbuf_reset (ringbuf_t * r)
+{
+	r->in = 0;
+	r->out = 0;
+	r->high_water = 0;
+	r->overflow = 0;
+}
+
+
+int ringbuf_count (const ringbuf_t * r)
+{
+	return RINGBUF_COUNT(r);
+}
+
+
+int ringbuf_free (const ringbuf_t * r)
+{
+	return RINGBUF_SIZE(r) - RINGBUF_COUNT(r);
+}
+
+
+// a statistic, producer and consumer both update it without locking
+
+static void update_high_water (ringbuf_t * r, uint16_t n)
+{
+	if (n > r->high_water)
+	{
+		r->high_water = n;
+	}
+}
+
+
+int ringbuf_write (ringbuf_t * r, const uint8_t * data, int len)
+{
+	uint16_t in = r->in;
+	int n = ringbuf_free(r);
+
+	if (len > n)
+	{
+		r->overflow += len - n;
+		len = n;
+	}
+
+	int pos = in & r->mask;
+	int first = RINGBUF_SIZE(r) - pos;  // contiguous space up to the end
+
+	if (first > len)
+	{
+		first = len;
+	}
+
+	memcpy(r->buf + pos, data, first);
+	memcpy(r->buf, data + first, len - first);
+
+	in += len;
+
+	RINGBUF_BARRIER();
+	r->in = in;
+
+	update_high_water(r, in - r->out);
+
+	return len;
+}
+
+
+int ringbuf_read (ringbuf_t * r, uint8_t * data, int maxlen)
+{
+	uint16_t out = r->out;
+	int len = RINGBUF_COUNT(r);
+
+	update_high_water(r, len);  // includes the bytes of ringbuf_put()
+
+	if (len > maxlen)
+	{
+		len = maxlen;
+	}
+
+	int pos = out & r->mask;
+	int first = RINGBUF_SIZE(r) - pos;
+
+	if (first > len)
+	{
+		first = len;
+	}
+
+	memcpy(data, r->buf + pos, first);
+	memcpy(data + first, r->buf, len - first);
+
+	RINGBUF_BARRIER();
+	r->out = out + len;
+
+	return len;
+}
+
+
+int ringbuf_read_span (ringbuf_t * r, uint8_t ** p)
+{
+	int pos = r->out & r->mask;
+	int len = RINGBUF_COUNT(r);
+	int first = RINGBUF_SIZE(r) - pos;
+
+	update_high_water(r, len);  // includes the bytes of ringbuf_put()
+
+	*p = r->buf + pos;
+
+	return (len < first) ? len : first;
+}
+
+
+void ringbuf_consume (ringbuf_t * r, int len)
+{
+	RINGBUF_BARRIER();
+	r->out += len;
+}
+
+
+int ringbuf_write_span (const ringbuf_t * r, uint8_t ** p)
+{
+	int pos = r->in & r->mask;
+	int len = ringbuf_free(r);
+	int first = RINGBUF_SIZE(r) - pos;
+
+	*p = r->buf + pos;
+
+	return (len < first) ? len : first;
+}
+
+
+void ringbuf_commit (ringbuf_t * r, int len)
+{
+	uint16_t in = r->in + len;
+
+	RINGBUF_BARRIER();
+	r->in = in;
+
+	update_high_water(r, in - r->out);
+}
+
+
+void ringbuf_set_in_pos (ringbuf_t * r, int pos)
+{
+	uint16_t out = r->out;
+
+	// pos == position of out means empty, a full buffer can't be detected
+	uint16_t in = out + ((pos - out) & r->mask);
+
+	r->in = in;
+
+	update_high_water(r, in - out);
+}
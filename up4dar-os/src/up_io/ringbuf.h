@@ -0,0 +1,116 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * ringbuf.h
+ *
+ * Byte ring buffer for one producer and one consumer
+ *
+ */
+
+
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+
+// in and out count up and wrap at 65536, the position in the buffer is
+// (index & mask). All bytes of the buffer can be used.
+// Only the producer changes in, only the consumer changes out, so no
+// locking is needed if producer and consumer are different tasks.
+
+typedef struct ringbuf
+{
+	volatile uint16_t in;
+	volatile uint16_t out;
+	uint16_t mask;			// size - 1, size must be a power of two (max. 32768)
+	uint16_t high_water;	// max. number of bytes in the buffer, see below
+	uint32_t overflow;		// bytes not written, buffer was full
+	uint8_t * buf;
+} ringbuf_t;
+
+
+#define RINGBUF_COUNT(r)  ((uint16_t) ((r)->in - (r)->out))
+#define RINGBUF_SIZE(r)   ((r)->mask + 1)
+
+// the data is copied before the index is moved, the barrier keeps gcc
+// from reordering the two
+#define RINGBUF_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
+
+
+void ringbuf_init (ringbuf_t * r, uint8_t * buf, int size);
+void ringbuf_reset (ringbuf_t * r);
+
+int ringbuf_count (const ringbuf_t * r);
+int ringbuf_free (const ringbuf_t * r);
+
+// single bytes, return 1 on success. ringbuf_put() does not update
+// high_water, the block functions on both sides do: the bytes put one
+// by one are counted when the consumer reads them with ringbuf_read()
+// or ringbuf_read_span()
+
+static inline int ringbuf_put (ringbuf_t * r, uint8_t d)
+{
+	uint16_t in = r->in;
+
+	if (((uint16_t) (in - r->out)) > r->mask) // full
+	{
+		r->overflow ++;
+		return 0;
+	}
+
+	r->buf[in & r->mask] = d;
+
+	RINGBUF_BARRIER();
+	r->in = in + 1;
+
+	return 1;
+}
+
+static inline int ringbuf_get (ringbuf_t * r, uint8_t * d)
+{
+	uint16_t out = r->out;
+
+	if (r->in == out) // empty
+		return 0;
+
+	*d = r->buf[out & r->mask];
+
+	RINGBUF_BARRIER();
+	r->out = out + 1;
+
+	return 1;
+}
+
+// blocks, return the number of bytes copied
+int ringbuf_write (ringbuf_t * r, const uint8_t * data, int len);
+int ringbuf_read (ringbuf_t * r, uint8_t * data, int maxlen);
+
+// direct access to the buffer (e.g. for DMA),
+// span returns the number of contiguous bytes starting at *p
+int ringbuf_read_span (ringbuf_t * r, uint8_t ** p);
+void ringbuf_consume (ringbuf_t * r, int len);
+
+int ringbuf_write_span (const ringbuf_t * r, uint8_t ** p);
+void ringbuf_commit (ringbuf_t * r, int len);
+
+// the producer (DMA) has written up to buffer position pos
+void ringbuf_set_in_pos (ringbuf_t * r, int pos);
+
+#endif /* RINGBUF_H_ */
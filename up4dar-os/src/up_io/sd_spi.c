@@ -0,0 +1,206 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * sd_spi.c
+ *
+ * The PDCA moves the bytes in both directions. A transfer can be made
+ * of two spans, the second one waits in the reload registers, so a data
+ * block and its CRC need only one start. The end of the RX transfer
+ * raises an interrupt that gives the semaphore, the task sleeps while
+ * the block is transferred instead of polling every tick.
+ */
+
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <avr32/io.h>
+#include "intc.h"
+#include "gpio.h"
+
+#include "sd_spi.h"
+
+
+#define SD_SPI_TX_CHANNEL	4
+#define SD_SPI_RX_CHANNEL	5
+
+#define SD_SPI_MIN_CD		4	// the USART needs CD >= 4 in SPI master mode
+
+static xSemaphoreHandle xfer_sem;
+
+
+#if __GNUC__
+__attribute__((__noinline__))
+#endif
+static portBASE_TYPE sd_spi_int_non_naked (void)
+{
+	portBASE_TYPE task_woken = pdFALSE;
+	
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].idr = AVR32_PDCA_IDR_TRC_MASK;
+	
+	xSemaphoreGiveFromISR( xfer_sem, &task_woken );
+	
+	return task_woken;
+}
+
+
+#if __GNUC__
+__attribute__((__naked__))
+#endif
+static void sd_spi_int (void)
+{
+	portENTER_SWITCHING_ISR();
+	sd_spi_int_non_naked();
+	portEXIT_SWITCHING_ISR();
+}
+
+
+void sd_spi_init (void)
+{
+	vSemaphoreCreateBinary( xfer_sem );
+	xSemaphoreTake( xfer_sem, 0 );
+	
+	sd_spi_set_clock( SD_SPI_INIT_CLOCK );
+	
+	AVR32_USART3.mr = 0x000409CE;
+	   // CLKO, CPOL=0, no parity, CPHA=1,
+	   //   CHRL=8, USCLKS=CLK_USART, Mode=SPI Master
+	
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].mr = AVR32_PDCA_BYTE; // 8 bit transfer
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].psr = AVR32_PDCA_PID_USART3_TX; // select peripherial
+	
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].mr = AVR32_PDCA_BYTE; // 8 bit transfer
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].psr = AVR32_PDCA_PID_USART3_RX; // select peripherial
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].idr = 0xFFFFFFFF;
+	
+	portENTER_CRITICAL();
+	
+	INTC_register_interrupt( (__int_handler) &sd_spi_int,
+			AVR32_PDCA_IRQ_0 + SD_SPI_RX_CHANNEL, AVR32_INTC_INT1 );
+	
+	portEXIT_CRITICAL();
+	
+	AVR32_USART3.cr = 0x50; // RXEN + TXEN
+	
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].cr = 1; // rx DMA enable
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].cr = 1; // tx DMA enable  
+}
+
+
+uint32_t sd_spi_set_clock (uint32_t hz)
+{
+	uint32_t cd = (configPBA_CLOCK_HZ + hz - 1) / hz;
+	
+	if (cd < SD_SPI_MIN_CD)
+	{
+		cd = SD_SPI_MIN_CD;
+	}
+	else if (cd > 0xFFFF)
+	{
+		cd = 0xFFFF;
+	}
+	
+	AVR32_USART3.brgr = cd;
+	
+	return configPBA_CLOCK_HZ / cd;
+}
+
+
+void sd_spi_select (int on)
+{
+	if (on)
+	{
+		gpio_set_pin_low(AVR32_PIN_PA04);
+	}
+	else
+	{
+		gpio_set_pin_high(AVR32_PIN_PA04);
+	}
+}
+
+
+static void sd_spi_wait (int len)
+{
+	volatile avr32_pdca_channel_t * rx = & AVR32_PDCA.channel[SD_SPI_RX_CHANNEL];
+	
+	if (len > SD_SPI_POLL_LEN)
+	{
+		rx->ier = AVR32_PDCA_IER_TRC_MASK;
+		
+		while (rx->ISR.trc == 0)
+		{
+			xSemaphoreTake( xfer_sem, 2 ); // the interrupt may have come before
+		}
+		
+		rx->idr = AVR32_PDCA_IDR_TRC_MASK;
+		xSemaphoreTake( xfer_sem, 0 );
+	}
+	else
+	{
+		while (rx->ISR.trc == 0) // a few microseconds
+		{
+		}
+	}
+}
+
+
+void sd_spi_xfer (const uint8_t * tx, uint8_t * rx, int len)
+{
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].mar = (unsigned long) rx;
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].tcr = len;
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].mar = (unsigned long) tx;
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].tcr = len;
+	
+	sd_spi_wait(len);
+}
+
+
+void sd_spi_xfer2 (const uint8_t * tx1, uint8_t * rx1, int len1,
+		const uint8_t * tx2, uint8_t * rx2, int len2)
+{
+	// MAR/TCR first: the channels are enabled with TCR == 0, a reload
+	// value written now would be moved to MAR/TCR at once
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].mar = (unsigned long) rx1;
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].tcr = len1;
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].marr = (unsigned long) rx2;
+	AVR32_PDCA.channel[SD_SPI_RX_CHANNEL].tcrr = len2;
+	
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].mar = (unsigned long) tx1;
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].tcr = len1;
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].marr = (unsigned long) tx2;
+	AVR32_PDCA.channel[SD_SPI_TX_CHANNEL].tcrr = len2;
+	
+	sd_spi_wait(len1 + len2);
+}
+
+
+uint8_t sd_spi_byte (uint8_t d)
+{
+	static uint8_t tx;
+	static uint8_t rx;
+	
+	tx = d;
+	sd_spi_xfer(&tx, &rx, 1);
+	
+	return rx;
+}
@@ -0,0 +1,56 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+ * sd_spi.h
+ *
+ * SPI access to the SD card (USART3 in SPI master mode, PDCA channels 4 and 5)
+ *
+ */
+
+
+#ifndef SD_SPI_H_
+#define SD_SPI_H_
+
+
+#define SD_SPI_INIT_CLOCK	400000	// Hz, until the card is initialized
+#define SD_SPI_POLL_LEN		16		// shorter transfers are not waited for with the semaphore
+
+
+void sd_spi_init (void);
+
+// returns the clock that was set (Hz), the value is rounded down
+uint32_t sd_spi_set_clock (uint32_t hz);
+
+// chip select: 1 = active
+void sd_spi_select (int on);
+
+// full duplex transfer, returns when the last byte has been received
+void sd_spi_xfer (const uint8_t * tx, uint8_t * rx, int len);
+
+// two spans in one run, the second one is in the reload registers
+// (e.g. data and CRC of a block)
+void sd_spi_xfer2 (const uint8_t * tx1, uint8_t * rx1, int len1,
+		const uint8_t * tx2, uint8_t * rx2, int len2);
+
+uint8_t sd_spi_byte (uint8_t d);
+
+#endif /* SD_SPI_H_ */
@@ -23,55 +23,123 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  * Created: 12.07.2012 08:22:57
  *  Author: mdirska
+ *
+ * Requests of other tasks are queued, reads before writes unless the
+ * read needs a queued write. All transfers use the multiple block
+ * commands, the stream of the last command stays open: sequential
+ * writes go on with the next data token (write-behind, the stop token
+ * is sent when the card has been idle for a while), after a read the
+ * following blocks are read into the read-ahead buffer while there is
+ * nothing else to do.
  */ 
 
 
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "task.h"
+#include "semphr.h"
 
 
-#include <avr32/io.h>
+#include <asf.h>
 #include "board.h"
-#include "gpio.h"
 #include "gcc_builtin.h"
-#include "up_dstar/vdisp.h"
-#include "up_dstar/audio_q.h"
+#include "up_dstar/recorder.h"
+#include "up_net/snmp_data.h"
 
+#include "sd_spi.h"
 #include "sdcard.h"
 
-#define SD_BUF_LEN	900
+#define SD_BLOCK_LEN	SDCARD_BLOCK_LEN
+#define CMD_BYTES	20
 
-static uint8_t sdTxBuf[SD_BUF_LEN];
-static uint8_t sdRxBuf[SD_BUF_LEN];
+#define SD_NCR			8		// max. bytes before the R1 response
+#define SD_POLL_COUNT		256		// polls before giving up the CPU (~1 ms at 4 MHz)
+#define SD_READ_TIMEOUT		100		// ms until the data token
+#define SD_BUSY_TIMEOUT		500		// ms until a write has finished
+#define SD_SERVICE_INTERVAL	20		// ms
+#define SD_STREAM_IDLE		200		// ms until an open stream is stopped
+#define SD_REQ_BATCH		8		// requests before the recorder is serviced
+#define SD_READAHEAD		4		// blocks
 
+#define SD_DEFAULT_CLOCK_KHZ	4096	// after the initialization, max. PBA clock / 4
 
-static int sd_send_cmd( int cmd, uint32_t arg, uint32_t * data )
+#define SD_STREAM_NONE		0
+#define SD_STREAM_READ		1
+#define SD_STREAM_WRITE		2
+
+static uint8_t sdTxBuf[CMD_BYTES];
+static uint8_t sdRxBuf[SD_BLOCK_LEN];	// responses and data that is not needed
+static uint8_t sdIdleBuf[SD_BLOCK_LEN];	// 0xFF, sent while reading
+static uint8_t sdCRC[2];
+static uint8_t sdCSD[16];
+
+static int ccs = 0;
+
+static uint8_t stream_op = SD_STREAM_NONE;
+static uint32_t stream_blk;			// next block of the open stream
+static portTickType stream_time;	// last transfer
+static uint8_t sd_failed;			// card has to be initialized again
+
+static uint8_t ra_buf[SD_READAHEAD * SD_BLOCK_LEN];
+static uint32_t ra_blk;		// block in ra_buf[ra_pos]
+static int ra_pos;
+static int ra_count;		// valid blocks from ra_pos
+
+struct sd_queue
 {
+	struct sdcard_request * head;
+	struct sdcard_request * tail;
+};
 
-#define CMD_BYTES	20
+static struct sd_queue read_q;
+static struct sd_queue write_q;
+static xSemaphoreHandle req_sem;
+static volatile uint8_t card_ready = 0;
 
-	int tx_bytes = CMD_BYTES;
-	
-	if (cmd == 17) // read single block
-	{
-		tx_bytes = SD_BUF_LEN;
-	}
+static uint16_t clock_khz = SD_DEFAULT_CLOCK_KHZ;	// requested clock
+static volatile uint8_t clock_changed;
+static uint32_t clock_hz;	// actual clock
 
-	memset(sdTxBuf, 0xFF, tx_bytes);
-	
-	sdTxBuf[0] = 0x40 | (cmd & 0x3F);
-	sdTxBuf[1] = (arg >> 24) & 0xFF;
-	sdTxBuf[2] = (arg >> 16) & 0xFF;
-	sdTxBuf[3] = (arg >>  8) & 0xFF;
-	sdTxBuf[4] = (arg >>  0) & 0xFF;
+static struct
+{
+	uint32_t read_bytes;	// bytes and CPU cycles of the transfers,
+	uint32_t read_cycles;	//   halved when the cycles get too big
+	uint32_t write_bytes;
+	uint32_t write_cycles;
+	uint32_t blocks_read;
+	uint32_t blocks_written;
+	uint32_t readahead_hits;
+	uint32_t stream_cmds;
+	uint32_t errors;
+} sd_stats;
+
+
+static void sd_xfer( const uint8_t * tx, uint8_t * rx, int len )
+{
+	sd_spi_xfer(tx, rx, len);
+}
+
+
+static uint8_t sd_byte( uint8_t d )
+{
+	return sd_spi_byte(d);
+}
+
+
+static void sd_cmd_frame( uint8_t * p, int cmd, uint32_t arg )
+{
+	p[0] = 0x40 | (cmd & 0x3F);
+	p[1] = (arg >> 24) & 0xFF;
+	p[2] = (arg >> 16) & 0xFF;
+	p[3] = (arg >>  8) & 0xFF;
+	p[4] = (arg >>  0) & 0xFF;
 	
 	int i;
 	uint8_t crc = 0;
 	
 	for (i=0; i<5; i++) 
 	{
-		uint8_t d = sdTxBuf[i];
+		uint8_t d = p[i];
 		int j;
 		
 		for (j=0; j<8; j++)
@@ -87,37 +155,32 @@ static int sd_send_cmd( int cmd, uint32_t arg, uint32_t * data )
 
 	crc = (crc<<1) | 1;
 	
-	sdTxBuf[5] = crc;
-	
+	p[5] = crc;
+}
 
 
-	AVR32_PDCA.channel[5].mar = (unsigned long) sdRxBuf;
-	AVR32_PDCA.channel[5].tcr = tx_bytes ;
-	AVR32_PDCA.channel[4].mar = (unsigned long) sdTxBuf;
-	AVR32_PDCA.channel[4].tcr = tx_bytes ; // send buffer
+// command with R1, R3 or R7 response, used during initialization
 
-	while (AVR32_PDCA.channel[4].ISR.trc == 0)
-	{
-		vTaskDelay(1);
-	}
+static int sd_send_cmd( int cmd, uint32_t arg, uint32_t * data )
+{
+	memset(sdTxBuf, 0xFF, CMD_BYTES);
+	
+	sd_cmd_frame(sdTxBuf, cmd, arg);
+	
+	sd_xfer(sdTxBuf, sdRxBuf, CMD_BYTES);
 	
-	for (i=0; i < tx_bytes; i++)
+	int i;
+	
+	for (i=0; i < (CMD_BYTES - 4); i++)
 	{
 		if (sdRxBuf[i] != 0xFF)
 		{
 			if (data != NULL)
 			{
-				if (cmd != 17) // read single block
-				{				
-				  *data = (sdRxBuf[i+1] << 24)
-					| (sdRxBuf[i+2] << 16)
-					| (sdRxBuf[i+3] << 8)
-					| (sdRxBuf[i+4] );
-				}
-				else
-				{
-					*data = i+1;
-				}					
+			  *data = (sdRxBuf[i+1] << 24)
+				| (sdRxBuf[i+2] << 16)
+				| (sdRxBuf[i+3] << 8)
+				| (sdRxBuf[i+4] );
 			}
 			return sdRxBuf[i];
 		}
@@ -127,58 +190,546 @@ static int sd_send_cmd( int cmd, uint32_t arg, uint32_t * data )
 }
 
 
-static uint16_t tmp_buf[AUDIO_Q_TRANSFERLEN];
+// command with R1 response, the transfer stops after the response
+// so that the data of the command can follow
 
-static audio_q_t * audio_tx_q;
+static int sd_cmd( int cmd, uint32_t arg )
+{
+	int i;
+	
+	sd_cmd_frame(sdTxBuf, cmd, arg);
+	sd_xfer(sdTxBuf, sdRxBuf, 6);
+	
+	if (cmd == 12) // stop transmission: skip the stuff byte
+	{
+		sd_byte(0xFF);
+	}
+	
+	for (i=0; i < SD_NCR; i++)
+	{
+		uint8_t r = sd_byte(0xFF);
+		
+		if ((r & 0x80) == 0)
+		{
+			return r;
+		}
+	}
+	
+	return -1;
+}
 
-static void vSDCardTask( void *pvParameters )
+
+// wait for a byte != 0xFF (busy == 0), returns the byte or -1 (timeout)
+
+static int sd_wait( uint8_t busy, int timeout )
+{
+	portTickType start = xTaskGetTickCount();
+	int n = 0;
+	
+	for (;;)
+	{
+		uint8_t r = sd_byte(0xFF);
+		
+		if ((busy == 0) ? (r != 0xFF) : (r == 0xFF))
+		{
+			return r;
+		}
+		
+		if ((xTaskGetTickCount() - start) > timeout)
+		{
+			return -1;
+		}
+		
+		n ++;
+		
+		if (n > SD_POLL_COUNT) // this task has the lowest priority but one
+		{
+			vTaskDelay(1);
+		}
+	}
+}
+
+
+// data and CRC in one DMA run
+
+static int sd_read_data( uint8_t * buf, int len )
+{
+	if (sd_wait(0, SD_READ_TIMEOUT) != 0xFE) // no data token
+	{
+		return 1;
+	}
+	
+	sd_spi_xfer2(sdIdleBuf, buf, len, sdIdleBuf, sdCRC, 2); // CRC not checked
+	
+	return 0;
+}
+
+
+static int sd_write_data( uint8_t token, const uint8_t * buf )
+{
+	sd_byte(token);
+	
+	sd_spi_xfer2(buf, sdRxBuf, SD_BLOCK_LEN, sdIdleBuf, sdCRC, 2); // CRC not checked by the card
+	
+	if ((sd_byte(0xFF) & 0x1F) != 0x05) // data not accepted
+	{
+		return 1;
+	}
+	
+	return (sd_wait(1, SD_BUSY_TIMEOUT) < 0) ? 1 : 0;
+}
+
+
+static void sd_count_time( uint32_t * bytes, uint32_t * cycles, int count, uint32_t start )
+{
+	*bytes += count * SD_BLOCK_LEN;
+	*cycles += Get_sys_count() - start;
+	
+	if (*cycles > 0x40000000) // 16 seconds of transfers, older ones count less
+	{
+		*bytes >>= 1;
+		*cycles >>= 1;
+	}
+}
+
+
+static int sd_stream_stop( void )
+{
+	int res = 0;
+	
+	switch (stream_op)
+	{
+		case SD_STREAM_NONE:
+			return 0;
+		
+		case SD_STREAM_READ:
+			res = (sd_cmd(12, 0) != 0) ? 1 : 0;
+			break;
+		
+		case SD_STREAM_WRITE:
+			sd_byte(0xFD); // stop transmission token
+			sd_byte(0xFF);
+			break;
+	}
+	
+	stream_op = SD_STREAM_NONE;
+	
+	if (sd_wait(1, SD_BUSY_TIMEOUT) < 0)
+	{
+		res = 1;
+	}
+	
+	return res;
+}
+
+
+// continue the open stream or start a new one at blk
+
+static int sd_stream_start( int op, uint32_t blk )
+{
+	if ((stream_op == op) && (stream_blk == blk))
+	{
+		return 0;
+	}
+	
+	if (sd_stream_stop() != 0)
+	{
+		return 1;
+	}
+	
+	uint32_t addr = (ccs == 0) ? (blk << 9) : blk;
+	
+	if (sd_cmd((op == SD_STREAM_READ) ? 18 : 25, addr) != 0)
+	{
+		return 1;
+	}
+	
+	if (op == SD_STREAM_WRITE)
+	{
+		sd_byte(0xFF);
+	}
+	
+	stream_op = op;
+	stream_blk = blk;
+	sd_stats.stream_cmds ++;
+	
+	return 0;
+}
+
+
+static int sd_error( void )
+{
+	sd_stats.errors ++;
+	
+	sd_stream_stop();
+	
+	sd_failed = 1;
+	ra_count = 0;
+	
+	return 1;
+}
+
+
+static int sd_read_stream( uint32_t blk, uint8_t * buf, int count )
+{
+	uint32_t start = Get_sys_count();
+	int i;
+	
+	if (sd_stream_start(SD_STREAM_READ, blk) != 0)
+	{
+		return sd_error();
+	}
+	
+	for (i=0; i < count; i++)
+	{
+		if (sd_read_data(buf + (i * SD_BLOCK_LEN), SD_BLOCK_LEN) != 0)
+		{
+			return sd_error();
+		}
+		
+		stream_blk ++;
+	}
+	
+	stream_time = xTaskGetTickCount();
+	sd_stats.blocks_read += count;
+	sd_count_time(& sd_stats.read_bytes, & sd_stats.read_cycles, count, start);
+	
+	return 0;
+}
+
+
+static int sdcard_read( uint32_t blk, uint8_t * buf, int count )
+{
+	if ((ra_count > 0) && (blk != ra_blk))
+	{
+		ra_count = 0;
+	}
+	
+	while ((count > 0) && (ra_count > 0))
+	{
+		memcpy(buf, ra_buf + (ra_pos * SD_BLOCK_LEN), SD_BLOCK_LEN);
+		
+		ra_pos ++;
+		ra_count --;
+		ra_blk ++;
+		sd_stats.readahead_hits ++;
+		
+		blk ++;
+		buf += SD_BLOCK_LEN;
+		count --;
+	}
+	
+	if (count == 0)
+	{
+		return 0;
+	}
+	
+	return sd_read_stream(blk, buf, count);
+}
+
+
+static int sdcard_write( uint32_t blk, const uint8_t * buf, int count )
+{
+	uint32_t start = Get_sys_count();
+	int i;
+	
+	if ((ra_count > 0) && (blk < (ra_blk + ra_count)) && ((blk + count) > ra_blk))
+	{
+		ra_count = 0;
+	}
+	
+	if (sd_stream_start(SD_STREAM_WRITE, blk) != 0)
+	{
+		return sd_error();
+	}
+	
+	for (i=0; i < count; i++)
+	{
+		if (sd_write_data(0xFC, buf + (i * SD_BLOCK_LEN)) != 0)
+		{
+			return sd_error();
+		}
+		
+		stream_blk ++;
+	}
+	
+	stream_time = xTaskGetTickCount();
+	sd_stats.blocks_written += count;
+	sd_count_time(& sd_stats.write_bytes, & sd_stats.write_cycles, count, start);
+	
+	return 0;
+}
+
+
+// number of blocks from the CSD register, 0 on error
+
+static uint32_t sd_num_blocks( void )
+{
+	if ((sd_cmd(9, 0) != 0) || (sd_read_data(sdCSD, sizeof sdCSD) != 0))
+	{
+		return 0;
+	}
+	
+	if ((sdCSD[0] >> 6) == 1) // CSD version 2.0 (SDHC, SDXC)
+	{
+		uint32_t c_size = ((sdCSD[7] & 0x3F) << 16) | (sdCSD[8] << 8) | sdCSD[9];
+		
+		return (c_size + 1) << 10;
+	}
+	
+	int read_bl_len = sdCSD[5] & 0x0F;
+	int c_size_mult = ((sdCSD[9] & 0x03) << 1) | (sdCSD[10] >> 7);
+	uint32_t c_size = ((sdCSD[6] & 0x03) << 10) | (sdCSD[7] << 2) | (sdCSD[8] >> 6);
+	
+	return (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+}
+
+
+static struct rec_blkdev sd_dev = {
+	sdcard_read,
+	sdcard_write,
+	0
+};
+
+
+uint32_t sdcard_num_blocks (void)
+{
+	return card_ready ? sd_dev.num_blocks : 0;
+}
+
+
+static void sd_queue_put( struct sd_queue * q, struct sdcard_request * req )
+{
+	if (q->head == NULL)
+	{
+		q->head = req;
+	}
+	else
+	{
+		q->tail->next = req;
+	}
+	
+	q->tail = req;
+}
+
+
+int sdcard_submit (struct sdcard_request * req)
+{
+	if ((req->count == 0) ||
+		((req->op != SDCARD_OP_READ) && (req->op != SDCARD_OP_WRITE)))
+	{
+		return 1;
+	}
+	
+	req->next = NULL;
+	req->result = SDCARD_PENDING;
+	
+	portENTER_CRITICAL();
+	
+	if ((card_ready == 0) || (req->blk >= sd_dev.num_blocks) ||
+		(req->count > (sd_dev.num_blocks - req->blk)))
+	{
+		portEXIT_CRITICAL();
+		req->result = 1;
+		return 1;
+	}
+	
+	sd_queue_put((req->op == SDCARD_OP_READ) ? & read_q : & write_q, req);
+	
+	portEXIT_CRITICAL();
+	
+	xSemaphoreGive( req_sem );
+	
+	return 0;
+}
+
+
+// reads first, unless the first read needs data of a queued write
+
+static struct sdcard_request * sd_next_request( void )
 {
-	AVR32_USART3.brgr = 8; // 2 MHz   (65.536 MHz / 4 / 4)  SCK
+	struct sdcard_request * req;
+	struct sd_queue * q = & read_q;
 	
-	AVR32_USART3.mr = 0x000409CE;
-	   // CLKO, CPOL=0, no parity, CPHA=1,
-	   //   CHRL=8, USCLKS=CLK_USART, Mode=SPI Master
-	   
+	portENTER_CRITICAL();
 	
-	AVR32_PDCA.channel[4].mr = AVR32_PDCA_BYTE; // 8 bit transfer
-	AVR32_PDCA.channel[4].psr = AVR32_PDCA_PID_USART3_TX; // select peripherial
-	// AVR32_PDCA.channel[4].mar = (unsigned long) sdTxBuf;
-	// AVR32_PDCA.channel[4].tcr = SD_BUF_LEN ;
+	req = read_q.head;
+	
+	if (req != NULL)
+	{
+		struct sdcard_request * w;
+		
+		for (w = write_q.head; w != NULL; w = w->next)
+		{
+			if ((req->blk < (w->blk + w->count)) && ((req->blk + req->count) > w->blk))
+			{
+				req = NULL;
+				break;
+			}
+		}
+	}
+	
+	if (req == NULL)
+	{
+		q = & write_q;
+		req = write_q.head;
+	}
+	
+	if (req != NULL)
+	{
+		q->head = req->next;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return req;
+}
+
+
+static void sd_complete( struct sdcard_request * req, int result )
+{
+	req->result = result;
+	
+	if (req->callback != NULL)
+	{
+		req->callback(req);
+	}
+}
+
+
+static void sd_fail_requests( void )
+{
+	struct sdcard_request * r;
+	struct sdcard_request * w;
+	
+	portENTER_CRITICAL();
+	
+	card_ready = 0;
+	r = read_q.head;
+	w = write_q.head;
+	read_q.head = NULL;
+	write_q.head = NULL;
+	
+	portEXIT_CRITICAL();
+	
+	while (r != NULL)
+	{
+		struct sdcard_request * next = r->next;
+		sd_complete(r, 1);
+		r = next;
+	}
+	
+	while (w != NULL)
+	{
+		struct sdcard_request * next = w->next;
+		sd_complete(w, 1);
+		w = next;
+	}
+}
+
+
+// nothing to do: read ahead or stop the stream
+
+static void sd_idle( void )
+{
+	if ((stream_op == SD_STREAM_READ) && (ra_count == 0))
+	{
+		int n = SD_READAHEAD;
+		
+		if ((stream_blk + n) > sd_dev.num_blocks)
+		{
+			n = sd_dev.num_blocks - stream_blk;
+		}
+		
+		if (n > 0)
+		{
+			ra_blk = stream_blk;
+			ra_pos = 0;
+			
+			if (sd_read_stream(stream_blk, ra_buf, n) == 0)
+			{
+				ra_count = n;
+			}
+			
+			return;
+		}
+	}
 	
+	if ((stream_op != SD_STREAM_NONE) &&
+		((xTaskGetTickCount() - stream_time) >= SD_STREAM_IDLE))
+	{
+		if (sd_stream_stop() != 0)
+		{
+			sd_error();
+		}
+	}
+}
+
+
+static void sd_process( void )
+{
+	int i;
 	
-	AVR32_PDCA.channel[5].mr = AVR32_PDCA_BYTE; // 8 bit transfer
-	AVR32_PDCA.channel[5].psr = AVR32_PDCA_PID_USART3_RX; // select peripherial
-	/*
-	AVR32_PDCA.channel[5].mar = (unsigned long) sdRxBuf;
-	AVR32_PDCA.channel[5].tcr = SD_BUF_LEN ;
-	*/
-	AVR32_USART3.cr = 0x50; // RXEN + TXEN
+	if (clock_changed != 0)
+	{
+		clock_changed = 0;
+		
+		if (sd_stream_stop() != 0)
+		{
+			sd_error();
+			return;
+		}
+		
+		clock_hz = sd_spi_set_clock(clock_khz * 1000);
+	}
 	
-	AVR32_PDCA.channel[5].cr = 1; // rx DMA enable
-	AVR32_PDCA.channel[4].cr = 1; // tx DMA enable  
+	for (i=0; i < SD_REQ_BATCH; i++)
+	{
+		struct sdcard_request * req = sd_next_request();
+		
+		if (req == NULL)
+		{
+			sd_idle();
+			xSemaphoreTake( req_sem, SD_SERVICE_INTERVAL );
+			return;
+		}
+		
+		if (req->op == SDCARD_OP_READ)
+		{
+			sd_complete(req, sdcard_read(req->blk, req->buf, req->count));
+		}
+		else
+		{
+			sd_complete(req, sdcard_write(req->blk, req->buf, req->count));
+		}
+		
+		if (sd_failed != 0)
+		{
+			return;
+		}
+	}
+}
+
+
+static void vSDCardTask( void *pvParameters )
+{
+	sd_spi_init();
+	clock_hz = SD_SPI_INIT_CLOCK;
 	
-	memset(sdRxBuf, 0xFF, SD_BUF_LEN);
-	memset(sdTxBuf, 0xFF, SD_BUF_LEN);
+	memset(sdIdleBuf, 0xFF, SD_BLOCK_LEN);
 	
 	vTaskDelay(1000);
 	
 	// send lots of clock pulses without CS
 	
-	AVR32_PDCA.channel[5].mar = (unsigned long) sdRxBuf;
-	AVR32_PDCA.channel[5].tcr = SD_BUF_LEN ;
-	AVR32_PDCA.channel[4].mar = (unsigned long) sdTxBuf;
-	AVR32_PDCA.channel[4].tcr = SD_BUF_LEN ;
+	sd_xfer(sdIdleBuf, sdRxBuf, SD_BLOCK_LEN);
 	
-	gpio_set_pin_low(AVR32_PIN_PA04); // activate CS
+	sd_spi_select(1); // activate CS
 	
 	int state = 0;
-	int acmd41 = 0;
-	int ccs = 0;
 	uint32_t ocr = 0;
 	uint32_t cmd8data = 0;
-	uint32_t ptr = 0;
-	int blk_num = 52700;
-	int i;
+	portTickType service_time = 0;
 	
 	for (;;)
 	{
@@ -230,7 +781,6 @@ static void vSDCardTask( void *pvParameters )
 				if (res == 0) // ready
 				{
 					state = 3; // set block size
-					acmd41 = 1;
 				}
 				break;
 				
@@ -241,7 +791,6 @@ static void vSDCardTask( void *pvParameters )
 				if (res == 0) // ready
 				{
 					state = 3; // set block size
-					acmd41 = 0;
 				}
 				break;
 				
@@ -260,6 +809,7 @@ static void vSDCardTask( void *pvParameters )
 				break;
 			
 			case 4: // get OCR
+				ccs = 0;
 				res = sd_send_cmd(58, 0, &ocr);
 				
 				if (res < 0) // no response
@@ -270,7 +820,7 @@ static void vSDCardTask( void *pvParameters )
 				if (res == 0) // ready
 				{
 					ccs = (ocr & 0xC0000000) == 0xC0000000 ? 1 : 0;
-					state = 5; // get block
+					state = 5; // get size
 				}
 				else
 				{
@@ -278,76 +828,138 @@ static void vSDCardTask( void *pvParameters )
 				}
 				break;
 				
-			case 5:
-			
-				// vTaskDelay(5);
-				
-				res = sd_send_cmd( 17, (ccs == 0) ? (blk_num << 9) : blk_num, &ptr);
+			case 5: // full clock, get size, mount the recorder area
+				clock_changed = 0;
+				clock_hz = sd_spi_set_clock(clock_khz * 1000);
 				
-				blk_num ++;
+				sd_dev.num_blocks = sd_num_blocks();
 				
-				for (; ptr < SD_BUF_LEN; ptr++)
+				if (sd_dev.num_blocks == 0)
 				{
-					if (sdRxBuf[ptr] == 0xFE) // data token
-					{
-						int j;
-						
-						for (j=0; j < 8; j++)
-						{
-							for (i=0; i < AUDIO_Q_TRANSFERLEN; i++)
-							{
-								tmp_buf[i] = (sdRxBuf[ptr + 2 + ((i + (j*AUDIO_Q_TRANSFERLEN)) <<1)] << 8) |
-									sdRxBuf[ptr + 1 + ((i + (j*AUDIO_Q_TRANSFERLEN)) <<1)];
-							}
-							
-							audio_q_put( audio_tx_q, (const short *) tmp_buf);
-							
-							vTaskDelay(3);
-						}
-												
-						
-						
-						break;
-					}						
-						
-				}	
+					clock_hz = sd_spi_set_clock(SD_SPI_INIT_CLOCK);
+					state = 0;
+					break;
+				}
 				
+				stream_op = SD_STREAM_NONE;
+				ra_count = 0;
+				sd_failed = 0;
 				
+				recorder_mount( & sd_dev );
+				card_ready = 1;
+				state = 6;
+				break;
+				
+			case 6:
+				sd_process();
+				
+				if ((xTaskGetTickCount() - service_time) >= SD_SERVICE_INTERVAL)
+				{
+					service_time = xTaskGetTickCount();
+					recorder_service();
+				}
+				
+				if ((sd_failed != 0) || (recorder_state() == REC_STATE_ERROR)) // card removed?
+				{
+					sd_fail_requests();
+					recorder_unmount();
+					sd_stream_stop();
+					clock_hz = sd_spi_set_clock(SD_SPI_INIT_CLOCK);
+					state = 0;
+				}
 				break;
 		}
+	}
+}
+
+void sdcard_init (void)
+{
+	vSemaphoreCreateBinary( req_sem );
+	
+	xTaskCreate( vSDCardTask, (signed char *) "SDCARD", 200, ( void * ) 0,  (tskIDLE_PRIORITY + 1), ( xTaskHandle * ) NULL );
+	
+}
+
+
+// bytes per ms = kB/s
+
+static int32_t sd_rate( uint32_t bytes, uint32_t cycles )
+{
+	cycles >>= 16; // ms
+	
+	return (cycles == 0) ? 0 : (bytes / cycles);
+}
+
+
+int snmp_get_sdcard (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = clock_hz / 1000;
+			break;
 		
+		case 2:
+			value = sd_rate(sd_stats.read_bytes, sd_stats.read_cycles);
+			break;
 		
+		case 3:
+			value = sd_rate(sd_stats.write_bytes, sd_stats.write_cycles);
+			break;
 		
-		char buf[9];
-			
-		vdisp_i2s(buf, 4, 10, 0, state);
-		vdisp_prints_xy(0, 8, VDISP_FONT_6x8, 0, buf);
-		
-		vdisp_i2s(buf, 4, 10, 0, acmd41);
-		vdisp_prints_xy(0, 16, VDISP_FONT_6x8, 0, buf);
-		
-		vdisp_i2s(buf, 4, 10, 0, ccs);
-		vdisp_prints_xy(0, 24, VDISP_FONT_6x8, 0, buf);
-		
-		vdisp_i2s(buf, 8, 16, 1, ocr);
-		vdisp_prints_xy(0, 32, VDISP_FONT_6x8, 0, buf);
+		case 4:
+			value = sd_stats.blocks_read;
+			break;
 		
-		vdisp_i2s(buf, 4, 10, 0, res);
-		vdisp_prints_xy(0, 40, VDISP_FONT_6x8, 0, buf);
+		case 5:
+			value = sd_stats.blocks_written;
+			break;
 		
-		vdisp_i2s(buf, 4, 10, 0, ptr);
-		vdisp_prints_xy(0, 48, VDISP_FONT_6x8, 0, buf);
+		case 6:
+			value = sd_stats.readahead_hits;
+			break;
 		
-		vdisp_i2s(buf, 8, 10, 0, blk_num);
-		vdisp_prints_xy(0, 56, VDISP_FONT_6x8, 0, buf);
+		case 7:
+			value = sd_stats.stream_cmds;
+			break;
 		
+		case 8:
+			value = sd_stats.errors;
+			break;
 	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
 }
 
-void sdcard_init (audio_q_t * tx)
+
+int snmp_set_sdcard (int32_t arg, const uint8_t * req, int req_len)
 {
-	audio_tx_q = tx;
+	int value = 0;
+	int i;
 	
-	xTaskCreate( vSDCardTask, (signed char *) "SDCARD", 200, ( void * ) 0,  (tskIDLE_PRIORITY + 1), ( xTaskHandle * ) NULL );
+	if ((arg != 1) || (req_len < 1) || (req_len > 4))
+	{
+		return 1;
+	}
 	
-}
\ No newline at end of file
+	for (i=0; i < req_len; i++)
+	{
+		value = (value << 8) | req[i];
+	}
+	
+	if ((value < (SD_SPI_INIT_CLOCK / 1000)) || (value > 25000)) // kHz
+	{
+		return 1;
+	}
+	
+	clock_khz = value;
+	
+	if (card_ready != 0) // otherwise used after the initialization
+	{
+		clock_changed = 1;
+	}
+	
+	return 0;
+}
@@ -29,8 +29,45 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef SDCARD_H_
 #define SDCARD_H_
 
-// void sdcard_init (void);
-void sdcard_init (audio_q_t * tx);
+#define SDCARD_BLOCK_LEN	512
+
+#define SDCARD_OP_READ		1
+#define SDCARD_OP_WRITE		2
+
+#define SDCARD_PENDING		2	// result while the request is queued
+
+
+struct sdcard_request;
+
+typedef void (*sdcard_callback_t) (struct sdcard_request * req);
+
+// The request belongs to the SD card task from sdcard_submit() until
+// result changes from SDCARD_PENDING (0 = ok, 1 = error). The callback
+// is called by the SD card task after that, it must not block.
+
+struct sdcard_request
+{
+	struct sdcard_request * next;
+	uint8_t op;
+	volatile int8_t result;
+	uint16_t count;		// blocks
+	uint32_t blk;
+	uint8_t * buf;
+	sdcard_callback_t callback;	// may be NULL
+	void * ctx;
+};
+
+
+// SD card task: initializes the card and runs the QSO recorder
+
+void sdcard_init (void);
+
+// returns 0 if the request was queued, 1 if there is no card
+// or the blocks are not on the card
+int sdcard_submit (struct sdcard_request * req);
+
+// number of blocks, 0 = no card
+uint32_t sdcard_num_blocks (void);
 
 
 #endif /* SDCARD_H_ */
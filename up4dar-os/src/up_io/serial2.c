@@ -76,6 +76,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "board.h"
 #include "gpio.h"
 
+#include "ringbuf.h"
+#include "up_net/snmp_data.h"
+
 
 int serial_rx_error = 0;
 int serial_rx_ok = 0;
@@ -83,62 +86,7 @@ int serial_rx_ok = 0;
 
 #define NUM_USART 2
 
-#define USART_BUFLEN	200
-
-
-
-struct usartBuffer
-{
-	int input_ptr;
-	int output_ptr;
-	char buf[USART_BUFLEN];
-};
-
-
-
-static int put_q( struct usartBuffer * q, char c)
-{
-	int next_ptr = q->input_ptr;
-	
-	next_ptr ++;
-	
-	if (next_ptr >= USART_BUFLEN)
-	{
-		next_ptr = 0;
-	}
-	
-	if (next_ptr == q->output_ptr) // queue is full
-	{
-		return 0;
-	}
-	
-	q->buf[ q->input_ptr ] = c;
-	q->input_ptr = next_ptr;
-	
-	return 1;
-}
-
-static int get_q( struct usartBuffer * q, char * c)
-{
-	if (q->input_ptr == q->output_ptr)
-	{
-		return 0; // queue empty
-	}
-	
-	int next_ptr = q->output_ptr;
-	
-	next_ptr ++;
-	
-	if (next_ptr >= USART_BUFLEN)
-	{
-		next_ptr = 0;
-	}
-	
-	*c = q->buf[ q->output_ptr ];
-	q->output_ptr = next_ptr;
-	
-	return 1;
-}
+#define USART_BUFLEN	256   // power of two (ringbuf)
 
 
 
@@ -149,15 +97,16 @@ static struct usartParams
 	uint8_t dma_pid_tx;
 	uint8_t dma_channel_rx;
 	uint8_t dma_channel_tx;
-	int tx_ptr_sent;
-	struct usartBuffer rx;
-	struct usartBuffer tx;
+	uint16_t tx_in_sent;	// ring index after the bytes handed over to the DMA
+	uint32_t rx_restarts;	// RX DMA transfer completed, buffer dropped
+	ringbuf_t rx;
+	ringbuf_t tx;
+	uint8_t rx_buf[USART_BUFLEN];
+	uint8_t tx_buf[USART_BUFLEN];
 } usarts[NUM_USART] =
 {
-	  { &AVR32_USART0, AVR32_PDCA_PID_USART0_RX, AVR32_PDCA_PID_USART0_TX, 6, 7, 0,
-		   {0, 0, { 0 }},  {0, 0, { 0 }} }
-	 ,{ &AVR32_USART1, AVR32_PDCA_PID_USART1_RX, AVR32_PDCA_PID_USART1_TX, 8, 9, 0,
-		   {0, 0, { 0 }},  {0, 0, { 0 }} }
+	  { &AVR32_USART0, AVR32_PDCA_PID_USART0_RX, AVR32_PDCA_PID_USART0_TX, 6, 7, 0 }
+	 ,{ &AVR32_USART1, AVR32_PDCA_PID_USART1_RX, AVR32_PDCA_PID_USART1_TX, 8, 9, 0 }
 };
 
 
@@ -173,6 +122,10 @@ int serial_init ( int usartNum, int baudrate )
 	volatile avr32_usart_t  *usart = usarts[usartNum].usart;
 	
 	int cd; /* USART Clock Divider. */
+	
+	ringbuf_init( & usarts[usartNum].rx, usarts[usartNum].rx_buf, USART_BUFLEN );
+	ringbuf_init( & usarts[usartNum].tx, usarts[usartNum].tx_buf, USART_BUFLEN );
+	usarts[usartNum].tx_in_sent = 0;
 
 
 	/* Configure USART. */
@@ -315,9 +268,7 @@ int serial_putc_q_full = 0;
 
 int serial_putc ( int usartNum, char cOutChar )
 {
-	struct usartBuffer * q = & usarts[usartNum].tx;
-
-	if (put_q(q, cOutChar) != 1)
+	if (ringbuf_put( & usarts[usartNum].tx, cOutChar) != 1)
 	{
 		serial_putc_q_full++;
 		return 0; // queue is full
@@ -332,18 +283,18 @@ int serial_putc ( int usartNum, char cOutChar )
 
 int serial_rx_char_available (int usartNum)
 {
-	struct usartBuffer * rx_q = & usarts[usartNum].rx;
+	ringbuf_t * rx_q = & usarts[usartNum].rx;
 	uint8_t dma_channel = usarts[usartNum].dma_channel_rx;
 	
-	rx_q->input_ptr = AVR32_PDCA.channel[dma_channel].mar 
-						- (unsigned long) usarts[usartNum].rx.buf;
+	ringbuf_set_in_pos( rx_q, AVR32_PDCA.channel[dma_channel].mar 
+						- (unsigned long) rx_q->buf );
 	
 	if (AVR32_PDCA.channel[dma_channel].ISR.trc != 0) // transfer complete -> should not happen
 	{
 		// start again
 		
-		rx_q->input_ptr = 0;
-		rx_q->output_ptr = 0;
+		rx_q->in = 0;
+		rx_q->out = 0;
 		
 		AVR32_PDCA.channel[dma_channel].marr  = (unsigned long) rx_q->buf;
 		AVR32_PDCA.channel[dma_channel].mar  = (unsigned long) rx_q->buf;
@@ -351,6 +302,7 @@ int serial_rx_char_available (int usartNum)
 		AVR32_PDCA.channel[dma_channel].tcr  = (USART_BUFLEN & AVR32_PDCA_TCR_TCV_MASK) << AVR32_PDCA_TCR_TCV_OFFSET;
 		
 		serial_rx_error ++;
+		usarts[usartNum].rx_restarts ++;
 	}								
 	else if (AVR32_PDCA.channel[dma_channel].ISR.rcz != 0)
 	{
@@ -360,68 +312,135 @@ int serial_rx_char_available (int usartNum)
 		serial_rx_ok ++;
 	}
 	
-	struct usartBuffer * tx_q = & usarts[usartNum].tx;
+	ringbuf_t * tx_q = & usarts[usartNum].tx;
 	dma_channel = usarts[usartNum].dma_channel_tx;
 	
-	if (usarts[usartNum].tx_ptr_sent != tx_q->output_ptr) // transmission in progress
+	if (usarts[usartNum].tx_in_sent != tx_q->out) // transmission in progress
 	{
 		if (AVR32_PDCA.channel[dma_channel].ISR.trc != 0) // tx inactive
 		{
-			tx_q->output_ptr = usarts[usartNum].tx_ptr_sent; // everything transmitted
+			ringbuf_consume( tx_q, (uint16_t) (usarts[usartNum].tx_in_sent - tx_q->out) ); // everything transmitted
 		}			
 	}
 	
-	if (usarts[usartNum].tx_ptr_sent == tx_q->output_ptr) // transmission not in progress
+	if (usarts[usartNum].tx_in_sent == tx_q->out) // transmission not in progress
 	{
-		if (tx_q->input_ptr > tx_q->output_ptr)
-		{
-			int len = tx_q->input_ptr - tx_q->output_ptr;
+		int count = ringbuf_count(tx_q);
 		
-			AVR32_PDCA.channel[dma_channel].mar  = (unsigned long) (tx_q->buf + tx_q->output_ptr);
-			AVR32_PDCA.channel[dma_channel].tcr  = (len & AVR32_PDCA_TCR_TCV_MASK) << AVR32_PDCA_TCR_TCV_OFFSET;
-			usarts[usartNum].tx_ptr_sent = tx_q->input_ptr;
-		}
-		else if (tx_q->input_ptr < tx_q->output_ptr)
+		if (count > 0)
 		{
-			int len = USART_BUFLEN - tx_q->output_ptr;
+			uint8_t * p;
+			int len = ringbuf_read_span(tx_q, &p);
 		
-			AVR32_PDCA.channel[dma_channel].mar  = (unsigned long) (tx_q->buf + tx_q->output_ptr);
+			AVR32_PDCA.channel[dma_channel].mar  = (unsigned long) p;
 			AVR32_PDCA.channel[dma_channel].tcr  = (len & AVR32_PDCA_TCR_TCV_MASK) << AVR32_PDCA_TCR_TCV_OFFSET;
-			AVR32_PDCA.channel[dma_channel].marr  = (unsigned long) tx_q->buf;
-			AVR32_PDCA.channel[dma_channel].tcrr  = (tx_q->input_ptr & AVR32_PDCA_TCRR_TCRV_MASK) << AVR32_PDCA_TCRR_TCRV_OFFSET;
-			usarts[usartNum].tx_ptr_sent = tx_q->input_ptr;
+			
+			if (count > len) // wraps at the end of the buffer
+			{
+				AVR32_PDCA.channel[dma_channel].marr  = (unsigned long) tx_q->buf;
+				AVR32_PDCA.channel[dma_channel].tcrr  = ((count - len) & AVR32_PDCA_TCRR_TCRV_MASK) << AVR32_PDCA_TCRR_TCRV_OFFSET;
+			}
+			
+			usarts[usartNum].tx_in_sent = tx_q->out + count;
 		}
 	}
 
-	return rx_q->input_ptr != rx_q->output_ptr;
+	return RINGBUF_COUNT(rx_q) != 0;
 }
 
 
 
 void serial_putc_tmo (int comPort, char c, short timeout)
 {
+	ringbuf_t * q = & usarts[comPort].tx;
 	short i = timeout;
 	
-	while (i > 0)
+	while (ringbuf_free(q) == 0)  // a retry is not a dropped byte
 	{
-		if (serial_putc(comPort, c) == 1)
-			break;
+		if (i <= 0)
+		{
+			q->overflow ++;
+			serial_timeout_error ++;
+			return;
+		}
+		
 		i--;
 		serial_rx_char_available(comPort); // fill the TX buffer
 		vTaskDelay(1);
 	}
 	
-	if (i <= 0)
+	ringbuf_put(q, c);
+}
+
+// write a block, waits (max. timeout ms) while the buffer is full
+
+void serial_write_tmo (int comPort, const char * buf, int len, short timeout)
+{
+	ringbuf_t * q = & usarts[comPort].tx;
+	short i = timeout;
+	
+	while (1)
 	{
-		serial_timeout_error ++;
+		int n = ringbuf_free(q);
+		
+		if (n > len)
+		{
+			n = len;
+		}
+		
+		ringbuf_write(q, (const uint8_t *) buf, n);
+		buf += n;
+		len -= n;
+		
+		if (len <= 0)
+			break;
+			
+		if (i <= 0)
+		{
+			q->overflow += len;  // the rest is dropped
+			serial_timeout_error ++;
+			break;
+		}
+		
+		i--;
+		serial_rx_char_available(comPort); // fill the TX buffer
+		vTaskDelay(1);
 	}
 }
 
 int serial_getc ( int usartNum, char * cOutChar )
 {
-	struct usartBuffer * q = & usarts[usartNum].rx;
+	return ringbuf_get( & usarts[usartNum].rx, (uint8_t *) cOutChar);
+}
+
+int serial_read ( int usartNum, char * buf, int maxlen )
+{
+	return ringbuf_read( & usarts[usartNum].rx, (uint8_t *) buf, maxlen);
+}
+
+
+int snmp_get_serial_stats ( int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	struct usartParams * u = usarts + ((arg >> 4) & 0x01);  // USART in the upper nibble
+	
+	switch (arg & 0x0F)
+	{
+		case 1:
+			value = u->rx.high_water;
+			break;
+		case 2:
+			value = u->tx.high_water;
+			break;
+		case 3:
+			value = u->tx.overflow;
+			break;
+		case 4:
+			value = u->rx_restarts;
+			break;
+	}
 	
-	return get_q(q, cOutChar);
+	return snmp_encode_int( value, res, res_len, maxlen );
 }
 
 
@@ -38,8 +38,10 @@ int serial_init ( int usartNum, int baudrate );
 int serial_putc ( int usartNum, char cOutChar );
 int serial_stop ( int usartNum );
 int serial_getc ( int usartNum, char * cOutChar );
+int serial_read ( int usartNum, char * buf, int maxlen );
 int serial_rx_char_available (int usartNum);
 void serial_putc_tmo (int comPort, char c, short timeout);
+void serial_write_tmo (int comPort, const char * buf, int len, short timeout);
 
 // int serial_puts (int usartNum, const char * s);
 
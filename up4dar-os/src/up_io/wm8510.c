@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gpio.h"
 
 #include "wm8510.h"
+#include "pdca_dbuf.h"
 
 #include "up_dstar/vdisp.h"
 
@@ -37,7 +38,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "up_dstar/audio_q.h"
 
-#include "up_dstar/fixpoint_math.h"
+#include "up_dstar/tone_gen.h"
 #include "up_dstar/settings.h"
 
 
@@ -77,16 +78,12 @@ void wm8510_set_spkr_volume (int vol)
 	}
 }
 
-static int beep_counter = 0;
-static int beep_phase = 0;
-static int beep_phase_incr = 0;
-static int beep_volume = 0;
-static int beep_fade_in = 0;
+static tone_gen_t tone;
 
 
 static int chip_init(void)
 {
-	beep_counter = 0;
+	tone_init( &tone );
 	
 	AVR32_TWI.cr = 0x24; // MSEN + SVDIS
 	AVR32_TWI.mmr =  0x001A0100;    // DADR= 0011010   , One-byte internal device address, MREAD = 0
@@ -164,14 +161,16 @@ static int16_t rx_buf1[BUF_SIZE];
 static int16_t * tx_buf[2];
 static int16_t * rx_buf[2];
 
-static int curr_tx_buf = 0;
-static int curr_rx_buf = 0;
+static pdca_dbuf_t ssc_tx;
+static pdca_dbuf_t ssc_rx;
+static xSemaphoreHandle ssc_sem;
 
 
 
 static portTASK_FUNCTION( wm8510Task, pvParameters )
 {
 	int audio_state = 0;
+	int16_t * b;
 	
 	for(;;)
 	{
@@ -185,22 +184,19 @@ static portTASK_FUNCTION( wm8510Task, pvParameters )
 				audio_state = 1;
 				// vdisp_prints_xy(0, 40, VDISP_FONT_6x8, 0, "OK ");
 				
-				AVR32_PDCA.channel[2].mr = AVR32_PDCA_HALF_WORD; // 16 bit transfer
-				AVR32_PDCA.channel[2].psr = AVR32_PDCA_PID_SSC_TX; // select peripherial
-				AVR32_PDCA.channel[2].mar = (unsigned long) tx_buf[curr_tx_buf];
-				AVR32_PDCA.channel[2].tcr = BUF_SIZE ; 
+				// 16 bit transfers
+				pdca_dbuf_init( &ssc_tx, 2, AVR32_PDCA_PID_SSC_TX, AVR32_PDCA_HALF_WORD,
+					tx_buf[0], tx_buf[1], BUF_SIZE, ssc_sem );
 				
-				audio_q_get( audio_tx_q, tx_buf[curr_tx_buf]); // first half
-				// audio_q_get( audio_tx_q, tx_buf[curr_tx_buf] + AUDIO_Q_TRANSFERLEN);  // second half
+				audio_q_get( audio_tx_q, tx_buf[0]); // first half
+				// audio_q_get( audio_tx_q, tx_buf[0] + AUDIO_Q_TRANSFERLEN);  // second half
 				
-				AVR32_PDCA.channel[3].mr = AVR32_PDCA_HALF_WORD; // 16 bit transfer
-				AVR32_PDCA.channel[3].psr = AVR32_PDCA_PID_SSC_RX; // select peripherial
-				AVR32_PDCA.channel[3].mar = (unsigned long) rx_buf[curr_rx_buf];
-				AVR32_PDCA.channel[3].tcr = BUF_SIZE ; 
+				pdca_dbuf_init( &ssc_rx, 3, AVR32_PDCA_PID_SSC_RX, AVR32_PDCA_HALF_WORD,
+					rx_buf[0], rx_buf[1], BUF_SIZE, ssc_sem );
 				
 				AVR32_SSC.cr = 0x0101;  // enable TX + RX
-				AVR32_PDCA.channel[3].cr = 1; // rx DMA enable
-				AVR32_PDCA.channel[2].cr = 1; // tx DMA enable
+				pdca_dbuf_start( &ssc_rx );
+				pdca_dbuf_start( &ssc_tx );
 			}
 			else
 			{
@@ -209,60 +205,31 @@ static portTASK_FUNCTION( wm8510Task, pvParameters )
 			break;
 			
 		case 1:
-			vTaskDelay(1);
-			if ( (AVR32_PDCA.channel[2].tcrr == 0)
-				&& (AVR32_PDCA.channel[2].tcr < BUF_SIZE))
+			xSemaphoreTake( ssc_sem, 100 ); // woken up by the PDCA interrupt
+			
+			b = (int16_t *) pdca_dbuf_get( &ssc_tx );  // buffer that has to be filled
+			
+			if (b != NULL)
 			{
-				curr_tx_buf ^= 1; // toggle buffer
-				AVR32_PDCA.channel[2].marr = (unsigned long) tx_buf[curr_tx_buf];
-				AVR32_PDCA.channel[2].tcrr = BUF_SIZE;
+				struct latency_tag tag;
 				
-				audio_q_get( audio_tx_q, tx_buf[curr_tx_buf]); // first half
-				// audio_q_get( audio_tx_q, tx_buf[curr_tx_buf] + AUDIO_Q_TRANSFERLEN); // second half
+				audio_q_get_tag( audio_tx_q, b, &tag); // first half
+				LATENCY_STAGE(&tag, LATENCY_AUDIO_Q);
+				// audio_q_get( audio_tx_q, b + AUDIO_Q_TRANSFERLEN); // second half
 				
-				if (beep_counter > 0)
-				{
-					int i;
-					
-					for (i=0; i < BUF_SIZE; i++)
-					{
-						int vol = beep_volume;
-						
-						if (beep_counter == 1) // at the end of the beep
-						{
-							vol = (BUF_SIZE - i) * beep_volume / BUF_SIZE; // fade out
-						}
-						else if (beep_fade_in != 0) // start of beep
-						{
-							beep_fade_in = 0;
-							vol = (i + 1) * beep_volume / BUF_SIZE; // fade in
-						}
-						
-						tx_buf[curr_tx_buf][i] = (tx_buf[curr_tx_buf][i] / 2) + 
-							(vol * fixpoint_sin(beep_phase)) / 100;
-						beep_phase += beep_phase_incr;
-						if (beep_phase >= 360)
-						{
-							beep_phase -= 360;
-						}
-					}						
-					
-					beep_counter --;	
-				}
+				tone_render( &tone, b, BUF_SIZE );
 				
 			}			
-			if ( (AVR32_PDCA.channel[3].tcrr == 0)
-				&& (AVR32_PDCA.channel[3].tcr < BUF_SIZE))
+			
+			b = (int16_t *) pdca_dbuf_get( &ssc_rx );  // buffer that has been received
+			
+			if (b != NULL)
 			{
-				curr_rx_buf ^= 1; // toggle buffer
-				AVR32_PDCA.channel[3].marr = (unsigned long) rx_buf[curr_rx_buf];
-				AVR32_PDCA.channel[3].tcrr = BUF_SIZE;
-				
 				// if (gpio_get_pin_value(AVR32_PIN_PA28) == 0)
 				// {
 				
-				audio_q_put( audio_rx_q, rx_buf[curr_rx_buf]); // first half
-				// audio_q_put( audio_rx_q, rx_buf[curr_rx_buf] + AUDIO_Q_TRANSFERLEN); // second half
+				audio_q_put( audio_rx_q, b); // first half
+				// audio_q_put( audio_rx_q, b + AUDIO_Q_TRANSFERLEN); // second half
 				
 				// }					
 			}			
@@ -273,32 +240,14 @@ static portTASK_FUNCTION( wm8510Task, pvParameters )
 }	
 
 
-#define SAMPLE_RATE 8000
-
 void wm8510_beep(int duration_ms, int frequency_hz, int volume_percent)
 {
-	if ((duration_ms <= 0) || (volume_percent <= 0))
-		return;
+	tone_beep( &tone, duration_ms, frequency_hz, volume_percent );
+}
 
-	beep_counter = duration_ms  *  SAMPLE_RATE / ( configTICK_RATE_HZ * BUF_SIZE ) ;
-	
-	beep_volume = volume_percent;
-	
-	if (beep_volume < 0)
-	{
-		beep_volume = 0;
-	}
-	
-	if (beep_volume > 100)
-	{
-		beep_volume = 100;
-	}
-	
-	beep_phase = 0;
-	
-	beep_phase_incr = (360 * frequency_hz) / SAMPLE_RATE;
-	
-	beep_fade_in = 1;
+int wm8510_play(const char * script, int volume_percent)
+{
+	return tone_play( &tone, script, volume_percent );
 }
 
 
@@ -308,16 +257,14 @@ void wm8510Init( audio_q_t * tx, audio_q_t * rx )
 	tx_buf[0] = tx_buf0;
 	tx_buf[1] = tx_buf1;
 	
-	curr_tx_buf = 0;
-	
 	rx_buf[0] = rx_buf0;
 	rx_buf[1] = rx_buf1;
 	
-	curr_rx_buf = 0;
-	
 	audio_tx_q = tx;
 	audio_rx_q = rx;
 	
+	vSemaphoreCreateBinary( ssc_sem );
+	
 	xTaskCreate( wm8510Task, ( signed char * ) "WM8510", configMINIMAL_STACK_SIZE, NULL,
 		 tskIDLE_PRIORITY + 2 , ( xTaskHandle * ) NULL );
 	
@@ -57,7 +57,7 @@ static const unsigned char arp_header[6] = {0x00, 0x01, 0x08, 0x00, 6, 4};
 
 void arp_send_request (const ip_addr_t * a, int unicast, const mac_addr_t * m)
 {
-	eth_txmem_t * t = eth_txmem_get(ARP_PACKET_SIZE); // get buffer
+	eth_txmem_t * t = eth_txmem_get_raw(ARP_PACKET_SIZE); // get buffer, zeroed below
 	
 	if (t == NULL)
 		return;
@@ -120,7 +120,7 @@ void arp_process_packet(uint8_t * raw_packet)
 		{
 			int i;
 			
-			eth_txmem_t * t = eth_txmem_get(ARP_PACKET_SIZE); // get buffer
+			eth_txmem_t * t = eth_txmem_get_raw(ARP_PACKET_SIZE); // get buffer, zeroed below
 			
 			if (t == NULL)
 				break;
@@ -40,6 +40,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "up_io/eth_txmem.h"
 #include "ipneigh.h"
 #include "ipv4.h"
+#include "udp_socket.h"
 
 #include "dhcp.h"
 
@@ -130,10 +131,24 @@ static void print_ipv4_config(void)
 
 
 
+static udp_socket_t dhcp_socket;
+
+static void dhcp_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	if (dhcp_is_ready() == 0)  // if DHCP is not completed yet
+	{
+		dhcp_input_packet( data, data_len );
+	}
+}
+
 void dhcp_init(int fixed_address)
 {
 	dhcp_fixed_address = fixed_address;
 	
+	udp_socket_init(&dhcp_socket, dhcp_udp_input, 0, 0);
+	udp_socket_bind(&dhcp_socket, 68);
+	
 	if (fixed_address)
 	{
 		memcpy (ipv4_addr,		&SETTING_LONG(L_MY_IPV4_ADDR), 4);
@@ -143,6 +158,8 @@ void dhcp_init(int fixed_address)
 		memcpy (ipv4_dns_sec,	&SETTING_LONG(L_IPV4_DNS2), 4);
 		memcpy (ipv4_ntp,		&SETTING_LONG(L_IPV4_NTP), 4);
 		
+		ipneigh_changed(); // rebuild cached headers (udp4_flow)
+		
 		print_ipv4_config();
 		
 		dhcp_state = DHCP_READY;
@@ -686,6 +703,7 @@ void dhcp_input_packet (const uint8_t * data, int data_len)
 			
 			case RECEIVED_ACK:
 				dhcp_state = DHCP_READY;
+				ipneigh_changed(); // new address, netmask and gateway
 				print_ipv4_config();
 				
 				if (dhcp_T1 < DHCP_TIMEOUT_TIMER_MIN)
@@ -211,8 +211,6 @@ static int dns_send_req(int req_type)
 	{
 		dns_udp_local_port = udp_get_new_srcport();
 		
-		udp_socket_ports[UDP_SOCKET_DNS] = dns_udp_local_port;
-		
 		dns_req_id = crypto_get_random_16bit();
 	}
 	
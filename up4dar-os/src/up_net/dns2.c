@@ -40,6 +40,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "up_io/eth_txmem.h"
 #include "ipneigh.h"
 #include "ipv4.h"
+#include "udp_socket.h"
 
 #include "gcc_builtin.h"
 
@@ -113,6 +114,15 @@ struct dns2_cache
 #define DNS_NUMBER_OF_ENTRIES  7
 static struct dns2_cache * dc;
 
+// one socket per cache entry, the answers are queued by the Ethernet RX
+// task and processed by vDNSTask
+
+#define DNS_RX_SLOTS		4		// power of two
+#define DNS_RX_MAX_LEN		512		// max. DNS message over UDP
+
+static udp_socket_t dns_socket[DNS_NUMBER_OF_ENTRIES];
+static udp_socket_queue_t dns_rx_q;
+
 
 
 /*
@@ -487,9 +497,7 @@ static int dns2_send_req( int handle, uint8_t req_type)
 	
 	if (cur->udp_local_port == 0)
 	{
-		cur->udp_local_port = udp_get_new_srcport();
-		
-		// udp_socket_ports[UDP_SOCKET_DNS] = dns_udp_local_port;
+		cur->udp_local_port = udp_bind_new_srcport(dns_socket + handle);
 		
 		cur->req_id = crypto_get_random_16bit();
 	}
@@ -538,23 +546,17 @@ static int dns2_send_req( int handle, uint8_t req_type)
 }
 
 
-int dns2_find_dns_port( uint16_t port )
+static void dns2_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
 {
-	int i;
+	struct dns2_cache * cur = dc + s->arg;
 	
-	for (i=0; i < DNS_NUMBER_OF_ENTRIES; i++)
+	if ((cur->reqname_len > 0) && 
+		(cur->state == DNS_STATE_REQ_A) &&
+		(cur->udp_local_port == s->port))
 	{
-		struct dns2_cache * cur = dc + i;
-		
-		if ((cur->reqname_len > 0) && 
-			(cur->state == DNS_STATE_REQ_A) &&
-			(cur->udp_local_port == port))
-		{
-			return i;
-		}
+		dns2_input_packet(s->arg, data, data_len, ipv4_src_addr);
 	}
-	
-	return -1; // not found
 }
 
 
@@ -841,6 +843,8 @@ static void vDNSTask( void *pvParameters )
 		{
 			vTaskDelay(DNS_WAIT_TIME_PER_SLOT); // give time to other threads
 			
+			udp_socket_queue_service(&dns_rx_q); // answers received in the meantime
+			
 			struct dns2_cache * cur = dc + i;
 			
 			if (cur->reqname_len == 0) // skip inactive slots
@@ -905,6 +909,7 @@ static void vDNSTask( void *pvParameters )
 				if ((cur->ttl == 0) && (cur->link == 0)) // TTL expired and entry unused
 				{
 					cur->reqname_len = 0; // free entry
+					udp_socket_unbind(dns_socket + i);
 					
 					int j;
 					for (j=0; j < DNS_NUMBER_OF_ENTRIES; j++)
@@ -943,6 +948,17 @@ void dns2_init(void)
 	
 	memset(dc, 0, DNS_NUMBER_OF_ENTRIES * (sizeof (struct dns2_cache))); // clear cache memory
 	
+	udp_socket_queue_init(&dns_rx_q, (uint8_t *) pvPortMalloc ( UDP_SOCKET_QUEUE_MEM(DNS_RX_SLOTS, DNS_RX_MAX_LEN) ),
+		DNS_RX_SLOTS, DNS_RX_MAX_LEN);
+	
+	int i;
+	
+	for (i=0; i < DNS_NUMBER_OF_ENTRIES; i++)
+	{
+		udp_socket_init(dns_socket + i, dns2_udp_input, i, 0);
+		udp_socket_set_queue(dns_socket + i, &dns_rx_q);
+	}
+	
 	xTaskCreate( vDNSTask, (signed char *) "DNS2", 400, ( void * ) 0, ( tskIDLE_PRIORITY + 1 ), ( xTaskHandle * ) NULL );
 
 }
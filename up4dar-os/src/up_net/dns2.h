@@ -33,8 +33,6 @@ void dns2_init(void);
 
 void dns2_input_packet ( int handle, const uint8_t * data, int data_len, const uint8_t * ipv4_src_addr);
 
-int dns2_find_dns_port( uint16_t port );
-
 int dns2_req_A (const char * name);
 int dns2_result_available( int handle );
 int dns2_get_A_addr ( int handle, uint8_t ** v4addr);
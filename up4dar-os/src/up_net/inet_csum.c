@@ -0,0 +1,233 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * inet_csum.c
+ *
+ * Internet checksum (RFC 1071) with incremental update (RFC 1624)
+ *
+ * The words are summed 32 bits at a time into a 64 bit accumulator
+ * (add with carry, no carry test in the loop). 2^32 is 1 modulo 0xFFFF,
+ * so the folded result is the same as with 16 bit words. Data at an odd
+ * address is summed one byte off and swapped.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "gcc_builtin.h"
+
+#include "inet_csum.h"
+
+
+// the first byte of a word is the high byte (big endian)
+#ifndef INET_CSUM_BYTE0
+#define INET_CSUM_BYTE0(b)	(((uint32_t) (b)) << 8)
+#endif
+
+
+static uint32_t fold17 (uint64_t s)
+{
+	uint64_t t = (s & 0xFFFFFFFF) + (s >> 32);
+	
+	t = (t & 0xFFFF) + (t >> 16);
+	t = (t & 0xFFFF) + (t >> 16);
+	t = (t & 0xFFFF) + (t >> 16);
+	
+	return t;  // below 0x20000
+}
+
+
+uint32_t inet_csum_add (uint32_t sum, const uint8_t * d, int len)
+{
+	uint64_t s = sum;
+	
+	if (len <= 0)
+	{
+		return fold17(s);
+	}
+	
+	if ((((unsigned long) d) & 1) != 0)  // odd address
+	{
+		// the first byte is the high byte of a word, the words after it
+		// start at an even address and are summed swapped
+		
+		s += INET_CSUM_BYTE0(d[0]);
+		s += inet_csum_swap(inet_csum_add(0, d + 1, len - 1));
+		
+		return fold17(s);
+	}
+	
+	if (((((unsigned long) d) & 2) != 0) && (len >= 2))
+	{
+		s += *(const uint16_t *) d;
+		d += 2;
+		len -= 2;
+	}
+	
+	const uint32_t * w = (const uint32_t *) d;
+	
+	while (len >= 16)
+	{
+		s += w[0];
+		s += w[1];
+		s += w[2];
+		s += w[3];
+		w += 4;
+		len -= 16;
+	}
+	
+	while (len >= 4)
+	{
+		s += w[0];
+		w ++;
+		len -= 4;
+	}
+	
+	d = (const uint8_t *) w;
+	
+	if (len >= 2)
+	{
+		s += *(const uint16_t *) d;
+		d += 2;
+		len -= 2;
+	}
+	
+	if (len == 1)  // odd number of bytes, padded with 0
+	{
+		s += INET_CSUM_BYTE0(d[0]);
+	}
+	
+	return fold17(s);
+}
+
+
+uint32_t inet_csum_copy (uint32_t sum, uint8_t * dst, const uint8_t * src, int len)
+{
+	if (((((unsigned long) src) ^ ((unsigned long) dst)) & 3) != 0 ||
+		(((unsigned long) src) & 1) != 0)
+	{
+		// no common word alignment
+		memcpy(dst, src, len);
+		return inet_csum_add(sum, dst, len);
+	}
+	
+	uint64_t s = sum;
+	
+	if (((((unsigned long) src) & 2) != 0) && (len >= 2))
+	{
+		uint16_t v = *(const uint16_t *) src;
+		*(uint16_t *) dst = v;
+		s += v;
+		src += 2;
+		dst += 2;
+		len -= 2;
+	}
+	
+	const uint32_t * ws = (const uint32_t *) src;
+	uint32_t * wd = (uint32_t *) dst;
+	
+	while (len >= 16)
+	{
+		uint32_t a = ws[0];
+		uint32_t b = ws[1];
+		uint32_t c = ws[2];
+		uint32_t e = ws[3];
+		wd[0] = a;
+		wd[1] = b;
+		wd[2] = c;
+		wd[3] = e;
+		s += a;
+		s += b;
+		s += c;
+		s += e;
+		ws += 4;
+		wd += 4;
+		len -= 16;
+	}
+	
+	while (len >= 4)
+	{
+		uint32_t a = ws[0];
+		wd[0] = a;
+		s += a;
+		ws ++;
+		wd ++;
+		len -= 4;
+	}
+	
+	src = (const uint8_t *) ws;
+	dst = (uint8_t *) wd;
+	
+	if (len >= 2)
+	{
+		uint16_t v = *(const uint16_t *) src;
+		*(uint16_t *) dst = v;
+		s += v;
+		src += 2;
+		dst += 2;
+		len -= 2;
+	}
+	
+	if (len == 1)
+	{
+		dst[0] = src[0];
+		s += INET_CSUM_BYTE0(src[0]);
+	}
+	
+	return fold17(s);
+}
+
+
+uint16_t inet_csum_fold (uint32_t sum)
+{
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	
+	return sum;
+}
+
+
+uint32_t inet_csum_swap (uint32_t sum)
+{
+	uint16_t s = inet_csum_fold(sum);
+	
+	return ((s & 0xFF) << 8) | (s >> 8);
+}
+
+
+// RFC 1624, eqn. 3:  HC' = ~(~HC + ~m + m')
+
+uint16_t inet_csum_update16 (uint16_t csum, uint16_t old_value, uint16_t new_value)
+{
+	uint32_t sum = ((uint16_t) ~csum) + ((uint16_t) ~old_value) + new_value;
+	
+	return ~inet_csum_fold(sum);
+}
+
+
+uint16_t inet_csum_update32 (uint16_t csum, uint32_t old_value, uint32_t new_value)
+{
+	uint32_t sum = ((uint16_t) ~csum) +
+		((uint16_t) ~(old_value >> 16)) + ((uint16_t) ~old_value) +
+		(new_value >> 16) + (new_value & 0xFFFF);
+	
+	return ~inet_csum_fold(sum);
+}
@@ -0,0 +1,90 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * inet_csum.h
+ *
+ * Internet checksum (RFC 1071) with incremental update (RFC 1624)
+ *
+ */
+
+
+#ifndef INET_CSUM_H_
+#define INET_CSUM_H_
+
+
+// A partial sum is the unfolded ones' complement sum of 16 bit words in
+// the byte order of the CPU (big endian). Partial sums of pieces can be
+// added, a piece that starts at an odd offset of the datagram is added
+// with inet_csum_swap(). The functions return values below 0x20000, so
+// many partial sums and small numbers (protocol, length) can be added
+// before inet_csum_fold().
+
+// add len bytes at d, an odd length is padded with 0 (the next piece
+// starts at an odd offset)
+uint32_t inet_csum_add (uint32_t sum, const uint8_t * d, int len);
+
+// copy len bytes from src to dst and add them to sum
+uint32_t inet_csum_copy (uint32_t sum, uint8_t * dst, const uint8_t * src, int len);
+
+// 16 bit ones' complement sum
+uint16_t inet_csum_fold (uint32_t sum);
+
+// partial sum of a piece at an odd offset
+uint32_t inet_csum_swap (uint32_t sum);
+
+// checksum field value for the partial sum
+#define INET_CSUM_FINISH(sum)  ((uint16_t) ~inet_csum_fold(sum))
+
+// new checksum after a 16 or 32 bit field changed from old_value to new_value
+uint16_t inet_csum_update16 (uint16_t csum, uint16_t old_value, uint16_t new_value);
+uint16_t inet_csum_update32 (uint16_t csum, uint32_t old_value, uint32_t new_value);
+
+// checksum field value of an IPv4 header of 20 bytes (no options) at an
+// even address, the checksum field is skipped: the ten words with three
+// or four aligned 32 bit loads, no loop
+
+static inline uint16_t inet_csum_ip_header (const uint8_t * h)
+{
+	const uint16_t * v = (const uint16_t *) h;
+	uint64_t s;
+	
+	if ((((unsigned long) h) & 2) == 0)
+	{
+		const uint32_t * w = (const uint32_t *) h;
+		
+		s = (uint64_t) w[0] + w[1] + v[4] + w[3] + w[4];  // words 0..4, 6..9
+	}
+	else  // behind the Ethernet header
+	{
+		s = (uint64_t) v[0] + *(const uint32_t *) (h + 2) + *(const uint32_t *) (h + 6) +
+			v[6] + *(const uint32_t *) (h + 14) + v[9];
+	}
+	
+	s = (s & 0xFFFFFFFF) + (s >> 32);
+	s = (s & 0xFFFF) + (s >> 16);
+	s = (s & 0xFFFF) + (s >> 16);
+	s = (s & 0xFFFF) + (s >> 16);
+	
+	return (uint16_t) ~s;
+}
+
+
+#endif /* INET_CSUM_H_ */
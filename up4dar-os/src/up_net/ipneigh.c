@@ -64,10 +64,26 @@ static struct ipneigh_list neighbors[NEIGH_LIST_LEN];
 
 static ip_addr_t zero_address;
 
+// counts changes that make a MAC addr taken from the table invalid,
+// users that cache the MAC addr (udp4_flow) compare it before sending
+static uint32_t neigh_generation;
+
 void ipneigh_init(void)
 {
 	memset(neighbors, 0, sizeof neighbors);
 	memset(&zero_address, 0, sizeof zero_address);	
+	
+	neigh_generation ++;
+}
+
+uint32_t ipneigh_generation(void)
+{
+	return neigh_generation;
+}
+
+void ipneigh_changed(void)
+{
+	neigh_generation ++;
 }
 
 #define REACHABLE_TIMER 40
@@ -151,6 +167,7 @@ void ipneigh_service(void)
 							neighbors[i].timer = INCOMPLETE_TIMER;
 							neighbors[i].retry_counter = INCOMPLETE_RETRY;
 							neighbors[i].pending_packet = NULL;				
+							neigh_generation ++; // neighbor didn't answer, MAC addr is not valid anymore
 						}
 						else
 						{
@@ -182,6 +199,11 @@ void ipneigh_rx ( const ip_addr_t * a, const mac_addr_t * m, int solicited )
 			if ((solicited != 0) && 
 			  ((neighbors[i].state == INCOMPLETE) || (neighbors[i].state == PROBE)))
 			{
+				if (memcmp(&neighbors[i].mac_addr, m, sizeof (mac_addr_t)) != 0)
+				{
+					neigh_generation ++; // MAC addr changed
+				}
+				
 				memcpy(&neighbors[i].mac_addr, m, sizeof (mac_addr_t));
 				neighbors[i].state = REACHABLE;
 				neighbors[i].timer = REACHABLE_TIMER;
@@ -223,6 +245,8 @@ void ipneigh_rx ( const ip_addr_t * a, const mac_addr_t * m, int solicited )
 		if ( (memcmp(&neighbors[i].ip_addr, &zero_address, sizeof (ip_addr_t)) != 0) &&
 		     (neighbors[i].state == STALE) )
 		{
+			neigh_generation ++; // entry is replaced
+			
 			memcpy(&neighbors[i].ip_addr, a, sizeof (ip_addr_t));
 			memcpy(&neighbors[i].mac_addr, m, sizeof (mac_addr_t));
 			
@@ -299,6 +323,8 @@ static int ipneigh_get ( const ip_addr_t * a, mac_addr_t * m, eth_txmem_t * pack
 		if ( (memcmp(&neighbors[i].ip_addr, &zero_address, sizeof (ip_addr_t)) != 0) &&
 		     (neighbors[i].state == STALE) )
 		{
+			neigh_generation ++; // entry is replaced
+			
 			memcpy(&neighbors[i].ip_addr, a, sizeof (ip_addr_t));
 			memset(&neighbors[i].mac_addr, 0, sizeof (mac_addr_t));
 			
@@ -315,6 +341,37 @@ static int ipneigh_get ( const ip_addr_t * a, mac_addr_t * m, eth_txmem_t * pack
 }
 
 
+int ipneigh_get_mac ( const ip_addr_t * a, mac_addr_t * m )
+{
+	int i;
+	
+	for (i=0; i < NEIGH_LIST_LEN; i++)
+	{
+		if (memcmp(&neighbors[i].ip_addr, a, sizeof (ip_addr_t)) == 0)
+		{
+			if (neighbors[i].state == INCOMPLETE)
+			{
+				return 0;
+			}
+			
+			memcpy(m, &neighbors[i].mac_addr, sizeof (mac_addr_t));
+			
+			if (neighbors[i].state == STALE)
+			{
+				neighbors[i].state = PROBE;
+				neighbors[i].timer = PROBE_TIMER;
+				neighbors[i].retry_counter = PROBE_RETRY;
+				neighbors[i].pending_packet = NULL;
+			}
+			
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+
 
 void ipneigh_send_packet ( const ip_addr_t * a, eth_txmem_t * packet )
 {
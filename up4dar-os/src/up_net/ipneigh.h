@@ -69,6 +69,15 @@ void ipneigh_rx ( const ip_addr_t * a, const mac_addr_t * m, int solicited );
 
 void ipneigh_send_packet ( const ip_addr_t * a, eth_txmem_t * packet );
 
+// returns 1 and the MAC addr if the neighbor is known, no ND is started
+int ipneigh_get_mac ( const ip_addr_t * a, mac_addr_t * m );
+
+// changes when a MAC addr returned by ipneigh_get_mac() may be invalid
+uint32_t ipneigh_generation (void);
+
+// IPv4 address, netmask or gateway changed
+void ipneigh_changed (void);
+
 void ipneigh_service(void);
 
 #endif /* IPNEIGH_H_ */
\ No newline at end of file
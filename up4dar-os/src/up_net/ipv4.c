@@ -41,18 +41,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ipneigh.h"
 #include "ipv4.h"
+#include "inet_csum.h"
+#include "udp_socket.h"
 
 #include "up_dstar/dstar.h"
 
 #include "snmp.h"
-#include "up_dstar/dcs.h"
 #include "up_net/dhcp.h"
-#include "dns2.h"
 
 #include "up_dstar/vdisp.h"
 #include "up_crypto/up_crypto.h"
-#include "ntp.h"
-#include "up_dstar/ccs.h"
 
 unsigned char ipv4_addr[4];
 
@@ -82,23 +80,16 @@ static const uint8_t echo_reply_header[38] = {
 
 static int ipv4_header_checksum( const uint8_t * p, int header_len )
 {
-	int sum = 0;
-	int i;
-	
-	for (i=0; i < (header_len >> 1); i++)
+	if (header_len == 20)  // no options
 	{
-		if (i != 5)  // skip checksum field
-		{
-			sum += ((unsigned short *) p) [i];
-		}
+		return inet_csum_ip_header(p);
 	}
 	
-	while ((sum >> 16) != 0)
-	{
-		sum = (sum & 0xFFFF) + (sum >> 16);
-	}
+	uint32_t sum = inet_csum_add(0, p, 10);
+	
+	sum = inet_csum_add(sum, p + 12, header_len - 12); // skip checksum field
 	
-	return ( ~sum ) & 0xFFFF;
+	return INET_CSUM_FINISH(sum);
 }
 
 static void ipv4_send (eth_txmem_t * packet, const uint8_t * ipv4_dest_addr)
@@ -119,7 +110,7 @@ static void ipv4_send (eth_txmem_t * packet, const uint8_t * ipv4_dest_addr)
 	
 static void icmpv4_send_echo_reply (const uint8_t * p, int len, const uint8_t * ipv4_header)
 {
-	eth_txmem_t * packet = eth_txmem_get(len + 20 + 14); // get buffer for reply
+	eth_txmem_t * packet = eth_txmem_get_raw(len + 20 + 14); // get buffer for reply, every byte is written
 	
 	if (packet == NULL) // nomem
 		return;
@@ -142,30 +133,9 @@ static void icmpv4_send_echo_reply (const uint8_t * p, int len, const uint8_t *
 	
 	memcpy(echo_reply_buf + 38, p + 4, len - 4);  // ping daten kopieren ohne type und chksum
 	
-	int i;
-	int sum = 0;
-	
-	for (i=0; i < (len >> 1); i++)
-	{
-		if (i != 1)  // das checksum-feld weglassen
-		{
-			sum += ((unsigned short *) (echo_reply_buf + 34)) [i];
-		}
-	}
-	
-	if ((len & 0x01) != 0)  // ungerade Anzahl bytes
-	{
-		sum += (echo_reply_buf + 34)[len -1] << 8;  // letztes byte mit 0 als padding
-	}
-	
-	while ((sum >> 16) != 0)
-	{
-		sum = (sum & 0xFFFF) + (sum >> 16);
-	}
-	
-	sum = ( ~sum ) & 0xFFFF;
-	
-	((unsigned short *) (echo_reply_buf + 34)) [1] = sum;
+	// only type and code differ from the request (checked by icmpv4_input)
+	((unsigned short *) (echo_reply_buf + 34)) [1] = inet_csum_update16( ((unsigned short *) p) [1],
+		((unsigned short *) p) [0], ((unsigned short *) (echo_reply_buf + 34)) [0] );
 		
 	ipv4_send(packet, ipv4_header + 12); // send response to src address of request
 		
@@ -176,30 +146,11 @@ static void icmpv4_send_echo_reply (const uint8_t * p, int len, const uint8_t *
 
 static void icmpv4_input (const uint8_t * p, int len, const uint8_t * ipv4_header)
 {
-	int sum = 0;
-	int i;
+	uint32_t sum = inet_csum_add(0, p, 2);
 	
-	for (i=0; i < (len >> 1); i++)
-	{
-		if (i != 1)  // das checksum-feld weglassen
-		{
-			sum += ((unsigned short *) p) [i];
-		}
-	}
-	
-	if ((len & 0x01) != 0)  // ungerade Anzahl bytes
-	{
-		sum += p[len -1] << 8;  // letztes byte mit 0 als padding
-	}
-	
-	while ((sum >> 16) != 0)
-	{
-		sum = (sum & 0xFFFF) + (sum >> 16);
-	}
-	
-	sum = ( ~sum ) & 0xFFFF;
+	sum = inet_csum_add(sum, p + 4, len - 4);  // das checksum-feld weglassen
 		
-	if (sum != ((unsigned short *) p) [1])  // checksumme falsch
+	if (INET_CSUM_FINISH(sum) != ((unsigned short *) p) [1])  // checksumme falsch
 		return;
 	
 	
@@ -214,20 +165,17 @@ static void icmpv4_input (const uint8_t * p, int len, const uint8_t * ipv4_heade
 }	
 
 
-void ipv4_udp_prepare_packet( eth_txmem_t * packet, const uint8_t * dest_ipv4_addr, int udp_data_length,
+// Ethernet, IPv4 and UDP header, the length fields, the IP ID and
+// the checksums are 0
+
+static void ipv4_udp_fixed_header( uint8_t * p, const uint8_t * dest_ipv4_addr,
 	int udp_src_port, int udp_dest_port )
 {
-	uint8_t * p = packet->data;
-	
-	memset(p + 14, 0, 20 ); // fill IP header with zeros
+	memset(p + 14, 0, 20 + 8 ); // fill IP and UDP header with zeros
 	
 	eth_set_src_mac_and_type(p, 0x0800); // IP packet
 	
-	unsigned short r = crypto_get_random_15bit();
-	
 	p[14] = 0x45; // IPv4, 20 Bytes Header
-	p[18] = r & 0xFF;
-	p[19] = r >> 7;
 	p[20] = 0x40; // don't fragment
 	p[22] = 128;  // TTL=128
 	p[23] = 17;  // next header -> UDP
@@ -235,6 +183,23 @@ void ipv4_udp_prepare_packet( eth_txmem_t * packet, const uint8_t * dest_ipv4_ad
 	memcpy(p + 26, ipv4_addr, sizeof ipv4_addr); // src IP
 	memcpy(p + 30, dest_ipv4_addr, sizeof ipv4_addr); // dest IP
 	
+	((unsigned short *) (p + 14)) [10] = udp_src_port & 0xFFFF; 
+	((unsigned short *) (p + 14)) [11] = udp_dest_port & 0xFFFF;
+}
+
+
+void ipv4_udp_prepare_packet( eth_txmem_t * packet, const uint8_t * dest_ipv4_addr, int udp_data_length,
+	int udp_src_port, int udp_dest_port )
+{
+	uint8_t * p = packet->data;
+	
+	ipv4_udp_fixed_header(p, dest_ipv4_addr, udp_src_port, udp_dest_port);
+	
+	unsigned short r = crypto_get_random_15bit();
+	
+	p[18] = r & 0xFF;
+	p[19] = r >> 7;
+	
 	int total_length = udp_data_length + 8 + 20;
 	
 	((unsigned short *) (p + 14)) [1] = total_length;
@@ -242,19 +207,18 @@ void ipv4_udp_prepare_packet( eth_txmem_t * packet, const uint8_t * dest_ipv4_ad
 	
 	((unsigned short *) (p + 14)) [5] = ipv4_header_checksum(p+14, 20);
 	
-	((unsigned short *) (p + 14)) [10] = udp_src_port & 0xFFFF; 
-	((unsigned short *) (p + 14)) [11] = udp_dest_port & 0xFFFF;
 	((unsigned short *) (p + 14)) [12] = udp_data_length + 8;
     //	((unsigned short *) (p + 14)) [13] = 0;  // chksum
 	
 }
 
 
-static void snmp_send_reply (const uint8_t * p, int len, const uint8_t * ipv4_header)
+static void snmp_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
 {
 	int data_length = 0;
 	
-	eth_txmem_t * packet = snmp_process_request( p + 8, len, & data_length );
+	eth_txmem_t * packet = snmp_process_request( data, data_len, & data_length );
 	
 	if (packet == NULL)  // something went wrong
 		return; 
@@ -266,53 +230,99 @@ static void snmp_send_reply (const uint8_t * p, int len, const uint8_t * ipv4_he
 	}		
 		
 	
-	int src_port = (p[2] << 8) | p[3];
-	int dest_port = (p[0] << 8) | p[1];
-	
+	ipv4_udp_prepare_packet(packet, ipv4_src_addr, data_length, s->port, src_port);
 	
-	ipv4_udp_prepare_packet(packet, ipv4_header + 12, data_length, src_port, dest_port);
-	
-	udp4_calc_chksum_and_send(packet,  ipv4_header + 12);
+	udp4_calc_chksum_and_send(packet, ipv4_src_addr);
 	
 }
 
 
-static int udp4_header_checksum( const uint8_t * p)
-{
-	int sum = 0;
-	int i;
+// p is the IPv4 header, the first len1 bytes of the UDP datagram follow
+// the header, the rest is at p2 (datagram that wraps at the end of the
+// receive ring). len1 is even.
 
-	for (i=6; i < 10; i++) // dest+src IP addr
-	{
-		sum += ((unsigned short *) (p)) [i];
-	}
+static int udp4_header_checksum( const uint8_t * p, int len1, const uint8_t * p2 )
+{
+	uint32_t sum = inet_csum_add(0, p + 12, 8); // dest+src IP addr
 
 	sum += 17;
 
-	int udp_length = ((unsigned short *) (p)) [12];
+	int udp_length = (p[24] << 8) | p[25];
 	sum += udp_length;
 
+	if (len1 > udp_length)
+	{
+		len1 = udp_length;
+	}
 
+	sum = inet_csum_add(sum, p + 20, 6); // UDP header without checksum field
+	sum = inet_csum_add(sum, p + 28, len1 - 8);
 
-	for (i=0; i < (udp_length >> 1); i++)
+	if (len1 < udp_length)
 	{
-		if (i != 3) // skip checksum field
-		{
-			sum += ((unsigned short *) (p + 20))[i];
-		}
+		sum = inet_csum_add(sum, p2, udp_length - len1);
 	}
 
-	if ((udp_length & 1) == 1) // odd number of bytes
+	sum = INET_CSUM_FINISH(sum);
+
+	if (sum == 0)
 	{
-		sum += ((unsigned char * )( p + 20)) [udp_length-1] << 8;
+		sum = 0xFFFF;
 	}
+	
+	return sum;
+}
+
+// sum of the UDP data of a frame to send, with or without payload segments
+// (eth_txmem_add_seg()), the segments may start at any offset of the datagram
 
-	while ((sum >> 16) != 0)
+static uint32_t udp4_tx_data_sum( const eth_txmem_t * packet, int udp_length )
+{
+	int i;
+	
+	int len1 = udp_length;  // UDP header and data in the first buffer
+	
+	for (i=0; i < packet->num_seg; i++)
+	{
+		len1 -= packet->seg[i]->tx_size;
+	}
+	
+	uint32_t sum = inet_csum_add(0, packet->data + UDP_PACKET_SIZE(0), len1 - 8);
+	
+	int offset = len1;
+	
+	for (i=0; i < packet->num_seg; i++)
 	{
-		sum = (sum & 0xFFFF) + (sum >> 16);
+		const eth_txmem_t * s = packet->seg[i];
+		
+		uint32_t part = (s->pool == ETH_TXMEM_STATIC) ? s->sum : inet_csum_add(0, s->data, s->tx_size);
+		
+		if ((offset & 1) != 0)
+		{
+			part = inet_csum_swap(part);  // segment starts at an odd offset
+		}
+		
+		sum += part;
+		offset += s->tx_size;
 	}
+	
+	return sum;
+}
 
-	sum = ( ~sum ) & 0xFFFF;
+
+static int udp4_tx_checksum( const eth_txmem_t * packet, int udp_length )
+{
+	const uint8_t * p = packet->data + 14; // IPv4 header
+	
+	uint32_t sum = inet_csum_add(0, p + 12, 8); // src+dest IP addr
+	
+	sum += 17;
+	sum += udp_length;
+	
+	sum = inet_csum_add(sum, p + 20, 6); // UDP header without checksum field
+	sum += udp4_tx_data_sum(packet, udp_length);
+	
+	sum = INET_CSUM_FINISH(sum);
 
 	if (sum == 0)
 	{
@@ -322,7 +332,8 @@ static int udp4_header_checksum( const uint8_t * p)
 	return sum;
 }
 
-unsigned short udp_socket_ports[NUM_UDP_SOCKETS] = { 68, 161, 0, 0, 0 };
+
+static udp_socket_t snmp_socket;
 	
 
 int udp_get_new_srcport(void)
@@ -338,30 +349,50 @@ int udp_get_new_srcport(void)
 			p += 11000;
 		}
 	
-		int already_in_use = 0;
-		int i;
-		for (i=0; i < NUM_UDP_SOCKETS; i++)
-		{
-			if (p == udp_socket_ports[i])
-			{
-				already_in_use = 1;
-			}
-		}
-		
-		if (dns2_find_dns_port(p) >= 0) // port is used by DNS
-		{
-			already_in_use = 1;
-		}
-		
-		if (already_in_use == 0)
+		if (udp_socket_port_in_use(p) == 0)
 			break;
 	}
 	
 	return p;
 }	
+
+
+int udp_bind_new_srcport (udp_socket_t * s)
+{
+	// another task can take the port between the check and the bind
+	while (udp_socket_bind(s, udp_get_new_srcport()) != 0)
+	{
+	}
+	
+	return s->port;
+}
+	
 	
+// the first 'used' bytes of the datagram at p are needed in one piece,
+// returns the datagram (copied if it wraps at the end of the receive ring
+// before these bytes) or NULL
+
+static const uint8_t * udp_contiguous (eth_rx_frame_t * f, const uint8_t * p, int used)
+{
+	int offset = p - f->data;
+	
+	if ((offset + used) <= f->len1)
+	{
+		return p;  // in place
+	}
 	
-static void udp_input (const uint8_t * p, int len, const uint8_t * ipv4_header)
+	const uint8_t * d = eth_rx_frame_linear(f);
+	
+	if (d == NULL)
+	{
+		return NULL;
+	}
+	
+	return d + offset;
+}
+
+
+static void udp_input (eth_rx_frame_t * f, const uint8_t * p, int len, const uint8_t * ipv4_header)
 {
 	// int src_port = (p[0] << 8) | p[1];
 	int dest_port = (p[2] << 8) | p[3];
@@ -377,68 +408,46 @@ static void udp_input (const uint8_t * p, int len, const uint8_t * ipv4_header)
 	
 	if (checksum != 0)
 	{
-		if (checksum != udp4_header_checksum(ipv4_header))
+		if (checksum != udp4_header_checksum(ipv4_header, f->len1 - (p - f->data), f->data2))
 			return;
 	}	
 	
 	if (dest_port == 0)  // 0 is a special value (socket not connected)
 		return ;	
 	
-	int i;
+	udp_socket_t * s = udp_socket_lookup(dest_port);
+	
+	if (s == NULL)  // no socket for this port
+		return;
+	
+	int used = udp_length;  // bytes the input function reads, a queue gets the whole datagram
 	
-	for (i=0; i < NUM_UDP_SOCKETS; i++)
+	if ((s->q == NULL) && (s->read_len != 0) && (used > (8 + s->read_len)))
 	{
-		if (dest_port == udp_socket_ports[i])
-		{
-			switch (i)
-			{
-			case UDP_SOCKET_SNMP:
-				snmp_send_reply ( p, udp_length - 8, ipv4_header );
-				break;
-				
-			case UDP_SOCKET_DHCP:
-				if (dhcp_is_ready() == 0)  // if DHCP is not completed yet
-				{
-					dhcp_input_packet( p + 8, udp_length - 8 );
-				}
-				break;
-				
-			case UDP_SOCKET_DCS:
-				dcs_input_packet( p + 8, udp_length - 8, ipv4_header + 12 /* src addr */);
-				break;
-			
-			case UDP_SOCKET_CCS:
-				ccs_input_packet( p + 8, udp_length - 8, ipv4_header + 12 /* src addr */);
-				break;
-				
-			// case UDP_SOCKET_DNS:
-			//	dns_input_packet( p + 8, udp_length - 8, ipv4_header + 12 /* src addr */);
-			//	break;
-		
-				
-			case UDP_SOCKET_NTP:
-				ntp_handle_packet( p + 8, udp_length - 8, ipv4_header + 12 /* src addr */);
-				break;
-			}
-			
-			return;
-		}		 
-	}// for		
-	   
-	int handle = dns2_find_dns_port(dest_port);
+		used = 8 + s->read_len;
+	}
 	
-	if (handle >= 0)
+	p = udp_contiguous(f, p, used);
+	
+	if (p == NULL)  // no buffer for the copy
 	{
-		dns2_input_packet(handle, p + 8, udp_length - 8, ipv4_header + 12 /* src addr */);
+		udp_socket_drop(s);
+		return;
 	}
 	
+	udp_socket_deliver(s, p + 8, udp_length - 8, ipv4_header + 12 /* src addr */, (p[0] << 8) | p[1]);
+	
 }	
 	
 	
 
 
-void ipv4_input (const uint8_t * p, int len, const uint8_t * eth_header)
+void ipv4_input (struct eth_rx_frame * f)
 {
+	const uint8_t * p = f->data + 14;
+	int len = f->len - 14;
+	const uint8_t * eth_header = f->data;
+	
 	if (dhcp_is_ready() != 0)  // dhcp completed
 	{
 		if (memcmp(p+16, ipv4_addr, sizeof ipv4_addr) != 0)  // then: only allow packets
@@ -480,10 +489,19 @@ void ipv4_input (const uint8_t * p, int len, const uint8_t * eth_header)
 	switch (p[9])  // protocol
 	{
 		case 1:
+			if (f->len1 < f->len)  // the echo reply copies the whole packet
+			{
+				const uint8_t * d = eth_rx_frame_linear(f);
+				
+				if (d == NULL)
+					return;
+				
+				p = d + 14;
+			}
 			icmpv4_input(p + header_len, total_len - header_len, p);
 			break;
 		case 17: // UDP
-			udp_input(p + header_len, total_len - header_len, p);
+			udp_input(f, p + header_len, total_len - header_len, p);
 			break;
 	}
 	
@@ -569,13 +587,16 @@ void ipv4_init(void)
 	memcpy(ipv4_ntp, ipv4_zero_addr, sizeof ipv4_zero_addr); // no NTP server
 	
 	ipneigh_init(); // delete neighbor cache
+	
+	udp_socket_init(&snmp_socket, snmp_udp_input, 0, 0);
+	udp_socket_bind(&snmp_socket, 161);
 }
 
 
 
 eth_txmem_t * udp4_get_packet_mem (int udp_size, int src_port, int dest_port, const uint8_t * ipv4_dest_addr)
 {
-	eth_txmem_t * packet = eth_txmem_get( UDP_PACKET_SIZE(udp_size) );
+	eth_txmem_t * packet = eth_txmem_get_raw( UDP_PACKET_SIZE(udp_size) );
 	
 	if (packet == NULL)
 	{
@@ -583,19 +604,45 @@ eth_txmem_t * udp4_get_packet_mem (int udp_size, int src_port, int dest_port, co
 		return NULL;
 	}
 	
+	// the headers are written by ipv4_udp_prepare_packet() and
+	// ipv4_send(), only the UDP data is initialized with 0
+	memset(packet->data + UDP_PACKET_SIZE(0), 0, udp_size);
+	
 	ipv4_udp_prepare_packet( packet, ipv4_dest_addr, udp_size, src_port, dest_port);
 	
 	return packet;
 }
 
 
+eth_txmem_t * udp4_get_packet_mem_seg (int udp_size, eth_txmem_t * seg, int src_port, int dest_port, const uint8_t * ipv4_dest_addr)
+{
+	eth_txmem_t * packet = eth_txmem_get_raw( UDP_PACKET_SIZE(udp_size) );
+	
+	if (packet == NULL)
+	{
+		vdisp_prints_xy( 40, 56, VDISP_FONT_6x8, 0, "NOMEM" );
+		return NULL;
+	}
+	
+	memset(packet->data + UDP_PACKET_SIZE(0), 0, udp_size);
+	
+	eth_txmem_add_seg( packet, seg );
+	
+	ipv4_udp_prepare_packet( packet, ipv4_dest_addr, udp_size + seg->tx_size, src_port, dest_port);
+	
+	return packet;
+}
+
+
 void udp4_calc_chksum_and_send (eth_txmem_t * packet, const uint8_t * ipv4_dest_addr)
 {
 	
 	uint8_t * p = packet->data;
 
 	
-	((unsigned short *) (p + 14)) [13] = udp4_header_checksum(p + 14);
+	int udp_length = ((unsigned short *) (p + 14)) [12];
+	
+	((unsigned short *) (p + 14)) [13] = udp4_tx_checksum(packet, udp_length);
 	
 	
 	if (ipv4_dest_addr == NULL)
@@ -609,3 +656,159 @@ void udp4_calc_chksum_and_send (eth_txmem_t * packet, const uint8_t * ipv4_dest_
 	}
 	
 }
+
+
+
+static void udp4_flow_build (udp4_flow_t * flow)
+{
+	uint8_t * p = flow->header;
+	
+	ipv4_udp_fixed_header(p, flow->dest_addr, flow->src_port, flow->dest_port);
+	
+	memset(p, 0, 6); // dest MAC addr is set by udp4_flow_resolve()
+	
+	flow->ip_sum = inet_csum_add(0, p + 14, 20);
+	
+	uint32_t sum = inet_csum_add(0, p + 26, 8); // src+dest IP addr
+	
+	sum += 17;
+	
+	flow->udp_sum = inet_csum_add(sum, p + 34, 4); // UDP ports
+	
+	flow->generation = ipneigh_generation();
+	flow->state = UDP4_FLOW_OPEN;
+}
+
+
+static void udp4_flow_resolve (udp4_flow_t * flow)
+{
+	ip_addr_t  tmp_addr;
+	
+	if ((ipv4_get_neigh_addr(&tmp_addr, flow->dest_addr) == 0) &&
+		(ipneigh_get_mac(&tmp_addr, (mac_addr_t *) flow->header) != 0))
+	{
+		flow->state = UDP4_FLOW_RESOLVED;
+	}
+	
+	// otherwise the packets are sent with ipv4_send() which starts ND
+}
+
+
+void udp4_flow_connect (udp4_flow_t * flow, const uint8_t * ipv4_dest_addr, int src_port, int dest_port)
+{
+	unsigned short r = crypto_get_random_15bit();
+	
+	portENTER_CRITICAL();
+	
+	memcpy(flow->dest_addr, ipv4_dest_addr, sizeof flow->dest_addr);
+	flow->src_port = src_port;
+	flow->dest_port = dest_port;
+	flow->ip_id = r;
+	
+	udp4_flow_build(flow);
+	
+	portEXIT_CRITICAL();
+}
+
+
+eth_txmem_t * udp4_flow_get_packet_mem (udp4_flow_t * flow, int udp_size)
+{
+	if (flow->state == UDP4_FLOW_CLOSED)
+	{
+		return NULL;
+	}
+	
+	eth_txmem_t * packet = eth_txmem_get_raw( UDP_PACKET_SIZE(udp_size) );
+	
+	if (packet == NULL)
+	{
+		vdisp_prints_xy( 40, 56, VDISP_FONT_6x8, 0, "NOMEM" );
+		return NULL;
+	}
+	
+	// the headers are written by udp4_flow_send()
+	memset(packet->data + UDP_PACKET_SIZE(0), 0, udp_size);
+	
+	return packet;
+}
+
+
+eth_txmem_t * udp4_flow_get_packet_mem_seg (udp4_flow_t * flow, int udp_size, eth_txmem_t * seg)
+{
+	eth_txmem_t * packet = udp4_flow_get_packet_mem( flow, udp_size );
+	
+	if (packet != NULL)
+	{
+		eth_txmem_add_seg( packet, seg );
+	}
+	
+	return packet;
+}
+
+
+void udp4_flow_send (udp4_flow_t * flow, eth_txmem_t * packet)
+{
+	uint8_t * p = packet->data;
+	
+	int udp_length = eth_txmem_frame_len(packet) - UDP_PACKET_SIZE(0) + 8;
+	
+	uint32_t sum = udp4_tx_data_sum(packet, udp_length);
+	uint32_t ip_sum;
+	unsigned short id;
+	int state;
+	
+	portENTER_CRITICAL(); // the flow may be used by more than one task
+	
+	if ((flow->state != UDP4_FLOW_CLOSED) && (flow->generation != ipneigh_generation()))
+	{
+		udp4_flow_build(flow); // neighbor cache or IPv4 config changed
+	}
+	
+	if (flow->state == UDP4_FLOW_OPEN)
+	{
+		udp4_flow_resolve(flow);
+	}
+	
+	memcpy(p, flow->header, UDP_PACKET_SIZE(0));
+	
+	id = flow->ip_id ++;
+	ip_sum = flow->ip_sum;
+	sum += flow->udp_sum;
+	state = flow->state;
+	
+	portEXIT_CRITICAL();
+	
+	if (state == UDP4_FLOW_CLOSED)
+	{
+		eth_txmem_free(packet);
+		return;
+	}
+	
+	int total_length = udp_length + 20;
+	
+	((unsigned short *) (p + 14)) [1] = total_length;
+	((unsigned short *) (p + 14)) [2] = id;
+	((unsigned short *) (p + 14)) [5] = INET_CSUM_FINISH(ip_sum + total_length + id);
+	
+	((unsigned short *) (p + 14)) [12] = udp_length;
+	
+	sum += 2 * udp_length; // pseudo header and UDP header
+	
+	sum = INET_CSUM_FINISH(sum);
+	
+	if (sum == 0)
+	{
+		sum = 0xFFFF;
+	}
+	
+	((unsigned short *) (p + 14)) [13] = sum;
+	
+	if (state == UDP4_FLOW_RESOLVED)
+	{
+		eth_txmem_send(packet); // MAC addr is in the header
+	}
+	else
+	{
+		ipv4_send(packet, flow->dest_addr);
+	}
+}
@@ -44,19 +44,10 @@ extern const uint8_t ipv4_zero_addr[4];
 
 #define UDP_PACKET_SIZE(a) (14 + 20 + 8 + (a))
 
-#define NUM_UDP_SOCKETS   6
 
-extern unsigned short udp_socket_ports[NUM_UDP_SOCKETS];
+struct eth_rx_frame;
 
-#define UDP_SOCKET_DHCP		0
-#define UDP_SOCKET_SNMP		1
-#define UDP_SOCKET_DNS		2
-#define UDP_SOCKET_DCS		3
-#define UDP_SOCKET_NTP		4
-#define UDP_SOCKET_CCS		5
-
-
-void ipv4_input (const uint8_t * p, int len, const uint8_t * eth_header);
+void ipv4_input (struct eth_rx_frame * f);
 
 int ipv4_get_neigh_addr( ip_addr_t * addr, const uint8_t * ipv4_dest );
 int ipv4_addr_is_local ( const uint8_t * ipv4_a );
@@ -65,9 +56,48 @@ void ipv4_udp_prepare_packet( eth_txmem_t * packet, const uint8_t * dest_ipv4_ad
 
 eth_txmem_t * udp4_get_packet_mem (int udp_size, int src_port, int dest_port, const uint8_t * ipv4_dest_addr);
 
+// udp_size bytes of UDP data in the buffer, followed by the payload segment seg
+eth_txmem_t * udp4_get_packet_mem_seg (int udp_size, eth_txmem_t * seg, int src_port, int dest_port, const uint8_t * ipv4_dest_addr);
+
 void udp4_calc_chksum_and_send (eth_txmem_t * packet, const uint8_t * ipv4_dest_addr);
 int udp_get_new_srcport(void);
 
+struct udp_socket;
+
+// binds the socket to a new source port, returns the port
+int udp_bind_new_srcport (struct udp_socket * s);
+
+
+// connected UDP flow: destination and ports are fixed, the Ethernet/IPv4/UDP
+// header and the MAC addr of the next hop are built once and used until
+// the neighbor cache or the IPv4 config changes (ipneigh_generation())
+
+#define UDP4_FLOW_CLOSED	0
+#define UDP4_FLOW_OPEN		1	// header built, next hop MAC addr unknown
+#define UDP4_FLOW_RESOLVED	2	// header contains the MAC addr
+
+typedef struct udp4_flow
+{
+	uint8_t		header[UDP_PACKET_SIZE(0)];  // lengths, IP ID and checksums 0
+	uint8_t		dest_addr[4];
+	uint16_t	src_port;
+	uint16_t	dest_port;
+	uint32_t	ip_sum;		// IPv4 header without length and ID
+	uint32_t	udp_sum;	// pseudo header and UDP ports without length
+	uint32_t	generation;
+	uint16_t	ip_id;
+	uint8_t		state;
+} udp4_flow_t;
+
+void udp4_flow_connect (udp4_flow_t * flow, const uint8_t * ipv4_dest_addr, int src_port, int dest_port);
+
+// buffer with udp_size bytes of UDP data (initialized with 0), NULL if the flow is closed
+eth_txmem_t * udp4_flow_get_packet_mem (udp4_flow_t * flow, int udp_size);
+eth_txmem_t * udp4_flow_get_packet_mem_seg (udp4_flow_t * flow, int udp_size, eth_txmem_t * seg);
+
+// writes the headers and checksums and sends the packet
+void udp4_flow_send (udp4_flow_t * flow, eth_txmem_t * packet);
+
 void ipv4_print_ip_addr(int y, const char * desc, const uint8_t * ip);
 
 #endif /* IPV4_H_ */
\ No newline at end of file
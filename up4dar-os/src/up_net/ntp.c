@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "up_io/eth_txmem.h"
 #include "ipneigh.h"
 #include "ipv4.h"
+#include "udp_socket.h"
 #include "dhcp.h"
 #include "up_dstar/settings.h"
 #include "dns2.h"
@@ -35,10 +36,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define NTP_PORT                 123
 #define NTP_PACKET_LENGTH        48
 
-#define LOCAL_PORT               udp_socket_ports[UDP_SOCKET_NTP]
+#define LOCAL_PORT               ntp_socket.port
 #define ETHERNET_PAYLOAD_OFFSET  42
 
 
+static udp_socket_t ntp_socket;
+
 static char ntp_state;
 static int ntp_timer;
 static char ntp_retry_counter;
@@ -68,7 +71,7 @@ void ntp_handle_packet(const uint8_t* data, int length, const uint8_t* address)
 		}			
 		
 		ntp_state = NTP_STATE_IDLE;
-		LOCAL_PORT = 0; // close socket
+		udp_socket_unbind(&ntp_socket); // close socket
 	}  
   
 }
@@ -146,7 +149,7 @@ void ntp_service(void)
 					ntp_timer = TIMER_SECONDS(2);
 					ntp_retry_counter = 4;
 					memcpy(ntp_server_address, ipv4_ntp, sizeof(ntp_server_address));
-					LOCAL_PORT = udp_get_new_srcport();
+					udp_bind_new_srcport(&ntp_socket);
 					query_time();
 				}
 			}
@@ -175,7 +178,7 @@ void ntp_service(void)
 					ntp_timer = TIMER_SECONDS(2);
 					ntp_retry_counter = 4;
 					memcpy(ntp_server_address, addrptr, sizeof(ntp_server_address));
-					LOCAL_PORT = udp_get_new_srcport();
+					udp_bind_new_srcport(&ntp_socket);
 					query_time();
 				}
 				
@@ -195,15 +198,23 @@ void ntp_service(void)
 			{  // no answer, try again in 2 minutes
 				ntp_state = NTP_STATE_IDLE;
 				ntp_timer = TIMER_SECONDS(120);
-				LOCAL_PORT = 0; // close socket
+				udp_socket_unbind(&ntp_socket); // close socket
 			}
 			break;
 			
 	}
 }
 
+static void ntp_udp_input (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	ntp_handle_packet(data, data_len, ipv4_src_addr);
+}
+
 void ntp_init()
 {
+  udp_socket_init(&ntp_socket, ntp_udp_input, 0, 0);
+  
   // dns_cache_set_slot(DNS_CACHE_SLOT_NTP, "0.up4dar.pool.ntp.org", update_time);
   
   ntp_state = NTP_STATE_IDLE;
@@ -464,7 +464,188 @@ static const struct snmp_table_struct {
 	// Display
 	
 	{ "910", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_DISP_CONTRAST },
-	{ "920", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_DISP_BACKLIGHT }
+	{ "920", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_DISP_BACKLIGHT },
+	
+	// RX jitter buffer of the network stream
+	
+	{ "A11", BER_INTEGER, snmp_get_rx_stats, 0, 0x21 },  // frames received
+	{ "A12", BER_INTEGER, snmp_get_rx_stats, 0, 0x22 },  // frames played
+	{ "A13", BER_INTEGER, snmp_get_rx_stats, 0, 0x23 },  // late frames
+	{ "A14", BER_INTEGER, snmp_get_rx_stats, 0, 0x24 },  // lost frames
+	{ "A15", BER_INTEGER, snmp_get_rx_stats, 0, 0x25 },  // duplicate frames
+	{ "A16", BER_INTEGER, snmp_get_rx_stats, 0, 0x26 },  // underruns
+	{ "A17", BER_INTEGER, snmp_get_rx_stats, 0, 0x27 },  // superframe slips
+	{ "A18", BER_INTEGER, snmp_get_rx_stats, 0, 0x28 },  // jitter (usec)
+	{ "A19", BER_INTEGER, snmp_get_rx_stats, 0, 0x29 },  // mean added latency (msec)
+	{ "A1A", BER_INTEGER, snmp_get_rx_stats, 0, 0x2A },  // AMBE FEC bit errors (current transmission)
+	{ "A1B", BER_INTEGER, snmp_get_rx_stats, 0, 0x2B },  // AMBE bit error rate (0.01%)
+	
+	{ "A21", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_RX_JB_MIN_DEPTH },
+	{ "A22", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_RX_JB_MAX_DEPTH },
+	{ "A23", BER_INTEGER, snmp_get_setting_char, snmp_set_setting_char,  C_RX_ARBITRATION },
+	
+	// AMBE packet loss concealment (current transmission)
+	
+	{ "A31", BER_INTEGER, snmp_get_plc_stats, 0, 1 },  // frames decoded
+	{ "A32", BER_INTEGER, snmp_get_plc_stats, 0, 2 },  // lost frames
+	{ "A33", BER_INTEGER, snmp_get_plc_stats, 0, 3 },  // repeated frames
+	{ "A34", BER_INTEGER, snmp_get_plc_stats, 0, 4 },  // muted frames
+	{ "A35", BER_INTEGER, snmp_get_plc_stats, 0, 5 },  // loss bursts
+	{ "A36", BER_INTEGER, snmp_get_plc_stats, 0, 6 },  // longest burst
+	
+	// RX jitter buffer of the PHY stream, same order as A11..A1B
+	
+	{ "A41", BER_INTEGER, snmp_get_rx_stats, 0, 0x11 },
+	{ "A42", BER_INTEGER, snmp_get_rx_stats, 0, 0x12 },
+	{ "A43", BER_INTEGER, snmp_get_rx_stats, 0, 0x13 },
+	{ "A44", BER_INTEGER, snmp_get_rx_stats, 0, 0x14 },
+	{ "A45", BER_INTEGER, snmp_get_rx_stats, 0, 0x15 },
+	{ "A46", BER_INTEGER, snmp_get_rx_stats, 0, 0x16 },
+	{ "A47", BER_INTEGER, snmp_get_rx_stats, 0, 0x17 },
+	{ "A48", BER_INTEGER, snmp_get_rx_stats, 0, 0x18 },
+	{ "A49", BER_INTEGER, snmp_get_rx_stats, 0, 0x19 },
+	{ "A4A", BER_INTEGER, snmp_get_rx_stats, 0, 0x1A },
+	{ "A4B", BER_INTEGER, snmp_get_rx_stats, 0, 0x1B },
+	
+	// RX arbitration between PHY and network
+	
+	{ "A51", BER_INTEGER, snmp_get_rx_arb_stats, 0, 1 },  // preempted streams
+	{ "A52", BER_INTEGER, snmp_get_rx_arb_stats, 0, 2 },  // streams given to the secondary consumer
+	{ "A53", BER_INTEGER, snmp_get_rx_arb_stats, 0, 3 },  // secondary frames
+	{ "A54", BER_INTEGER, snmp_get_rx_arb_stats, 0, 4 },  // frames of a second session dropped
+	
+	// DTMF detector
+	
+	{ "A61", BER_INTEGER, snmp_get_setting_short, snmp_set_setting_short, S_DTMF_ON_COUNT },
+	{ "A62", BER_INTEGER, snmp_get_setting_short, snmp_set_setting_short, S_DTMF_OFF_COUNT },
+	{ "A63", BER_INTEGER, snmp_get_setting_short, snmp_set_setting_short, S_DTMF_MIN_GAP },
+	
+	// slow data demultiplexer
+	
+	{ "A71", BER_INTEGER, snmp_get_slowdata_stats, 0, 1 },  // blocks
+	{ "A72", BER_INTEGER, snmp_get_slowdata_stats, 0, 2 },  // incomplete blocks
+	{ "A73", BER_INTEGER, snmp_get_slowdata_stats, 0, 3 },  // complete text messages
+	{ "A74", BER_INTEGER, snmp_get_slowdata_stats, 0, 4 },  // headers with correct CRC
+	{ "A75", BER_INTEGER, snmp_get_slowdata_stats, 0, 5 },  // headers with CRC error
+	{ "A76", BER_INTEGER, snmp_get_slowdata_stats, 0, 6 },  // GPS bytes dropped
+	
+	// RX capture ring
+	
+	{ "B11", BER_INTEGER, snmp_get_capture, snmp_set_capture, 1 },  // 0 = stop, 1 = run, 2 = clear and run
+	{ "B12", BER_INTEGER, snmp_get_capture, 0, 2 },  // bytes in the ring
+	{ "B13", BER_INTEGER, snmp_get_capture, 0, 3 },  // records not captured (ring busy)
+	{ "B14", BER_INTEGER, snmp_get_capture, snmp_set_capture, 4 },  // read position
+	{ "B15", BER_OCTETSTRING, snmp_get_capture_data, 0, 0 },  // records from the read position
+	
+	// PHY serial port (USART1)
+	
+	{ "B21", BER_INTEGER, snmp_get_serial_stats, 0, 0x11 },  // RX buffer high water mark
+	{ "B22", BER_INTEGER, snmp_get_serial_stats, 0, 0x12 },  // TX buffer high water mark
+	{ "B23", BER_INTEGER, snmp_get_serial_stats, 0, 0x13 },  // TX bytes dropped (buffer full)
+	{ "B24", BER_INTEGER, snmp_get_serial_stats, 0, 0x14 },  // RX DMA restarts
+	
+	// audio queues: drift (ppm), underruns, overruns
+	
+	{ "B31", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x01 },  // decoded audio -> codec
+	{ "B32", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x02 },
+	{ "B33", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x03 },
+	{ "B34", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x11 },  // microphone -> encoder
+	{ "B35", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x12 },
+	{ "B36", BER_INTEGER, snmp_get_audio_q_stats, 0, 0x13 },
+	
+	// DMA buffers processed too late (PDCA channel)
+	
+	{ "B41", BER_INTEGER, snmp_get_pdca_dbuf_stats, 0, 0 },  // AMBE SPI TX
+	{ "B42", BER_INTEGER, snmp_get_pdca_dbuf_stats, 0, 1 },  // AMBE SPI RX
+	{ "B43", BER_INTEGER, snmp_get_pdca_dbuf_stats, 0, 2 },  // codec SSC TX
+	{ "B44", BER_INTEGER, snmp_get_pdca_dbuf_stats, 0, 3 },  // codec SSC RX
+	
+	// audio level meter (milliBel relative to full scale), microphone and speaker
+	
+	{ "B51", BER_INTEGER, snmp_get_audio_meter, 0, 0x01 },  // mic RMS
+	{ "B52", BER_INTEGER, snmp_get_audio_meter, 0, 0x02 },  // mic peak
+	{ "B53", BER_INTEGER, snmp_get_audio_meter, 0, 0x03 },  // mic clipped samples
+	{ "B54", BER_OCTETSTRING, snmp_get_audio_meter_history, 0, 0 },  // mic RMS/peak of the last 16 x 20ms
+	{ "B55", BER_INTEGER, snmp_get_audio_meter, 0, 0x11 },  // speaker RMS
+	{ "B56", BER_INTEGER, snmp_get_audio_meter, 0, 0x12 },  // speaker peak
+	{ "B57", BER_INTEGER, snmp_get_audio_meter, 0, 0x13 },  // speaker clipped samples
+	{ "B58", BER_OCTETSTRING, snmp_get_audio_meter_history, 0, 1 },  // speaker history
+	
+	// latency of received voice frames (usec): input, jitter queue, AMBE queue,
+	// decoder, audio queue, total (input -> codec)
+	
+	{ "B61", BER_INTEGER, snmp_get_latency, 0, 0x01 },  // mean
+	{ "B62", BER_INTEGER, snmp_get_latency, 0, 0x11 },
+	{ "B63", BER_INTEGER, snmp_get_latency, 0, 0x21 },
+	{ "B64", BER_INTEGER, snmp_get_latency, 0, 0x31 },
+	{ "B65", BER_INTEGER, snmp_get_latency, 0, 0x41 },
+	{ "B66", BER_INTEGER, snmp_get_latency, 0, 0x51 },
+	{ "B71", BER_INTEGER, snmp_get_latency, 0, 0x02 },  // max.
+	{ "B72", BER_INTEGER, snmp_get_latency, 0, 0x12 },
+	{ "B73", BER_INTEGER, snmp_get_latency, 0, 0x22 },
+	{ "B74", BER_INTEGER, snmp_get_latency, 0, 0x32 },
+	{ "B75", BER_INTEGER, snmp_get_latency, 0, 0x42 },
+	{ "B76", BER_INTEGER, snmp_get_latency, 0, 0x52 },
+	{ "B81", BER_OCTETSTRING, snmp_get_latency_hist, 0, 0 },  // frames per bucket (<1ms, 1ms, 2-3ms, 4-7ms, ...)
+	{ "B82", BER_OCTETSTRING, snmp_get_latency_hist, 0, 1 },
+	{ "B83", BER_OCTETSTRING, snmp_get_latency_hist, 0, 2 },
+	{ "B84", BER_OCTETSTRING, snmp_get_latency_hist, 0, 3 },
+	{ "B85", BER_OCTETSTRING, snmp_get_latency_hist, 0, 4 },
+	{ "B86", BER_OCTETSTRING, snmp_get_latency_hist, 0, 5 },
+	
+	// QSO recorder on the SD card
+	
+	{ "B91", BER_INTEGER, snmp_get_recorder, snmp_set_recorder, 1 },  // 0 = off, 1 = on, 2 = format the area and switch on
+	{ "B92", BER_INTEGER, snmp_get_recorder, 0, 2 },  // 0 = no card, 1 = not formatted, 2 = ready, 3 = error
+	{ "B93", BER_INTEGER, snmp_get_recorder, 0, 3 },  // entries in the list
+	{ "B94", BER_INTEGER, snmp_get_recorder, 0, 4 },  // frames not recorded (card too slow)
+	{ "B95", BER_OCTETSTRING, snmp_get_recorder_list, 0, 0 },  // index entries, newest first (55 bytes each)
+	{ "B96", BER_INTEGER, snmp_get_recorder, snmp_set_recorder, 5 },  // play: (target << 8) | n, target 1 = local, 2 = TX, 0 = stop
+	{ "B97", BER_INTEGER, snmp_get_recorder, snmp_set_recorder, 6 },  // parrot: play every received transmission onto the air
+	{ "B98", BER_INTEGER, snmp_get_recorder, 0, 7 },  // playback underruns
+	
+	// SD card transfers
+	
+	{ "BA1", BER_INTEGER, snmp_get_sdcard, snmp_set_sdcard, 1 },  // SPI clock (kHz) after the initialization
+	{ "BA2", BER_INTEGER, snmp_get_sdcard, 0, 2 },  // read throughput (kB/s, while transferring)
+	{ "BA3", BER_INTEGER, snmp_get_sdcard, 0, 3 },  // write throughput (kB/s, while transferring)
+	{ "BA4", BER_INTEGER, snmp_get_sdcard, 0, 4 },  // blocks read from the card
+	{ "BA5", BER_INTEGER, snmp_get_sdcard, 0, 5 },  // blocks written
+	{ "BA6", BER_INTEGER, snmp_get_sdcard, 0, 6 },  // blocks taken from the read-ahead buffer
+	{ "BA7", BER_INTEGER, snmp_get_sdcard, 0, 7 },  // CMD18 and CMD25 sent
+	{ "BA8", BER_INTEGER, snmp_get_sdcard, 0, 8 },  // transfer errors
+	
+	// last-heard list
+	
+	{ "BB1", BER_INTEGER, snmp_get_lastheard, snmp_set_lastheard, 1 },  // number of entries, set 0 = clear
+	{ "BB2", BER_INTEGER, snmp_get_lastheard, snmp_set_lastheard, 2 },  // position of the table walk (0 = newest)
+	{ "BB3", BER_OCTETSTRING, snmp_get_lastheard_table, 0, 0 },  // entries from the walk position (40 bytes each), empty at the end
+	{ "BB4", BER_INTEGER, snmp_get_lastheard, snmp_set_lastheard, 4 },  // saves to the SD card, set 1 = save now
+	
+	// Ethernet receive task
+	
+	{ "BC1", BER_INTEGER, snmp_get_eth_rx, 0, 1 },  // wakes by the MACB interrupt or a frame to send
+	{ "BC2", BER_INTEGER, snmp_get_eth_rx, 0, 2 },  // wakes by the idle timeout
+	{ "BC3", BER_INTEGER, snmp_get_eth_rx, 0, 3 },  // frames received
+	{ "BC4", BER_INTEGER, snmp_get_eth_rx, 0, 4 },  // wakes that used up the frame budget
+	{ "BC5", BER_INTEGER, snmp_get_eth_rx, 0, 5 },  // receive overruns (no free buffer)
+	{ "BC6", BER_INTEGER, snmp_get_eth_rx, 0, 6 },  // searches of the whole ring
+	{ "BC7", BER_INTEGER, snmp_get_eth_rx, 0, 7 },  // mean time RX interrupt -> task (us)
+	{ "BC8", BER_INTEGER, snmp_get_eth_rx, 0, 8 },  // max. time RX interrupt -> task (us)
+	{ "BC9", BER_INTEGER, snmp_get_eth_rx, 0, 9 },  // frames that wrap at the end of the receive ring
+	{ "BCA", BER_INTEGER, snmp_get_eth_rx, 0, 10 },  // wrapped frames copied (the input function needs them in one piece)
+	{ "BCB", BER_INTEGER, snmp_get_eth_rx, 0, 11 },  // wrapped frames dropped, no buffer for the copy
+	{ "BD1", BER_INTEGER, snmp_get_eth_tx, 0, 1 },  // frames appended to the TX ring
+	{ "BD2", BER_INTEGER, snmp_get_eth_tx, 0, 2 },  // frames dropped, TX ring full
+	{ "BD3", BER_INTEGER, snmp_get_eth_tx, 0, 3 },  // TX buffer requests without free buffer
+	{ "BD4", BER_INTEGER, snmp_get_eth_tx, 0, 4 },  // mean time send -> buffer free again (us)
+	{ "BD5", BER_INTEGER, snmp_get_eth_tx, 0, 5 },  // max. time send -> buffer free again (us)
+	{ "BD6", BER_INTEGER, snmp_get_eth_tx, 0, 6 },  // max. descriptors in use
+	{ "BD7", BER_INTEGER, snmp_get_eth_tx, 0, 7 },  // TX errors (ring restarted)
+	{ "BE1", BER_INTEGER, snmp_get_udp, 0, 1 },  // UDP datagrams for bound ports
+	{ "BE2", BER_INTEGER, snmp_get_udp, 0, 2 },  // UDP datagrams for ports without socket
+	{ "BE3", BER_INTEGER, snmp_get_udp, 0, 3 },  // UDP datagrams dropped (queue full, too long, no buffer)
+	{ "BE4", BER_INTEGER, snmp_get_udp, 0, 4 }  // UDP datagrams passed to the owning task
 };	
 
 
@@ -72,4 +72,40 @@ SNMP_GET_FUNC ( snmp_get_display )
 
 SNMP_SET_FUNC ( snmp_set_remote_button )
 
+SNMP_GET_FUNC ( snmp_get_rx_stats )
+SNMP_GET_FUNC ( snmp_get_rx_arb_stats )
+
+SNMP_GET_FUNC ( snmp_get_plc_stats )
+
+SNMP_GET_FUNC ( snmp_get_slowdata_stats )
+SNMP_GET_FUNC ( snmp_get_serial_stats )
+SNMP_GET_FUNC ( snmp_get_audio_q_stats )
+SNMP_GET_FUNC ( snmp_get_pdca_dbuf_stats )
+
+SNMP_GET_FUNC ( snmp_get_audio_meter )
+SNMP_GET_FUNC ( snmp_get_audio_meter_history )
+
+SNMP_GET_FUNC ( snmp_get_latency )
+SNMP_GET_FUNC ( snmp_get_latency_hist )
+
+SNMP_GET_FUNC ( snmp_get_capture )
+SNMP_SET_FUNC ( snmp_set_capture )
+SNMP_GET_FUNC ( snmp_get_capture_data )
+
+SNMP_GET_FUNC ( snmp_get_recorder )
+SNMP_SET_FUNC ( snmp_set_recorder )
+SNMP_GET_FUNC ( snmp_get_recorder_list )
+
+SNMP_GET_FUNC ( snmp_get_sdcard )
+SNMP_SET_FUNC ( snmp_set_sdcard )
+
+SNMP_GET_FUNC ( snmp_get_lastheard )
+SNMP_SET_FUNC ( snmp_set_lastheard )
+SNMP_GET_FUNC ( snmp_get_lastheard_table )
+
+SNMP_GET_FUNC ( snmp_get_eth_rx )
+SNMP_GET_FUNC ( snmp_get_eth_tx )
+
+SNMP_GET_FUNC ( snmp_get_udp )
+
 #endif /* SNMP_DATA_H_ */
\ No newline at end of file
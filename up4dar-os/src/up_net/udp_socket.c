@@ -0,0 +1,288 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * udp_socket.c
+ *
+ * UDP sockets: port demux and receive queues
+ *
+ * The bound sockets are kept in a small hash table with chains, the
+ * lookup for a datagram reads one chain. A socket either has its input
+ * function called directly in the Ethernet RX task, or the datagrams are
+ * copied to a receive queue that is emptied by the owning task, so a slow
+ * input function doesn't stall the Ethernet reception.
+ */
+
+
+#include "FreeRTOS.h"
+
+#include "gcc_builtin.h"
+
+#include "udp_socket.h"
+#include "up_net/snmp_data.h"
+
+
+#define UDP_HASH_SIZE	16		// power of two
+
+#define UDP_HASH(port)  (((port) ^ ((port) >> 4) ^ ((port) >> 8) ^ ((port) >> 12)) & (UDP_HASH_SIZE - 1))
+
+#define UDP_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
+
+
+static udp_socket_t * udp_hash[UDP_HASH_SIZE];
+
+static struct
+{
+	uint32_t rx;		// datagrams for bound ports
+	uint32_t no_port;	// datagrams for ports without socket
+	uint32_t dropped;	// sum of the drop_count of all sockets
+	uint32_t queued;	// datagrams passed to the owning task
+} udp_stats;
+
+
+void udp_socket_init (udp_socket_t * s, udp_socket_input_t input, int arg, int read_len)
+{
+	udp_socket_unbind(s);  // init runs again after a link loss, the socket may still be in a chain
+	
+	memset(s, 0, sizeof (udp_socket_t));
+	
+	s->input = input;
+	s->arg = arg;
+	s->read_len = read_len;
+}
+
+
+void udp_socket_set_queue (udp_socket_t * s, udp_socket_queue_t * q)
+{
+	s->q = q;
+}
+
+
+void udp_socket_queue_init (udp_socket_queue_t * q, uint8_t * mem, int num_slots, int max_len)
+{
+	q->in = 0;
+	q->out = 0;
+	q->mask = num_slots - 1;
+	q->max_len = max_len;
+	q->slot_size = UDP_SOCKET_SLOT_SIZE(max_len);
+	q->mem = mem;
+}
+
+
+static udp_socket_t * udp_socket_find (int port)
+{
+	udp_socket_t * s;
+	
+	for (s = udp_hash[UDP_HASH(port)]; s != NULL; s = s->next)
+	{
+		if (s->port == port)
+		{
+			return s;
+		}
+	}
+	
+	return NULL;
+}
+
+
+static void udp_socket_remove (udp_socket_t * s)
+{
+	udp_socket_t ** pp = udp_hash + UDP_HASH(s->port);
+	
+	while (*pp != NULL)
+	{
+		if (*pp == s)
+		{
+			*pp = s->next;
+			break;
+		}
+		
+		pp = & (*pp)->next;
+	}
+	
+	s->port = 0;
+}
+
+
+int udp_socket_bind (udp_socket_t * s, int port)
+{
+	int res = 0;
+	
+	portENTER_CRITICAL();
+	
+	if (s->port != 0)
+	{
+		udp_socket_remove(s);
+	}
+	
+	if ((port == 0) || (udp_socket_find(port) != NULL))
+	{
+		res = -1;  // 0 is not a valid port or the port is in use
+	}
+	else
+	{
+		s->port = port;
+		s->next = udp_hash[UDP_HASH(port)];
+		udp_hash[UDP_HASH(port)] = s;
+	}
+	
+	portEXIT_CRITICAL();
+	
+	return res;
+}
+
+
+void udp_socket_unbind (udp_socket_t * s)
+{
+	portENTER_CRITICAL();
+	
+	if (s->port != 0)
+	{
+		udp_socket_remove(s);
+	}
+	
+	portEXIT_CRITICAL();
+}
+
+
+int udp_socket_port_in_use (int port)
+{
+	portENTER_CRITICAL();
+	
+	int res = (udp_socket_find(port) != NULL);
+	
+	portEXIT_CRITICAL();
+	
+	return res;
+}
+
+
+udp_socket_t * udp_socket_lookup (int port)
+{
+	portENTER_CRITICAL();
+	
+	udp_socket_t * s = udp_socket_find(port);
+	
+	portEXIT_CRITICAL();
+	
+	if (s == NULL)
+	{
+		udp_stats.no_port ++;
+	}
+	
+	return s;
+}
+
+
+void udp_socket_drop (udp_socket_t * s)
+{
+	s->drop_count ++;
+	udp_stats.dropped ++;
+}
+
+
+void udp_socket_deliver (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port)
+{
+	udp_socket_queue_t * q = s->q;
+	
+	s->rx_count ++;
+	udp_stats.rx ++;
+	
+	if (q == NULL)
+	{
+		s->input(s, data, data_len, ipv4_src_addr, src_port);
+		return;
+	}
+	
+	uint8_t in = q->in;
+	
+	if ((((uint8_t) (in - q->out)) > q->mask) || (data_len > q->max_len))
+	{
+		udp_socket_drop(s);  // queue full or datagram too long for a slot
+		return;
+	}
+	
+	struct udp_socket_slot * slot = (struct udp_socket_slot *) (q->mem + (in & q->mask) * q->slot_size);
+	
+	slot->s = s;
+	slot->len = data_len;
+	slot->src_port = src_port;
+	memcpy(slot->src_addr, ipv4_src_addr, sizeof slot->src_addr);
+	memcpy(slot + 1, data, data_len);
+	
+	UDP_BARRIER();
+	q->in = in + 1;
+	
+	udp_stats.queued ++;
+}
+
+
+int udp_socket_queue_service (udp_socket_queue_t * q)
+{
+	uint8_t out = q->out;
+	int n = 0;
+	
+	while (q->in != out)
+	{
+		struct udp_socket_slot * slot = (struct udp_socket_slot *) (q->mem + (out & q->mask) * q->slot_size);
+		udp_socket_t * s = slot->s;
+		
+		if (s->port != 0) // not unbound in the meantime
+		{
+			s->input(s, (const uint8_t *) (slot + 1), slot->len, slot->src_addr, slot->src_port);
+		}
+		
+		out ++;
+		n ++;
+		
+		UDP_BARRIER();
+		q->out = out;
+	}
+	
+	return n;
+}
+
+
+int snmp_get_udp (int32_t arg, uint8_t * res, int * res_len, int maxlen)
+{
+	int32_t value = 0;
+	
+	switch (arg)
+	{
+		case 1:
+			value = udp_stats.rx;
+			break;
+		
+		case 2:
+			value = udp_stats.no_port;
+			break;
+		
+		case 3:
+			value = udp_stats.dropped;
+			break;
+		
+		case 4:
+			value = udp_stats.queued;
+			break;
+	}
+	
+	return snmp_encode_int( value, res, res_len, maxlen );
+}
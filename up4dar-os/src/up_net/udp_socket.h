@@ -0,0 +1,102 @@
+/*
+
+Copyright (C) 2015   Michael Dirska, DL1BFF (dl1bff@mdx.de)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * udp_socket.h
+ *
+ * UDP sockets: port demux and receive queues
+ *
+ */
+
+
+#ifndef UDP_SOCKET_H_
+#define UDP_SOCKET_H_
+
+
+struct udp_socket;
+struct udp_socket_queue;
+
+// data is the UDP data (without header), ipv4_src_addr has 4 bytes
+typedef void (* udp_socket_input_t) ( struct udp_socket * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port );
+
+typedef struct udp_socket
+{
+	struct udp_socket * next;		// hash chain
+	udp_socket_input_t input;
+	struct udp_socket_queue * q;	// NULL: input() is called by the Ethernet RX task
+	int arg;						// free for the owner of the socket
+	uint16_t port;					// 0: not bound
+	uint16_t read_len;				// input() reads only the first read_len data bytes (0: all)
+	uint32_t rx_count;				// datagrams for this socket
+	uint32_t drop_count;			// datagrams dropped: queue full, too long or no buffer
+} udp_socket_t;
+
+
+// bounded receive queue: the Ethernet RX task puts the datagrams in the
+// slots, the task that owns the sockets calls udp_socket_queue_service().
+// Several sockets can share one queue.
+
+struct udp_socket_slot
+{
+	udp_socket_t * s;
+	uint16_t len;
+	uint16_t src_port;
+	uint8_t src_addr[4];
+};
+
+typedef struct udp_socket_queue
+{
+	volatile uint8_t in;
+	volatile uint8_t out;
+	uint8_t mask;		// number of slots - 1, number of slots must be a power of two
+	uint16_t max_len;	// max. UDP data per slot
+	uint16_t slot_size;
+	uint8_t * mem;
+} udp_socket_queue_t;
+
+#define UDP_SOCKET_SLOT_SIZE(max_len)  ((sizeof (struct udp_socket_slot) + (max_len) + 3) & ~3)
+#define UDP_SOCKET_QUEUE_MEM(num_slots, max_len)  ((num_slots) * UDP_SOCKET_SLOT_SIZE(max_len))
+
+
+// s is a static socket, a bound socket is unbound first
+void udp_socket_init (udp_socket_t * s, udp_socket_input_t input, int arg, int read_len);
+void udp_socket_set_queue (udp_socket_t * s, udp_socket_queue_t * q);
+
+// mem must have UDP_SOCKET_QUEUE_MEM(num_slots, max_len) bytes
+void udp_socket_queue_init (udp_socket_queue_t * q, uint8_t * mem, int num_slots, int max_len);
+
+// a bound socket is unbound first, returns -1 if another socket uses the port
+int udp_socket_bind (udp_socket_t * s, int port);
+void udp_socket_unbind (udp_socket_t * s);
+
+int udp_socket_port_in_use (int port);
+
+// Ethernet RX task
+udp_socket_t * udp_socket_lookup (int port);
+void udp_socket_deliver (udp_socket_t * s, const uint8_t * data, int data_len,
+	const uint8_t * ipv4_src_addr, int src_port);
+void udp_socket_drop (udp_socket_t * s);
+
+// owner of the sockets, calls input() for the queued datagrams,
+// returns the number of datagrams
+int udp_socket_queue_service (udp_socket_queue_t * q);
+
+#endif /* UDP_SOCKET_H_ */